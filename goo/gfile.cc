@@ -43,6 +43,9 @@
 #  include <limits.h>
 #  include <string.h>
 #  include <pwd.h>
+#  ifdef HAVE_SYS_MMAN_H
+#    include <sys/mman.h>
+#  endif
 #endif // _WIN32
 #include <stdio.h>
 #include <limits>
@@ -384,6 +387,13 @@ GooFile* GooFile::open(const wchar_t *fileName) {
   return handle == INVALID_HANDLE_VALUE ? nullptr : new GooFile(handle);
 }
 
+const char *GooFile::map(Goffset * /*lengthA*/) const {
+  return nullptr;
+}
+
+void GooFile::unmap(const char * /*data*/, Goffset /*lengthA*/) {
+}
+
 bool GooFile::modificationTimeChangedSinceOpen() const
 {
   struct _FILETIME lastModified;
@@ -416,6 +426,32 @@ GooFile* GooFile::open(const GooString *fileName) {
   return fd < 0 ? nullptr : new GooFile(fd);
 }
 
+const char *GooFile::map(Goffset *lengthA) const {
+#ifdef HAVE_SYS_MMAN_H
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_size <= 0) {
+    return nullptr;
+  }
+  if ((unsigned long long)statbuf.st_size > std::numeric_limits<size_t>::max()) {
+    return nullptr;
+  }
+  void *data = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  *lengthA = statbuf.st_size;
+  return (const char *)data;
+#else
+  return nullptr;
+#endif
+}
+
+void GooFile::unmap(const char *data, Goffset lengthA) {
+#ifdef HAVE_SYS_MMAN_H
+  munmap((void *)data, lengthA);
+#endif
+}
+
 GooFile::GooFile(int fdA)
  : fd(fdA)
 {
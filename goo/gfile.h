@@ -119,6 +119,14 @@ public:
 
   int read(char *buf, int n, Goffset offset) const;
   Goffset size() const;
+
+  // Map the whole file read-only into memory and return its length in
+  // <lengthA>. Returns nullptr if the file can't be mapped, e.g. because
+  // it is empty, not a regular file or mapping is not supported on this
+  // platform. The mapping outlives the GooFile and has to be released
+  // with unmap().
+  const char *map(Goffset *lengthA) const;
+  static void unmap(const char *data, Goffset lengthA);
   
   static GooFile *open(const GooString *fileName);
   
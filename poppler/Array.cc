@@ -56,6 +56,16 @@ Object Array::copy(XRef *xrefA) const {
   return Object(a);
 }
 
+Object Array::deepCopy() const {
+  arrayLocker();
+  Array *a = new Array(xref);
+  a->elems.reserve(elems.size());
+  for (const auto& elem : elems) {
+    a->elems.push_back(elem.deepCopy());
+  }
+  return Object(a);
+}
+
 void Array::add(Object &&elem) {
   arrayLocker();
   elems.push_back(std::move(elem));
@@ -59,6 +59,9 @@ public:
   // Copy array with new xref
   Object copy(XRef *xrefA) const;
 
+  // Copy array and the arrays and dicts it contains
+  Object deepCopy() const;
+
   // Add an element
   // elem becomes a dead object after this call
   void add(Object &&elem);
@@ -13,6 +13,10 @@
 
 #include <config.h>
 #include "CachedFile.h"
+#include "CachedFileStore.h"
+#include "GlobalParams.h"
+
+#include <algorithm>
 
 //------------------------------------------------------------------------
 // CachedFile
@@ -20,18 +24,32 @@
 
 CachedFile::CachedFile(CachedFileLoader *cachedFileLoaderA, GooString *uriA)
 {
+  std::string storeDir, storeKey;
+
   uri = uriA;
   loader = cachedFileLoaderA;
+  store = nullptr;
 
   streamPos = 0;
   chunks = new std::vector<Chunk>();
   length = 0;
+  stopPrefetch = false;
 
   length = loader->init(uri, this);
   refCnt = 1;
 
   if (length != ((size_t) -1)) {
     chunks->resize(length/CachedFileChunkSize + 1);
+
+    if (globalParams &&
+        !(storeDir = globalParams->getChunkCacheDir()).empty() &&
+        !(storeKey = loader->getCacheKey()).empty()) {
+      store = new CachedFileStore(storeDir, storeKey, globalParams->getChunkCacheSize());
+      if (!store->isOk()) {
+        delete store;
+        store = nullptr;
+      }
+    }
   }
   else {
     error(errInternal, -1, "Failed to initialize file cache for '{0:t}'.", uri);
@@ -41,6 +59,16 @@ CachedFile::CachedFile(CachedFileLoader *cachedFileLoaderA, GooString *uriA)
 
 CachedFile::~CachedFile()
 {
+  {
+    std::lock_guard<std::mutex> locker(mutex);
+    stopPrefetch = true;
+  }
+  chunkCond.notify_all();
+  if (prefetchThread.joinable()) {
+    prefetchThread.join();
+  }
+
+  delete store;
   delete uri;
   delete loader;
   delete chunks;
@@ -77,15 +105,108 @@ int CachedFile::seek(long int offset, int origin)
   return 0;
 }
 
+void CachedFile::getChunkRange(const ByteRange &range, int *startChunk, int *endChunk)
+{
+  size_t start, end;
+
+  if (range.length == 0 || range.offset >= length) {
+    *startChunk = 0;
+    *endChunk = -1;
+    return;
+  }
+  start = range.offset;
+  end = start + range.length - 1;
+  if (end >= length) end = length - 1;
+  *startChunk = start / CachedFileChunkSize;
+  *endChunk = end / CachedFileChunkSize;
+}
+
+size_t CachedFile::getChunkLength(int chunk)
+{
+  return std::min((size_t)CachedFileChunkSize, length - chunk * CachedFileChunkSize);
+}
+
+// Load the chunks of <chunkList>, sorted and all in chunkStateLoading,
+// from the store or else with one range per run of adjacent chunks.
+// The mutex must not be locked.
+int CachedFile::loadChunks(std::vector<int> *chunkList)
+{
+  std::vector<ByteRange> chunk_ranges;
+  std::vector<int> missing;
+  ByteRange range;
+  size_t i, j;
+  int result;
+
+  std::unique_lock<std::mutex> loaderLocker(loaderMutex);
+
+  if (store) {
+    for (int chunk : *chunkList) {
+      if (store->read(chunk, (*chunks)[chunk].data, getChunkLength(chunk))) {
+        std::lock_guard<std::mutex> locker(mutex);
+        (*chunks)[chunk].state = chunkStateLoaded;
+        chunkCond.notify_all();
+      } else {
+        missing.push_back(chunk);
+      }
+    }
+  } else {
+    missing = *chunkList;
+  }
+
+  for (i = 0; i < missing.size(); i = j) {
+    for (j = i + 1; j < missing.size() && missing[j] == missing[j - 1] + 1; ++j) ;
+    range.offset = missing[i] * CachedFileChunkSize;
+    range.length = (j - i) * CachedFileChunkSize;
+    chunk_ranges.push_back(range);
+  }
+
+  result = 0;
+  if (!chunk_ranges.empty()) {
+    CachedFileWriter writer =
+        CachedFileWriter(this, &missing);
+    result = loader->load(chunk_ranges, &writer);
+  }
+
+  std::unique_lock<std::mutex> locker(mutex);
+  if (store) {
+    // loaded chunks are only read from now on, so they can be written
+    // out without the mutex
+    for (i = 0, j = 0; i < missing.size(); ++i) {
+      if ((*chunks)[missing[i]].state == chunkStateLoaded) {
+        missing[j++] = missing[i];
+      }
+    }
+    missing.resize(j);
+    locker.unlock();
+    for (int chunk : missing) {
+      store->write(chunk, (*chunks)[chunk].data, getChunkLength(chunk));
+    }
+    locker.lock();
+  }
+  loaderLocker.unlock();
+
+  // chunks the loader didn't deliver can be requested again
+  for (int chunk : *chunkList) {
+    if ((*chunks)[chunk].state != chunkStateLoaded) {
+      (*chunks)[chunk].state = chunkStateNew;
+      if (result == 0) {
+        result = -1;
+      }
+    }
+  }
+  chunkCond.notify_all();
+  return result;
+}
+
 int CachedFile::cache(const std::vector<ByteRange> &origRanges)
 {
   std::vector<int> loadChunks;
-  int numChunks = length/CachedFileChunkSize + 1;
-  std::vector<bool> chunkNeeded(numChunks);
   int startChunk, endChunk;
-  std::vector<ByteRange> chunk_ranges, all;
+  std::vector<ByteRange> all;
   ByteRange range;
   const std::vector<ByteRange> *ranges = &origRanges;
+  bool loading;
+  int result;
 
   if (ranges->empty()) {
     range.offset = 0;
@@ -94,51 +215,119 @@ int CachedFile::cache(const std::vector<ByteRange> &origRanges)
     ranges = &all;
   }
 
-  for (int i = 0; i < numChunks; ++i)
-    chunkNeeded[i] = false;
-  for (size_t i = 0; i < ranges->size(); i++) {
-
-    if ((*ranges)[i].length == 0) continue;
-    if ((*ranges)[i].offset >= length) continue;
-
-    size_t start = (*ranges)[i].offset;
-    size_t end = start + (*ranges)[i].length - 1;
-    if (end >= length) end = length - 1;
-
-    startChunk = start / CachedFileChunkSize;
-    endChunk = end / CachedFileChunkSize;
-    for (int chunk = startChunk; chunk <= endChunk; chunk++) {
-      if ((*chunks)[chunk].state == chunkStateNew) {
-           chunkNeeded[chunk] = true;
+  std::unique_lock<std::mutex> locker(mutex);
+  for (;;) {
+    // take the chunks nobody is loading, and wait for the others
+    loadChunks.clear();
+    loading = false;
+    for (size_t i = 0; i < ranges->size(); i++) {
+      getChunkRange((*ranges)[i], &startChunk, &endChunk);
+      for (int chunk = startChunk; chunk <= endChunk; chunk++) {
+        if ((*chunks)[chunk].state == chunkStateNew) {
+          (*chunks)[chunk].state = chunkStateLoading;
+          loadChunks.push_back(chunk);
+        } else if ((*chunks)[chunk].state == chunkStateLoading) {
+          loading = true;
+        }
       }
     }
-  }
 
-  int chunk = 0;
-  while (chunk < numChunks) {
-    while (!chunkNeeded[chunk] && (++chunk != numChunks)) ;
-    if (chunk == numChunks) break;
-    startChunk = chunk;
-    loadChunks.push_back(chunk);
-
-    while ((++chunk != numChunks) && chunkNeeded[chunk]) {
-      loadChunks.push_back(chunk);
+    if (!loadChunks.empty()) {
+      std::sort(loadChunks.begin(), loadChunks.end());
+      locker.unlock();
+      result = this->loadChunks(&loadChunks);
+      locker.lock();
+      if (result != 0) {
+        return result;
+      }
+    } else if (loading) {
+      chunkCond.wait(locker);
+    } else {
+      return 0;
     }
-    endChunk = chunk - 1;
+  }
+}
 
-    range.offset = startChunk * CachedFileChunkSize;
-    range.length = (endChunk - startChunk + 1) * CachedFileChunkSize;
+void CachedFile::prefetch(const std::vector<ByteRange> &ranges)
+{
+  std::lock_guard<std::mutex> locker(mutex);
 
-    chunk_ranges.push_back(range);
+  if (chunks->empty()) {
+    return;
   }
-
-  if (chunk_ranges.size() > 0) {
-    CachedFileWriter writer =
-        CachedFileWriter(this, &loadChunks);
-    return loader->load(chunk_ranges, &writer);
+  if (!prefetchThread.joinable()) {
+    prefetchThread = std::thread(&CachedFile::prefetchLoop, this);
   }
+  prefetchQueue.push_back(ranges);
+  chunkCond.notify_all();
+}
 
-  return 0;
+void CachedFile::prefetchLoop()
+{
+  std::vector<ByteRange> ranges;
+  std::vector<int> needed, loadChunks;
+  int startChunk, endChunk, chunk, gap;
+  size_t i;
+
+  std::unique_lock<std::mutex> locker(mutex);
+  for (;;) {
+    chunkCond.wait(locker, [this] { return stopPrefetch || !prefetchQueue.empty(); });
+    if (stopPrefetch) {
+      return;
+    }
+    ranges = std::move(prefetchQueue.front());
+    prefetchQueue.pop_front();
+
+    needed.clear();
+    for (const ByteRange &range : ranges) {
+      getChunkRange(range, &startChunk, &endChunk);
+      for (chunk = startChunk; chunk <= endChunk; chunk++) {
+        needed.push_back(chunk);
+      }
+    }
+    std::sort(needed.begin(), needed.end());
+    needed.erase(std::unique(needed.begin(), needed.end()), needed.end());
+
+    // load the needed chunks nobody has loaded yet, joining runs
+    // separated by short gaps into one request
+    i = 0;
+    while (i < needed.size() && !stopPrefetch) {
+      loadChunks.clear();
+      for (; i < needed.size(); ++i) {
+        chunk = needed[i];
+        if ((*chunks)[chunk].state != chunkStateNew) {
+          if (loadChunks.empty()) {
+            continue;
+          }
+          break;
+        }
+        if (!loadChunks.empty()) {
+          if (chunk - loadChunks.back() - 1 > CachedFilePrefetchMaxGap ||
+              chunk - loadChunks.front() >= CachedFilePrefetchMaxChunks) {
+            break;
+          }
+          for (gap = loadChunks.back() + 1;
+               gap < chunk && (*chunks)[gap].state == chunkStateNew;
+               ++gap) ;
+          if (gap < chunk) {
+            break;
+          }
+          for (gap = loadChunks.back() + 1; gap < chunk; ++gap) {
+            (*chunks)[gap].state = chunkStateLoading;
+            loadChunks.push_back(gap);
+          }
+        }
+        (*chunks)[chunk].state = chunkStateLoading;
+        loadChunks.push_back(chunk);
+      }
+      if (loadChunks.empty()) {
+        break;
+      }
+      locker.unlock();
+      this->loadChunks(&loadChunks);
+      locker.lock();
+    }
+  }
 }
 
 size_t CachedFile::read(void *ptr, size_t unitsize, size_t count)
@@ -201,6 +390,13 @@ CachedFileWriter::~CachedFileWriter()
 {
 }
 
+void CachedFileWriter::setLoaded(size_t chunk)
+{
+  std::lock_guard<std::mutex> locker(cachedFile->mutex);
+  (*cachedFile->chunks)[chunk].state = CachedFile::chunkStateLoaded;
+  cachedFile->chunkCond.notify_all();
+}
+
 size_t CachedFileWriter::write(const char *ptr, size_t size)
 {
   const char *cp = ptr;
@@ -241,13 +437,13 @@ size_t CachedFileWriter::write(const char *ptr, size_t size)
     }
 
     if (offset == CachedFileChunkSize) {
-       (*cachedFile->chunks)[chunk].state = CachedFile::chunkStateLoaded;
+       setLoaded(chunk);
     }
   }
 
   if ((chunk == (cachedFile->length / CachedFileChunkSize)) &&
       (offset == (cachedFile->length % CachedFileChunkSize))) {
-     (*cachedFile->chunks)[chunk].state = CachedFile::chunkStateLoaded;
+     setLoaded(chunk);
   }
 
   return written;
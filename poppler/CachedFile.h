@@ -20,14 +20,29 @@
 #include "Object.h"
 #include "Stream.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 //------------------------------------------------------------------------
 
 #define CachedFileChunkSize 8192 // This should be a multiple of cachedStreamBufSize
 
+// most chunks loaded with one prefetch request
+#define CachedFilePrefetchMaxChunks 64
+
+// longest run of unneeded chunks a prefetch request is extended over
+// to join two runs of needed ones, as that is cheaper than one more
+// request
+#define CachedFilePrefetchMaxGap 4
+
 class GooString;
 class CachedFileLoader;
+class CachedFileStore;
 
 //------------------------------------------------------------------------
 // CachedFile
@@ -36,6 +51,16 @@ class CachedFileLoader;
 // In the constructor, you specify a CachedFileLoader that handles loading
 // the data from the document. The CachedFile requests no more data then it
 // needs from the CachedFileLoader.
+//
+// Byte ranges that will be needed soon can be handed to prefetch(): a
+// background thread then loads them, with one request per run of
+// adjacent chunks.  Reads of chunks being loaded wait for them instead
+// of requesting them again.  The loader is never called from two
+// threads at once.
+//
+// If the loader can identify the contents of the file and
+// GlobalParams has a chunk cache directory, the chunks are also kept
+// on disk in a CachedFileStore, which is consulted before the loader.
 //------------------------------------------------------------------------
 
 class CachedFile {
@@ -56,6 +81,10 @@ public:
   size_t write(const char *ptr, size_t size, size_t fromByte);
   int cache(const std::vector<ByteRange> &ranges);
 
+  // Start loading <ranges> in the background.  Ranges already loaded or
+  // being loaded are skipped.
+  void prefetch(const std::vector<ByteRange> &ranges);
+
   // Reference counting.
   void incRefCnt();
   void decRefCnt();
@@ -66,6 +95,7 @@ private:
 
   enum ChunkState {
     chunkStateNew = 0,
+    chunkStateLoading,
     chunkStateLoaded
   };
 
@@ -75,8 +105,13 @@ private:
   } Chunk;
 
   int cache(size_t offset, size_t length);
+  size_t getChunkLength(int chunk);
+  void getChunkRange(const ByteRange &range, int *startChunk, int *endChunk);
+  int loadChunks(std::vector<int> *loadChunks);
+  void prefetchLoop();
 
   CachedFileLoader *loader;
+  CachedFileStore *store;
   GooString *uri;
 
   size_t length;
@@ -84,7 +119,16 @@ private:
 
   std::vector<Chunk> *chunks;
 
-  int refCnt;  // reference count
+  std::atomic_int refCnt;  // reference count
+
+  // The state of the chunks and the prefetch queue are guarded by mutex;
+  // chunkCond is signalled when chunks finish loading or are queued.
+  std::mutex mutex;
+  std::condition_variable chunkCond;
+  std::mutex loaderMutex;
+  std::deque<std::vector<ByteRange>> prefetchQueue;
+  std::thread prefetchThread;
+  bool stopPrefetch;
 
 };
 
@@ -111,6 +155,8 @@ public:
 
 private:
 
+  void setLoaded(size_t chunk);
+
   CachedFile *cachedFile;
   std::vector<int> *chunks;
   std::vector<int>::iterator it;
@@ -145,6 +191,11 @@ public:
   // The caller is responsible for deleting the writer.
   virtual int load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer) = 0;
 
+  // Returns a key that identifies the contents of the file, such as its
+  // URL, entity tag and length, once init() has been called.  Chunks
+  // are only kept on disk for loaders that return a non-empty key.
+  virtual std::string getCacheKey() { return std::string(); }
+
 };
 
 //------------------------------------------------------------------------
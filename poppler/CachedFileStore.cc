@@ -0,0 +1,270 @@
+//========================================================================
+//
+// CachedFileStore.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include "CachedFileStore.h"
+#include "goo/GooString.h"
+#include "goo/gdir.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+#include <algorithm>
+#include <vector>
+
+// marks the start of each record of a store file; changes with the
+// format, which is also part of the file names
+#define storeRecordMagic 0x32484350
+#define storeFileSuffix ".v2.chunks"
+
+// chunk number of the record that holds the key of a store file
+#define storeKeyRecord 0xffffffff
+
+// bytes appended between two checks of the size of the directory
+#define storeEvictInterval (4 * 1024 * 1024)
+
+// Each record of a store file starts with this header, followed by
+// <length> bytes of data.  The first record holds the key.
+struct StoreRecordHeader {
+  unsigned int magic;
+  unsigned int chunk;
+  unsigned int length;
+  unsigned int crc;		// CRC-32 of the data
+};
+
+// CRC-32 (ISO 3309) of <len> bytes of <data>.
+static unsigned int crc32(const char *data, size_t len) {
+  static const std::vector<unsigned int> table = [] {
+    std::vector<unsigned int> t(256);
+    for (unsigned int i = 0; i < 256; ++i) {
+      unsigned int c = i;
+      for (int k = 0; k < 8; ++k) {
+	c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+  unsigned int crc = 0xffffffff;
+
+  for (size_t i = 0; i < len; ++i) {
+    crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc ^ 0xffffffff;
+}
+
+static std::string getStoreFileName(const std::string &key) {
+  unsigned long long h;
+  char buf[32];
+
+  // FNV-1a
+  h = 14695981039346656037ULL;
+  for (unsigned char c : key) {
+    h = (h ^ c) * 1099511628211ULL;
+  }
+  snprintf(buf, sizeof(buf), "%016llx" storeFileSuffix, h);
+  return buf;
+}
+
+//------------------------------------------------------------------------
+// CachedFileStore
+//------------------------------------------------------------------------
+
+CachedFileStore::CachedFileStore(const std::string &dirA, const std::string &keyA,
+				 size_t maxBytesA)
+{
+  GooString *path;
+
+  dir = dirA;
+  key = keyA;
+  maxBytes = maxBytesA;
+  readFile = nullptr;
+  appendFile = nullptr;
+  fileSize = 0;
+  bytesSinceEvict = 0;
+  ok = false;
+
+  path = new GooString(dir.c_str());
+  appendToPath(path, getStoreFileName(key).c_str());
+  fileName = path->toStr();
+  delete path;
+
+  if ((readFile = openFile(fileName.c_str(), "rb"))) {
+    if (!readIndex()) {
+      // another file with the same hash, or a store file that is just
+      // being created
+      fclose(readFile);
+      readFile = nullptr;
+      return;
+    }
+    // mark it as recently used
+    utime(fileName.c_str(), nullptr);
+  }
+
+  if ((appendFile = openFile(fileName.c_str(), "ab"))) {
+    // each record is written with a single write, so that records
+    // appended by other processes don't get mixed up with it
+    setvbuf(appendFile, nullptr, _IONBF, 0);
+    if (!readFile) {
+      writeRecord(storeKeyRecord, key.data(), key.size());
+      readFile = openFile(fileName.c_str(), "rb");
+    }
+    evict();
+  }
+  ok = readFile != nullptr;
+}
+
+CachedFileStore::~CachedFileStore()
+{
+  if (readFile) {
+    fclose(readFile);
+  }
+  if (appendFile) {
+    fclose(appendFile);
+  }
+}
+
+bool CachedFileStore::readIndex()
+{
+  StoreRecordHeader hdr;
+  std::vector<char> buf;
+  Goffset pos, dataPos;
+  bool haveKey;
+
+  Gfseek(readFile, 0, SEEK_END);
+  fileSize = Gftell(readFile);
+  haveKey = false;
+  pos = 0;
+  while (pos + (Goffset)sizeof(hdr) <= fileSize) {
+    Gfseek(readFile, pos, SEEK_SET);
+    if (fread(&hdr, sizeof(hdr), 1, readFile) != 1 || hdr.magic != storeRecordMagic) {
+      break;
+    }
+    dataPos = pos + sizeof(hdr);
+    if (hdr.length > fileSize - dataPos) {
+      // cut short
+      break;
+    }
+    if (hdr.chunk == storeKeyRecord) {
+      // processes creating the file at the same time both write a key
+      buf.resize(hdr.length);
+      if (hdr.length != key.size() ||
+	  fread(buf.data(), 1, hdr.length, readFile) != hdr.length ||
+	  memcmp(buf.data(), key.data(), hdr.length)) {
+	return false;
+      }
+      haveKey = true;
+    } else if (!haveKey) {
+      return false;
+    } else {
+      // a chunk is only written again if an earlier record was bad
+      index[hdr.chunk] = Entry{dataPos, hdr.length, hdr.crc};
+    }
+    pos = dataPos + hdr.length;
+  }
+  return haveKey;
+}
+
+bool CachedFileStore::read(int chunk, char *data, size_t len)
+{
+  auto it = index.find(chunk);
+
+  if (it == index.end() || it->second.length != len) {
+    return false;
+  }
+  // a record cut short by a crash or a full disk may run into the next one
+  if (Gfseek(readFile, it->second.offset, SEEK_SET) != 0 ||
+      fread(data, 1, len, readFile) != len ||
+      crc32(data, len) != it->second.crc) {
+    index.erase(it);
+    return false;
+  }
+  return true;
+}
+
+void CachedFileStore::write(int chunk, const char *data, size_t len)
+{
+  if (!appendFile || (size_t)fileSize + sizeof(StoreRecordHeader) + len > maxBytes) {
+    return;
+  }
+  writeRecord(chunk, data, len);
+  if (bytesSinceEvict >= storeEvictInterval) {
+    evict();
+  }
+}
+
+void CachedFileStore::writeRecord(unsigned int chunk, const char *data, size_t len)
+{
+  std::vector<char> record(sizeof(StoreRecordHeader) + len);
+  StoreRecordHeader hdr;
+
+  hdr.magic = storeRecordMagic;
+  hdr.chunk = chunk;
+  hdr.length = len;
+  hdr.crc = crc32(data, len);
+  memcpy(record.data(), &hdr, sizeof(hdr));
+  memcpy(record.data() + sizeof(hdr), data, len);
+  if (fwrite(record.data(), 1, record.size(), appendFile) == record.size()) {
+    fileSize += record.size();
+    bytesSinceEvict += record.size();
+  } else {
+    // other processes may have appended since, so the partial record
+    // can't be cut off; its CRC keeps it from being read
+    fclose(appendFile);
+    appendFile = nullptr;
+  }
+}
+
+// Remove the least recently used store files of the directory until
+// they take at most maxBytes bytes.
+void CachedFileStore::evict()
+{
+  struct StoreFile {
+    std::string path;
+    Goffset size;
+    time_t mtime;
+  };
+  std::vector<StoreFile> files;
+  GDirEntry *entry;
+  struct stat st;
+  Goffset total;
+
+  bytesSinceEvict = 0;
+  total = 0;
+  GDir gdir(dir.c_str(), false);
+  while ((entry = gdir.getNextEntry())) {
+    const GooString *name = entry->getName();
+    // store files of older formats too
+    if (name->getLength() > 7 && !strcmp(name->c_str() + name->getLength() - 7, ".chunks") &&
+	stat(entry->getFullPath()->c_str(), &st) == 0) {
+      files.push_back(StoreFile{entry->getFullPath()->toStr(), (Goffset)st.st_size, st.st_mtime});
+      total += st.st_size;
+    }
+    delete entry;
+  }
+  if (total <= (Goffset)maxBytes) {
+    return;
+  }
+
+  std::sort(files.begin(), files.end(), [](const StoreFile &a, const StoreFile &b) {
+    return a.mtime < b.mtime;
+  });
+  for (const StoreFile &file : files) {
+    if (total <= (Goffset)maxBytes) {
+      break;
+    }
+    if (file.path != fileName && remove(file.path.c_str()) == 0) {
+      total -= file.size;
+    }
+  }
+}
@@ -0,0 +1,83 @@
+//========================================================================
+//
+// CachedFileStore.h
+//
+// On-disk store of CachedFile chunks.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef CACHEDFILESTORE_H
+#define CACHEDFILESTORE_H
+
+#include "poppler-config.h"
+#include "goo/gfile.h"
+
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+
+//------------------------------------------------------------------------
+// CachedFileStore
+//
+// Keeps the chunks a CachedFile downloads in a directory, so that the
+// next time the same file is opened, in this process or another one,
+// they don't have to be downloaded again.  The chunks of a file are
+// appended to one store file, named after a hash of the key that
+// identifies the contents of the file (e.g. its URL, entity tag and
+// length).  Once the store files in the directory take more than the
+// given number of bytes, the least recently used ones are removed.
+// Each chunk is stored with a CRC-32 of its data, so that a record left
+// incomplete by a crash or a failed write is never read back.
+//
+// A CachedFileStore isn't thread safe; CachedFile only uses it with its
+// loader mutex locked.
+//------------------------------------------------------------------------
+
+class CachedFileStore {
+public:
+
+  CachedFileStore(const std::string &dirA, const std::string &keyA, size_t maxBytesA);
+  ~CachedFileStore();
+
+  CachedFileStore(const CachedFileStore &) = delete;
+  CachedFileStore& operator=(const CachedFileStore &) = delete;
+
+  // Check if the store file could be opened.
+  bool isOk() const { return ok; }
+
+  // Read chunk <chunk>, which must have <len> bytes, into <data>.
+  // Returns false if the chunk isn't in the store, or if its data
+  // doesn't match the CRC stored with it.
+  bool read(int chunk, char *data, size_t len);
+
+  // Add chunk <chunk>.
+  void write(int chunk, const char *data, size_t len);
+
+private:
+
+  struct Entry {
+    Goffset offset;		// offset of the chunk's data
+    size_t length;
+    unsigned int crc;		// CRC-32 of the chunk's data
+  };
+
+  bool readIndex();
+  void writeRecord(unsigned int chunk, const char *data, size_t len);
+  void evict();
+
+  std::string dir;
+  std::string key;
+  size_t maxBytes;
+  std::string fileName;
+
+  FILE *readFile;			// the store file, for reading
+  FILE *appendFile;			// the store file, for appending
+  Goffset fileSize;			// size of the store file
+  std::unordered_map<int, Entry> index;	// chunks in the store file
+  size_t bytesSinceEvict;		// bytes appended since the last evict()
+  bool ok;
+};
+
+#endif
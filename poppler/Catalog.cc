@@ -61,6 +61,7 @@
 #include "ViewerPreferences.h"
 #include "FileSpec.h"
 #include "StructTreeRoot.h"
+#include "Gfx.h"
 
 //------------------------------------------------------------------------
 // Catalog
@@ -84,6 +85,8 @@ Catalog::Catalog(PDFDoc *docA) {
   jsNameTree = nullptr;
   viewerPrefs = nullptr;
   structTreeRoot = nullptr;
+  contentCache = nullptr;
+  imageCache = nullptr;
 
   pagesList = nullptr;
   pagesRefList = nullptr;
@@ -148,6 +151,8 @@ Catalog::~Catalog() {
   delete optContent;
   delete viewerPrefs;
   delete structTreeRoot;
+  delete contentCache;
+  delete imageCache;
 }
 
 GooString *Catalog::readMetadata() {
@@ -1090,3 +1095,19 @@ LinkAction* Catalog::getAdditionalAction(DocumentAdditionalActionsType type) {
   }
   return linkAction;
 }
+
+GfxContentCache *Catalog::getContentCache() {
+  catalogLocker();
+  if (!contentCache) {
+    contentCache = new GfxContentCache();
+  }
+  return contentCache;
+}
+
+GfxImageCache *Catalog::getImageCache() {
+  catalogLocker();
+  if (!imageCache) {
+    imageCache = new GfxImageCache();
+  }
+  return imageCache;
+}
@@ -57,6 +57,8 @@ class OCGs;
 class ViewerPreferences;
 class FileSpec;
 class StructTreeRoot;
+class GfxContentCache;
+class GfxImageCache;
 
 //------------------------------------------------------------------------
 // NameTree
@@ -249,6 +251,12 @@ public:
 
   LinkAction *getAdditionalAction(DocumentAdditionalActionsType type);
 
+  // Parsed content streams of the document's pages and forms.
+  GfxContentCache *getContentCache();
+
+  // Decoded images of the document's Image XObjects.
+  GfxImageCache *getImageCache();
+
 private:
 
   // Get page label info.
@@ -282,6 +290,8 @@ private:
   PageMode pageMode;		// page mode
   PageLayout pageLayout;	// page layout
   Object additionalActions;     // page additional actions
+  GfxContentCache *contentCache;	// parsed content streams
+  GfxImageCache *imageCache;	// decoded images
 
   bool cachePageTree(int page); // Cache first <page> pages.
   Object *findDestInTree(Object *tree, GooString *name, Object *obj);
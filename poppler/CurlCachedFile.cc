@@ -16,6 +16,13 @@
 
 #include "goo/GooString.h"
 
+#include <string.h>
+#ifdef _MSC_VER
+#  define strncasecmp strnicmp
+#else
+#  include <strings.h>
+#endif
+
 //------------------------------------------------------------------------
 
 CurlCachedFileLoader::CurlCachedFileLoader()
@@ -23,6 +30,7 @@ CurlCachedFileLoader::CurlCachedFileLoader()
   url = nullptr;
   cachedFile = nullptr;
   curl = nullptr;
+  size = (size_t)-1;
 }
 
 CurlCachedFileLoader::~CurlCachedFileLoader() {
@@ -35,12 +43,35 @@ noop_cb(char *ptr, size_t size, size_t nmemb, void *ptr2)
   return size*nmemb;
 }
 
+// Keep the value of the ETag header, or else of the Last-Modified one,
+// which tell whether the file changed.
+static size_t
+header_cb(char *ptr, size_t size, size_t nmemb, void *data)
+{
+  std::string *validator = (std::string *) data;
+  size_t len = size*nmemb;
+  size_t nameLen;
+
+  if (len > 5 && !strncasecmp(ptr, "ETag:", 5)) {
+    nameLen = 5;
+  } else if (len > 14 && !strncasecmp(ptr, "Last-Modified:", 14) &&
+             (validator->empty() || (*validator)[0] == 'M')) {
+    nameLen = 14;
+  } else {
+    return len;
+  }
+  std::string value(ptr + nameLen, len - nameLen);
+  value.erase(0, value.find_first_not_of(" \t"));
+  value.erase(value.find_last_not_of(" \t\r\n") + 1);
+  *validator = (nameLen == 5 ? "E" : "M") + value;
+  return len;
+}
+
 size_t
 CurlCachedFileLoader::init(GooString *urlA, CachedFile *cachedFileA)
 {
   double contentLength = -1;
   long code = 0;
-  size_t size;
 
   url = urlA;
   cachedFile = cachedFileA;
@@ -50,6 +81,8 @@ CurlCachedFileLoader::init(GooString *urlA, CachedFile *cachedFileA)
   curl_easy_setopt(curl, CURLOPT_HEADER, 1);
   curl_easy_setopt(curl, CURLOPT_NOBODY, 1);
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &noop_cb);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &header_cb);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &validator);
   curl_easy_perform(curl);
   curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
   if (code) {
@@ -95,5 +128,14 @@ int CurlCachedFileLoader::load(const std::vector<ByteRange> &ranges, CachedFileW
   return r;
 }
 
+std::string CurlCachedFileLoader::getCacheKey()
+{
+  // without a validator there is no telling whether the file changed
+  if (validator.empty() || size == (size_t)-1) {
+    return std::string();
+  }
+  return url->toStr() + '\n' + validator + '\n' + std::to_string(size);
+}
+
 //------------------------------------------------------------------------
 
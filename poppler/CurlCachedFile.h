@@ -27,12 +27,15 @@ public:
   ~CurlCachedFileLoader();
   size_t init(GooString *url, CachedFile* cachedFile) override;
   int load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer) override;
+  std::string getCacheKey() override;
 
 private:
 
   GooString *url;
   CachedFile *cachedFile;
   CURL *curl;
+  size_t size;
+  std::string validator;	// ETag or Last-Modified header of the file
 
 };
 
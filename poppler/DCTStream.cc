@@ -64,6 +64,7 @@ static void str_term_source(j_decompress_ptr cinfo)
 DCTStream::DCTStream(Stream *strA, int colorXformA, Dict *dict, int recursion) :
   FilterStream(strA) {
   colorXform = colorXformA;
+  scaleDenom = 1;
   if (dict != nullptr) {
     Object obj = dict->lookup("Width", recursion);
     err.width = (obj.isInt() && obj.getInt() <= JPEG_MAX_DIMENSION) ? obj.getInt() : 0;
@@ -115,7 +116,11 @@ void DCTStream::init()
 }
 
 void DCTStream::reset() {
-  int row_stride;
+  int row_stride, denom;
+
+  // the reduced size only applies to the reset() after setReducedSize()
+  denom = scaleDenom;
+  scaleDenom = 1;
 
   str->reset();
 
@@ -188,6 +193,9 @@ void DCTStream::reset() {
 	break;
       }
 
+      cinfo.scale_num = 1;
+      cinfo.scale_denom = denom;
+
       jpeg_start_decompress(&cinfo);
 
       row_stride = cinfo.output_width * cinfo.output_components;
@@ -247,6 +255,29 @@ int DCTStream::lookChar() {
   return *current;
 }
 
+// libjpeg can decode at 1/2, 1/4 and 1/8 of the size by using fewer
+// DCT coefficients, which is much faster than decoding the whole image
+// to scale it down afterwards.
+bool DCTStream::setReducedSize(int *width, int *height, int minWidth, int minHeight) {
+  int denom, w, h;
+
+  // the reduced size is computed from the size in the image dictionary
+  if (*width != err.width || *height != err.height) {
+    return false;
+  }
+  for (denom = 8; denom > 1; denom /= 2) {
+    w = (*width + denom - 1) / denom;
+    h = (*height + denom - 1) / denom;
+    if (w >= minWidth && h >= minHeight) {
+      scaleDenom = denom;
+      *width = w;
+      *height = h;
+      return true;
+    }
+  }
+  return false;
+}
+
 GooString *DCTStream::getPSFilter(int psLevel, const char *indent) {
   GooString *s;
 
@@ -63,6 +63,7 @@ public:
   int lookChar() override;
   GooString *getPSFilter(int psLevel, const char *indent) override;
   bool isBinary(bool last = true) override;
+  bool setReducedSize(int *width, int *height, int minWidth, int minHeight) override;
 
 private:
   void init();
@@ -71,6 +72,7 @@ private:
   int getChars(int nChars, unsigned char *buffer) override;
 
   int colorXform;
+  int scaleDenom;		// decode at 1/scaleDenom of the full size
   JSAMPLE *current;
   JSAMPLE *limit;
   struct jpeg_decompress_struct cinfo;
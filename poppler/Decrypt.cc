@@ -50,7 +50,6 @@ static void aes256KeyExpansion(DecryptAES256State *s, unsigned char *objKey, int
 static void aes256EncryptBlock(DecryptAES256State *s, unsigned char *in);
 static void aes256DecryptBlock(DecryptAES256State *s, unsigned char *in, bool last);
 
-static void sha256(unsigned char *msg, int msgLen, unsigned char *hash);
 static void sha384(unsigned char *msg, int msgLen, unsigned char *hash);
 static void sha512(unsigned char *msg, int msgLen, unsigned char *hash);
 
@@ -1463,7 +1462,7 @@ static void sha256HashBlock(unsigned char *blk, unsigned int *H) {
   H[7] += h;
 }
 
-static void sha256(unsigned char *msg, int msgLen, unsigned char *hash) {
+void sha256(unsigned char *msg, int msgLen, unsigned char *hash) {
   unsigned char blk[64];
   unsigned int H[8];
   int blkLen, i;
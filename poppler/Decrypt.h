@@ -152,5 +152,6 @@ public:
 //------------------------------------------------------------------------
 
 extern void md5(const unsigned char *msg, int msgLen, unsigned char *digest);
+extern void sha256(unsigned char *msg, int msgLen, unsigned char *hash);
 
 #endif
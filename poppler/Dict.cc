@@ -32,9 +32,11 @@
 #include <config.h>
 
 #include <algorithm>
+#include <string.h>
 
 #include "XRef.h"
 #include "Dict.h"
+#include "NameTable.h"
 
 //------------------------------------------------------------------------
 // Dict
@@ -44,15 +46,14 @@
 
 constexpr int SORT_LENGTH_LOWER_LIMIT = 32;
 
+// Sorted dicts are ordered by key hash, so a lookup only compares
+// integers until it reaches the key's hash.
 struct Dict::CmpDictEntry {
   bool operator()(const DictEntry &lhs, const DictEntry &rhs) const {
-    return lhs.first < rhs.first;
+    return lhs.hash < rhs.hash || (lhs.hash == rhs.hash && lhs.key < rhs.key);
   }
-  bool operator()(const DictEntry &lhs, const char *rhs) const {
-    return lhs.first < rhs;
-  }
-  bool operator()(const char *lhs, const DictEntry &rhs) const {
-    return lhs < rhs.first;
+  bool operator()(const DictEntry &lhs, unsigned int rhs) const {
+    return lhs.hash < rhs;
   }
 };
 
@@ -69,7 +70,7 @@ Dict::Dict(const Dict* dictA) {
 
   entries.reserve(dictA->entries.size());
   for (const auto& entry : dictA->entries) {
-    entries.emplace_back(entry.first, entry.second.copy());
+    entries.emplace_back(entry.key, entry.hash, entry.val.copy());
   }
 
   sorted = dictA->sorted.load();
@@ -80,20 +81,42 @@ Dict *Dict::copy(XRef *xrefA) const {
   Dict *dictA = new Dict(this);
   dictA->xref = xrefA;
   for (auto &entry : dictA->entries) {
-    if (entry.second.getType() == objDict) {
-      entry.second = Object(entry.second.getDict()->copy(xrefA));
+    if (entry.val.getType() == objDict) {
+      entry.val = Object(entry.val.getDict()->copy(xrefA));
     }
   }
   return dictA;
 }
 
+Dict *Dict::deepCopy() const {
+  dictLocker();
+  Dict *dictA = new Dict(xref);
+
+  dictA->entries.reserve(entries.size());
+  for (const auto& entry : entries) {
+    dictA->entries.emplace_back(entry.key, entry.hash, entry.val.deepCopy());
+  }
+  dictA->sorted = sorted.load();
+  return dictA;
+}
+
 void Dict::add(const char *key, Object &&val) {
+  std::size_t len;
+  const unsigned int hash = NameTable::hash(key, &len);
+
   dictLocker();
-  entries.emplace_back(key, std::move(val));
+  entries.emplace_back(std::string(key, len), hash, std::move(val));
   sorted = false;
 }
 
 inline const Dict::DictEntry *Dict::find(const char *key) const {
+  std::size_t len;
+  const unsigned int hash = NameTable::hash(key, &len);
+  const auto matches = [key, hash, len](const DictEntry& entry) {
+    return entry.hash == hash && entry.key.size() == len &&
+           !memcmp(entry.key.data(), key, len);
+  };
+
   if (entries.size() >= SORT_LENGTH_LOWER_LIMIT) {
     if (!sorted) {
       dictLocker();
@@ -107,14 +130,14 @@ inline const Dict::DictEntry *Dict::find(const char *key) const {
   }
 
   if (sorted) {
-    const auto pos = std::lower_bound(entries.begin(), entries.end(), key, CmpDictEntry{});
-    if (pos != entries.end() && pos->first == key) {
-      return &*pos;
+    for (auto pos = std::lower_bound(entries.begin(), entries.end(), hash, CmpDictEntry{});
+	 pos != entries.end() && pos->hash == hash; ++pos) {
+      if (matches(*pos)) {
+	return &*pos;
+      }
     }
   } else {
-    const auto pos = std::find_if(entries.rbegin(), entries.rend(), [key](const DictEntry& entry) {
-      return entry.first == key;
-    });
+    const auto pos = std::find_if(entries.rbegin(), entries.rend(), matches);
     if (pos != entries.rend()) {
       return &*pos;
     }
@@ -133,7 +156,7 @@ void Dict::remove(const char *key) {
       const auto index = entry - &entries.front();
       entries.erase(entries.begin() + index);
     } else {
-      swap(*entry, entries.back());
+      std::swap(*entry, entries.back());
       entries.pop_back();
     }
   }
@@ -146,7 +169,7 @@ void Dict::set(const char *key, Object &&val) {
   }
   dictLocker();
   if (auto *entry = find(key)) {
-    entry->second = std::move(val);
+    entry->val = std::move(val);
   } else {
     add(key, std::move(val));
   }
@@ -155,26 +178,26 @@ void Dict::set(const char *key, Object &&val) {
 
 bool Dict::is(const char *type) const {
   if (const auto *entry = find("Type")) {
-    return entry->second.isName(type);
+    return entry->val.isName(type);
   }
   return false;
 }
 
 Object Dict::lookup(const char *key, int recursion) const {
   if (const auto *entry = find(key)) {
-    return entry->second.fetch(xref, recursion);
+    return entry->val.fetch(xref, recursion);
   }
   return Object(objNull);
 }
 
 Object Dict::lookup(const char *key, Ref *returnRef, int recursion) const {
   if (const auto *entry = find(key)) {
-    if (entry->second.getType() == objRef) {
-      *returnRef = entry->second.getRef();
+    if (entry->val.getType() == objRef) {
+      *returnRef = entry->val.getRef();
     } else {
       *returnRef = Ref::INVALID();
     }
-    return entry->second.fetch(xref, recursion);
+    return entry->val.fetch(xref, recursion);
   }
   *returnRef = Ref::INVALID();
   return Object(objNull);
@@ -182,7 +205,7 @@ Object Dict::lookup(const char *key, Ref *returnRef, int recursion) const {
 
 const Object &Dict::lookupNF(const char *key) const {
   if (const auto *entry = find(key)) {
-    return entry->second;
+    return entry->val;
   }
   static Object nullObj(objNull);
   return nullObj;
@@ -204,12 +227,12 @@ bool Dict::lookupInt(const char *key, const char *alt_key, int *value) const
 Object Dict::getVal(int i, Ref *returnRef) const
 {
     const DictEntry &entry = entries[i];
-    if (entry.second.getType() == objRef) {
-      *returnRef = entry.second.getRef();
+    if (entry.val.getType() == objRef) {
+      *returnRef = entry.val.getRef();
     } else {
       *returnRef = Ref::INVALID();
     }
-    return entry.second.fetch(xref);
+    return entry.val.fetch(xref);
 }
 
 bool Dict::hasKey(const char *key) const {
@@ -50,6 +50,8 @@ public:
   Dict(XRef *xrefA);
   Dict(const Dict *dictA);
   Dict *copy(XRef *xrefA) const;
+  // Copy the dict and the arrays and dicts it contains.
+  Dict *deepCopy() const;
 
   Dict(const Dict &) = delete;
   Dict& operator=(const Dict &) = delete;
@@ -82,11 +84,11 @@ public:
   bool lookupInt(const char *key, const char *alt_key, int *value) const;
 
   // Iterative accessors.
-  const char *getKey(int i) const { return entries[i].first.c_str(); }
-  Object getVal(int i) const { return entries[i].second.fetch(xref); }
+  const char *getKey(int i) const { return entries[i].key.c_str(); }
+  Object getVal(int i) const { return entries[i].val.fetch(xref); }
   // Same as above but if the returned object is a fetched Ref returns such Ref in returnRef, otherwise returnRef is Ref::INVALID()
   Object getVal(int i, Ref *returnRef) const;
-  const Object &getValNF(int i) const { return entries[i].second; }
+  const Object &getValNF(int i) const { return entries[i].val; }
 
   // Set the xref pointer.  This is only used in one special case: the
   // trailer dictionary, which is read before the xref table is
@@ -104,7 +106,14 @@ private:
   int incRef() { return ++ref; }
   int decRef() { return --ref; }
 
-  using DictEntry = std::pair<std::string, Object>;
+  struct DictEntry {
+    DictEntry(std::string keyA, unsigned int hashA, Object &&valA)
+      : key(std::move(keyA)), hash(hashA), val(std::move(valA)) {}
+
+    std::string key;
+    unsigned int hash;		// NameTable::hash of the key
+    Object val;
+  };
   struct CmpDictEntry;
 
   std::atomic_bool sorted;
@@ -17,6 +17,7 @@
 
 #ifdef ENABLE_ZLIB_UNCOMPRESS
 
+#include <algorithm>
 #include "FlateStream.h"
 
 FlateStream::FlateStream(Stream *strA, int predictor, int columns, int colors, int bits) :
@@ -58,9 +59,20 @@ int FlateStream::getRawChar() {
   return doGetRawChar();
 }
 
-void FlateStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
+int FlateStream::getRawChars(int nChars, unsigned char *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (fill_buffer()) {
+      break;
+    }
+    m = std::min(out_buf_len - out_pos, nChars - n);
+    memcpy(buffer + n, out_buf + out_pos, m);
+    out_pos += m;
+    n += m;
+  }
+  return n;
 }
 
 int FlateStream::getChar() {
@@ -80,6 +92,21 @@ int FlateStream::lookChar() {
   return out_buf[out_pos];
 }
 
+const unsigned char *FlateStream::lookChars(int *nChars) {
+  if (pred)
+    return nullptr;
+
+  if (fill_buffer())
+    return nullptr;
+
+  *nChars = out_buf_len - out_pos;
+  return out_buf + out_pos;
+}
+
+void FlateStream::skipChars(int nChars) {
+  out_pos += nChars;
+}
+
 int FlateStream::fill_buffer() {
   /* only fill the buffer if it has all been used */
   if (out_pos >= out_buf_len) {
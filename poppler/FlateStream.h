@@ -41,8 +41,10 @@ public:
   virtual void reset() override;
   virtual int getChar() override;
   virtual int lookChar() override;
+  virtual const unsigned char *lookChars(int *nChars) override;
+  virtual void skipChars(int nChars) override;
   virtual int getRawChar() override;
-  virtual void getRawChars(int nChars, int *buffer) override;
+  virtual int getRawChars(int nChars, unsigned char *buffer) override;
   virtual GooString *getPSFilter(int psLevel, const char *indent) override;
   virtual bool isBinary(bool last = true) override;
 
@@ -32,6 +32,8 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <algorithm>
+#include <vector>
 #include "goo/gmem.h"
 #include "goo/gstrtod.h"
 #include "Object.h"
@@ -174,6 +176,12 @@ bool Function::init(Dict *dict) {
   return true;
 }
 
+void Function::transformBatch(const double *in, double *out, int count) const {
+  for (int i = 0; i < count; ++i) {
+    transform(in + i * m, out + i * n);
+  }
+}
+
 //------------------------------------------------------------------------
 // IdentityFunction
 //------------------------------------------------------------------------
@@ -1007,6 +1015,9 @@ public:
     return 0;
   }
   bool empty() { return sp == psStackSize; }
+  int depth() { return psStackSize - sp; }
+  // Return the object <i> entries below the top of the stack.
+  const PSObject &peek(int i) { return stack[sp + i]; }
   bool topIsInt() { return sp < psStackSize && stack[sp].type == psInt; }
   bool topTwoAreInts()
     { return sp < psStackSize - 1 &&
@@ -1132,6 +1143,1156 @@ void PSStack::roll(int n, int j) {
   }
 }
 
+// Execute a single operator other than if, ifelse and return.
+static void execOp(PSStack *stack, PSOp op) {
+  int i1, i2;
+  double r1, r2, result;
+  bool b1, b2;
+
+  switch (op) {
+  case psOpAbs:
+    if (stack->topIsInt()) {
+      stack->pushInt(abs(stack->popInt()));
+    } else {
+      stack->pushReal(fabs(stack->popNum()));
+    }
+    break;
+  case psOpAdd:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushInt(i1 + i2);
+    } else {
+      r2 = stack->popNum();
+      r1 = stack->popNum();
+      stack->pushReal(r1 + r2);
+    }
+    break;
+  case psOpAnd:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushInt(i1 & i2);
+    } else {
+      b2 = stack->popBool();
+      b1 = stack->popBool();
+      stack->pushBool(b1 && b2);
+    }
+    break;
+  case psOpAtan:
+    r2 = stack->popNum();
+    r1 = stack->popNum();
+    result = atan2(r1, r2) * 180.0 / M_PI;
+    if (result < 0) result += 360.0;
+    stack->pushReal(result);
+    break;
+  case psOpBitshift:
+    i2 = stack->popInt();
+    i1 = stack->popInt();
+    if (i2 > 0) {
+      stack->pushInt(i1 << i2);
+    } else if (i2 < 0) {
+      stack->pushInt((int)((unsigned int)i1 >> -i2));
+    } else {
+      stack->pushInt(i1);
+    }
+    break;
+  case psOpCeiling:
+    if (!stack->topIsInt()) {
+      stack->pushReal(ceil(stack->popNum()));
+    }
+    break;
+  case psOpCopy:
+    stack->copy(stack->popInt());
+    break;
+  case psOpCos:
+    stack->pushReal(cos(stack->popNum() * M_PI / 180.0));
+    break;
+  case psOpCvi:
+    if (!stack->topIsInt()) {
+      stack->pushInt((int)stack->popNum());
+    }
+    break;
+  case psOpCvr:
+    if (!stack->topIsReal()) {
+      stack->pushReal(stack->popNum());
+    }
+    break;
+  case psOpDiv:
+    r2 = stack->popNum();
+    r1 = stack->popNum();
+    stack->pushReal(r1 / r2);
+    break;
+  case psOpDup:
+    stack->copy(1);
+    break;
+  case psOpEq:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushBool(i1 == i2);
+    } else if (stack->topTwoAreNums()) {
+      r2 = stack->popNum();
+      r1 = stack->popNum();
+      stack->pushBool(r1 == r2);
+    } else {
+      b2 = stack->popBool();
+      b1 = stack->popBool();
+      stack->pushBool(b1 == b2);
+    }
+    break;
+  case psOpExch:
+    stack->roll(2, 1);
+    break;
+  case psOpExp:
+    r2 = stack->popNum();
+    r1 = stack->popNum();
+    stack->pushReal(pow(r1, r2));
+    break;
+  case psOpFalse:
+    stack->pushBool(false);
+    break;
+  case psOpFloor:
+    if (!stack->topIsInt()) {
+      stack->pushReal(floor(stack->popNum()));
+    }
+    break;
+  case psOpGe:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushBool(i1 >= i2);
+    } else {
+      r2 = stack->popNum();
+      r1 = stack->popNum();
+      stack->pushBool(r1 >= r2);
+    }
+    break;
+  case psOpGt:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushBool(i1 > i2);
+    } else {
+      r2 = stack->popNum();
+      r1 = stack->popNum();
+      stack->pushBool(r1 > r2);
+    }
+    break;
+  case psOpIdiv:
+    i2 = stack->popInt();
+    i1 = stack->popInt();
+    if (likely(i2 != 0)) {
+      stack->pushInt(i1 / i2);
+    }
+    break;
+  case psOpIndex:
+    stack->index(stack->popInt());
+    break;
+  case psOpLe:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushBool(i1 <= i2);
+    } else {
+      r2 = stack->popNum();
+      r1 = stack->popNum();
+      stack->pushBool(r1 <= r2);
+    }
+    break;
+  case psOpLn:
+    stack->pushReal(log(stack->popNum()));
+    break;
+  case psOpLog:
+    stack->pushReal(log10(stack->popNum()));
+    break;
+  case psOpLt:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushBool(i1 < i2);
+    } else {
+      r2 = stack->popNum();
+      r1 = stack->popNum();
+      stack->pushBool(r1 < r2);
+    }
+    break;
+  case psOpMod:
+    i2 = stack->popInt();
+    i1 = stack->popInt();
+    if (likely(i2 != 0)) {
+      stack->pushInt(i1 % i2);
+    }
+    break;
+  case psOpMul:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      //~ should check for out-of-range, and push a real instead
+      stack->pushInt(i1 * i2);
+    } else {
+      r2 = stack->popNum();
+      r1 = stack->popNum();
+      stack->pushReal(r1 * r2);
+    }
+    break;
+  case psOpNe:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushBool(i1 != i2);
+    } else if (stack->topTwoAreNums()) {
+      r2 = stack->popNum();
+      r1 = stack->popNum();
+      stack->pushBool(r1 != r2);
+    } else {
+      b2 = stack->popBool();
+      b1 = stack->popBool();
+      stack->pushBool(b1 != b2);
+    }
+    break;
+  case psOpNeg:
+    if (stack->topIsInt()) {
+      stack->pushInt(-stack->popInt());
+    } else {
+      stack->pushReal(-stack->popNum());
+    }
+    break;
+  case psOpNot:
+    if (stack->topIsInt()) {
+      stack->pushInt(~stack->popInt());
+    } else {
+      stack->pushBool(!stack->popBool());
+    }
+    break;
+  case psOpOr:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushInt(i1 | i2);
+    } else {
+      b2 = stack->popBool();
+      b1 = stack->popBool();
+      stack->pushBool(b1 || b2);
+    }
+    break;
+  case psOpPop:
+    stack->pop();
+    break;
+  case psOpRoll:
+    i2 = stack->popInt();
+    i1 = stack->popInt();
+    stack->roll(i1, i2);
+    break;
+  case psOpRound:
+    if (!stack->topIsInt()) {
+      r1 = stack->popNum();
+      stack->pushReal((r1 >= 0) ? floor(r1 + 0.5) : ceil(r1 - 0.5));
+    }
+    break;
+  case psOpSin:
+    stack->pushReal(sin(stack->popNum() * M_PI / 180.0));
+    break;
+  case psOpSqrt:
+    stack->pushReal(sqrt(stack->popNum()));
+    break;
+  case psOpSub:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushInt(i1 - i2);
+    } else {
+      r2 = stack->popNum();
+      r1 = stack->popNum();
+      stack->pushReal(r1 - r2);
+    }
+    break;
+  case psOpTrue:
+    stack->pushBool(true);
+    break;
+  case psOpTruncate:
+    if (!stack->topIsInt()) {
+      r1 = stack->popNum();
+      stack->pushReal((r1 >= 0) ? floor(r1) : ceil(r1));
+    }
+    break;
+  case psOpXor:
+    if (stack->topTwoAreInts()) {
+      i2 = stack->popInt();
+      i1 = stack->popInt();
+      stack->pushInt(i1 ^ i2);
+    } else {
+      b2 = stack->popBool();
+      b1 = stack->popBool();
+      stack->pushBool(b1 ^ b2);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+//------------------------------------------------------------------------
+// PSProgram
+//------------------------------------------------------------------------
+
+// PostScript functions are compiled to code for a register machine.
+// The compiler runs the function on a stack of symbolic values
+// (inputs, constants and registers), so that the stack operators
+// disappear, operators with constant operands are folded, and every
+// other operator becomes one instruction writing a new register.
+// Functions whose stack layout or operand types depend on the input
+// values, or which would run into a stack error, are not compiled and
+// are left to the interpreter.
+
+#define psMaxRegisters 512
+
+enum PSInstrOp {
+  psiMove,
+  psiJump,
+  psiJumpIfFalse,
+  psiAbsI,
+  psiAbsR,
+  psiAddI,
+  psiAddR,
+  psiAndI,
+  psiAndB,
+  psiAtan,
+  psiBitshift,
+  psiCeiling,
+  psiCos,
+  psiCvi,
+  psiDiv,
+  psiEqI,
+  psiEqR,
+  psiEqB,
+  psiExp,
+  psiFloor,
+  psiGeI,
+  psiGeR,
+  psiGtI,
+  psiGtR,
+  psiIdiv,
+  psiLeI,
+  psiLeR,
+  psiLn,
+  psiLog,
+  psiLtI,
+  psiLtR,
+  psiMod,
+  psiMulI,
+  psiMulR,
+  psiNeI,
+  psiNeR,
+  psiNeB,
+  psiNegI,
+  psiNegR,
+  psiNotI,
+  psiNotB,
+  psiOrI,
+  psiOrB,
+  psiRound,
+  psiSin,
+  psiSqrt,
+  psiSubI,
+  psiSubR,
+  psiTruncate,
+  psiXorI,
+  psiXorB,
+  psiNone			// no instruction needed
+};
+
+struct PSInstr {
+  PSInstrOp op;
+  int dst;			// result register
+  int src1, src2;		// operand registers; jumps keep their
+				//   offset from the next instruction in src2
+};
+
+// Bools are kept in intg, ints both in intg and in real, so that any
+// number can be read from real.
+struct PSRegister {
+  double real;
+  int intg;
+};
+
+struct PSValue {
+  PSObjectType type;		// psBool, psInt or psReal
+  int reg;			// register, or -1 for a constant
+  PSObject obj;			// value of a constant
+};
+
+class PSProgram {
+public:
+
+  // Returns nullptr if the code can't be compiled.
+  static PSProgram *compile(const PSObject *code, int m, int n);
+
+  PSProgram *copy() const { return new PSProgram(*this); }
+
+  // Run the program.  Returns false if the interpreter has to handle
+  // these input values.
+  bool run(const double *in, double *out) const;
+
+private:
+
+  friend class PSCompiler;
+
+  int m;			// number of inputs, in registers 0 .. m-1
+  std::vector<PSInstr> instrs;
+  std::vector<PSRegister> initRegs;	// constants, and room for the
+					//   other registers
+  std::vector<int> outRegs;
+};
+
+class PSCompiler {
+public:
+
+  PSCompiler(const PSObject *codeA, PSProgram *progA):
+    code(codeA), prog(progA), ok(true) {}
+
+  // Compile the block starting at <codePtr>, up to its return.
+  bool compileBlock(int codePtr, std::vector<PSValue> *stack);
+
+  // Return the register holding <v>, set up for constants as needed.
+  int getReg(const PSValue &v);
+
+  // Returns false if the program got too large.
+  bool isOk() { return ok; }
+
+private:
+
+  bool compileIf(bool ifelse, int codePtr, std::vector<PSValue> *stack);
+  bool compileOp(PSOp op, std::vector<PSValue> *stack);
+  bool copy(int n, std::vector<PSValue> *stack);
+  bool roll(int n, int j, std::vector<PSValue> *stack);
+  void fold(PSOp op, int nArgs, std::vector<PSValue> *stack);
+  int newReg();
+
+  const PSObject *code;
+  PSProgram *prog;
+  bool ok;
+};
+
+static inline bool psIsNum(PSObjectType type) {
+  return type == psInt || type == psReal;
+}
+
+static PSValue psConstant(const PSObject &obj) {
+  PSValue v;
+
+  v.type = obj.type;
+  v.reg = -1;
+  v.obj = obj;
+  return v;
+}
+
+static bool psSameValue(const PSValue &v1, const PSValue &v2) {
+  if (v1.reg >= 0 || v2.reg >= 0) {
+    return v1.reg == v2.reg;
+  }
+  switch (v1.type) {
+  case psBool:
+    return v1.obj.booln == v2.obj.booln;
+  case psInt:
+    return v1.obj.intg == v2.obj.intg;
+  default:
+    return v1.obj.real == v2.obj.real;
+  }
+}
+
+// Select the instruction for <op> with operands of types <t1> and <t2>
+// (<t2> is the top of the stack, <t1> is unused for unary operators),
+// and the type of its result.  Returns false if the interpreter would
+// report a type mismatch.
+static bool psSelectInstr(PSOp op, PSObjectType t1, PSObjectType t2,
+			  PSInstrOp *instr, PSObjectType *type) {
+  const bool ints = t1 == psInt && t2 == psInt;
+  const bool nums = psIsNum(t1) && psIsNum(t2);
+  const bool bools = t1 == psBool && t2 == psBool;
+
+  *type = psReal;
+  switch (op) {
+  case psOpAbs:
+  case psOpNeg:
+    if (!psIsNum(t2)) {
+      return false;
+    }
+    *type = t2;
+    if (op == psOpAbs) {
+      *instr = t2 == psInt ? psiAbsI : psiAbsR;
+    } else {
+      *instr = t2 == psInt ? psiNegI : psiNegR;
+    }
+    return true;
+  case psOpCeiling:
+  case psOpFloor:
+  case psOpRound:
+  case psOpTruncate:
+    if (!psIsNum(t2)) {
+      return false;
+    }
+    *type = t2;
+    if (t2 == psInt) {
+      *instr = psiNone;
+    } else if (op == psOpCeiling) {
+      *instr = psiCeiling;
+    } else if (op == psOpFloor) {
+      *instr = psiFloor;
+    } else if (op == psOpRound) {
+      *instr = psiRound;
+    } else {
+      *instr = psiTruncate;
+    }
+    return true;
+  case psOpCvi:
+    *type = psInt;
+    *instr = t2 == psInt ? psiNone : psiCvi;
+    return psIsNum(t2);
+  case psOpCvr:
+    // ints already hold their value as a real
+    *instr = psiNone;
+    return psIsNum(t2);
+  case psOpCos:
+  case psOpLn:
+  case psOpLog:
+  case psOpSin:
+  case psOpSqrt:
+    switch (op) {
+    case psOpCos: *instr = psiCos; break;
+    case psOpLn: *instr = psiLn; break;
+    case psOpLog: *instr = psiLog; break;
+    case psOpSin: *instr = psiSin; break;
+    default: *instr = psiSqrt; break;
+    }
+    return psIsNum(t2);
+  case psOpNot:
+    *type = t2;
+    *instr = t2 == psInt ? psiNotI : psiNotB;
+    return t2 == psInt || t2 == psBool;
+  case psOpAdd:
+  case psOpMul:
+  case psOpSub:
+    *type = ints ? psInt : psReal;
+    switch (op) {
+    case psOpAdd: *instr = ints ? psiAddI : psiAddR; break;
+    case psOpMul: *instr = ints ? psiMulI : psiMulR; break;
+    default: *instr = ints ? psiSubI : psiSubR; break;
+    }
+    return nums;
+  case psOpAnd:
+  case psOpOr:
+  case psOpXor:
+    *type = ints ? psInt : psBool;
+    switch (op) {
+    case psOpAnd: *instr = ints ? psiAndI : psiAndB; break;
+    case psOpOr: *instr = ints ? psiOrI : psiOrB; break;
+    default: *instr = ints ? psiXorI : psiXorB; break;
+    }
+    return ints || bools;
+  case psOpAtan:
+  case psOpDiv:
+  case psOpExp:
+    switch (op) {
+    case psOpAtan: *instr = psiAtan; break;
+    case psOpDiv: *instr = psiDiv; break;
+    default: *instr = psiExp; break;
+    }
+    return nums;
+  case psOpBitshift:
+  case psOpIdiv:
+  case psOpMod:
+    *type = psInt;
+    switch (op) {
+    case psOpBitshift: *instr = psiBitshift; break;
+    case psOpIdiv: *instr = psiIdiv; break;
+    default: *instr = psiMod; break;
+    }
+    return ints;
+  case psOpEq:
+  case psOpNe:
+    *type = psBool;
+    if (op == psOpEq) {
+      *instr = ints ? psiEqI : nums ? psiEqR : psiEqB;
+    } else {
+      *instr = ints ? psiNeI : nums ? psiNeR : psiNeB;
+    }
+    return nums || bools;
+  case psOpGe:
+  case psOpGt:
+  case psOpLe:
+  case psOpLt:
+    *type = psBool;
+    switch (op) {
+    case psOpGe: *instr = ints ? psiGeI : psiGeR; break;
+    case psOpGt: *instr = ints ? psiGtI : psiGtR; break;
+    case psOpLe: *instr = ints ? psiLeI : psiLeR; break;
+    default: *instr = ints ? psiLtI : psiLtR; break;
+    }
+    return nums;
+  default:
+    return false;
+  }
+}
+
+static bool psIsUnary(PSOp op) {
+  switch (op) {
+  case psOpAbs:
+  case psOpCeiling:
+  case psOpCos:
+  case psOpCvi:
+  case psOpCvr:
+  case psOpFloor:
+  case psOpLn:
+  case psOpLog:
+  case psOpNeg:
+  case psOpNot:
+  case psOpRound:
+  case psOpSin:
+  case psOpSqrt:
+  case psOpTruncate:
+    return true;
+  default:
+    return false;
+  }
+}
+
+int PSCompiler::newReg() {
+  PSRegister reg;
+
+  if (prog->initRegs.size() >= psMaxRegisters) {
+    ok = false;
+    return 0;
+  }
+  reg.real = 0;
+  reg.intg = 0;
+  prog->initRegs.push_back(reg);
+  return (int)prog->initRegs.size() - 1;
+}
+
+int PSCompiler::getReg(const PSValue &v) {
+  int reg;
+
+  if (v.reg >= 0) {
+    return v.reg;
+  }
+  reg = newReg();
+  if (v.type == psReal) {
+    prog->initRegs[reg].real = v.obj.real;
+  } else if (v.type == psInt) {
+    prog->initRegs[reg].intg = v.obj.intg;
+    prog->initRegs[reg].real = v.obj.intg;
+  } else {
+    prog->initRegs[reg].intg = v.obj.booln;
+  }
+  return reg;
+}
+
+bool PSCompiler::compileBlock(int codePtr, std::vector<PSValue> *stack) {
+  PSOp op;
+
+  while (ok) {
+    switch (code[codePtr].type) {
+    case psInt:
+    case psReal:
+      if (stack->size() >= psStackSize) {
+	return false;
+      }
+      stack->push_back(psConstant(code[codePtr++]));
+      break;
+    case psOperator:
+      op = code[codePtr++].op;
+      if (op == psOpReturn) {
+	return true;
+      }
+      if (op == psOpIf || op == psOpIfelse) {
+	if (!compileIf(op == psOpIfelse, codePtr, stack)) {
+	  return false;
+	}
+	codePtr = code[codePtr + 1].blk;
+      } else if (!compileOp(op, stack)) {
+	return false;
+      }
+      break;
+    default:
+      return false;
+    }
+  }
+  return false;
+}
+
+bool PSCompiler::compileIf(bool ifelse, int codePtr,
+			   std::vector<PSValue> *stack) {
+  std::vector<PSValue> elseStack;
+  std::vector<PSInstr> thenCode, elseCode;
+  PSInstr instr;
+  PSValue cond;
+  bool compiled;
+
+  if (stack->empty() || stack->back().type != psBool) {
+    return false;
+  }
+  cond = stack->back();
+  stack->pop_back();
+
+  // a constant condition only needs the branch it takes
+  if (cond.reg < 0) {
+    if (cond.obj.booln) {
+      return compileBlock(codePtr + 2, stack);
+    } else if (ifelse) {
+      return compileBlock(code[codePtr].blk, stack);
+    }
+    return true;
+  }
+
+  // compile both branches on their own, then have each of them move
+  // the values they leave differently into common registers
+  elseStack = *stack;
+  prog->instrs.swap(thenCode);
+  compiled = compileBlock(codePtr + 2, stack);
+  prog->instrs.swap(thenCode);
+  if (compiled && ifelse) {
+    prog->instrs.swap(elseCode);
+    compiled = compileBlock(code[codePtr].blk, &elseStack);
+    prog->instrs.swap(elseCode);
+  }
+  if (!compiled || stack->size() != elseStack.size()) {
+    return false;
+  }
+  instr.op = psiMove;
+  instr.src2 = 0;
+  for (size_t i = 0; i < stack->size(); ++i) {
+    PSValue &v1 = (*stack)[i];
+    const PSValue &v2 = elseStack[i];
+    if (v1.type != v2.type) {
+      return false;
+    }
+    if (!psSameValue(v1, v2)) {
+      instr.dst = newReg();
+      instr.src1 = getReg(v1);
+      thenCode.push_back(instr);
+      instr.src1 = getReg(v2);
+      elseCode.push_back(instr);
+      v1.reg = instr.dst;
+    }
+  }
+
+  instr.op = psiJumpIfFalse;
+  instr.dst = 0;
+  instr.src1 = cond.reg;
+  instr.src2 = (int)thenCode.size() + (elseCode.empty() ? 0 : 1);
+  prog->instrs.push_back(instr);
+  prog->instrs.insert(prog->instrs.end(), thenCode.begin(), thenCode.end());
+  if (!elseCode.empty()) {
+    instr.op = psiJump;
+    instr.src1 = 0;
+    instr.src2 = (int)elseCode.size();
+    prog->instrs.push_back(instr);
+    prog->instrs.insert(prog->instrs.end(), elseCode.begin(), elseCode.end());
+  }
+  return true;
+}
+
+// Same as PSStack::copy.
+bool PSCompiler::copy(int n, std::vector<PSValue> *stack) {
+  const int depth = (int)stack->size();
+
+  if (n < 0 || n > depth || depth + n > psStackSize) {
+    return false;
+  }
+  for (int i = depth - n; i < depth; ++i) {
+    stack->push_back((*stack)[i]);
+  }
+  return true;
+}
+
+// Same as PSStack::roll, on the top <n> entries.
+bool PSCompiler::roll(int n, int j, std::vector<PSValue> *stack) {
+  PSValue obj;
+  int i, k;
+
+  if (unlikely(n == 0)) {
+    return true;
+  }
+  if (j >= 0) {
+    j %= n;
+  } else {
+    j = -j % n;
+    if (j != 0) {
+      j = n - j;
+    }
+  }
+  if (n <= 0 || j == 0 || n > psStackSize || n > (int)stack->size()) {
+    return true;
+  }
+  // entry <k> from the top is entries[k]
+  PSValue *entries = stack->data() + stack->size() - n;
+  std::reverse(entries, entries + n);
+  if (j <= n / 2) {
+    for (i = 0; i < j; ++i) {
+      obj = entries[0];
+      for (k = 0; k < n - 1; ++k) {
+	entries[k] = entries[k+1];
+      }
+      entries[n - 1] = obj;
+    }
+  } else {
+    j = n - j;
+    for (i = 0; i < j; ++i) {
+      obj = entries[n - 1];
+      for (k = n - 1; k > 0; --k) {
+	entries[k] = entries[k-1];
+      }
+      entries[0] = obj;
+    }
+  }
+  std::reverse(entries, entries + n);
+  return true;
+}
+
+// Run <op> on the constants at the top of the stack.
+void PSCompiler::fold(PSOp op, int nArgs, std::vector<PSValue> *stack) {
+  PSStack tmp;
+  int i;
+
+  for (i = (int)stack->size() - nArgs; i < (int)stack->size(); ++i) {
+    const PSValue &v = (*stack)[i];
+    if (v.type == psBool) {
+      tmp.pushBool(v.obj.booln);
+    } else if (v.type == psInt) {
+      tmp.pushInt(v.obj.intg);
+    } else {
+      tmp.pushReal(v.obj.real);
+    }
+  }
+  stack->resize(stack->size() - nArgs);
+  execOp(&tmp, op);
+  for (i = tmp.depth() - 1; i >= 0; --i) {
+    stack->push_back(psConstant(tmp.peek(i)));
+  }
+}
+
+bool PSCompiler::compileOp(PSOp op, std::vector<PSValue> *stack) {
+  PSInstr instr;
+  PSInstrOp iop;
+  PSObjectType t1, type;
+  int depth, nArgs, i1, i2;
+
+  depth = (int)stack->size();
+  switch (op) {
+  case psOpTrue:
+  case psOpFalse:
+    if (depth >= psStackSize) {
+      return false;
+    }
+    stack->push_back(psConstant(PSObject{psBool, {}}));
+    stack->back().obj.booln = op == psOpTrue;
+    return true;
+  case psOpPop:
+    if (depth < 1) {
+      return false;
+    }
+    stack->pop_back();
+    return true;
+  case psOpDup:
+    return copy(1, stack);
+  case psOpExch:
+    return roll(2, 1, stack);
+  case psOpCopy:
+  case psOpIndex:
+    // the count must be known here
+    if (depth < 1 || stack->back().type != psInt || stack->back().reg >= 0) {
+      return false;
+    }
+    i1 = stack->back().obj.intg;
+    stack->pop_back();
+    if (op == psOpCopy) {
+      return copy(i1, stack);
+    }
+    if (i1 < 0 || i1 >= depth - 1 || depth - 1 >= psStackSize) {
+      return false;
+    }
+    stack->push_back((*stack)[depth - 2 - i1]);
+    return true;
+  case psOpRoll:
+    if (depth < 2 ||
+	(*stack)[depth - 1].type != psInt || (*stack)[depth - 1].reg >= 0 ||
+	(*stack)[depth - 2].type != psInt || (*stack)[depth - 2].reg >= 0) {
+      return false;
+    }
+    i2 = (*stack)[depth - 1].obj.intg;
+    i1 = (*stack)[depth - 2].obj.intg;
+    stack->resize(depth - 2);
+    return roll(i1, i2, stack);
+  default:
+    break;
+  }
+
+  nArgs = psIsUnary(op) ? 1 : 2;
+  if (depth < nArgs) {
+    return false;
+  }
+  const PSValue &v2 = (*stack)[depth - 1];
+  const PSValue &v1 = (*stack)[depth - nArgs];
+  t1 = nArgs == 2 ? v1.type : psInt;
+  if (!psSelectInstr(op, t1, v2.type, &iop, &type)) {
+    return false;
+  }
+  if (iop == psiNone) {
+    if (v2.reg >= 0 || v2.type == type) {
+      stack->back().type = type;
+    } else {
+      fold(op, 1, stack);
+    }
+    return true;
+  }
+  if (v2.reg < 0 && (nArgs == 1 || v1.reg < 0)) {
+    fold(op, nArgs, stack);
+    return true;
+  }
+
+  instr.op = iop;
+  instr.src1 = getReg(v1);
+  instr.src2 = getReg(v2);
+  instr.dst = newReg();
+  prog->instrs.push_back(instr);
+  stack->resize(depth - nArgs);
+  stack->push_back(PSValue{type, instr.dst, {}});
+  return true;
+}
+
+PSProgram *PSProgram::compile(const PSObject *code, int m, int n) {
+  PSProgram *prog;
+  std::vector<PSValue> stack;
+  int i;
+
+  prog = new PSProgram();
+  prog->m = m;
+  prog->initRegs.resize(m);
+  for (i = 0; i < m; ++i) {
+    stack.push_back(PSValue{psReal, i, {}});
+  }
+  PSCompiler compiler(code, prog);
+  bool ok = compiler.compileBlock(0, &stack) && (int)stack.size() >= n;
+  for (i = 0; ok && i < n; ++i) {
+    const PSValue &v = stack[stack.size() - n + i];
+    if (v.type == psBool) {
+      ok = false;
+    } else {
+      prog->outRegs.push_back(compiler.getReg(v));
+    }
+  }
+  if (!ok || !compiler.isOk()) {
+    delete prog;
+    return nullptr;
+  }
+  return prog;
+}
+
+static inline void psSetInt(PSRegister *reg, int i) {
+  reg->intg = i;
+  reg->real = i;
+}
+
+bool PSProgram::run(const double *in, double *out) const {
+  PSRegister regs[psMaxRegisters];
+  const int nInstrs = (int)instrs.size();
+  double result;
+  int pc, i;
+
+  memcpy(regs, initRegs.data(), initRegs.size() * sizeof(PSRegister));
+  for (i = 0; i < m; ++i) {
+    regs[i].real = in[i];
+  }
+
+  pc = 0;
+  while (pc < nInstrs) {
+    const PSInstr &instr = instrs[pc++];
+    PSRegister *d = &regs[instr.dst];
+    const PSRegister &a = regs[instr.src1];
+    const PSRegister &b = regs[instr.src2];
+    switch (instr.op) {
+    case psiMove:
+      *d = a;
+      break;
+    case psiJump:
+      pc += instr.src2;
+      break;
+    case psiJumpIfFalse:
+      if (!a.intg) {
+	pc += instr.src2;
+      }
+      break;
+    case psiAbsI:
+      psSetInt(d, abs(b.intg));
+      break;
+    case psiAbsR:
+      d->real = fabs(b.real);
+      break;
+    case psiAddI:
+      psSetInt(d, a.intg + b.intg);
+      break;
+    case psiAddR:
+      d->real = a.real + b.real;
+      break;
+    case psiAndI:
+      psSetInt(d, a.intg & b.intg);
+      break;
+    case psiAndB:
+      d->intg = a.intg && b.intg;
+      break;
+    case psiAtan:
+      result = atan2(a.real, b.real) * 180.0 / M_PI;
+      if (result < 0) result += 360.0;
+      d->real = result;
+      break;
+    case psiBitshift:
+      if (b.intg > 0) {
+	psSetInt(d, a.intg << b.intg);
+      } else if (b.intg < 0) {
+	psSetInt(d, (int)((unsigned int)a.intg >> -b.intg));
+      } else {
+	psSetInt(d, a.intg);
+      }
+      break;
+    case psiCeiling:
+      d->real = ceil(b.real);
+      break;
+    case psiCos:
+      d->real = cos(b.real * M_PI / 180.0);
+      break;
+    case psiCvi:
+      psSetInt(d, (int)b.real);
+      break;
+    case psiDiv:
+      d->real = a.real / b.real;
+      break;
+    case psiEqI:
+      d->intg = a.intg == b.intg;
+      break;
+    case psiEqR:
+      d->intg = a.real == b.real;
+      break;
+    case psiEqB:
+      d->intg = a.intg == b.intg;
+      break;
+    case psiExp:
+      d->real = pow(a.real, b.real);
+      break;
+    case psiFloor:
+      d->real = floor(b.real);
+      break;
+    case psiGeI:
+      d->intg = a.intg >= b.intg;
+      break;
+    case psiGeR:
+      d->intg = a.real >= b.real;
+      break;
+    case psiGtI:
+      d->intg = a.intg > b.intg;
+      break;
+    case psiGtR:
+      d->intg = a.real > b.real;
+      break;
+    case psiIdiv:
+      // the interpreter leaves the stack short in this case
+      if (unlikely(b.intg == 0)) {
+	return false;
+      }
+      psSetInt(d, a.intg / b.intg);
+      break;
+    case psiLeI:
+      d->intg = a.intg <= b.intg;
+      break;
+    case psiLeR:
+      d->intg = a.real <= b.real;
+      break;
+    case psiLn:
+      d->real = log(b.real);
+      break;
+    case psiLog:
+      d->real = log10(b.real);
+      break;
+    case psiLtI:
+      d->intg = a.intg < b.intg;
+      break;
+    case psiLtR:
+      d->intg = a.real < b.real;
+      break;
+    case psiMod:
+      if (unlikely(b.intg == 0)) {
+	return false;
+      }
+      psSetInt(d, a.intg % b.intg);
+      break;
+    case psiMulI:
+      psSetInt(d, a.intg * b.intg);
+      break;
+    case psiMulR:
+      d->real = a.real * b.real;
+      break;
+    case psiNeI:
+      d->intg = a.intg != b.intg;
+      break;
+    case psiNeR:
+      d->intg = a.real != b.real;
+      break;
+    case psiNeB:
+      d->intg = a.intg != b.intg;
+      break;
+    case psiNegI:
+      psSetInt(d, -b.intg);
+      break;
+    case psiNegR:
+      d->real = -b.real;
+      break;
+    case psiNotI:
+      psSetInt(d, ~b.intg);
+      break;
+    case psiNotB:
+      d->intg = !b.intg;
+      break;
+    case psiOrI:
+      psSetInt(d, a.intg | b.intg);
+      break;
+    case psiOrB:
+      d->intg = a.intg || b.intg;
+      break;
+    case psiRound:
+      d->real = (b.real >= 0) ? floor(b.real + 0.5) : ceil(b.real - 0.5);
+      break;
+    case psiSin:
+      d->real = sin(b.real * M_PI / 180.0);
+      break;
+    case psiSqrt:
+      d->real = sqrt(b.real);
+      break;
+    case psiSubI:
+      psSetInt(d, a.intg - b.intg);
+      break;
+    case psiSubR:
+      d->real = a.real - b.real;
+      break;
+    case psiTruncate:
+      d->real = (b.real >= 0) ? floor(b.real) : ceil(b.real);
+      break;
+    case psiXorI:
+      psSetInt(d, a.intg ^ b.intg);
+      break;
+    case psiXorB:
+      d->intg = a.intg ^ b.intg;
+      break;
+    case psiNone:
+      break;
+    }
+  }
+
+  for (i = 0; i < (int)outRegs.size(); ++i) {
+    out[i] = regs[outRegs[i]].real;
+  }
+  return true;
+}
+
 PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   Stream *str;
   int codePtr;
@@ -1141,6 +2302,7 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   code = nullptr;
   codeString = nullptr;
   codeSize = 0;
+  program = nullptr;
   ok = false;
 
   //----- initialize the generic stuff
@@ -1172,6 +2334,9 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   }
   str->close();
 
+  //----- compile it, if possible
+  program = PSProgram::compile(code, m, n);
+
   //----- set up the cache
   for (i = 0; i < m; ++i) {
     in[i] = domain[i][0];
@@ -1195,6 +2360,8 @@ PostScriptFunction::PostScriptFunction(const PostScriptFunction *func) : Functio
 
   codeString = func->codeString->copy();
 
+  program = func->program ? func->program->copy() : nullptr;
+
   memcpy(cacheIn, func->cacheIn, funcMaxInputs * sizeof(double));
   memcpy(cacheOut, func->cacheOut, funcMaxOutputs * sizeof(double));
 
@@ -1202,12 +2369,12 @@ PostScriptFunction::PostScriptFunction(const PostScriptFunction *func) : Functio
 }
 
 PostScriptFunction::~PostScriptFunction() {
+  delete program;
   gfree(code);
   delete codeString;
 }
 
 void PostScriptFunction::transform(const double *in, double *out) const {
-  PSStack stack;
   int i;
 
   // check the cache
@@ -1223,6 +2390,39 @@ void PostScriptFunction::transform(const double *in, double *out) const {
     return;
   }
 
+  evaluate(in, out);
+
+  // save current result in the cache
+  for (i = 0; i < m; ++i) {
+    cacheIn[i] = in[i];
+  }
+  for (i = 0; i < n; ++i) {
+    cacheOut[i] = out[i];
+  }
+}
+
+void PostScriptFunction::transformBatch(const double *in, double *out, int count) const {
+  for (int i = 0; i < count; ++i) {
+    evaluate(in + i * m, out + i * n);
+  }
+}
+
+void PostScriptFunction::transformInterpreted(const double *in, double *out) const {
+  interpret(in, out);
+  clipToRange(out);
+}
+
+void PostScriptFunction::evaluate(const double *in, double *out) const {
+  if (!program || !program->run(in, out)) {
+    interpret(in, out);
+  }
+  clipToRange(out);
+}
+
+void PostScriptFunction::interpret(const double *in, double *out) const {
+  PSStack stack;
+  int i;
+
   for (i = 0; i < m; ++i) {
     //~ may need to check for integers here
     stack.pushReal(in[i]);
@@ -1230,25 +2430,21 @@ void PostScriptFunction::transform(const double *in, double *out) const {
   exec(&stack, 0);
   for (i = n - 1; i >= 0; --i) {
     out[i] = stack.popNum();
-    if (out[i] < range[i][0]) {
-      out[i] = range[i][0];
-    } else if (out[i] > range[i][1]) {
-      out[i] = range[i][1];
-    }
   }
-  stack.clear();
 
   // if (!stack->empty()) {
   //   error(errSyntaxWarning, -1,
   //         "Extra values on stack at end of PostScript function");
   // }
+}
 
-  // save current result in the cache
-  for (i = 0; i < m; ++i) {
-    cacheIn[i] = in[i];
-  }
-  for (i = 0; i < n; ++i) {
-    cacheOut[i] = out[i];
+void PostScriptFunction::clipToRange(double *out) const {
+  for (int i = 0; i < n; ++i) {
+    if (out[i] < range[i][0]) {
+      out[i] = range[i][0];
+    } else if (out[i] > range[i][1]) {
+      out[i] = range[i][1];
+    }
   }
 }
 
@@ -1413,9 +2609,7 @@ void PostScriptFunction::resizeCode(int newSize) {
 }
 
 void PostScriptFunction::exec(PSStack *stack, int codePtr) const {
-  int i1, i2;
-  double r1, r2, result;
-  bool b1, b2;
+  bool b1;
 
   while (1) {
     switch (code[codePtr].type) {
@@ -1427,283 +2621,6 @@ void PostScriptFunction::exec(PSStack *stack, int codePtr) const {
       break;
     case psOperator:
       switch (code[codePtr++].op) {
-      case psOpAbs:
-	if (stack->topIsInt()) {
-	  stack->pushInt(abs(stack->popInt()));
-	} else {
-	  stack->pushReal(fabs(stack->popNum()));
-	}
-	break;
-      case psOpAdd:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushInt(i1 + i2);
-	} else {
-	  r2 = stack->popNum();
-	  r1 = stack->popNum();
-	  stack->pushReal(r1 + r2);
-	}
-	break;
-      case psOpAnd:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushInt(i1 & i2);
-	} else {
-	  b2 = stack->popBool();
-	  b1 = stack->popBool();
-	  stack->pushBool(b1 && b2);
-	}
-	break;
-      case psOpAtan:
-	r2 = stack->popNum();
-	r1 = stack->popNum();
-	result = atan2(r1, r2) * 180.0 / M_PI;
-	if (result < 0) result += 360.0;
-	stack->pushReal(result);
-	break;
-      case psOpBitshift:
-	i2 = stack->popInt();
-	i1 = stack->popInt();
-	if (i2 > 0) {
-	  stack->pushInt(i1 << i2);
-	} else if (i2 < 0) {
-	  stack->pushInt((int)((unsigned int)i1 >> -i2));
-	} else {
-	  stack->pushInt(i1);
-	}
-	break;
-      case psOpCeiling:
-	if (!stack->topIsInt()) {
-	  stack->pushReal(ceil(stack->popNum()));
-	}
-	break;
-      case psOpCopy:
-	stack->copy(stack->popInt());
-	break;
-      case psOpCos:
-	stack->pushReal(cos(stack->popNum() * M_PI / 180.0));
-	break;
-      case psOpCvi:
-	if (!stack->topIsInt()) {
-	  stack->pushInt((int)stack->popNum());
-	}
-	break;
-      case psOpCvr:
-	if (!stack->topIsReal()) {
-	  stack->pushReal(stack->popNum());
-	}
-	break;
-      case psOpDiv:
-	r2 = stack->popNum();
-	r1 = stack->popNum();
-	stack->pushReal(r1 / r2);
-	break;
-      case psOpDup:
-	stack->copy(1);
-	break;
-      case psOpEq:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushBool(i1 == i2);
-	} else if (stack->topTwoAreNums()) {
-	  r2 = stack->popNum();
-	  r1 = stack->popNum();
-	  stack->pushBool(r1 == r2);
-	} else {
-	  b2 = stack->popBool();
-	  b1 = stack->popBool();
-	  stack->pushBool(b1 == b2);
-	}
-	break;
-      case psOpExch:
-	stack->roll(2, 1);
-	break;
-      case psOpExp:
-	r2 = stack->popNum();
-	r1 = stack->popNum();
-	stack->pushReal(pow(r1, r2));
-	break;
-      case psOpFalse:
-	stack->pushBool(false);
-	break;
-      case psOpFloor:
-	if (!stack->topIsInt()) {
-	  stack->pushReal(floor(stack->popNum()));
-	}
-	break;
-      case psOpGe:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushBool(i1 >= i2);
-	} else {
-	  r2 = stack->popNum();
-	  r1 = stack->popNum();
-	  stack->pushBool(r1 >= r2);
-	}
-	break;
-      case psOpGt:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushBool(i1 > i2);
-	} else {
-	  r2 = stack->popNum();
-	  r1 = stack->popNum();
-	  stack->pushBool(r1 > r2);
-	}
-	break;
-      case psOpIdiv:
-	i2 = stack->popInt();
-	i1 = stack->popInt();
-	if (likely(i2 != 0)) {
-	  stack->pushInt(i1 / i2);
-	}
-	break;
-      case psOpIndex:
-	stack->index(stack->popInt());
-	break;
-      case psOpLe:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushBool(i1 <= i2);
-	} else {
-	  r2 = stack->popNum();
-	  r1 = stack->popNum();
-	  stack->pushBool(r1 <= r2);
-	}
-	break;
-      case psOpLn:
-	stack->pushReal(log(stack->popNum()));
-	break;
-      case psOpLog:
-	stack->pushReal(log10(stack->popNum()));
-	break;
-      case psOpLt:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushBool(i1 < i2);
-	} else {
-	  r2 = stack->popNum();
-	  r1 = stack->popNum();
-	  stack->pushBool(r1 < r2);
-	}
-	break;
-      case psOpMod:
-	i2 = stack->popInt();
-	i1 = stack->popInt();
-	if (likely(i2 != 0)) {
-	  stack->pushInt(i1 % i2);
-	}
-	break;
-      case psOpMul:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  //~ should check for out-of-range, and push a real instead
-	  stack->pushInt(i1 * i2);
-	} else {
-	  r2 = stack->popNum();
-	  r1 = stack->popNum();
-	  stack->pushReal(r1 * r2);
-	}
-	break;
-      case psOpNe:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushBool(i1 != i2);
-	} else if (stack->topTwoAreNums()) {
-	  r2 = stack->popNum();
-	  r1 = stack->popNum();
-	  stack->pushBool(r1 != r2);
-	} else {
-	  b2 = stack->popBool();
-	  b1 = stack->popBool();
-	  stack->pushBool(b1 != b2);
-	}
-	break;
-      case psOpNeg:
-	if (stack->topIsInt()) {
-	  stack->pushInt(-stack->popInt());
-	} else {
-	  stack->pushReal(-stack->popNum());
-	}
-	break;
-      case psOpNot:
-	if (stack->topIsInt()) {
-	  stack->pushInt(~stack->popInt());
-	} else {
-	  stack->pushBool(!stack->popBool());
-	}
-	break;
-      case psOpOr:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushInt(i1 | i2);
-	} else {
-	  b2 = stack->popBool();
-	  b1 = stack->popBool();
-	  stack->pushBool(b1 || b2);
-	}
-	break;
-      case psOpPop:
-	stack->pop();
-	break;
-      case psOpRoll:
-	i2 = stack->popInt();
-	i1 = stack->popInt();
-	stack->roll(i1, i2);
-	break;
-      case psOpRound:
-	if (!stack->topIsInt()) {
-	  r1 = stack->popNum();
-	  stack->pushReal((r1 >= 0) ? floor(r1 + 0.5) : ceil(r1 - 0.5));
-	}
-	break;
-      case psOpSin:
-	stack->pushReal(sin(stack->popNum() * M_PI / 180.0));
-	break;
-      case psOpSqrt:
-	stack->pushReal(sqrt(stack->popNum()));
-	break;
-      case psOpSub:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushInt(i1 - i2);
-	} else {
-	  r2 = stack->popNum();
-	  r1 = stack->popNum();
-	  stack->pushReal(r1 - r2);
-	}
-	break;
-      case psOpTrue:
-	stack->pushBool(true);
-	break;
-      case psOpTruncate:
-	if (!stack->topIsInt()) {
-	  r1 = stack->popNum();
-	  stack->pushReal((r1 >= 0) ? floor(r1) : ceil(r1));
-	}
-	break;
-      case psOpXor:
-	if (stack->topTwoAreInts()) {
-	  i2 = stack->popInt();
-	  i1 = stack->popInt();
-	  stack->pushInt(i1 ^ i2);
-	} else {
-	  b2 = stack->popBool();
-	  b1 = stack->popBool();
-	  stack->pushBool(b1 ^ b2);
-	}
-	break;
       case psOpIf:
 	b1 = stack->popBool();
 	if (b1) {
@@ -1722,6 +2639,9 @@ void PostScriptFunction::exec(PSStack *stack, int codePtr) const {
 	break;
       case psOpReturn:
 	return;
+      default:
+	execOp(stack, code[codePtr - 1].op);
+	break;
       }
       break;
     default:
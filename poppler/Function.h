@@ -34,6 +34,7 @@ class Dict;
 class Stream;
 struct PSObject;
 class PSStack;
+class PSProgram;
 
 //------------------------------------------------------------------------
 // Function
@@ -83,6 +84,10 @@ public:
   // Transform an input tuple into an output tuple.
   virtual void transform(const double *in, double *out) const = 0;
 
+  // Transform <count> input tuples, stored one after the other in <in>,
+  // into the output tuples in <out>.
+  virtual void transformBatch(const double *in, double *out, int count) const;
+
   virtual bool isOk() const = 0;
 
 protected:
@@ -232,10 +237,19 @@ public:
   Function *copy() const override { return new PostScriptFunction(this); }
   int getType() const override { return 4; }
   void transform(const double *in, double *out) const override;
+  void transformBatch(const double *in, double *out, int count) const override;
   bool isOk() const override { return ok; }
 
   const GooString *getCodeString() const { return codeString; }
 
+  // Whether the function was compiled, rather than left to the
+  // interpreter.
+  bool isCompiled() const { return program != nullptr; }
+
+  // Evaluate the function with the interpreter, even if it was compiled.
+  // The compiled code must give the same results.
+  void transformInterpreted(const double *in, double *out) const;
+
 private:
 
   PostScriptFunction(const PostScriptFunction *func);
@@ -243,10 +257,14 @@ private:
   GooString getToken(Stream *str);
   void resizeCode(int newSize);
   void exec(PSStack *stack, int codePtr) const;
+  void evaluate(const double *in, double *out) const;
+  void interpret(const double *in, double *out) const;
+  void clipToRange(double *out) const;
 
   GooString *codeString;
   PSObject *code;
   int codeSize;
+  PSProgram *program;		// compiled code, or nullptr to interpret it
   mutable double cacheIn[funcMaxInputs];
   mutable double cacheOut[funcMaxOutputs];
   bool ok;
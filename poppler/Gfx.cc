@@ -56,7 +56,10 @@
 #include <stddef.h>
 #include <string.h>
 #include <math.h>
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <string>
 #include "goo/gmem.h"
 #include "goo/GooTimer.h"
 #include "GlobalParams.h"
@@ -129,6 +132,16 @@
 // fill.
 #define patchColorDelta (dblToCol((3. / 256.0)))
 
+// Max number of parsed content streams kept per document, and their
+// total memory budget.
+#define contentCacheSize 256
+#define contentCacheMaxBytes (32 * 1024 * 1024)
+
+// Max number of decoded images kept per document, and their default
+// total memory budget.
+#define imageCacheSize 256
+#define imageCacheMaxBytes (64 * 1024 * 1024)
+
 //------------------------------------------------------------------------
 // Operator table
 //------------------------------------------------------------------------
@@ -519,6 +532,134 @@ Object GfxResources::lookupGStateNF(const char *name) {
   return Object(objNull);
 }
 
+//------------------------------------------------------------------------
+// GfxContentCache
+//------------------------------------------------------------------------
+
+GfxContentCache::GfxContentCache() :
+    cache(contentCacheSize, contentCacheMaxBytes) {
+}
+
+std::shared_ptr<const GfxContentOps> GfxContentCache::lookup(Ref ref) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (auto *ops = cache.lookup(ref)) {
+    return *ops;
+  }
+  return nullptr;
+}
+
+void GfxContentCache::put(Ref ref, std::shared_ptr<const GfxContentOps> ops) {
+  // a stream this large would push everything else out of the cache
+  if (ops->bytes > contentCacheMaxBytes / 4) {
+    return;
+  }
+  const std::size_t bytes = ops->bytes;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  cache.put(ref, new std::shared_ptr<const GfxContentOps>(std::move(ops)), bytes);
+}
+
+//------------------------------------------------------------------------
+// GfxImageCache
+//------------------------------------------------------------------------
+
+bool GfxImageCacheKey::operator==(const GfxImageCacheKey &key) const {
+  return ref == key.ref && width == key.width && height == key.height &&
+         mode == key.mode && csMode == key.csMode &&
+         nComps == key.nComps && bits == key.bits && decode == key.decode;
+}
+
+std::size_t GfxImageCacheKeyHash::operator()(const GfxImageCacheKey &key) const {
+  std::hash<double> doubleHash;
+  std::size_t h;
+
+  h = std::hash<Ref>()(key.ref);
+  h = h * 31 + (std::size_t)key.width;
+  h = h * 31 + (std::size_t)key.height;
+  h = h * 31 + (std::size_t)key.mode;
+  h = h * 31 + (std::size_t)key.csMode;
+  h = h * 31 + (std::size_t)key.nComps;
+  h = h * 31 + (std::size_t)key.bits;
+  for (double d : key.decode) {
+    h = h * 31 + doubleHash(d);
+  }
+  return h;
+}
+
+GfxImageCache::GfxImageCache() :
+    cache(imageCacheSize, imageCacheMaxBytes) {
+  maxBytes = imageCacheMaxBytes;
+  hits = 0;
+  misses = 0;
+}
+
+std::shared_ptr<const GfxCachedImage> GfxImageCache::lookup(const GfxImageCacheKey &key) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (auto *image = cache.lookup(key)) {
+    ++hits;
+    return *image;
+  }
+  ++misses;
+  return nullptr;
+}
+
+bool GfxImageCache::accepts(std::size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // an image this large would push everything else out of the cache
+  return bytes <= maxBytes / 4;
+}
+
+void GfxImageCache::put(const GfxImageCacheKey &key,
+			std::shared_ptr<const GfxCachedImage> image) {
+  const std::size_t bytes = image->rows.size() + sizeof(GfxCachedImage);
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // another thread may have decoded the same image meanwhile
+  if (bytes > maxBytes / 4 || cache.lookup(key)) {
+    return;
+  }
+  cache.put(key, new std::shared_ptr<const GfxCachedImage>(std::move(image)), bytes);
+}
+
+void GfxImageCache::setMaxBytes(std::size_t maxBytesA) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  maxBytes = maxBytesA;
+  if (maxBytes == 0) {
+    cache.clear();
+  } else {
+    cache.setMaxBytes(maxBytes);
+  }
+}
+
+std::size_t GfxImageCache::getMaxBytes() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return maxBytes;
+}
+
+std::size_t GfxImageCache::getBytes() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return cache.getBytes();
+}
+
+std::size_t GfxImageCache::getHits() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return hits;
+}
+
+std::size_t GfxImageCache::getMisses() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return misses;
+}
+
 //------------------------------------------------------------------------
 // Gfx
 //------------------------------------------------------------------------
@@ -689,7 +830,7 @@ Gfx::~Gfx() {
   }
 }
 
-void Gfx::display(Object *obj, bool topLevel) {
+void Gfx::display(Object *obj, bool topLevel, Ref contentsRef) {
   int i;
 
   if (obj->isArray()) {
@@ -704,84 +845,85 @@ void Gfx::display(Object *obj, bool topLevel) {
     error(errSyntaxError, -1, "Weird page contents");
     return;
   }
+
+  // a modified document may have changed the stream since it was cached
+  GfxContentCache *contentCache = nullptr;
+  if (contentsRef != Ref::INVALID() && catalog && !xref->isModified()) {
+    contentCache = catalog->getContentCache();
+    if (auto ops = contentCache->lookup(contentsRef)) {
+      go(ops.get(), topLevel);
+      return;
+    }
+  }
+
+  std::unique_ptr<GfxContentOps> record;
+  if (contentCache) {
+    record = std::make_unique<GfxContentOps>();
+  }
   parser = new Parser(xref, obj, false);
-  go(topLevel);
+  if (go(topLevel, record.get()) && record) {
+    contentCache->put(contentsRef, std::move(record));
+  }
   delete parser;
   parser = nullptr;
 }
 
-void Gfx::go(bool topLevel) {
+// Interpret the content stream from the parser.  If <record> is not
+// nullptr, the operators are also appended to it; returns true if the
+// recording is complete, i.e. the stream could be replayed from it.
+bool Gfx::go(bool topLevel, GfxContentOps *record) {
   Object obj;
   Object args[maxArgs];
+  Operator *op;
   int numArgs, i;
   int lastAbortCheck;
+  bool complete;
 
   // scan a sequence of objects
   pushStateGuard();
   updateLevel = 1; // make sure even empty pages trigger a call to dump()
   lastAbortCheck = 0;
   numArgs = 0;
+  complete = true;
   obj = parser->getObj();
   while (!obj.isEOF()) {
     commandAborted = false;
 
     // got a command - execute it
     if (obj.isCmd()) {
-      if (printCommands) {
-	obj.print(stdout);
-	for (i = 0; i < numArgs; ++i) {
-	  printf(" ");
-	  args[i].print(stdout);
-	}
-	printf("\n");
-	fflush(stdout);
-      }
-      GooTimer *timer = nullptr;
-
-      if (unlikely(profileCommands)) {
-          timer = new GooTimer();
-      }
-
-      // Run the operation
-      execOp(&obj, args, numArgs);
+      op = findOp(obj.getCmd());
 
-      // Update the profile information
-      if (unlikely(profileCommands)) {
-	if (auto* const hash = out->getProfileHash()) {
-	  auto& data = (*hash)[obj.getCmd()];
-	  data.addElement(timer->getElapsed());
+      if (record) {
+	// in-line images read their data from the stream itself
+	if (op && op->func == &Gfx::opBeginImage) {
+	  record = nullptr;
+	} else {
+	  record->ops.push_back(GfxContentOp{obj.copy(), op,
+					     (int)record->args.size(), numArgs});
+	  // not shared with the operands, which the command may modify
+	  for (i = 0; i < numArgs; ++i) {
+	    record->args.push_back(args[i].deepCopy());
+	    record->bytes += args[i].getMemoryUsage();
+	  }
+	  record->bytes += sizeof(GfxContentOp);
+	  // too large to be cached: stop recording
+	  if (record->bytes > contentCacheMaxBytes / 4) {
+	    record->ops.clear();
+	    record->args.clear();
+	    record = nullptr;
+	  }
 	}
-	delete timer;
-      }
-      for (i = 0; i < numArgs; ++i)
-	args[i].setToNull(); // Free memory early
-      numArgs = 0;
-
-      // periodically update display
-      if (++updateLevel >= 20000) {
-	out->dump();
-	updateLevel = 0;
-	lastAbortCheck = 0;
       }
 
-      // did the command throw an exception
-      if (commandAborted) {
-	// don't propogate; recursive drawing comes from Form XObjects which
-	// should probably be drawn in a separate context anyway for caching
-	commandAborted = false;
+      // the operands were used up by the command, even one that aborted
+      // the drawing
+      const bool cont = runCmd(&obj, op, args, numArgs, &lastAbortCheck);
+      numArgs = 0;
+      if (!cont) {
+	complete = false;
 	break;
       }
 
-      // check for an abort
-      if (abortCheckCbk) {
-	if (updateLevel - lastAbortCheck > 10) {
-	  if ((*abortCheckCbk)(abortCheckCbkData)) {
-	    break;
-	  }
-	  lastAbortCheck = updateLevel;
-	}
-      }
-
     // got an argument - save it
     } else if (numArgs < maxArgs) {
       args[numArgs++] = std::move(obj);
@@ -820,16 +962,169 @@ void Gfx::go(bool topLevel) {
   if (topLevel && updateLevel > 0) {
     out->dump();
   }
+
+  return record && complete;
 }
 
-void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
-  Operator *op;
+// Replay a content stream that was parsed before.
+void Gfx::go(const GfxContentOps *ops, bool topLevel) {
+  Object args[maxArgs];
+  int lastAbortCheck, i;
+
+  pushStateGuard();
+  updateLevel = 1; // make sure even empty pages trigger a call to dump()
+  lastAbortCheck = 0;
+  for (const GfxContentOp &cmd : ops->ops) {
+    commandAborted = false;
+    // the operators may modify their operands, arrays and dicts
+    // included, which copy() would share with the recording
+    for (i = 0; i < cmd.numArgs; ++i) {
+      args[i] = ops->args[cmd.firstArg + i].deepCopy();
+    }
+    if (!runCmd(&cmd.cmd, cmd.op, args, cmd.numArgs, &lastAbortCheck)) {
+      break;
+    }
+  }
+  popStateGuard();
+
+  // update display
+  if (topLevel && updateLevel > 0) {
+    out->dump();
+  }
+}
+
+// Execute a command and do the periodic work between commands.  Returns
+// false if drawing has to stop.
+bool Gfx::runCmd(const Object *cmd, Operator *op, Object args[], int numArgs,
+		 int *lastAbortCheck) {
+  int i;
+
+  if (printCommands) {
+    cmd->print(stdout);
+    for (i = 0; i < numArgs; ++i) {
+      printf(" ");
+      args[i].print(stdout);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+  GooTimer *timer = nullptr;
+
+  if (unlikely(profileCommands)) {
+      pushProfileFrame(cmd, op, args, numArgs);
+      timer = new GooTimer();
+  }
+
+  // Run the operation
+  execOp(cmd, op, args, numArgs);
+
+  // Update the profile information
+  if (unlikely(profileCommands)) {
+    popProfileFrame(cmd, timer->getElapsed());
+    delete timer;
+  }
+  for (i = 0; i < numArgs; ++i)
+    args[i].setToNull(); // Free memory early
+
+  // periodically update display
+  if (++updateLevel >= 20000) {
+    out->dump();
+    updateLevel = 0;
+    *lastAbortCheck = 0;
+  }
+
+  // did the command throw an exception
+  if (commandAborted) {
+    // don't propogate; recursive drawing comes from Form XObjects which
+    // should probably be drawn in a separate context anyway for caching
+    commandAborted = false;
+    return false;
+  }
+
+  // check for an abort
+  if (abortCheckCbk) {
+    if (updateLevel - *lastAbortCheck > 10) {
+      if ((*abortCheckCbk)(abortCheckCbkData)) {
+	return false;
+      }
+      *lastAbortCheck = updateLevel;
+    }
+  }
+
+  return true;
+}
+
+// Start profiling a command: find the resource it works on, which has
+// to be done before the command runs, as it may modify its operands.
+void Gfx::pushProfileFrame(const Object *cmd, Operator *op, Object args[], int numArgs) {
+  ProfileFrame frame;
+  GfxFont *font;
+
+  frame.ref = Ref::INVALID();
+  frame.childTime = 0;
+  if (op && op->func == &Gfx::opXObject && numArgs >= 1 && args[numArgs - 1].isName()) {
+    Object refObj = res->lookupXObjectNF(args[numArgs - 1].getName());
+    if (refObj.isRef()) {
+      frame.ref = refObj.getRef();
+    }
+  } else if (op && op->func == &Gfx::opSetFont && numArgs >= 2 && args[numArgs - 2].isName()) {
+    if ((font = res->lookupFont(args[numArgs - 2].getName()))) {
+      frame.ref = *font->getID();
+    }
+  } else if (op && (op->func == &Gfx::opShowText ||
+		    op->func == &Gfx::opShowSpaceText ||
+		    op->func == &Gfx::opMoveShowText ||
+		    op->func == &Gfx::opMoveSetShowText)) {
+    if ((font = state->getFont())) {
+      frame.ref = *font->getID();
+    }
+  }
+
+  // ';' separates the frames of folded stacks
+  frame.name = cmd->getCmd();
+  std::replace(frame.name.begin(), frame.name.end(), ';', '_');
+  if (frame.ref != Ref::INVALID()) {
+    frame.name += ' ';
+    frame.name += std::to_string(frame.ref.num);
+    frame.name += ' ';
+    frame.name += std::to_string(frame.ref.gen);
+    frame.name += " R";
+  }
+  profileFrames.push_back(std::move(frame));
+}
+
+void Gfx::popProfileFrame(const Object *cmd, double elapsed) {
+  ProfileFrame frame = std::move(profileFrames.back());
+  profileFrames.pop_back();
+  if (!profileFrames.empty()) {
+    profileFrames.back().childTime += elapsed;
+  }
+
+  if (auto* const hash = out->getProfileHash()) {
+    auto& data = (*hash)[cmd->getCmd()];
+    data.addElement(elapsed);
+  }
+  if (auto* const report = out->getProfileReport()) {
+    report->addElement(cmd->getCmd(), frame.ref.num, frame.ref.gen,
+		       (int)profileFrames.size(), elapsed);
+    std::string stack;
+    for (const ProfileFrame &outer : profileFrames) {
+      stack += outer.name;
+      stack += ';';
+    }
+    stack += frame.name;
+    report->addStack(stack, elapsed - frame.childTime);
+  }
+}
+
+// <op> is the operator table entry for <cmd>, or nullptr if there is
+// none.
+void Gfx::execOp(const Object *cmd, Operator *op, Object args[], int numArgs) {
   Object *argPtr;
   int i;
 
-  // find operator
   const char *name = cmd->getCmd();
-  if (!(op = findOp(name))) {
+  if (!op) {
     if (ignoreUndef == 0)
       error(errSyntaxError, getPos(), "Unknown operator '{0:s}'", name);
     return;
@@ -4175,7 +4470,7 @@ void Gfx::opXObject(Object args[], int numArgs) {
       if (out->useDrawForm() && refObj.isRef()) {
 	out->drawForm(refObj.getRef());
       } else {
-	doForm(&obj1);
+	doForm(&obj1, refObj.isRef() ? refObj.getRef() : Ref::INVALID());
       }
     }
     if (refObj.isRef() && shouldDoForm) {
@@ -4662,7 +4957,7 @@ bool Gfx::checkTransparencyGroup(Dict *resDict) {
   return transpGroup;
 }
 
-void Gfx::doForm(Object *str) {
+void Gfx::doForm(Object *str, Ref formRef) {
   Dict *dict;
   bool transpGroup, isolated, knockout;
   GfxColorSpace *blendingColorSpace;
@@ -4758,7 +5053,8 @@ void Gfx::doForm(Object *str) {
   // draw it
   ++formDepth;
   drawForm(str, resDict, m, bbox,
-	  transpGroup, false, blendingColorSpace, isolated, knockout);
+	  transpGroup, false, blendingColorSpace, isolated, knockout,
+	  false, nullptr, nullptr, formRef);
   --formDepth;
 
   if (blendingColorSpace) {
@@ -4773,7 +5069,7 @@ void Gfx::drawForm(Object *str, Dict *resDict, const double *matrix, const doubl
 		  GfxColorSpace *blendingColorSpace,
 		  bool isolated, bool knockout,
 		  bool alpha, Function *transferFunc,
-		  GfxColor *backdropColor) {
+		  GfxColor *backdropColor, Ref formRef) {
   Parser *oldParser;
   GfxState *savedState;
   double oldBaseMatrix[6];
@@ -4834,7 +5130,7 @@ void Gfx::drawForm(Object *str, Dict *resDict, const double *matrix, const doubl
   GfxState *stateBefore = state;
 
   // draw the form
-  display(str, false);
+  display(str, false, formRef);
   
   if (stateBefore != state) {
     if (state->isParentState(stateBefore)) {
@@ -39,6 +39,8 @@
 #include "Object.h"
 #include "PopplerCache.h"
 
+#include <memory>
+#include <mutex>
 #include <vector>
 
 class GooString;
@@ -140,6 +142,115 @@ private:
   GfxResources *next;
 };
 
+//------------------------------------------------------------------------
+// GfxContentOps
+//------------------------------------------------------------------------
+
+// A content stream that has already been parsed: its operators, looked
+// up in the operator table, and their operands.  Drawing the stream
+// again replays these instead of decoding and lexing the stream.
+struct GfxContentOp {
+  Object cmd;			// operator name
+  Operator *op;			// nullptr if the operator is unknown
+  int firstArg;			// index of the first operand in args
+  int numArgs;
+};
+
+struct GfxContentOps {
+  std::vector<GfxContentOp> ops;
+  std::vector<Object> args;
+  std::size_t bytes = 0;	// approximate memory use
+};
+
+//------------------------------------------------------------------------
+// GfxContentCache
+//------------------------------------------------------------------------
+
+// Per-document cache of parsed page content streams and Form XObjects,
+// keyed by the Ref of the stream (or of the page, for a direct array of
+// content streams).
+class GfxContentCache {
+public:
+
+  GfxContentCache();
+
+  GfxContentCache(const GfxContentCache &) = delete;
+  GfxContentCache& operator=(const GfxContentCache &other) = delete;
+
+  // Returns nullptr if <ref> isn't cached.
+  std::shared_ptr<const GfxContentOps> lookup(Ref ref);
+
+  void put(Ref ref, std::shared_ptr<const GfxContentOps> ops);
+
+private:
+
+  std::mutex mutex;
+  PopplerCache<Ref, std::shared_ptr<const GfxContentOps>> cache;
+};
+
+//------------------------------------------------------------------------
+// GfxImageCache
+//------------------------------------------------------------------------
+
+// An Image XObject as decoded and color converted by an output device.
+struct GfxImageCacheKey {
+  Ref ref;			// the image XObject
+  int width, height;		// decoded size (may be reduced)
+  int mode;			// output device color mode
+  GfxColorSpaceMode csMode;
+  int nComps, bits;
+  std::vector<double> decode;	// decode low and high, per component
+
+  bool operator==(const GfxImageCacheKey &key) const;
+};
+
+struct GfxImageCacheKeyHash {
+  std::size_t operator()(const GfxImageCacheKey &key) const;
+};
+
+struct GfxCachedImage {
+  int rowSize;			// bytes per row
+  std::vector<unsigned char> rows;
+};
+
+// Per-document cache of decoded, color converted images, so that an
+// image shared by many pages (logos, backgrounds) is only decoded once
+// per output mode.  Shared by all the threads drawing the document.
+class GfxImageCache {
+public:
+
+  GfxImageCache();
+
+  GfxImageCache(const GfxImageCache &) = delete;
+  GfxImageCache& operator=(const GfxImageCache &other) = delete;
+
+  // Returns nullptr if <key> isn't cached.
+  std::shared_ptr<const GfxCachedImage> lookup(const GfxImageCacheKey &key);
+
+  // Returns true if an image of <bytes> bytes may be cached.
+  bool accepts(std::size_t bytes);
+
+  void put(const GfxImageCacheKey &key, std::shared_ptr<const GfxCachedImage> image);
+
+  // Memory budget; 0 disables the cache.
+  void setMaxBytes(std::size_t maxBytesA);
+  std::size_t getMaxBytes();
+  std::size_t getBytes();
+
+  // Number of lookups that found, or didn't find, the image.
+  std::size_t getHits();
+  std::size_t getMisses();
+
+private:
+
+  std::mutex mutex;
+  PopplerCache<GfxImageCacheKey, std::shared_ptr<const GfxCachedImage>,
+	       GfxImageCacheKeyHash> cache;
+  std::size_t maxBytes;
+  std::size_t hits;
+  std::size_t misses;
+};
+
 //------------------------------------------------------------------------
 // Gfx
 //------------------------------------------------------------------------
@@ -169,8 +280,10 @@ public:
 
   XRef *getXRef() { return xref; }
 
-  // Interpret a stream or array of streams.
-  void display(Object *obj, bool topLevel = true);
+  // Interpret a stream or array of streams.  If <contentsRef> is
+  // valid, the parsed operators are kept in the document's
+  // GfxContentCache under that Ref, and replayed from there next time.
+  void display(Object *obj, bool topLevel = true, Ref contentsRef = Ref::INVALID());
 
   // Display an annotation, given its appearance (a Form XObject),
   // border style, and bounding box (in default user space).
@@ -199,7 +312,7 @@ public:
 	       GfxColorSpace *blendingColorSpace = nullptr,
 	       bool isolated = false, bool knockout = false,
 	       bool alpha = false, Function *transferFunc = nullptr,
-	       GfxColor *backdropColor = nullptr);
+	       GfxColor *backdropColor = nullptr, Ref formRef = Ref::INVALID());
 
   void pushResources(Dict *resDict);
   void popResources();
@@ -213,6 +326,13 @@ private:
   bool subPage;		// is this a sub-page object?
   bool printCommands;		// print the drawing commands (for debugging)
   bool profileCommands;	// profile the drawing commands (for debugging)
+  struct ProfileFrame {
+    std::string name;		// operator and resource, as shown in stacks
+    Ref ref;			// resource, or Ref::INVALID()
+    double childTime;		// time spent in nested operators
+  };
+  std::vector<ProfileFrame> profileFrames; // operators being profiled,
+					   //   outermost first
   bool commandAborted;         // did the previous command abort the drawing?
   GfxResources *res;		// resource stack
   int updateLevel;
@@ -242,8 +362,13 @@ private:
 
   static Operator opTab[];	// table of operators
 
-  void go(bool topLevel);
-  void execOp(Object *cmd, Object args[], int numArgs);
+  bool go(bool topLevel, GfxContentOps *record);
+  void go(const GfxContentOps *ops, bool topLevel);
+  bool runCmd(const Object *cmd, Operator *op, Object args[], int numArgs,
+	      int *lastAbortCheck);
+  void execOp(const Object *cmd, Operator *op, Object args[], int numArgs);
+  void pushProfileFrame(const Object *cmd, Operator *op, Object args[], int numArgs);
+  void popProfileFrame(const Object *cmd, double elapsed);
   Operator *findOp(const char *name);
   bool checkArg(Object *arg, TchkType type);
   Goffset getPos();
@@ -364,7 +489,7 @@ private:
   // XObject operators
   void opXObject(Object args[], int numArgs);
   void doImage(Object *ref, Stream *str, bool inlineImg);
-  void doForm(Object *str);
+  void doForm(Object *str, Ref formRef = Ref::INVALID());
 
   // in-line image operators
   void opBeginImage(Object args[], int numArgs);
@@ -47,6 +47,9 @@
 #include <stddef.h>
 #include <math.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "goo/gfile.h"
 #include "goo/gmem.h"
 #include "Error.h"
@@ -183,8 +186,6 @@ static const char *gfxColorSpaceModeNames[] = {
 
 #ifdef USE_CMS
 
-static const std::map<unsigned int, unsigned int>::size_type CMSCACHE_LIMIT = 2048;
-
 #include <lcms2.h>
 #define LCMS_FLAGS cmsFLAGS_NOOPTIMIZE | cmsFLAGS_BLACKPOINTCOMPENSATION
 
@@ -1008,11 +1009,7 @@ void GfxDeviceRGBColorSpace::getRGBLine(unsigned char *in, unsigned int *out,
 }
 
 void GfxDeviceRGBColorSpace::getRGBLine(unsigned char *in, unsigned char *out, int length) {
-  for (int i = 0; i < length; i++) {
-    *out++ = *in++;
-    *out++ = *in++;
-    *out++ = *in++;
-  }
+  memcpy(out, in, 3 * (size_t)length);
 }
 
 void GfxDeviceRGBColorSpace::getRGBXLine(unsigned char *in, unsigned char *out, int length) {
@@ -1386,14 +1383,14 @@ void GfxDeviceCMYKColorSpace::getRGB(const GfxColor *color, GfxRGB *rgb) const {
   rgb->b = clip01(dblToCol(b));
 }
 
-static inline void GfxDeviceCMYKColorSpacegetRGBLineHelper(unsigned char *&in, double &r, double &g, double &b)
+static inline void GfxDeviceCMYKColorSpacegetRGBLineHelper(const unsigned char *in, double &r, double &g, double &b)
 {
   double c, m, y, k, c1, m1, y1, k1;
   
-  c = byteToDbl(*in++);
-  m = byteToDbl(*in++);
-  y = byteToDbl(*in++);
-  k = byteToDbl(*in++);
+  c = byteToDbl(in[0]);
+  m = byteToDbl(in[1]);
+  y = byteToDbl(in[2]);
+  k = byteToDbl(in[3]);
   c1 = 1 - c;
   m1 = 1 - m;
   y1 = 1 - y;
@@ -1401,48 +1398,184 @@ static inline void GfxDeviceCMYKColorSpacegetRGBLineHelper(unsigned char *&in, d
   cmykToRGBMatrixMultiplication(c, m, y, k, c1, m1, y1, k1, r, g, b);
 }
 
-void GfxDeviceCMYKColorSpace::getRGBLine(unsigned char *in, unsigned int *out, int length)
+static inline void cmykPixelToRGB(const unsigned char *in, unsigned char *out)
 {
   double r, g, b;
-  for (int i = 0; i < length; i++) {
-    GfxDeviceCMYKColorSpacegetRGBLineHelper(in, r, g, b);
-    *out++ = (dblToByte(clip01(r)) << 16) | (dblToByte(clip01(g)) << 8) | dblToByte(clip01(b));
+
+  GfxDeviceCMYKColorSpacegetRGBLineHelper(in, r, g, b);
+  out[0] = dblToByte(clip01(r));
+  out[1] = dblToByte(clip01(g));
+  out[2] = dblToByte(clip01(b));
+}
+
+#ifdef __SSE2__
+
+// r += coef * x, for two pixels.
+static inline __m128d cmykAddTerm(__m128d r, double coef, __m128d x)
+{
+  return _mm_add_pd(r, _mm_mul_pd(_mm_set1_pd(coef), x));
+}
+
+// Same as cmykPixelToRGB(), for the two pixels at <in0> and <in1>: the
+// operations are the same, in the same order, so the results are too.
+static inline void cmykPixelsToRGB(const unsigned char *in0, const unsigned char *in1,
+				   unsigned char *out0, unsigned char *out1)
+{
+  const __m128d d255 = _mm_set1_pd(255.0);
+  const __m128d one = _mm_set1_pd(1.0);
+  __m128d c, m, y, k, c1, m1, y1, k1, c1m1, c1m, cm1, cm, x, r, g, b;
+  int rgb[2][3];
+  int i;
+
+  c = _mm_div_pd(_mm_set_pd(in1[0], in0[0]), d255);
+  m = _mm_div_pd(_mm_set_pd(in1[1], in0[1]), d255);
+  y = _mm_div_pd(_mm_set_pd(in1[2], in0[2]), d255);
+  k = _mm_div_pd(_mm_set_pd(in1[3], in0[3]), d255);
+  c1 = _mm_sub_pd(one, c);
+  m1 = _mm_sub_pd(one, m);
+  y1 = _mm_sub_pd(one, y);
+  k1 = _mm_sub_pd(one, k);
+  c1m1 = _mm_mul_pd(c1, m1);
+  c1m = _mm_mul_pd(c1, m);
+  cm1 = _mm_mul_pd(c, m1);
+  cm = _mm_mul_pd(c, m);
+
+  // see cmykToRGBMatrixMultiplication()
+  x = _mm_mul_pd(_mm_mul_pd(c1m1, y1), k1);
+  r = g = b = x;
+  x = _mm_mul_pd(_mm_mul_pd(c1m1, y1), k);
+  r = cmykAddTerm(r, 0.1373, x);
+  g = cmykAddTerm(g, 0.1216, x);
+  b = cmykAddTerm(b, 0.1255, x);
+  x = _mm_mul_pd(_mm_mul_pd(c1m1, y), k1);
+  r = _mm_add_pd(r, x);
+  g = cmykAddTerm(g, 0.9490, x);
+  x = _mm_mul_pd(_mm_mul_pd(c1m1, y), k);
+  r = cmykAddTerm(r, 0.1098, x);
+  g = cmykAddTerm(g, 0.1020, x);
+  x = _mm_mul_pd(_mm_mul_pd(c1m, y1), k1);
+  r = cmykAddTerm(r, 0.9255, x);
+  b = cmykAddTerm(b, 0.5490, x);
+  x = _mm_mul_pd(_mm_mul_pd(c1m, y1), k);
+  r = cmykAddTerm(r, 0.1412, x);
+  x = _mm_mul_pd(_mm_mul_pd(c1m, y), k1);
+  r = cmykAddTerm(r, 0.9294, x);
+  g = cmykAddTerm(g, 0.1098, x);
+  b = cmykAddTerm(b, 0.1412, x);
+  x = _mm_mul_pd(_mm_mul_pd(c1m, y), k);
+  r = cmykAddTerm(r, 0.1333, x);
+  x = _mm_mul_pd(_mm_mul_pd(cm1, y1), k1);
+  g = cmykAddTerm(g, 0.6784, x);
+  b = cmykAddTerm(b, 0.9373, x);
+  x = _mm_mul_pd(_mm_mul_pd(cm1, y1), k);
+  g = cmykAddTerm(g, 0.0588, x);
+  b = cmykAddTerm(b, 0.1412, x);
+  x = _mm_mul_pd(_mm_mul_pd(cm1, y), k1);
+  g = cmykAddTerm(g, 0.6510, x);
+  b = cmykAddTerm(b, 0.3137, x);
+  x = _mm_mul_pd(_mm_mul_pd(cm1, y), k);
+  g = cmykAddTerm(g, 0.0745, x);
+  x = _mm_mul_pd(_mm_mul_pd(cm, y1), k1);
+  r = cmykAddTerm(r, 0.1804, x);
+  g = cmykAddTerm(g, 0.1922, x);
+  b = cmykAddTerm(b, 0.5725, x);
+  x = _mm_mul_pd(_mm_mul_pd(cm, y1), k);
+  b = cmykAddTerm(b, 0.0078, x);
+  x = _mm_mul_pd(_mm_mul_pd(cm, y), k1);
+  r = cmykAddTerm(r, 0.2118, x);
+  g = cmykAddTerm(g, 0.2119, x);
+  b = cmykAddTerm(b, 0.2235, x);
+
+  // dblToByte(clip01(v)), truncating like the conversion to unsigned char
+  const __m128d zero = _mm_setzero_pd();
+  __m128i ri = _mm_cvttpd_epi32(_mm_mul_pd(_mm_min_pd(_mm_max_pd(r, zero), one), d255));
+  __m128i gi = _mm_cvttpd_epi32(_mm_mul_pd(_mm_min_pd(_mm_max_pd(g, zero), one), d255));
+  __m128i bi = _mm_cvttpd_epi32(_mm_mul_pd(_mm_min_pd(_mm_max_pd(b, zero), one), d255));
+  for (i = 0; i < 2; ++i) {
+    rgb[i][0] = _mm_cvtsi128_si32(ri);
+    rgb[i][1] = _mm_cvtsi128_si32(gi);
+    rgb[i][2] = _mm_cvtsi128_si32(bi);
+    ri = _mm_srli_si128(ri, 4);
+    gi = _mm_srli_si128(gi, 4);
+    bi = _mm_srli_si128(bi, 4);
+  }
+  out0[0] = (unsigned char)rgb[0][0];
+  out0[1] = (unsigned char)rgb[0][1];
+  out0[2] = (unsigned char)rgb[0][2];
+  out1[0] = (unsigned char)rgb[1][0];
+  out1[1] = (unsigned char)rgb[1][1];
+  out1[2] = (unsigned char)rgb[1][2];
+}
+
+#endif
+
+// Convert a line of CMYK pixels to RGB, with <outStride> bytes per
+// output pixel; the bytes after the first 3 are left unchanged.  Print
+// images often have runs of identical pixels (flat areas, white
+// margins): a pixel equal to the previous one reuses its color.
+static void cmykLineToRGB(const unsigned char *in, unsigned char *out,
+			  int length, int outStride)
+{
+  const unsigned char *prevIn = nullptr;
+  unsigned char *prevOut = nullptr;
+  int i;
+
+  i = 0;
+#ifdef __SSE2__
+  for (; i + 1 < length; i += 2, in += 8, out += 2 * outStride) {
+    if (prevIn && !memcmp(in, prevIn, 4) && !memcmp(in + 4, prevIn, 4)) {
+      memcpy(out, prevOut, 3);
+      memcpy(out + outStride, prevOut, 3);
+    } else {
+      cmykPixelsToRGB(in, in + 4, out, out + outStride);
+      prevIn = in + 4;
+      prevOut = out + outStride;
+    }
+  }
+#endif
+  for (; i < length; ++i, in += 4, out += outStride) {
+    if (prevIn && !memcmp(in, prevIn, 4)) {
+      memcpy(out, prevOut, 3);
+    } else {
+      cmykPixelToRGB(in, out);
+      prevIn = in;
+      prevOut = out;
+    }
   }
 }
 
-void GfxDeviceCMYKColorSpace::getRGBLine(unsigned char *in, unsigned char *out, int length)
+void GfxDeviceCMYKColorSpace::getRGBLine(unsigned char *in, unsigned int *out, int length)
 {
-  double r, g, b;
-  
-  for (int i = 0; i < length; i++) {
-    GfxDeviceCMYKColorSpacegetRGBLineHelper(in, r, g, b);
-    *out++ = dblToByte(clip01(r));
-    *out++ = dblToByte(clip01(g));
-    *out++ = dblToByte(clip01(b));
+  unsigned char buf[3 * 256];
+  int n, i;
+
+  while (length > 0) {
+    n = length < 256 ? length : 256;
+    cmykLineToRGB(in, buf, n, 3);
+    for (i = 0; i < n; i++) {
+      *out++ = (buf[3*i] << 16) | (buf[3*i+1] << 8) | buf[3*i+2];
+    }
+    in += 4 * n;
+    length -= n;
   }
 }
 
+void GfxDeviceCMYKColorSpace::getRGBLine(unsigned char *in, unsigned char *out, int length)
+{
+  cmykLineToRGB(in, out, length, 3);
+}
+
 void GfxDeviceCMYKColorSpace::getRGBXLine(unsigned char *in, unsigned char *out, int length)
 {
-  double r, g, b;
-  
+  cmykLineToRGB(in, out, length, 4);
   for (int i = 0; i < length; i++) {
-    GfxDeviceCMYKColorSpacegetRGBLineHelper(in, r, g, b);
-    *out++ = dblToByte(clip01(r));
-    *out++ = dblToByte(clip01(g));
-    *out++ = dblToByte(clip01(b));
-    *out++ = 255;
+    out[4*i+3] = 255;
   }
 }
 
 void GfxDeviceCMYKColorSpace::getCMYKLine(unsigned char *in, unsigned char *out, int length)
 {
-  for (int i = 0; i < length; i++) {
-    *out++ = *in++;
-    *out++ = *in++;
-    *out++ = *in++;
-    *out++ = *in++;
-  }
+  memcpy(out, in, 4 * (size_t)length);
 }
 
 void GfxDeviceCMYKColorSpace::getDeviceNLine(unsigned char *in, unsigned char *out, int length)
@@ -1997,22 +2130,21 @@ void GfxICCBasedColorSpace::getGray(const GfxColor *color, GfxGray *gray) const
       for (int j = 0; j < nComps; j++) {
         key = (key << 8) + in[j];
       }
-      std::map<unsigned int, unsigned int>::iterator it = cmsCache.find(key);
-      if (it != cmsCache.end()) {
-        unsigned int value = it->second;
+      unsigned int value;
+      if (cmsCache.lookup(key, &value)) {
         *gray = byteToCol(value & 0xff);
         return;
       }
     }    
     transform->doTransform(in,out,1);
     *gray = byteToCol(out[0]);
-    if (nComps <= 4 && cmsCache.size() <= CMSCACHE_LIMIT) {
+    if (nComps <= 4) {
       unsigned int key = 0;
       for (int j = 0; j < nComps; j++) {
         key = (key << 8) + in[j];
       }
       unsigned int value = out[0];
-      cmsCache.insert(std::pair<unsigned int, unsigned int>(key, value));
+      cmsCache.put(key, value);
     }
   } else {
     GfxRGB rgb;
@@ -2046,9 +2178,8 @@ void GfxICCBasedColorSpace::getRGB(const GfxColor *color, GfxRGB *rgb) const {
       for (int j = 0; j < nComps; j++) {
         key = (key << 8) + in[j];
       }
-      std::map<unsigned int, unsigned int>::iterator it = cmsCache.find(key);
-      if (it != cmsCache.end()) {
-        unsigned int value = it->second;
+      unsigned int value;
+      if (cmsCache.lookup(key, &value)) {
         rgb->r = byteToCol(value >> 16);
         rgb->g = byteToCol((value >> 8) & 0xff);
         rgb->b = byteToCol(value & 0xff);
@@ -2059,13 +2190,13 @@ void GfxICCBasedColorSpace::getRGB(const GfxColor *color, GfxRGB *rgb) const {
     rgb->r = byteToCol(out[0]);
     rgb->g = byteToCol(out[1]);
     rgb->b = byteToCol(out[2]);
-    if (nComps <= 4 && cmsCache.size() <= CMSCACHE_LIMIT) {
+    if (nComps <= 4) {
       unsigned int key = 0;
       for (int j = 0; j < nComps; j++) {
         key = (key << 8) + in[j];
       }
       unsigned int value = (out[0] << 16) + (out[1] << 8) + out[2];
-      cmsCache.insert(std::pair<unsigned int, unsigned int>(key, value));
+      cmsCache.put(key, value);
     }
   } else if (transform != nullptr && transform->getTransformPixelType() == PT_CMYK) {
     unsigned char in[gfxColorMaxComps];
@@ -2086,9 +2217,8 @@ void GfxICCBasedColorSpace::getRGB(const GfxColor *color, GfxRGB *rgb) const {
       for (int j = 0; j < nComps; j++) {
         key = (key << 8) + in[j];
       }
-      std::map<unsigned int, unsigned int>::iterator it = cmsCache.find(key);
-      if (it != cmsCache.end()) {
-        unsigned int value = it->second;
+      unsigned int value;
+      if (cmsCache.lookup(key, &value)) {
         rgb->r = byteToCol(value >> 16);
         rgb->g = byteToCol((value >> 8) & 0xff);
         rgb->b = byteToCol(value & 0xff);
@@ -2108,13 +2238,13 @@ void GfxICCBasedColorSpace::getRGB(const GfxColor *color, GfxRGB *rgb) const {
     rgb->r = clip01(dblToCol(r));
     rgb->g = clip01(dblToCol(g));
     rgb->b = clip01(dblToCol(b));
-    if (nComps <= 4 && cmsCache.size() <= CMSCACHE_LIMIT) {
+    if (nComps <= 4) {
       unsigned int key = 0;
       for (int j = 0; j < nComps; j++) {
         key = (key << 8) + in[j];
       }
       unsigned int value = (dblToByte(r) << 16) + (dblToByte(g) << 8) + dblToByte(b);
-      cmsCache.insert(std::pair<unsigned int, unsigned int>(key, value));
+      cmsCache.put(key, value);
     }
   } else {
     alt->getRGB(color, rgb);
@@ -2304,9 +2434,8 @@ void GfxICCBasedColorSpace::getCMYK(const GfxColor *color, GfxCMYK *cmyk) const
       for (int j = 0; j < nComps; j++) {
         key = (key << 8) + in[j];
       }
-      std::map<unsigned int, unsigned int>::iterator it = cmsCache.find(key);
-      if (it != cmsCache.end()) {
-        unsigned int value = it->second;
+      unsigned int value;
+      if (cmsCache.lookup(key, &value)) {
         cmyk->c = byteToCol(value >> 24);
         cmyk->m = byteToCol((value >> 16) & 0xff);
         cmyk->y = byteToCol((value >> 8) & 0xff);
@@ -2319,13 +2448,13 @@ void GfxICCBasedColorSpace::getCMYK(const GfxColor *color, GfxCMYK *cmyk) const
     cmyk->m = byteToCol(out[1]);
     cmyk->y = byteToCol(out[2]);
     cmyk->k = byteToCol(out[3]);
-    if (nComps <= 4 && cmsCache.size() <= CMSCACHE_LIMIT) {
+    if (nComps <= 4) {
       unsigned int key = 0;
       for (int j = 0; j < nComps; j++) {
         key = (key << 8) + in[j];
       }
       unsigned int value = (out[0] << 24) + (out[1] << 16) + (out[2] << 8) + out[3];
-      cmsCache.insert(std::pair<unsigned int, unsigned int>(key, value));
+      cmsCache.put(key, value);
     }
   } else if (nComps != 4 && transform != nullptr && transform->getTransformPixelType() == PT_RGB) {
     GfxRGB rgb;
@@ -3984,12 +4113,18 @@ void GfxUnivariateShading::setupCache(const Matrix *ctm,
     for (j = 0; j < cacheSize; ++j) {
       cacheBounds[j] = tMin + j * step;
       cacheCoeff[j] = coeff;
-
-      for (i = 0; i < nComps; ++i) {
-	cacheValues[j*nComps + i] = 0;
-      }
-      for (i = 0; i < nFuncs; ++i) {
-	funcs[i]->transform(&cacheBounds[j], &cacheValues[j*nComps + i]);
+    }
+    if (nFuncs == 1 && funcs[0]->getInputSize() == 1) {
+      // the bounds are the inputs, and the values line up as outputs
+      funcs[0]->transformBatch(cacheBounds, cacheValues, cacheSize);
+    } else {
+      for (j = 0; j < cacheSize; ++j) {
+	for (i = 0; i < nComps; ++i) {
+	  cacheValues[j*nComps + i] = 0;
+	}
+	for (i = 0; i < nFuncs; ++i) {
+	  funcs[i]->transform(&cacheBounds[j], &cacheValues[j*nComps + i]);
+	}
       }
     }
   }
@@ -5685,6 +5820,10 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
     lookup2[k] = nullptr;
   }
   byte_lookup = nullptr;
+  byteLookupIdentity = false;
+  for (k = 0; k < nLineFormats; ++k) {
+    lineLookup[k] = nullptr;
+  }
 
   // bits per component and color space
   if (unlikely(bitsA <= 0 || bitsA > 30))
@@ -5788,16 +5927,29 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
       byte_lookup = (unsigned char *)gmallocn ((maxPixel + 1), nComps2);
       useByteLookup = true;
     }
-    for (k = 0; k < nComps2; ++k) {
-      lookup2[k] = (GfxColorComp *)gmallocn(maxPixel + 1,
-					   sizeof(GfxColorComp));
-      for (i = 0; i <= maxPixel; ++i) {
-	x[0] = decodeLow[0] + (i * decodeRange[0]) / maxPixel;
-	sepFunc->transform(x, y);
-	lookup2[k][i] = dblToCol(y[k]);
-	if (useByteLookup)
-	  byte_lookup[i*nComps2 + k] = (unsigned char) (y[k] * 255);
+    {
+      // evaluate the function once for all the pixel values
+      const int nIn = sepFunc->getInputSize();
+      const int nOut = sepFunc->getOutputSize();
+      double *sepIn = (double *)gmallocn(maxPixel + 1, nIn * sizeof(double));
+      double *sepOut = (double *)gmallocn(maxPixel + 1, nOut * sizeof(double));
+      memset(sepIn, 0, (maxPixel + 1) * nIn * sizeof(double));
+      for (i = 0; i <= maxPixel && nIn > 0; ++i) {
+	sepIn[i*nIn] = decodeLow[0] + (i * decodeRange[0]) / maxPixel;
+      }
+      sepFunc->transformBatch(sepIn, sepOut, maxPixel + 1);
+      for (k = 0; k < nComps2; ++k) {
+	lookup2[k] = (GfxColorComp *)gmallocn(maxPixel + 1,
+					     sizeof(GfxColorComp));
+	for (i = 0; i <= maxPixel; ++i) {
+	  const double val = k < nOut ? sepOut[i*nOut + k] : 0;
+	  lookup2[k][i] = dblToCol(val);
+	  if (useByteLookup)
+	    byte_lookup[i*nComps2 + k] = (unsigned char) (val * 255);
+	}
       }
+      gfree(sepOut);
+      gfree(sepIn);
     }
     break;
   default:
@@ -5823,6 +5975,18 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
 	}
       }
     }
+    // the default Decode array of 8-bit images doesn't change the pixels
+    if (useByteLookup && maxPixel == 255) {
+      byteLookupIdentity = true;
+      for (i = 0; i <= maxPixel && byteLookupIdentity; ++i) {
+	for (k = 0; k < nComps; ++k) {
+	  if (byte_lookup[i * nComps + k] != i) {
+	    byteLookupIdentity = false;
+	    break;
+	  }
+	}
+      }
+    }
   }
 
   return;
@@ -5846,6 +6010,10 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
     lookup2[k] = nullptr;
   }
   byte_lookup = nullptr;
+  byteLookupIdentity = colorMap->byteLookupIdentity;
+  for (k = 0; k < nLineFormats; ++k) {
+    lineLookup[k] = nullptr;
+  }
   n = 1 << bits;
   for (k = 0; k < nComps; ++k) {
     lookup[k] = (GfxColorComp *)gmallocn(n, sizeof(GfxColorComp));
@@ -5891,6 +6059,9 @@ GfxImageColorMap::~GfxImageColorMap() {
     gfree(lookup2[i]);
   }
   gfree(byte_lookup);
+  for (i = 0; i < nLineFormats; ++i) {
+    gfree(lineLookup[i]);
+  }
 }
 
 void GfxImageColorMap::getGray(unsigned char *x, GfxGray *gray) {
@@ -5927,7 +6098,111 @@ void GfxImageColorMap::getRGB(unsigned char *x, GfxRGB *rgb) {
   }
 }
 
+// Pixels of one component images (gray, Indexed, Separation) can take
+// at most 256 values, and image lines are usually much longer than
+// that: converting all the values once and looking the pixels up is
+// much faster than converting each pixel, in particular for Indexed and
+// Separation images with a CMYK or ICCBased base.
+unsigned char *GfxImageColorMap::getLineLookup(LineFormat format) {
+  static const int formatBytes[nLineFormats] = {
+    1, 3, 4, 4, (int)sizeof(unsigned int)
+  };
+  unsigned char *values;
+  int n, i;
+
+  if (!lineLookup[format]) {
+    n = (1 << (bits < 8 ? bits : 8));
+    values = (unsigned char *)gmalloc(n);
+    for (i = 0; i < n; ++i) {
+      values[i] = (unsigned char)i;
+    }
+    lineLookup[format] = (unsigned char *)gmallocn(n, formatBytes[format]);
+    switch (format) {
+    case lineFormatGray:
+      convertGrayLine(values, lineLookup[format], n);
+      break;
+    case lineFormatRGB:
+      convertRGBLine(values, lineLookup[format], n);
+      break;
+    case lineFormatRGBX:
+      convertRGBXLine(values, lineLookup[format], n);
+      break;
+    case lineFormatCMYK:
+      convertCMYKLine(values, lineLookup[format], n);
+      break;
+    case lineFormatRGB32:
+      convertRGBLine(values, (unsigned int *)lineLookup[format], n);
+      break;
+    default:
+      break;
+    }
+    gfree(values);
+  }
+  return lineLookup[format];
+}
+
 void GfxImageColorMap::getGrayLine(unsigned char *in, unsigned char *out, int length) {
+  const unsigned char *table;
+  int i;
+
+  if (nComps == 1) {
+    table = getLineLookup(lineFormatGray);
+    for (i = 0; i < length; i++) {
+      out[i] = table[in[i]];
+    }
+    return;
+  }
+  convertGrayLine(in, out, length);
+}
+
+void GfxImageColorMap::getRGBLine(unsigned char *in, unsigned char *out, int length) {
+  const unsigned char *table, *p;
+  int i;
+
+  if (nComps == 1) {
+    table = getLineLookup(lineFormatRGB);
+    for (i = 0; i < length; i++) {
+      p = &table[3 * in[i]];
+      *out++ = p[0];
+      *out++ = p[1];
+      *out++ = p[2];
+    }
+    return;
+  }
+  convertRGBLine(in, out, length);
+}
+
+void GfxImageColorMap::getRGBXLine(unsigned char *in, unsigned char *out, int length) {
+  const unsigned char *table;
+  int i;
+
+  if (nComps == 1) {
+    table = getLineLookup(lineFormatRGBX);
+    for (i = 0; i < length; i++) {
+      memcpy(out, &table[4 * in[i]], 4);
+      out += 4;
+    }
+    return;
+  }
+  convertRGBXLine(in, out, length);
+}
+
+void GfxImageColorMap::getCMYKLine(unsigned char *in, unsigned char *out, int length) {
+  const unsigned char *table;
+  int i;
+
+  if (nComps == 1) {
+    table = getLineLookup(lineFormatCMYK);
+    for (i = 0; i < length; i++) {
+      memcpy(out, &table[4 * in[i]], 4);
+      out += 4;
+    }
+    return;
+  }
+  convertCMYKLine(in, out, length);
+}
+
+void GfxImageColorMap::convertGrayLine(unsigned char *in, unsigned char *out, int length) {
   int i, j;
   unsigned char *inp, *tmp_line;
 
@@ -5958,12 +6233,14 @@ void GfxImageColorMap::getGrayLine(unsigned char *in, unsigned char *out, int le
     break;
 
   default:
-    inp = in;
-    for (j = 0; j < length; j++)
-      for (i = 0; i < nComps; i++) {
-	*inp = byte_lookup[*inp * nComps + i];
-	inp++;
-      }
+    if (!byteLookupIdentity) {
+      inp = in;
+      for (j = 0; j < length; j++)
+	for (i = 0; i < nComps; i++) {
+	  *inp = byte_lookup[*inp * nComps + i];
+	  inp++;
+	}
+    }
     colorSpace->getGrayLine(in, out, length);
     break;
   }
@@ -5971,6 +6248,20 @@ void GfxImageColorMap::getGrayLine(unsigned char *in, unsigned char *out, int le
 }
 
 void GfxImageColorMap::getRGBLine(unsigned char *in, unsigned int *out, int length) {
+  const unsigned int *table;
+  int i;
+
+  if (nComps == 1) {
+    table = (const unsigned int *)getLineLookup(lineFormatRGB32);
+    for (i = 0; i < length; i++) {
+      out[i] = table[in[i]];
+    }
+    return;
+  }
+  convertRGBLine(in, out, length);
+}
+
+void GfxImageColorMap::convertRGBLine(unsigned char *in, unsigned int *out, int length) {
   int i, j;
   unsigned char *inp, *tmp_line;
 
@@ -6003,19 +6294,21 @@ void GfxImageColorMap::getRGBLine(unsigned char *in, unsigned int *out, int leng
     break;
 
   default:
-    inp = in;
-    for (j = 0; j < length; j++)
-      for (i = 0; i < nComps; i++) {
-	*inp = byte_lookup[*inp * nComps + i];
-	inp++;
-      }
+    if (!byteLookupIdentity) {
+      inp = in;
+      for (j = 0; j < length; j++)
+	for (i = 0; i < nComps; i++) {
+	  *inp = byte_lookup[*inp * nComps + i];
+	  inp++;
+	}
+    }
     colorSpace->getRGBLine(in, out, length);
     break;
   }
 
 }
 
-void GfxImageColorMap::getRGBLine(unsigned char *in, unsigned char *out, int length) {
+void GfxImageColorMap::convertRGBLine(unsigned char *in, unsigned char *out, int length) {
   int i, j;
   unsigned char *inp, *tmp_line;
 
@@ -6047,19 +6340,21 @@ void GfxImageColorMap::getRGBLine(unsigned char *in, unsigned char *out, int len
     break;
 
   default:
-    inp = in;
-    for (j = 0; j < length; j++)
-      for (i = 0; i < nComps; i++) {
-	*inp = byte_lookup[*inp * nComps + i];
-	inp++;
-      }
+    if (!byteLookupIdentity) {
+      inp = in;
+      for (j = 0; j < length; j++)
+	for (i = 0; i < nComps; i++) {
+	  *inp = byte_lookup[*inp * nComps + i];
+	  inp++;
+	}
+    }
     colorSpace->getRGBLine(in, out, length);
     break;
   }
 
 }
 
-void GfxImageColorMap::getRGBXLine(unsigned char *in, unsigned char *out, int length) {
+void GfxImageColorMap::convertRGBXLine(unsigned char *in, unsigned char *out, int length) {
   int i, j;
   unsigned char *inp, *tmp_line;
 
@@ -6092,19 +6387,21 @@ void GfxImageColorMap::getRGBXLine(unsigned char *in, unsigned char *out, int le
     break;
 
   default:
-    inp = in;
-    for (j = 0; j < length; j++)
-      for (i = 0; i < nComps; i++) {
-	*inp = byte_lookup[*inp * nComps + i];
-	inp++;
-      }
+    if (!byteLookupIdentity) {
+      inp = in;
+      for (j = 0; j < length; j++)
+	for (i = 0; i < nComps; i++) {
+	  *inp = byte_lookup[*inp * nComps + i];
+	  inp++;
+	}
+    }
     colorSpace->getRGBXLine(in, out, length);
     break;
   }
 
 }
 
-void GfxImageColorMap::getCMYKLine(unsigned char *in, unsigned char *out, int length) {
+void GfxImageColorMap::convertCMYKLine(unsigned char *in, unsigned char *out, int length) {
   int i, j;
   unsigned char *inp, *tmp_line;
 
@@ -6137,12 +6434,14 @@ void GfxImageColorMap::getCMYKLine(unsigned char *in, unsigned char *out, int le
     break;
 
   default:
-    inp = in;
-    for (j = 0; j < length; j++)
-      for (i = 0; i < nComps; i++) {
-	*inp = byte_lookup[*inp * nComps + i];
-	inp++;
-      }
+    if (!byteLookupIdentity) {
+      inp = in;
+      for (j = 0; j < length; j++)
+	for (i = 0; i < nComps; i++) {
+	  *inp = byte_lookup[*inp * nComps + i];
+	  inp++;
+	}
+    }
     colorSpace->getCMYKLine(in, out, length);
     break;
   }
@@ -6179,12 +6478,14 @@ void GfxImageColorMap::getDeviceNLine(unsigned char *in, unsigned char *out, int
     break;
 
   default:
-    inp = in;
-    for (int j = 0; j < length; j++)
-      for (int i = 0; i < nComps; i++) {
-	*inp = byte_lookup[*inp * nComps + i];
-	inp++;
-      }
+    if (!byteLookupIdentity) {
+      inp = in;
+      for (int j = 0; j < length; j++)
+	for (int i = 0; i < nComps; i++) {
+	  *inp = byte_lookup[*inp * nComps + i];
+	  inp++;
+	}
+    }
     colorSpace->getDeviceNLine(in, out, length);
     break;
   }
@@ -184,6 +184,65 @@ enum GfxColorSpaceMode {
   csPattern
 };
 
+//------------------------------------------------------------------------
+// GfxColorTransformCache
+//------------------------------------------------------------------------
+
+// Direct-mapped cache of the colors transformed one at a time, keyed by
+// the bytes of a color of up to 4 components.  A color replaces the one
+// cached in its slot, so the cache keeps working when the colors change
+// along the document.
+class GfxColorTransformCache {
+public:
+
+  GfxColorTransformCache() : entries(nullptr) {}
+  ~GfxColorTransformCache() { delete[] entries; }
+
+  GfxColorTransformCache(const GfxColorTransformCache &) = delete;
+  GfxColorTransformCache& operator=(const GfxColorTransformCache &) = delete;
+
+  bool lookup(unsigned int key, unsigned int *value) const {
+    if (!entries) {
+      return false;
+    }
+    const Entry &entry = entries[slot(key)];
+    if (entry.used && entry.key == key) {
+      *value = entry.value;
+      return true;
+    }
+    return false;
+  }
+
+  void put(unsigned int key, unsigned int value) {
+    if (!entries) {
+      // allocated on first use: color spaces are copied with the
+      // graphics state, most of them never transform a color
+      entries = new Entry[size]();
+    }
+    Entry &entry = entries[slot(key)];
+    entry.key = key;
+    entry.value = value;
+    entry.used = true;
+  }
+
+private:
+
+  static const int sizeBits = 11;
+  static const int size = 1 << sizeBits;
+
+  static int slot(unsigned int key) {
+    return (int)((key * 2654435761U) >> (32 - sizeBits));
+  }
+
+  struct Entry {
+    unsigned int key;
+    unsigned int value;
+    bool used;
+  };
+
+  Entry *entries;
+};
+
 // wrapper of cmsHTRANSFORM to copy
 class GfxColorTransform {
 public:
@@ -575,7 +634,7 @@ private:
   int getIntent() { return (transform != nullptr) ? transform->getIntent() : 0; }
   GfxColorTransform *transform;
   GfxColorTransform *lineTransform; // color transform for line
-  mutable std::map<unsigned int, unsigned int> cmsCache;
+  mutable GfxColorTransformCache cmsCache;
 #endif
 };
 //------------------------------------------------------------------------
@@ -1225,6 +1284,24 @@ private:
 
   GfxImageColorMap(GfxImageColorMap *colorMap);
 
+  // Conversions of one component pixels are looked up in tables of the
+  // converted colors of all the pixel values, built on first use.
+  enum LineFormat {
+    lineFormatGray,
+    lineFormatRGB,
+    lineFormatRGBX,
+    lineFormatCMYK,
+    lineFormatRGB32,		// packed in an unsigned int
+    nLineFormats
+  };
+  unsigned char *getLineLookup(LineFormat format);
+
+  void convertGrayLine(unsigned char *in, unsigned char *out, int length);
+  void convertRGBLine(unsigned char *in, unsigned int *out, int length);
+  void convertRGBLine(unsigned char *in, unsigned char *out, int length);
+  void convertRGBXLine(unsigned char *in, unsigned char *out, int length);
+  void convertCMYKLine(unsigned char *in, unsigned char *out, int length);
+
   GfxColorSpace *colorSpace;	// the image color space
   int bits;			// bits per component
   int nComps;			// number of components in a pixel
@@ -1235,6 +1312,9 @@ private:
   GfxColorComp *		// optimized case lookup table
     lookup2[gfxColorMaxComps];
   unsigned char *byte_lookup;
+  bool byteLookupIdentity;	// byte_lookup maps each value to itself
+  unsigned char *		// converted pixel values, one component
+    lineLookup[nLineFormats];	//   images only
   double			// minimum values for each component
     decodeLow[gfxColorMaxComps];
   double			// max - min value for each component
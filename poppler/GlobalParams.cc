@@ -73,6 +73,9 @@
 
 #ifdef WITH_FONTCONFIGURATION_FONTCONFIG
 #include <fontconfig/fontconfig.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #ifdef _MSC_VER
@@ -373,6 +376,224 @@ SysFontInfo *SysFontList::find(const GooString *name, bool fixedWidth, bool exac
   return fi;
 }
 
+//------------------------------------------------------------------------
+// SysFontSubstCache
+//------------------------------------------------------------------------
+
+// The system font fontconfig picked for a font.
+struct SysFontSubst {
+  bool found;			// false if fontconfig had no usable font
+  std::string path;
+  SysFontType type;
+  int fontNum;
+  bool bold, italic, oblique;	// style of the font that was found
+  std::string substituteName;
+  bool listed;			// added to the SysFontList yet?
+};
+
+// Remembers the system fonts fontconfig picked, so that it is asked
+// about each font only once.  The substitutes can be saved to a file
+// and loaded by the next process, along with the modification times of
+// fontconfig's configuration files and font directories, which have to
+// be the same when the file is loaded.
+class SysFontSubstCache {
+public:
+
+  SysFontSubstCache() { dirty = false; }
+
+  SysFontSubstCache(const SysFontSubstCache &) = delete;
+  SysFontSubstCache& operator=(const SysFontSubstCache &) = delete;
+
+  SysFontSubst *find(const std::string &key);
+  void add(const std::string &key, const SysFontSubst &subst);
+
+  // Load the substitutes saved in <fileNameA>, and save them there
+  // when save() is called.
+  void setFile(const std::string &fileNameA);
+  const std::string &getFile() const { return fileName; }
+
+  // Save the substitutes, if fontconfig was asked about new fonts.
+  void save();
+
+private:
+
+  void load();
+
+  std::unordered_map<std::string, SysFontSubst> substs;
+  std::string fileName;
+  bool dirty;
+};
+
+#ifdef WITH_FONTCONFIGURATION_FONTCONFIG
+// first line of the file the substitutes are saved to
+#define sysFontSubstFileHeader "poppler-font-substitutes 1"
+
+// load() reads lines shorter than this, including the newline
+#define sysFontSubstMaxLine 4096
+
+static void splitTabs(const char *line, std::vector<std::string> *fields) {
+  const char *p;
+
+  fields->clear();
+  while ((p = strchr(line, '\t'))) {
+    fields->emplace_back(line, p - line);
+    line = p + 1;
+  }
+  fields->emplace_back(line);
+}
+
+static bool getModTime(const std::string &path, long long *modTime) {
+  struct stat st;
+
+  if (stat(path.c_str(), &st) != 0) {
+    return false;
+  }
+  *modTime = (long long)st.st_mtime;
+  return true;
+}
+#endif
+
+SysFontSubst *SysFontSubstCache::find(const std::string &key) {
+  const auto subst = substs.find(key);
+
+  return subst == substs.end() ? nullptr : &subst->second;
+}
+
+void SysFontSubstCache::add(const std::string &key, const SysFontSubst &subst) {
+  substs[key] = subst;
+  dirty = true;
+}
+
+void SysFontSubstCache::setFile(const std::string &fileNameA) {
+  fileName = fileNameA;
+  if (!fileName.empty()) {
+    load();
+  }
+}
+
+// Add the substitutes of the file that aren't known yet.  A file
+// written with another fontconfig version or configuration is ignored.
+void SysFontSubstCache::load() {
+#ifdef WITH_FONTCONFIGURATION_FONTCONFIG
+  std::vector<std::string> fields;
+  std::unordered_map<std::string, SysFontSubst> loaded;
+  char buf[sysFontSubstMaxLine];
+  FILE *f;
+  size_t n;
+  long long modTime;
+  bool ok;
+
+  if (!(f = openFile(fileName.c_str(), "r"))) {
+    return;
+  }
+  ok = getLine(buf, sizeof(buf), f) &&
+       !strcmp(buf, sysFontSubstFileHeader "\n") &&
+       getLine(buf, sizeof(buf), f) &&
+       atoi(buf) == FcGetVersion();
+  while (ok && getLine(buf, sizeof(buf), f)) {
+    n = strlen(buf);
+    if (n == 0 || buf[n - 1] != '\n') {
+      ok = false;
+      break;
+    }
+    buf[n - 1] = '\0';
+    splitTabs(buf, &fields);
+    if (fields[0] == "stamp" && fields.size() == 3) {
+      // a configuration file or font directory, which must not have
+      // changed since
+      ok = getModTime(fields[2], &modTime) && modTime == atoll(fields[1].c_str());
+    } else if (fields[0] == "subst" && fields.size() == 18) {
+      SysFontSubst subst;
+      std::string key = fields[1];
+      for (int i = 2; i <= 9; ++i) {
+	key += '\t';
+	key += fields[i];
+      }
+      subst.found = fields[10] == "1";
+      subst.type = (SysFontType)atoi(fields[11].c_str());
+      subst.fontNum = atoi(fields[12].c_str());
+      subst.bold = fields[13] == "1";
+      subst.italic = fields[14] == "1";
+      subst.oblique = fields[15] == "1";
+      subst.path = fields[16];
+      subst.substituteName = fields[17];
+      subst.listed = false;
+      loaded[key] = subst;
+    } else {
+      ok = false;
+    }
+  }
+  fclose(f);
+  if (ok) {
+    substs.insert(loaded.begin(), loaded.end());
+  }
+#endif
+}
+
+void SysFontSubstCache::save() {
+#ifdef WITH_FONTCONFIGURATION_FONTCONFIG
+  FcStrList *list;
+  FcChar8 *path;
+  char buf[64];
+  FILE *f;
+  long long modTime;
+  bool ok;
+
+  if (!dirty || fileName.empty()) {
+    return;
+  }
+  // keep what other processes saved meanwhile
+  load();
+
+  // write another file and rename it, so that processes loading the
+  // file never see half of it
+  const std::string tmpFileName = fileName + ".tmp" + std::to_string((unsigned long)getpid());
+  if (!(f = openFile(tmpFileName.c_str(), "w"))) {
+    return;
+  }
+  fprintf(f, "%s\n%d\n", sysFontSubstFileHeader, FcGetVersion());
+  ok = true;
+  for (int i = 0; i < 2; ++i) {
+    list = i == 0 ? FcConfigGetConfigFiles(nullptr) : FcConfigGetFontDirs(nullptr);
+    while ((path = FcStrListNext(list))) {
+      if (getModTime((const char *)path, &modTime)) {
+	// without the stamp of a file, changes to it would go unnoticed,
+	// so a file name that can't be read back spoils the whole file
+	if (strpbrk((const char *)path, "\t\n") ||
+	    strlen((const char *)path) + 32 >= sysFontSubstMaxLine) {
+	  ok = false;
+	}
+	fprintf(f, "stamp\t%lld\t%s\n", modTime, (const char *)path);
+      }
+    }
+    FcStrListDone(list);
+  }
+  for (const auto &subst : substs) {
+    // a path or name with a tab or newline can't be read back, and
+    // neither can a line longer than load() reads; leave those out
+    if (subst.second.path.find_first_of("\t\n") != std::string::npos ||
+	subst.second.substituteName.find_first_of("\t\n") != std::string::npos) {
+      continue;
+    }
+    // the key already is tab separated
+    snprintf(buf, sizeof(buf), "\t%d\t%d\t%d\t%d\t%d\t%d\t",
+	     subst.second.found ? 1 : 0, (int)subst.second.type,
+	     subst.second.fontNum, subst.second.bold ? 1 : 0,
+	     subst.second.italic ? 1 : 0, subst.second.oblique ? 1 : 0);
+    const std::string line = "subst\t" + subst.first + buf + subst.second.path + '\t' +
+			     subst.second.substituteName + '\n';
+    if (line.size() < sysFontSubstMaxLine) {
+      fputs(line.c_str(), f);
+    }
+  }
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmpFileName.c_str(), fileName.c_str()) != 0) {
+    remove(tmpFileName.c_str());
+    return;
+  }
+  dirty = false;
+#endif
+}
 
 #define globalParamsLocker()	std::unique_lock<std::recursive_mutex> locker(mutex)
 #define unicodeMapCacheLocker()	std::unique_lock<std::recursive_mutex> locker(unicodeMapCacheMutex)
@@ -400,6 +621,7 @@ GlobalParams::GlobalParams(const char *customPopplerDataDir)
   nameToUnicodeText = new NameToCharCode();
   toUnicodeDirs = new std::vector<GooString*>();
   sysFonts = new SysFontList();
+  sysFontSubsts = new SysFontSubstCache();
   psExpandSmaller = false;
   psShrinkLarger = true;
   psLevel = psLevel2;
@@ -415,6 +637,9 @@ GlobalParams::GlobalParams(const char *customPopplerDataDir)
   printCommands = false;
   profileCommands = false;
   errQuiet = false;
+  jpxDecodeThreads = 1;
+  mapFiles = false;
+  chunkCacheSize = 256 * 1024 * 1024;
 
   cidToUnicodeCache = new CharCodeToUnicodeCache(cidToUnicodeCacheSize);
   unicodeToUnicodeCache =
@@ -562,6 +787,8 @@ GlobalParams::~GlobalParams() {
   }
   delete toUnicodeDirs;
   delete sysFonts;
+  sysFontSubsts->save();
+  delete sysFontSubsts;
   delete textEncoding;
 
   delete cidToUnicodeCache;
@@ -820,6 +1047,34 @@ static FcPattern *buildFcPattern(GfxFont *font, const GooString *base14Name)
     free((char*)family);
   return p;
 }
+
+// The key of the font in the SysFontSubstCache: everything the choice
+// of the system font depends on.  Returns false for names the key can't
+// hold.
+static bool getSysFontSubstKey(GfxFont *font, const GooString *base14Name, std::string *key)
+{
+  const GooString *names[3] = { font->getName(), base14Name, font->getFamily() };
+  char buf[64];
+
+  key->clear();
+  for (const GooString *name : names) {
+    if (name) {
+      if (strchr(name->c_str(), '\t') || strchr(name->c_str(), '\n') ||
+	  (int)strlen(name->c_str()) != name->getLength()) {
+	key->clear();
+	return false;
+      }
+      key->append(name->c_str());
+    }
+    key->push_back('\t');
+  }
+  snprintf(buf, sizeof(buf), "%d\t%d\t%d\t%d\t%d\t",
+	   font->isFixedWidth() ? 1 : 0, font->isBold() ? 1 : 0,
+	   font->isItalic() ? 1 : 0, (int)font->getWeight(), (int)font->getStretch());
+  key->append(buf);
+  key->append(getFontLang(font));
+  return true;
+}
 #endif
 
 GooString *GlobalParams::findFontFile(const GooString *fontName) {
@@ -854,6 +1109,8 @@ GooString *GlobalParams::findSystemFontFile(GfxFont *font,
 					  SysFontType *type,
 					  int *fontNum, GooString *substituteFontName, const GooString *base14Name) {
   SysFontInfo *fi = nullptr;
+  SysFontSubst *subst;
+  std::string substKey;
   FcPattern *p=nullptr;
   GooString *path = nullptr;
   const GooString *fontName = font->getName();
@@ -867,6 +1124,22 @@ GooString *GlobalParams::findSystemFontFile(GfxFont *font,
     *type = fi->type;
     *fontNum = fi->fontNum;
     substituteName.Set(fi->substituteName->c_str());
+  } else if (getSysFontSubstKey(font, base14Name, &substKey) &&
+	     (subst = sysFontSubsts->find(substKey))) {
+    // fontconfig was asked about this font before
+    if (subst->found) {
+      path = new GooString(subst->path);
+      *type = subst->type;
+      *fontNum = subst->fontNum;
+      if (!subst->listed) {
+	sysFonts->addFcFont(new SysFontInfo(fontName->copy(), subst->bold, subst->italic,
+					    subst->oblique, font->isFixedWidth(),
+					    path->copy(), subst->type, subst->fontNum,
+					    new GooString(subst->substituteName)));
+	subst->listed = true;
+      }
+    }
+    substituteName.Set(subst->substituteName.c_str());
   } else {
     FcChar8* s;
     char * ext;
@@ -997,6 +1270,22 @@ GooString *GlobalParams::findSystemFontFile(GfxFont *font,
       }
     }
     FcFontSetDestroy(set);
+
+    if (!substKey.empty()) {
+      SysFontSubst newSubst;
+      newSubst.found = fi != nullptr;
+      newSubst.type = fi ? fi->type : sysFontTTF;
+      newSubst.fontNum = fi ? fi->fontNum : 0;
+      newSubst.bold = fi && fi->bold;
+      newSubst.italic = fi && fi->italic;
+      newSubst.oblique = fi && fi->oblique;
+      if (fi) {
+	newSubst.path = fi->path->c_str();
+      }
+      newSubst.substituteName = substituteName.c_str();
+      newSubst.listed = true;
+      sysFontSubsts->add(substKey, newSubst);
+    }
   }
   if (path == nullptr && (fi = sysFonts->find(fontName, font->isFixedWidth(), false))) {
     path = fi->path->copy();
@@ -1170,6 +1459,31 @@ bool GlobalParams::getErrQuiet() {
   return errQuiet;
 }
 
+int GlobalParams::getJPXDecodeThreads() {
+  globalParamsLocker();
+  return jpxDecodeThreads;
+}
+
+bool GlobalParams::getMapFiles() {
+  globalParamsLocker();
+  return mapFiles;
+}
+
+std::string GlobalParams::getChunkCacheDir() {
+  globalParamsLocker();
+  return chunkCacheDir;
+}
+
+size_t GlobalParams::getChunkCacheSize() {
+  globalParamsLocker();
+  return chunkCacheSize;
+}
+
+std::string GlobalParams::getFontSubstCacheFile() {
+  globalParamsLocker();
+  return sysFontSubsts->getFile();
+}
+
 CharCodeToUnicode *GlobalParams::getCIDToUnicode(GooString *collection) {
   CharCodeToUnicode *ctu;
 
@@ -1295,3 +1609,28 @@ void GlobalParams::setErrQuiet(bool errQuietA) {
   globalParamsLocker();
   errQuiet = errQuietA;
 }
+
+void GlobalParams::setJPXDecodeThreads(int jpxDecodeThreadsA) {
+  globalParamsLocker();
+  jpxDecodeThreads = jpxDecodeThreadsA < 1 ? 1 : jpxDecodeThreadsA;
+}
+
+void GlobalParams::setMapFiles(bool mapFilesA) {
+  globalParamsLocker();
+  mapFiles = mapFilesA;
+}
+
+void GlobalParams::setChunkCacheDir(const char *dir) {
+  globalParamsLocker();
+  chunkCacheDir = dir ? dir : "";
+}
+
+void GlobalParams::setChunkCacheSize(size_t size) {
+  globalParamsLocker();
+  chunkCacheSize = size;
+}
+
+void GlobalParams::setFontSubstCacheFile(const char *fileName) {
+  globalParamsLocker();
+  sysFontSubsts->setFile(fileName ? fileName : "");
+}
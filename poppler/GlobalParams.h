@@ -59,6 +59,7 @@ class GlobalParams;
 class GfxFont;
 class Stream;
 class SysFontList;
+class SysFontSubstCache;
 
 //------------------------------------------------------------------------
 
@@ -140,6 +141,11 @@ public:
   bool getPrintCommands();
   bool getProfileCommands();
   bool getErrQuiet();
+  int getJPXDecodeThreads();
+  bool getMapFiles();
+  std::string getChunkCacheDir();
+  size_t getChunkCacheSize();
+  std::string getFontSubstCacheFile();
 
   CharCodeToUnicode *getCIDToUnicode(GooString *collection);
   UnicodeMap *getUnicodeMap(GooString *encodingName);
@@ -161,6 +167,18 @@ public:
   void setPrintCommands(bool printCommandsA);
   void setProfileCommands(bool profileCommandsA);
   void setErrQuiet(bool errQuietA);
+  void setJPXDecodeThreads(int jpxDecodeThreadsA);
+
+  // Read regular PDF files through mmap() rather than stdio.  This is
+  // off by default: if the file is truncated while it is mapped, e.g.
+  // because a tool writes its output over its input, the process gets
+  // SIGBUS instead of a read error.  Only turn it on when nothing else
+  // writes to the files being read.
+  void setMapFiles(bool mapFilesA);
+
+  void setChunkCacheDir(const char *dir);
+  void setChunkCacheSize(size_t size);
+  void setFontSubstCacheFile(const char *fileName);
 
   static bool parseYesNo2(const char *token, bool *flag);
 
@@ -205,6 +223,8 @@ private:
   // font files: font name mapped to path
   std::unordered_map<std::string, std::string> fontFiles;
   SysFontList *sysFonts;	// system fonts
+  SysFontSubstCache *sysFontSubsts;	// system fonts picked for the
+					//   fonts looked up so far
   bool psExpandSmaller;	// expand smaller pages to fill paper
   bool psShrinkLarger;		// shrink larger pages to fit paper
   PSLevel psLevel;		// PostScript level to generate
@@ -218,6 +238,12 @@ private:
   bool printCommands;		// print the drawing commands
   bool profileCommands;	// profile the drawing commands
   bool errQuiet;		// suppress error messages?
+  int jpxDecodeThreads;		// number of threads used to decode large
+				//   JPEG 2000 images
+  bool mapFiles;		// read regular files through mmap()
+  std::string chunkCacheDir;	// directory where downloaded chunks of
+				//   remote files are kept ("" for none)
+  size_t chunkCacheSize;	// max bytes taken by chunkCacheDir
 
   CharCodeToUnicodeCache *cidToUnicodeCache;
   CharCodeToUnicodeCache *unicodeToUnicodeCache;
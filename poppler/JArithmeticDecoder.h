@@ -82,7 +82,8 @@ public:
   // Read any leftover data in the stream.
   void cleanup();
 
-  // Decode one bit.
+  // Decode one bit.  This is inline, as it is called for every pixel
+  // of generic regions.
   int decodeBit(unsigned int context, JArithmeticDecoderStats *stats);
 
   // Decode eight bits.
@@ -103,10 +104,9 @@ private:
   int decodeIntBit(JArithmeticDecoderStats *stats);
   void byteIn();
 
-  static unsigned int qeTab[47];
-  static int nmpsTab[47];
-  static int nlpsTab[47];
-  static int switchTab[47];
+  static const unsigned int qeTab[47];
+  static const unsigned char nmpsCxTab[94];
+  static const unsigned char nlpsCxTab[94];
 
   unsigned int buf0, buf1;
   unsigned int c, a;
@@ -120,4 +120,49 @@ private:
   bool limitStream;
 };
 
+inline int JArithmeticDecoder::decodeBit(unsigned int context,
+					 JArithmeticDecoderStats *stats) {
+  unsigned char *cx;
+  unsigned int qe;
+  int bit;
+
+  cx = &stats->cxTab[context];
+  qe = qeTab[*cx >> 1];
+  a -= qe;
+  if (c < a) {
+    if (a & 0x80000000) {
+      return *cx & 1;
+    }
+    // MPS_EXCHANGE
+    if (a < qe) {
+      bit = 1 - (*cx & 1);
+      *cx = nlpsCxTab[*cx];
+    } else {
+      bit = *cx & 1;
+      *cx = nmpsCxTab[*cx];
+    }
+  } else {
+    c -= a;
+    // LPS_EXCHANGE
+    if (a < qe) {
+      bit = *cx & 1;
+      *cx = nmpsCxTab[*cx];
+    } else {
+      bit = 1 - (*cx & 1);
+      *cx = nlpsCxTab[*cx];
+    }
+    a = qe;
+  }
+  // RENORMD
+  do {
+    if (ct == 0) {
+      byteIn();
+    }
+    a <<= 1;
+    c <<= 1;
+    --ct;
+  } while (!(a & 0x80000000));
+  return bit;
+}
+
 #endif
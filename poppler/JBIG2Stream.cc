@@ -2960,6 +2960,41 @@ inline void JBIG2Stream::mmrAddPixelsNeg(int a1, int blackPixels,
   }
 }
 
+// Return the row of the AT pixel at offset <aty> from row <y>, or
+// nullptr if it is outside the bitmap.
+static inline unsigned char *getATRow(JBIG2Bitmap *bitmap, int y, int aty) {
+  if (y + aty < 0 || y + aty >= bitmap->getHeight()) {
+    return nullptr;
+  }
+  return bitmap->getDataPtr() + (y + aty) * bitmap->getLineSize();
+}
+
+// Return the 8 pixels of <row> starting at <x>, msb first.  Pixels
+// outside the row are 0.
+static inline unsigned int getATPixels(const unsigned char *row,
+				       int lineSize, int x) {
+  unsigned int b0, b1;
+  int i;
+
+  if (!row) {
+    return 0;
+  }
+  i = x >= 0 ? x / 8 : -((7 - x) / 8);
+  b0 = (i >= 0 && i < lineSize) ? row[i] : 0;
+  b1 = (i + 1 >= 0 && i + 1 < lineSize) ? row[i + 1] : 0;
+  return (((b0 << 8) | b1) >> (8 - (x - i * 8))) & 0xff;
+}
+
+// Return the bit to or into the AT pixels of the current byte when a
+// pixel is decoded as 1: only AT pixels in the current row less than 8
+// pixels back haven't been decoded when the byte is read.
+static inline unsigned int getATFix(int atx, int aty) {
+  if (aty == 0 && atx < 0 && atx > -8) {
+    return 0x80 >> -atx;
+  }
+  return 0;
+}
+
 JBIG2Bitmap *JBIG2Stream::readGenericBitmap(bool mmr, int w, int h,
 					    int templ, bool tpgdOn,
 					    bool useSkip, JBIG2Bitmap *skip,
@@ -2971,10 +3006,10 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(bool mmr, int w, int h,
   int *refLine, *codingLine;
   int code1, code2, code3;
   unsigned char *p0, *p1, *p2, *pp;
-  unsigned char *atP0, *atP1, *atP2, *atP3;
+  unsigned char *atRow0, *atRow1, *atRow2, *atRow3;
   unsigned int buf0, buf1, buf2;
   unsigned int atBuf0, atBuf1, atBuf2, atBuf3;
-  int atShift0, atShift1, atShift2, atShift3;
+  unsigned int atFix0, atFix1, atFix2, atFix3;
   unsigned char mask;
   int x, y, x0, x1, a0i, b1i, blackPixels, pix, i;
 
@@ -3224,6 +3259,19 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(bool mmr, int w, int h,
       }
     }
 
+    // the AT pixels are read 8 at a time from their rows (atRowN); a
+    // decoded pixel that is the AT pixel of a later pixel in the same
+    // byte is or'ed in with atFixN
+    atRow1 = atRow2 = atRow3 = nullptr;
+    atBuf1 = atBuf2 = atBuf3 = 0;
+    atFix0 = getATFix(atx[0], aty[0]);
+    atFix1 = atFix2 = atFix3 = 0;
+    if (templ == 0) {
+      atFix1 = getATFix(atx[1], aty[1]);
+      atFix2 = getATFix(atx[2], aty[2]);
+      atFix3 = getATFix(atx[3], aty[3]);
+    }
+
     ltp = 0;
     cx = cx0 = cx1 = cx2 = 0; // make gcc happy
     for (y = 0; y < h; ++y) {
@@ -3241,506 +3289,169 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(bool mmr, int w, int h,
 	}
       }
 
-      switch (templ) {
-      case 0:
-
-	// set up the context
-	p2 = pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
-	buf2 = *p2++ << 8;
-	if (y >= 1) {
-	  p1 = bitmap->getDataPtr() + (y - 1) * bitmap->getLineSize();
-	  buf1 = *p1++ << 8;
-	  if (y >= 2) {
-	    p0 = bitmap->getDataPtr() + (y - 2) * bitmap->getLineSize();
-	    buf0 = *p0++ << 8;
-	  } else {
-	    p0 = nullptr;
-	    buf0 = 0;
-	  }
+      // set up the context
+      p2 = pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
+      buf2 = *p2++ << 8;
+      if (y >= 1) {
+	p1 = bitmap->getDataPtr() + (y - 1) * bitmap->getLineSize();
+	buf1 = *p1++ << 8;
+	if (y >= 2 && templ != 3) {
+	  p0 = bitmap->getDataPtr() + (y - 2) * bitmap->getLineSize();
+	  buf0 = *p0++ << 8;
 	} else {
-	  p1 = p0 = nullptr;
-	  buf1 = buf0 = 0;
+	  p0 = nullptr;
+	  buf0 = 0;
 	}
+      } else {
+	p1 = p0 = nullptr;
+	buf1 = buf0 = 0;
+      }
+      atRow0 = getATRow(bitmap, y, aty[0]);
+      if (templ == 0) {
+	atRow1 = getATRow(bitmap, y, aty[1]);
+	atRow2 = getATRow(bitmap, y, aty[2]);
+	atRow3 = getATRow(bitmap, y, aty[3]);
+      }
 
-	if (atx[0] >= -8 && atx[0] <= 8 &&
-	    atx[1] >= -8 && atx[1] <= 8 &&
-	    atx[2] >= -8 && atx[2] <= 8 &&
-	    atx[3] >= -8 && atx[3] <= 8) {
-	  // set up the adaptive context
-	  if (y + aty[0] >= 0 && y + aty[0] < bitmap->getHeight()) {
-	    atP0 = bitmap->getDataPtr() + (y + aty[0]) * bitmap->getLineSize();
-	    atBuf0 = *atP0++ << 8;
-	  } else {
-	    atP0 = nullptr;
-	    atBuf0 = 0;
-	  }
-	  atShift0 = 15 - atx[0];
-	  if (y + aty[1] >= 0 && y + aty[1] < bitmap->getHeight()) {
-	    atP1 = bitmap->getDataPtr() + (y + aty[1]) * bitmap->getLineSize();
-	    atBuf1 = *atP1++ << 8;
-	  } else {
-	    atP1 = nullptr;
-	    atBuf1 = 0;
-	  }
-	  atShift1 = 15 - atx[1];
-	  if (y + aty[2] >= 0 && y + aty[2] < bitmap->getHeight()) {
-	    atP2 = bitmap->getDataPtr() + (y + aty[2]) * bitmap->getLineSize();
-	    atBuf2 = *atP2++ << 8;
-	  } else {
-	    atP2 = nullptr;
-	    atBuf2 = 0;
-	  }
-	  atShift2 = 15 - atx[2];
-	  if (y + aty[3] >= 0 && y + aty[3] < bitmap->getHeight()) {
-	    atP3 = bitmap->getDataPtr() + (y + aty[3]) * bitmap->getLineSize();
-	    atBuf3 = *atP3++ << 8;
-	  } else {
-	    atP3 = nullptr;
-	    atBuf3 = 0;
-	  }
-	  atShift3 = 15 - atx[3];
-
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	      if (atP0) {
-		atBuf0 |= *atP0++;
-	      }
-	      if (atP1) {
-		atBuf1 |= *atP1++;
-	      }
-	      if (atP2) {
-		atBuf2 |= *atP2++;
-	      }
-	      if (atP3) {
-		atBuf3 |= *atP3++;
-	      }
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 14) & 0x07;
-	      cx1 = (buf1 >> 13) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x0f;
-	      cx = (cx0 << 13) | (cx1 << 8) | (cx2 << 4) |
-		   (((atBuf0 >> atShift0) & 1) << 3) |
-		   (((atBuf1 >> atShift1) & 1) << 2) |
-		   (((atBuf2 >> atShift2) & 1) << 1) |
-		   ((atBuf3 >> atShift3) & 1);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		  if (aty[0] == 0) {
-		    atBuf0 |= 0x8000;
-		  }
-		  if (aty[1] == 0) {
-		    atBuf1 |= 0x8000;
-		  }
-		  if (aty[2] == 0) {
-		    atBuf2 |= 0x8000;
-		  }
-		  if (aty[3] == 0) {
-		    atBuf3 |= 0x8000;
-		  }
-		}
-	      }
-
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	      atBuf0 <<= 1;
-	      atBuf1 <<= 1;
-	      atBuf2 <<= 1;
-	      atBuf3 <<= 1;
-	    }
+      for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
+	if (x0 + 8 < w) {
+	  if (p0) {
+	    buf0 |= *p0++;
 	  }
-
-	} else {
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 14) & 0x07;
-	      cx1 = (buf1 >> 13) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x0f;
-	      cx = (cx0 << 13) | (cx1 << 8) | (cx2 << 4) |
-		   (bitmap->getPixel(x + atx[0], y + aty[0]) << 3) |
-		   (bitmap->getPixel(x + atx[1], y + aty[1]) << 2) |
-		   (bitmap->getPixel(x + atx[2], y + aty[2]) << 1) |
-		   bitmap->getPixel(x + atx[3], y + aty[3]);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		}
-	      }
-
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	    }
+	  if (p1) {
+	    buf1 |= *p1++;
 	  }
+	  buf2 |= *p2++;
 	}
-	break;
-
-      case 1:
-
-	// set up the context
-	p2 = pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
-	buf2 = *p2++ << 8;
-	if (y >= 1) {
-	  p1 = bitmap->getDataPtr() + (y - 1) * bitmap->getLineSize();
-	  buf1 = *p1++ << 8;
-	  if (y >= 2) {
-	    p0 = bitmap->getDataPtr() + (y - 2) * bitmap->getLineSize();
-	    buf0 = *p0++ << 8;
-	  } else {
-	    p0 = nullptr;
-	    buf0 = 0;
-	  }
-	} else {
-	  p1 = p0 = nullptr;
-	  buf1 = buf0 = 0;
+	atBuf0 = getATPixels(atRow0, bitmap->getLineSize(), x0 + atx[0]);
+	if (templ == 0) {
+	  atBuf1 = getATPixels(atRow1, bitmap->getLineSize(), x0 + atx[1]);
+	  atBuf2 = getATPixels(atRow2, bitmap->getLineSize(), x0 + atx[2]);
+	  atBuf3 = getATPixels(atRow3, bitmap->getLineSize(), x0 + atx[3]);
 	}
 
-	if (atx[0] >= -8 && atx[0] <= 8) {
-	  // set up the adaptive context
-	  const int atY = y + aty[0];
-	  if ((atY >= 0) && (atY < bitmap->getHeight())) {
-	    atP0 = bitmap->getDataPtr() + atY * bitmap->getLineSize();
-	    atBuf0 = *atP0++ << 8;
-	  } else {
-	    atP0 = nullptr;
-	    atBuf0 = 0;
-	  }
-	  atShift0 = 15 - atx[0];
-
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	      if (atP0) {
-		atBuf0 |= *atP0++;
-	      }
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 13) & 0x0f;
-	      cx1 = (buf1 >> 13) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x07;
-	      cx = (cx0 << 9) | (cx1 << 4) | (cx2 << 1) |
-		   ((atBuf0 >> atShift0) & 1);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		  if (aty[0] == 0) {
-		    atBuf0 |= 0x8000;
-		  }
-		}
-	      }
-
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	      atBuf0 <<= 1;
-	    }
-	  }
-
-	} else {
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
+	switch (templ) {
+	case 0:
+	  for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
+
+	    // build the context
+	    cx0 = (buf0 >> 14) & 0x07;
+	    cx1 = (buf1 >> 13) & 0x1f;
+	    cx2 = (buf2 >> 16) & 0x0f;
+	    cx = (cx0 << 13) | (cx1 << 8) | (cx2 << 4) |
+		 ((atBuf0 >> 4) & 0x08) | ((atBuf1 >> 5) & 0x04) |
+		 ((atBuf2 >> 6) & 0x02) | ((atBuf3 >> 7) & 0x01);
+
+	    // check for a skipped pixel
+	    if (!(useSkip && skip->getPixel(x, y))) {
+
+	      // decode the pixel
+	      if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
+		*pp |= mask;
+		buf2 |= 0x8000;
+		atBuf0 |= atFix0;
+		atBuf1 |= atFix1;
+		atBuf2 |= atFix2;
+		atBuf3 |= atFix3;
 	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
 	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 13) & 0x0f;
-	      cx1 = (buf1 >> 13) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x07;
-	      cx = (cx0 << 9) | (cx1 << 4) | (cx2 << 1) |
-		   bitmap->getPixel(x + atx[0], y + aty[0]);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		}
-	      }
 
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	    }
+	    // update the context
+	    buf0 <<= 1;
+	    buf1 <<= 1;
+	    buf2 <<= 1;
+	    atBuf0 <<= 1;
+	    atBuf1 <<= 1;
+	    atBuf2 <<= 1;
+	    atBuf3 <<= 1;
 	  }
-	}
-	break;
-
-      case 2:
-
-	// set up the context
-	p2 = pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
-	buf2 = *p2++ << 8;
-	if (y >= 1) {
-	  p1 = bitmap->getDataPtr() + (y - 1) * bitmap->getLineSize();
-	  buf1 = *p1++ << 8;
-	  if (y >= 2) {
-	    p0 = bitmap->getDataPtr() + (y - 2) * bitmap->getLineSize();
-	    buf0 = *p0++ << 8;
-	  } else {
-	    p0 = nullptr;
-	    buf0 = 0;
-	  }
-	} else {
-	  p1 = p0 = nullptr;
-	  buf1 = buf0 = 0;
-	}
+	  break;
 
-	if (atx[0] >= -8 && atx[0] <= 8) {
-	  // set up the adaptive context
-	  const int atY = y + aty[0];
-	  if ((atY >= 0) && (atY < bitmap->getHeight())) {
-	    atP0 = bitmap->getDataPtr() + atY * bitmap->getLineSize();
-	    atBuf0 = *atP0++ << 8;
-	  } else {
-	    atP0 = nullptr;
-	    atBuf0 = 0;
-	  }
-	  atShift0 = 15 - atx[0];
+	case 1:
+	  for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
 
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	      if (atP0) {
-		atBuf0 |= *atP0++;
-	      }
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 14) & 0x07;
-	      cx1 = (buf1 >> 14) & 0x0f;
-	      cx2 = (buf2 >> 16) & 0x03;
-	      cx = (cx0 << 7) | (cx1 << 3) | (cx2 << 1) |
-		   ((atBuf0 >> atShift0) & 1);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		  if (aty[0] == 0) {
-		    atBuf0 |= 0x8000;
-		  }
-		}
-	      }
+	    // build the context
+	    cx0 = (buf0 >> 13) & 0x0f;
+	    cx1 = (buf1 >> 13) & 0x1f;
+	    cx2 = (buf2 >> 16) & 0x07;
+	    cx = (cx0 << 9) | (cx1 << 4) | (cx2 << 1) |
+		 ((atBuf0 >> 7) & 0x01);
 
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	      atBuf0 <<= 1;
-	    }
-	  }
+	    // check for a skipped pixel
+	    if (!(useSkip && skip->getPixel(x, y))) {
 
-	} else {
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
+	      // decode the pixel
+	      if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
+		*pp |= mask;
+		buf2 |= 0x8000;
+		atBuf0 |= atFix0;
 	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
 	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 14) & 0x07;
-	      cx1 = (buf1 >> 14) & 0x0f;
-	      cx2 = (buf2 >> 16) & 0x03;
-	      cx = (cx0 << 7) | (cx1 << 3) | (cx2 << 1) |
-		   bitmap->getPixel(x + atx[0], y + aty[0]);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		}
-	      }
 
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	    }
+	    // update the context
+	    buf0 <<= 1;
+	    buf1 <<= 1;
+	    buf2 <<= 1;
+	    atBuf0 <<= 1;
 	  }
-	}
-	break;
+	  break;
 
-      case 3:
+	case 2:
+	  for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
 
-	// set up the context
-	p2 = pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
-	buf2 = *p2++ << 8;
-	if (y >= 1) {
-	  p1 = bitmap->getDataPtr() + (y - 1) * bitmap->getLineSize();
-	  buf1 = *p1++ << 8;
-	} else {
-	  p1 = nullptr;
-	  buf1 = 0;
-	}
+	    // build the context
+	    cx0 = (buf0 >> 14) & 0x07;
+	    cx1 = (buf1 >> 14) & 0x0f;
+	    cx2 = (buf2 >> 16) & 0x03;
+	    cx = (cx0 << 7) | (cx1 << 3) | (cx2 << 1) |
+		 ((atBuf0 >> 7) & 0x01);
 
-	if (atx[0] >= -8 && atx[0] <= 8) {
-	  // set up the adaptive context
-	  const int atY = y + aty[0];
-	  if ((atY >= 0) && (atY < bitmap->getHeight())) {
-	    atP0 = bitmap->getDataPtr() + atY * bitmap->getLineSize();
-	    atBuf0 = *atP0++ << 8;
-	  } else {
-	    atP0 = nullptr;
-	    atBuf0 = 0;
-	  }
-	  atShift0 = 15 - atx[0];
+	    // check for a skipped pixel
+	    if (!(useSkip && skip->getPixel(x, y))) {
 
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	      if (atP0) {
-		atBuf0 |= *atP0++;
+	      // decode the pixel
+	      if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
+		*pp |= mask;
+		buf2 |= 0x8000;
+		atBuf0 |= atFix0;
 	      }
 	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx1 = (buf1 >> 14) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x0f;
-	      cx = (cx1 << 5) | (cx2 << 1) |
-		   ((atBuf0 >> atShift0) & 1);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		  if (aty[0] == 0) {
-		    atBuf0 |= 0x8000;
-		  }
-		}
-	      }
 
-	      // update the context
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	      atBuf0 <<= 1;
-	    }
+	    // update the context
+	    buf0 <<= 1;
+	    buf1 <<= 1;
+	    buf2 <<= 1;
+	    atBuf0 <<= 1;
 	  }
+	  break;
 
-	} else {
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
+	case 3:
+	  for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
 
-	      // build the context
-	      cx1 = (buf1 >> 14) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x0f;
-	      cx = (cx1 << 5) | (cx2 << 1) |
-		   bitmap->getPixel(x + atx[0], y + aty[0]);
+	    // build the context
+	    cx1 = (buf1 >> 14) & 0x1f;
+	    cx2 = (buf2 >> 16) & 0x0f;
+	    cx = (cx1 << 5) | (cx2 << 1) |
+		 ((atBuf0 >> 7) & 0x01);
 
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
+	    // check for a skipped pixel
+	    if (!(useSkip && skip->getPixel(x, y))) {
 
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		}
+	      // decode the pixel
+	      if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
+		*pp |= mask;
+		buf2 |= 0x8000;
+		atBuf0 |= atFix0;
 	      }
-
-	      // update the context
-	      buf1 <<= 1;
-	      buf2 <<= 1;
 	    }
+
+	    // update the context
+	    buf1 <<= 1;
+	    buf2 <<= 1;
+	    atBuf0 <<= 1;
 	  }
+	  break;
 	}
-	break;
       }
     }
   }
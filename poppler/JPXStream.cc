@@ -26,8 +26,13 @@
 #include <config.h>
 
 #include <limits.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
 #include "gmem.h"
 #include "Error.h"
+#include "GlobalParams.h"
 #include "JArithmeticDecoder.h"
 #include "JPXStream.h"
 
@@ -67,6 +72,12 @@
 
 //------------------------------------------------------------------------
 
+// smallest image (in samples, at the decoded resolution) that is decoded
+// with more than one thread
+#define jpxParallelMinSamples (1024 * 1024)
+
+//------------------------------------------------------------------------
+
 // arithmetic decoder context for the significance propagation and
 // cleanup passes:
 //     [horiz][vert][diag][subband]
@@ -250,6 +261,9 @@ JPXStream::JPXStream(Stream *strA):
   havePalette = false;
   haveCompMap = false;
   haveChannelDefn = false;
+  reduction = 0;
+  haveRegion = false;
+  regionX0 = regionY0 = regionX1 = regionY1 = 0;
 
   img.tiles = nullptr;
   bitBuf = 0;
@@ -270,14 +284,18 @@ JPXStream::~JPXStream() {
 void JPXStream::reset() {
   bufStr->reset();
   if (readBoxes()) {
-    curY = img.yOffset;
+    curY = img.yOffsetR;
   } else {
     // readBoxes reported an error, so we go immediately to EOF
-    curY = img.ySize;
+    curY = img.ySizeR;
   }
-  curX = img.xOffset;
+  curX = img.xOffsetR;
   curComp = 0;
   readBufLen = 0;
+
+  // the reduced size and the region only apply to this reset()
+  reduction = 0;
+  haveRegion = false;
 }
 
 void JPXStream::close() {
@@ -333,6 +351,8 @@ void JPXStream::close() {
 			for (k = 0; k < subband->nXCBs * subband->nYCBs; ++k) {
 			  cb = &subband->cbs[k];
 			  gfree(cb->dataLen);
+			  gfree(cb->pktData);
+			  gfree(cb->pktInfo);
 			  gfree(cb->touched);
 			  if (cb->arithDecoder) {
 			    delete cb->arithDecoder;
@@ -407,11 +427,14 @@ void JPXStream::fillReadBuf() {
   int pix, pixBits;
 
   do {
-    if (curY >= img.ySize) {
+    if (curY >= img.ySizeR) {
       return;
     }
-    tileIdx = ((curY - img.yTileOffset) / img.yTileSize) * img.nXTiles
-              + (curX - img.xTileOffset) / img.xTileSize;
+    // (curX, curY) is on the reduced reference grid; it is in the tile
+    // that contains (curX, curY) << reduction
+    tileIdx = (((curY << img.reduction) - img.yTileOffset) / img.yTileSize)
+                * img.nXTiles
+              + ((curX << img.reduction) - img.xTileOffset) / img.xTileSize;
 #if 1 //~ ignore the palette, assume the PDF ColorSpace object is valid
     if (img.tiles == nullptr || tileIdx >= img.nXTiles * img.nYTiles || img.tiles[tileIdx].tileComps == nullptr) {
       error(errSyntaxError, getPos(), "Unexpected tileIdx in fillReadBuf in JPX stream");
@@ -421,17 +444,24 @@ void JPXStream::fillReadBuf() {
 #else
     tileComp = &img.tiles[tileIdx].tileComps[havePalette ? 0 : curComp];
 #endif
-    tx = jpxCeilDiv((curX - img.xTileOffset) % img.xTileSize, tileComp->hSep);
-    ty = jpxCeilDiv((curY - img.yTileOffset) % img.yTileSize, tileComp->vSep);
-    if (unlikely(ty >= (tileComp->y1 - tileComp->y0))) {
-      error(errSyntaxError, getPos(), "Unexpected ty in fillReadBuf in JPX stream");
-      return;
-    }
-    if (unlikely(tx >= (tileComp->x1 - tileComp->x0))) {
-      error(errSyntaxError, getPos(), "Unexpected tx in fillReadBuf in JPX stream");
-      return;
+    tx = jpxCeilDiv(curX, tileComp->hSep)
+         - jpxCeilDivPow2(tileComp->x0, img.reduction);
+    ty = jpxCeilDiv(curY, tileComp->vSep)
+         - jpxCeilDivPow2(tileComp->y0, img.reduction);
+    if (img.tiles[tileIdx].outside) {
+      // not decoded: any value will do
+      pix = 0;
+    } else {
+      if (unlikely(ty >= tileComp->h)) {
+	error(errSyntaxError, getPos(), "Unexpected ty in fillReadBuf in JPX stream");
+	return;
+      }
+      if (unlikely(tx >= tileComp->w)) {
+	error(errSyntaxError, getPos(), "Unexpected tx in fillReadBuf in JPX stream");
+	return;
+      }
+      pix = (int)tileComp->data[ty * tileComp->w + tx];
     }
-    pix = (int)tileComp->data[ty * (tileComp->x1 - tileComp->x0) + tx];
     pixBits = tileComp->prec;
 #if 1 //~ ignore the palette, assume the PDF ColorSpace object is valid
     if (++curComp == img.nComps) {
@@ -447,8 +477,8 @@ void JPXStream::fillReadBuf() {
     if (++curComp == (unsigned int)(havePalette ? palette.nComps : img.nComps)) {
 #endif
       curComp = 0;
-      if (++curX == img.xSize) {
-	curX = img.xOffset;
+      if (++curX == img.xSizeR) {
+	curX = img.xOffsetR;
 	++curY;
 	if (pixBits < 8) {
 	  pix <<= 8 - pixBits;
@@ -605,6 +635,141 @@ void JPXStream::getImageParams2(int *bitsPerComponent,
   }
 }
 
+// Skipping resolution levels halves the width and height of the
+// decoded image for each level, and skips the code-blocks of those
+// levels.  The smallest number of decomposition levels of the
+// components in the main header limits the reduction.
+bool JPXStream::setReducedSize(int *widthA, int *heightA,
+			       int minWidth, int minHeight) {
+  unsigned int xSize, ySize, xOffset, yOffset, nDecompLevels, r;
+  int w, h;
+
+  reduction = 0;
+  if (!getCodestreamParams(&xSize, &ySize, &xOffset, &yOffset,
+			   &nDecompLevels) ||
+      (int)(xSize - xOffset) != *widthA ||
+      (int)(ySize - yOffset) != *heightA) {
+    return false;
+  }
+  if (minWidth < 1) {
+    minWidth = 1;
+  }
+  if (minHeight < 1) {
+    minHeight = 1;
+  }
+  for (r = 1; r <= nDecompLevels && r < 31; ++r) {
+    w = (int)(jpxCeilDivPow2(xSize, r) - jpxCeilDivPow2(xOffset, r));
+    h = (int)(jpxCeilDivPow2(ySize, r) - jpxCeilDivPow2(yOffset, r));
+    if (w < minWidth || h < minHeight) {
+      break;
+    }
+    reduction = r;
+    *widthA = w;
+    *heightA = h;
+  }
+  return reduction > 0;
+}
+
+// Tiles are coded independently, so tiles outside the region are
+// skipped.
+bool JPXStream::setDecodeRegion(int x0, int y0, int x1, int y1) {
+  haveRegion = true;
+  regionX0 = x0 > 0 ? x0 : 0;
+  regionY0 = y0 > 0 ? y0 : 0;
+  regionX1 = x1 > (int)regionX0 ? x1 : regionX0;
+  regionY1 = y1 > (int)regionY0 ? y1 : regionY0;
+  return true;
+}
+
+// Get the size of the reference grid, the image offset, and the
+// smallest number of decomposition levels from the main header of the
+// codestream, without decoding it.
+bool JPXStream::getCodestreamParams(unsigned int *xSize, unsigned int *ySize,
+				    unsigned int *xOffset, unsigned int *yOffset,
+				    unsigned int *nDecompLevels) {
+  unsigned int boxType, boxLen, dataLen, segLen, nComps1, n, dummy, i;
+  int segType;
+  bool haveSIZ, haveCOD, ok;
+
+  haveSIZ = haveCOD = ok = false;
+  nComps1 = 0;
+  bufStr->reset();
+
+  // look for the codestream box
+  if (bufStr->lookChar() != 0xff) {
+    while (1) {
+      if (!readBoxHdr(&boxType, &boxLen, &dataLen)) {
+	bufStr->close();
+	return false;
+      }
+      if (boxType == 0x6A703263) { // codestream
+	break;
+      }
+      // the JP2 header superbox contains other boxes
+      if (boxType != 0x6a703268) {
+	for (i = 0; i < dataLen; ++i) {
+	  if (bufStr->getChar() == EOF) {
+	    bufStr->close();
+	    return false;
+	  }
+	}
+      }
+    }
+  }
+
+  while (readMarkerHdr(&segType, &segLen)) {
+    n = 0;
+    if (segType == 0x51) { // SIZ - image and tile size
+      if (!readUWord(&dummy) ||
+	  !readULong(xSize) ||
+	  !readULong(ySize) ||
+	  !readULong(xOffset) ||
+	  !readULong(yOffset) ||
+	  !readULong(&dummy) ||
+	  !readULong(&dummy) ||
+	  !readULong(&dummy) ||
+	  !readULong(&dummy) ||
+	  !readUWord(&nComps1)) {
+	break;
+      }
+      n = 36;
+      haveSIZ = *xSize > *xOffset && *ySize > *yOffset;
+    } else if (segType == 0x52) { // COD - coding style default
+      if (!readUByte(&dummy) ||
+	  !readUByte(&dummy) ||
+	  !readUWord(&dummy) ||
+	  !readUByte(&dummy) ||
+	  !readUByte(nDecompLevels)) {
+	break;
+      }
+      n = 6;
+      haveCOD = true;
+    } else if (segType == 0x53 && haveCOD) { // COC - coding style component
+      if ((nComps1 > 256 && !readUWord(&dummy)) ||
+	  (nComps1 <= 256 && !readUByte(&dummy)) ||
+	  !readUByte(&dummy) ||
+	  !readUByte(&i)) {
+	break;
+      }
+      n = nComps1 > 256 ? 4 : 3;
+      if (i < *nDecompLevels) {
+	*nDecompLevels = i;
+      }
+    } else if (segType == 0x90) { // SOT - end of the main header
+      ok = haveSIZ && haveCOD;
+      break;
+    }
+    for (i = n + 2; i < segLen; ++i) {
+      if (bufStr->getChar() == EOF) {
+	break;
+      }
+    }
+  }
+
+  bufStr->close();
+  return ok;
+}
+
 bool JPXStream::readBoxes() {
   unsigned int boxType, boxLen, dataLen;
   unsigned int bpc1, compression, unknownColorspace, ipr;
@@ -618,6 +783,9 @@ bool JPXStream::readBoxes() {
   img.xTileSize = img.yTileSize = 0;
   img.xTileOffset = img.yTileOffset = 0;
   img.nComps = 0;
+  img.reduction = reduction;
+  img.xSizeR = img.ySizeR = 0;
+  img.xOffsetR = img.yOffsetR = 0;
 
   // check for a naked JPEG 2000 codestream (without the JP2/JPX
   // wrapper) -- this appears to be a violation of the PDF spec, but
@@ -918,8 +1086,6 @@ bool JPXStream::readColorSpecBox(unsigned int dataLen) {
 }
 
 bool JPXStream::readCodestream(unsigned int len) {
-  JPXTile *tile;
-  JPXTileComp *tileComp;
   int segType;
   bool haveSIZ, haveCOD, haveQCD, haveSOT;
   unsigned int precinctSize, style, nDecompLevels;
@@ -972,6 +1138,10 @@ bool JPXStream::readCodestream(unsigned int len) {
 	error(errSyntaxError, getPos(), "Error in JPX SIZ marker segment");
 	return false;
       }
+      img.xSizeR = jpxCeilDivPow2(img.xSize, img.reduction);
+      img.ySizeR = jpxCeilDivPow2(img.ySize, img.reduction);
+      img.xOffsetR = jpxCeilDivPow2(img.xOffset, img.reduction);
+      img.yOffsetR = jpxCeilDivPow2(img.yOffset, img.reduction);
       img.nXTiles = (img.xSize - img.xTileOffset + img.xTileSize - 1)
 	            / img.xTileSize;
       img.nYTiles = (img.ySize - img.yTileOffset + img.yTileSize - 1)
@@ -987,6 +1157,7 @@ bool JPXStream::readCodestream(unsigned int len) {
 				      sizeof(JPXTile));
       for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
 	img.tiles[i].init = false;
+	img.tiles[i].outside = false;
 	img.tiles[i].tileComps = (JPXTileComp *)gmallocn(img.nComps,
 							 sizeof(JPXTileComp));
 	for (comp = 0; comp < img.nComps; ++comp) {
@@ -1501,23 +1672,12 @@ bool JPXStream::readCodestream(unsigned int len) {
 
   //----- finish decoding the image
   for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
-    tile = &img.tiles[i];
-    if (!tile->init) {
+    if (!img.tiles[i].init) {
       error(errSyntaxError, getPos(), "Uninitialized tile in JPX codestream");
       return false;
     }
-    for (comp = 0; comp < img.nComps; ++comp) {
-      tileComp = &tile->tileComps[comp];
-      inverseTransform(tileComp);
-    }
-    if (!inverseMultiCompAndDC(tile)) {
-      return false;
-    }
   }
-
-  //~ can free memory below tileComps here, and also tileComp.buf
-
-  return true;
+  return finishDecoding();
 }
 
 bool JPXStream::readTilePart() {
@@ -1929,6 +2089,16 @@ bool JPXStream::readTilePart() {
     if ((tile->y1 = img.yTileOffset + (i + 1) * img.yTileSize) > img.ySize) {
       tile->y1 = img.ySize;
     }
+    if (haveRegion) {
+      tile->outside =
+	  jpxCeilDivPow2(tile->x0, img.reduction) >= img.xOffsetR + regionX1 ||
+	  jpxCeilDivPow2(tile->x1, img.reduction) <= img.xOffsetR + regionX0 ||
+	  jpxCeilDivPow2(tile->y0, img.reduction) >= img.yOffsetR + regionY1 ||
+	  jpxCeilDivPow2(tile->y1, img.reduction) <= img.yOffsetR + regionY0;
+      if (tile->outside) {
+	return skipTilePartData(tilePartLen, tilePartToEOC);
+      }
+    }
     tile->comp = 0;
     tile->res = 0;
     tile->precinct = 0;
@@ -1943,16 +2113,25 @@ bool JPXStream::readTilePart() {
       tileComp->y0 = jpxCeilDiv(tile->y0, tileComp->vSep);
       tileComp->x1 = jpxCeilDiv(tile->x1, tileComp->hSep);
       tileComp->y1 = jpxCeilDiv(tile->y1, tileComp->vSep);
-      tileComp->w = tileComp->x1 - tileComp->x0;
+      // a component with fewer decomposition levels than the reduction
+      // is decoded larger, and subsampled afterwards
+      if (img.reduction < tileComp->nDecompLevels) {
+	tileComp->reduction = img.reduction;
+      } else {
+	tileComp->reduction = tileComp->nDecompLevels;
+      }
+      tileComp->w = jpxCeilDivPow2(tileComp->x1, tileComp->reduction)
+	            - jpxCeilDivPow2(tileComp->x0, tileComp->reduction);
+      tileComp->h = jpxCeilDivPow2(tileComp->y1, tileComp->reduction)
+	            - jpxCeilDivPow2(tileComp->y0, tileComp->reduction);
       tileComp->cbW = 1 << tileComp->codeBlockW;
       tileComp->cbH = 1 << tileComp->codeBlockH;
-      tileComp->data = (int *)gmallocn((tileComp->x1 - tileComp->x0) *
-				       (tileComp->y1 - tileComp->y0),
+      tileComp->data = (int *)gmallocn(tileComp->w * tileComp->h,
 				       sizeof(int));
-      if (tileComp->x1 - tileComp->x0 > tileComp->y1 - tileComp->y0) {
-	n = tileComp->x1 - tileComp->x0;
+      if (tileComp->w > tileComp->h) {
+	n = tileComp->w;
       } else {
-	n = tileComp->y1 - tileComp->y0;
+	n = tileComp->h;
       }
       tileComp->buf = (int *)gmallocn(n + 8, sizeof(int));
       for (r = 0; r <= tileComp->nDecompLevels; ++r) {
@@ -2032,7 +2211,10 @@ bool JPXStream::readTilePart() {
 						    sizeof(JPXCodeBlock));
 	    sbx0 = jpxFloorDivPow2(subband->x0, tileComp->codeBlockW);
 	    sby0 = jpxFloorDivPow2(subband->y0, tileComp->codeBlockH);
-	    if (r == 0) { // (NL)LL
+	    if (r + tileComp->reduction > tileComp->nDecompLevels) {
+	      // not decoded
+	      sbCoeffs = nullptr;
+	    } else if (r == 0) { // (NL)LL
 	      sbCoeffs = tileComp->data;
 	    } else if (sb == 0) { // (NL-r+1)HL
 	      sbCoeffs = tileComp->data
@@ -2070,19 +2252,28 @@ bool JPXStream::readTilePart() {
 		cb->nZeroBitPlanes = 0;
 		cb->dataLenSize = 1;
 		cb->dataLen = (unsigned int *)gmalloc(sizeof(unsigned int));
-		cb->coeffs = sbCoeffs
-		             + (cb->y0 - subband->y0) * tileComp->w
-		             + (cb->x0 - subband->x0);
-		cb->touched = (char *)gmalloc(1 << (tileComp->codeBlockW
-						    + tileComp->codeBlockH));
+		cb->pktData = nullptr;
+		cb->pktDataLen = cb->pktDataSize = 0;
+		cb->pktInfo = nullptr;
+		cb->pktInfoLen = cb->pktInfoSize = 0;
 		cb->len = 0;
-		for (cbj = 0; cbj < cb->y1 - cb->y0; ++cbj) {
-		  for (cbi = 0; cbi < cb->x1 - cb->x0; ++cbi) {
-		    cb->coeffs[cbj * tileComp->w + cbi] = 0;
+		if (sbCoeffs) {
+		  cb->coeffs = sbCoeffs
+		               + (cb->y0 - subband->y0) * tileComp->w
+		               + (cb->x0 - subband->x0);
+		  cb->touched = (char *)gmalloc(1 << (tileComp->codeBlockW
+						      + tileComp->codeBlockH));
+		  for (cbj = 0; cbj < cb->y1 - cb->y0; ++cbj) {
+		    for (cbi = 0; cbi < cb->x1 - cb->x0; ++cbi) {
+		      cb->coeffs[cbj * tileComp->w + cbi] = 0;
+		    }
 		  }
+		  memset(cb->touched, 0,
+			 (1 << (tileComp->codeBlockW + tileComp->codeBlockH)));
+		} else {
+		  cb->coeffs = nullptr;
+		  cb->touched = nullptr;
 		}
-		memset(cb->touched, 0,
-		       (1 << (tileComp->codeBlockW + tileComp->codeBlockH)));
 		cb->arithDecoder = nullptr;
 		cb->stats = nullptr;
 		++cb;
@@ -2094,9 +2285,35 @@ bool JPXStream::readTilePart() {
     }
   }
 
+  if (img.tiles[tileIdx].outside) {
+    return skipTilePartData(tilePartLen, tilePartToEOC);
+  }
   return readTilePartData(tileIdx, tilePartLen, tilePartToEOC);
 }
 
+// Skip the data of a tile-part that isn't decoded.  A tile-part that
+// extends to the end of the codestream ends right before the EOC marker
+// (markers can't appear in packet data).
+bool JPXStream::skipTilePartData(unsigned int tilePartLen,
+				 bool tilePartToEOC) {
+  unsigned int i;
+
+  if (tilePartToEOC) {
+    while (bufStr->lookChar() != EOF &&
+	   !(bufStr->lookChar() == 0xff && bufStr->lookChar(1) == 0xd9)) {
+      bufStr->getChar();
+    }
+  } else {
+    for (i = 0; i < tilePartLen; ++i) {
+      if (bufStr->getChar() == EOF) {
+	error(errSyntaxError, getPos(), "Unexpected EOF in JPX stream");
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
 bool JPXStream::readTilePartData(unsigned int tileIdx,
 				  unsigned int tilePartLen, bool tilePartToEOC) {
   JPXTile *tile;
@@ -2334,17 +2551,24 @@ bool JPXStream::readTilePartData(unsigned int tileIdx,
 	for (cbX = 0; cbX < subband->nXCBs; ++cbX) {
 	  cb = &subband->cbs[cbY * subband->nXCBs + cbX];
 	  if (cb->included) {
-	    if (!readCodeBlockData(tileComp, resLevel, precinct, subband,
-				   tile->res, sb, cb)) {
-	      return false;
-	    }
 	    if (tileComp->codeBlockStyle & 0x04) {
-	      for (i = 0; i < cb->nCodingPasses; ++i) {
-		tilePartLen -= cb->dataLen[i];
+	      for (n = 0, i = 0; i < cb->nCodingPasses; ++i) {
+		n += cb->dataLen[i];
 	      }
 	    } else {
-	      tilePartLen -= cb->dataLen[0];
+	      n = cb->dataLen[0];
 	    }
+	    if (tile->res + tileComp->reduction > tileComp->nDecompLevels) {
+	      // resolution level that is not decoded
+	      for (i = 0; i < n; ++i) {
+		if (bufStr->getChar() == EOF) {
+		  break;
+		}
+	      }
+	    } else {
+	      bufferCodeBlockData(tileComp, cb, n);
+	    }
+	    tilePartLen -= n;
 	    cb->seen = true;
 	  }
 	}
@@ -2433,12 +2657,176 @@ bool JPXStream::readTilePartData(unsigned int tileIdx,
   return false;
 }
 
+// Append the data of <cb> in the current packet (<n> bytes) to the data
+// of the previous packets.  Code-blocks are decoded in finishDecoding(),
+// once all of their packets have been read.
+void JPXStream::bufferCodeBlockData(JPXTileComp *tileComp, JPXCodeBlock *cb,
+				    unsigned int n) {
+  unsigned int nSegs, i, k, got;
+
+  nSegs = (tileComp->codeBlockStyle & 0x04) ? cb->nCodingPasses : 1;
+  if (cb->pktInfoLen + 1 + nSegs > cb->pktInfoSize) {
+    cb->pktInfoSize = 2 * cb->pktInfoSize + 1 + nSegs;
+    cb->pktInfo = (unsigned int *)greallocn(cb->pktInfo, cb->pktInfoSize,
+					    sizeof(unsigned int));
+  }
+  cb->pktInfo[cb->pktInfoLen++] = cb->nCodingPasses;
+  for (i = 0; i < nSegs; ++i) {
+    cb->pktInfo[cb->pktInfoLen++] = cb->dataLen[i];
+  }
+
+  // the lengths come from the packet header, so only grow the buffer as
+  // the data actually arrives
+  while (n > 0) {
+    k = n < 4096 ? n : 4096;
+    if (cb->pktDataLen + k > cb->pktDataSize) {
+      cb->pktDataSize = 2 * cb->pktDataSize + k;
+      cb->pktData = (unsigned char *)greallocn(cb->pktData, cb->pktDataSize,
+					       sizeof(unsigned char));
+    }
+    got = bufStr->doGetChars(k, cb->pktData + cb->pktDataLen);
+    cb->pktDataLen += got;
+    if (got < k) {
+      // EOF -- the decoder reads 0xff past the end of the data, as it
+      // does past the end of the stream
+      break;
+    }
+    n -= k;
+  }
+}
+
+// Run <func>(0) ... <func>(<n>-1) on up to <nThreads> threads (including
+// the calling one).
+static void jpxParallelFor(int nThreads, unsigned int n,
+			   const std::function<void(unsigned int)> &func) {
+  std::vector<std::thread> threads;
+  std::atomic<unsigned int> next(0);
+  int t;
+
+  auto worker = [&] {
+    unsigned int i;
+    while ((i = next++) < n) {
+      func(i);
+    }
+  };
+  for (t = 1; t < nThreads && (unsigned int)t < n; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+// Decode the code-blocks, then do the inverse transforms.  Code-blocks
+// are independent of each other, as are tile-components in the IDWT and
+// tiles in the multiple component transform, so large images are
+// decoded with the number of threads set in GlobalParams.
+bool JPXStream::finishDecoding() {
+  struct CodeBlockJob {
+    JPXTileComp *tileComp;
+    unsigned int res, sb;
+    JPXCodeBlock *cb;
+  };
+  std::vector<CodeBlockJob> cbJobs;
+  std::vector<JPXTileComp *> tileCompJobs;
+  std::vector<JPXTile *> tileJobs;
+  std::atomic<bool> ok(true);
+  JPXTile *tile;
+  JPXTileComp *tileComp;
+  JPXSubband *subband;
+  JPXCodeBlock *cb;
+  unsigned int comp, i, k, r, sb;
+  int nThreads;
+
+  for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
+    tile = &img.tiles[i];
+    if (tile->outside) {
+      continue;
+    }
+    tileJobs.push_back(tile);
+    for (comp = 0; comp < img.nComps; ++comp) {
+      tileComp = &tile->tileComps[comp];
+      if (tileComp->w == 0 || tileComp->h == 0) {
+	continue;
+      }
+      tileCompJobs.push_back(tileComp);
+      for (r = 0; r <= tileComp->nDecompLevels - tileComp->reduction; ++r) {
+	for (sb = 0; sb < (unsigned int)(r == 0 ? 1 : 3); ++sb) {
+	  subband = &tileComp->resLevels[r].precincts[0].subbands[sb];
+	  for (k = 0; k < subband->nXCBs * subband->nYCBs; ++k) {
+	    cb = &subband->cbs[k];
+	    if (cb->pktInfoLen > 0) {
+	      cbJobs.push_back(CodeBlockJob{tileComp, r, sb, cb});
+	    }
+	  }
+	}
+      }
+    }
+  }
+
+  nThreads = globalParams ? globalParams->getJPXDecodeThreads() : 1;
+  if ((double)img.nComps * (img.xSizeR - img.xOffsetR)
+        * (img.ySizeR - img.yOffsetR) < jpxParallelMinSamples) {
+    nThreads = 1;
+  }
+
+  jpxParallelFor(nThreads, cbJobs.size(), [&](unsigned int j) {
+    decodeCodeBlock(cbJobs[j].tileComp, cbJobs[j].res, cbJobs[j].sb,
+		    cbJobs[j].cb);
+  });
+  jpxParallelFor(nThreads, tileCompJobs.size(), [&](unsigned int j) {
+    inverseTransform(tileCompJobs[j]);
+    if (tileCompJobs[j]->reduction < img.reduction) {
+      reduceTileComp(tileCompJobs[j]);
+    }
+  });
+  jpxParallelFor(nThreads, tileJobs.size(), [&](unsigned int j) {
+    if (!inverseMultiCompAndDC(tileJobs[j])) {
+      ok = false;
+    }
+  });
+
+  //~ can free memory below tileComps here, and also tileComp.buf
+
+  return ok;
+}
+
+// Decode the data of <cb> from all packets, and free it.
+void JPXStream::decodeCodeBlock(JPXTileComp *tileComp,
+				unsigned int res, unsigned int sb,
+				JPXCodeBlock *cb) {
+  unsigned int nCodingPasses, i;
+
+  MemStream dataStr((const char *)cb->pktData, 0, cb->pktDataLen,
+		    Object(objNull));
+  i = 0;
+  while (i < cb->pktInfoLen) {
+    nCodingPasses = cb->pktInfo[i];
+    if (!readCodeBlockData(tileComp, res, sb, cb, &dataStr, nCodingPasses,
+			   &cb->pktInfo[i + 1])) {
+      break;
+    }
+    i += 1 + ((tileComp->codeBlockStyle & 0x04) ? nCodingPasses : 1);
+  }
+
+  delete cb->arithDecoder;
+  cb->arithDecoder = nullptr;
+  delete cb->stats;
+  cb->stats = nullptr;
+  gfree(cb->pktData);
+  cb->pktData = nullptr;
+  cb->pktDataLen = cb->pktDataSize = 0;
+  gfree(cb->pktInfo);
+  cb->pktInfo = nullptr;
+  cb->pktInfoLen = cb->pktInfoSize = 0;
+}
+
 bool JPXStream::readCodeBlockData(JPXTileComp *tileComp,
-				   JPXResLevel *resLevel,
-				   JPXPrecinct *precinct,
-				   JPXSubband *subband,
 				   unsigned int res, unsigned int sb,
-				   JPXCodeBlock *cb) {
+				   JPXCodeBlock *cb, Stream *dataStr,
+				   unsigned int nCodingPasses,
+				   unsigned int *dataLen) {
   int *coeff0, *coeff1, *coeff;
   char *touched0, *touched1, *touched;
   unsigned int horiz, vert, diag, all, cx, xorBit;
@@ -2448,11 +2836,11 @@ bool JPXStream::readCodeBlockData(JPXTileComp *tileComp,
 
   if (cb->arithDecoder) {
     cover(63);
-    cb->arithDecoder->restart(cb->dataLen[0]);
+    cb->arithDecoder->restart(dataLen[0]);
   } else {
     cover(64);
     cb->arithDecoder = new JArithmeticDecoder();
-    cb->arithDecoder->setStream(bufStr, cb->dataLen[0]);
+    cb->arithDecoder->setStream(dataStr, dataLen[0]);
     cb->arithDecoder->start();
     cb->stats = new JArithmeticDecoderStats(jpxNContexts);
     cb->stats->setEntry(jpxContextSigProp, 4, 0);
@@ -2460,9 +2848,9 @@ bool JPXStream::readCodeBlockData(JPXTileComp *tileComp,
     cb->stats->setEntry(jpxContextUniform, 46, 0);
   }
 
-  for (i = 0; i < cb->nCodingPasses; ++i) {
+  for (i = 0; i < nCodingPasses; ++i) {
     if ((tileComp->codeBlockStyle & 0x04) && i > 0) {
-      cb->arithDecoder->setStream(bufStr, cb->dataLen[i]);
+      cb->arithDecoder->setStream(dataStr, dataLen[i]);
       cb->arithDecoder->start();
     }
 
@@ -2845,7 +3233,7 @@ void JPXStream::inverseTransform(JPXTileComp *tileComp) {
 
   //----- IDWT for each level
 
-  for (r = 1; r <= tileComp->nDecompLevels; ++r) {
+  for (r = 1; r <= tileComp->nDecompLevels - tileComp->reduction; ++r) {
     resLevel = &tileComp->resLevels[r];
 
     // (n)LL is already in the upper-left corner of the
@@ -2856,6 +3244,35 @@ void JPXStream::inverseTransform(JPXTileComp *tileComp) {
   }
 }
 
+// Subsample a tile-component that was decoded at a higher resolution
+// than the rest of the image, because it has fewer decomposition levels
+// than the image reduction.
+void JPXStream::reduceTileComp(JPXTileComp *tileComp) {
+  unsigned int d, x0, y0, w, h, x, y;
+
+  d = img.reduction - tileComp->reduction;
+  x0 = (jpxCeilDivPow2(tileComp->x0, img.reduction) << d)
+       - jpxCeilDivPow2(tileComp->x0, tileComp->reduction);
+  y0 = (jpxCeilDivPow2(tileComp->y0, img.reduction) << d)
+       - jpxCeilDivPow2(tileComp->y0, tileComp->reduction);
+  w = jpxCeilDivPow2(tileComp->x1, img.reduction)
+      - jpxCeilDivPow2(tileComp->x0, img.reduction);
+  h = jpxCeilDivPow2(tileComp->y1, img.reduction)
+      - jpxCeilDivPow2(tileComp->y0, img.reduction);
+
+  // each sample moves towards the start of the array, so this can be
+  // done in place
+  for (y = 0; y < h; ++y) {
+    for (x = 0; x < w; ++x) {
+      tileComp->data[y * w + x] =
+	  tileComp->data[((y << d) + y0) * tileComp->w + (x << d) + x0];
+    }
+  }
+  tileComp->reduction = img.reduction;
+  tileComp->w = w;
+  tileComp->h = h;
+}
+
 // Do one level of the inverse transform:
 // - take (n)LL, (n)HL, (n)LH, and (n)HH from the upper-left corner
 //   of the tile-component data array
@@ -3009,10 +3426,10 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
 	*bufPtr = dataPtr[x];
       }
     }
-    if (tileComp->x1 - tileComp->x0 > tileComp->y1 - tileComp->y0) {
-      x = tileComp->x1 - tileComp->x0 + 5;
+    if (tileComp->w > tileComp->h) {
+      x = tileComp->w + 5;
     } else {
-      x = tileComp->y1 - tileComp->y0 + 5;
+      x = tileComp->h + 5;
     }
     if (offset + nx2 > x || nx2 == 0) {
       error(errSyntaxError, getPos(),
@@ -3059,10 +3476,10 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
 	*bufPtr = dataPtr[y * tileComp->w];
       }
     }
-    if (tileComp->x1 - tileComp->x0 > tileComp->y1 - tileComp->y0) {
-      y = tileComp->x1 - tileComp->x0 + 5;
+    if (tileComp->w > tileComp->h) {
+      y = tileComp->w + 5;
     } else {
-      y = tileComp->y1 - tileComp->y0 + 5;
+      y = tileComp->h + 5;
     }
     if (offset + ny2 > y || ny2 == 0) {
       error(errSyntaxError, getPos(),
@@ -3198,8 +3615,8 @@ bool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
     if (tile->tileComps[0].transform == 0) {
       cover(87);
       j = 0;
-      for (y = 0; y < tile->tileComps[0].y1 - tile->tileComps[0].y0; ++y) {
-	for (x = 0; x < tile->tileComps[0].x1 - tile->tileComps[0].x0; ++x) {
+      for (y = 0; y < tile->tileComps[0].h; ++y) {
+	for (x = 0; x < tile->tileComps[0].w; ++x) {
 	  d0 = tile->tileComps[0].data[j];
 	  d1 = tile->tileComps[1].data[j];
 	  d2 = tile->tileComps[2].data[j];
@@ -3215,8 +3632,8 @@ bool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
     } else {
       cover(88);
       j = 0;
-      for (y = 0; y < tile->tileComps[0].y1 - tile->tileComps[0].y0; ++y) {
-	for (x = 0; x < tile->tileComps[0].x1 - tile->tileComps[0].x0; ++x) {
+      for (y = 0; y < tile->tileComps[0].h; ++y) {
+	for (x = 0; x < tile->tileComps[0].w; ++x) {
 	  d0 = tile->tileComps[0].data[j];
 	  d1 = tile->tileComps[1].data[j];
 	  d2 = tile->tileComps[2].data[j];
@@ -3239,8 +3656,8 @@ bool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
       minVal = -(1 << (tileComp->prec - 1));
       maxVal = (1 << (tileComp->prec - 1)) - 1;
       dataPtr = tileComp->data;
-      for (y = 0; y < tileComp->y1 - tileComp->y0; ++y) {
-	for (x = 0; x < tileComp->x1 - tileComp->x0; ++x) {
+      for (y = 0; y < tileComp->h; ++y) {
+	for (x = 0; x < tileComp->w; ++x) {
 	  coeff = *dataPtr;
 	  if (tileComp->transform == 0) {
 	    cover(109);
@@ -3263,8 +3680,8 @@ bool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
       maxVal = (1 << tileComp->prec) - 1;
       zeroVal = 1 << (tileComp->prec - 1);
       dataPtr = tileComp->data;
-      for (y = 0; y < tileComp->y1 - tileComp->y0; ++y) {
-	for (x = 0; x < tileComp->x1 - tileComp->x0; ++x) {
+      for (y = 0; y < tileComp->h; ++y) {
+	for (x = 0; x < tileComp->w; ++x) {
 	  coeff = *dataPtr;
 	  if (tileComp->transform == 0) {
 	    cover(112);
@@ -114,6 +114,15 @@ struct JPXCodeBlock {
   unsigned int *dataLen;		// data lengths (one per codeword segment)
   unsigned int dataLenSize;		// size of the dataLen array
 
+  //----- data from all packets, decoded after the last packet
+  unsigned char *pktData;		// code-block data
+  unsigned int pktDataLen;		// number of bytes in pktData
+  unsigned int pktDataSize;		// size of the pktData array
+  unsigned int *pktInfo;		// for each packet: the number of coding
+				//   passes, then the data lengths
+  unsigned int pktInfoLen;		// number of entries in pktInfo
+  unsigned int pktInfoSize;		// size of the pktInfo array
+
   //----- coefficient data
   int *coeffs;
   char *touched;		// coefficient 'touched' flags
@@ -192,7 +201,9 @@ struct JPXTileComp {
 
   //----- computed
   unsigned int x0, y0, x1, y1;		// bounds of the tile-comp, in ref coords
-  unsigned int w;			// x1 - x0
+  unsigned int reduction;		// number of resolution levels that
+				//   are not decoded
+  unsigned int w, h;			// size of the decoded data
   unsigned int cbW;			// code-block width
   unsigned int cbH;			// code-block height
 
@@ -210,6 +221,8 @@ struct JPXTileComp {
 
 struct JPXTile {
   bool init;
+  bool outside;			// true if the tile is outside the
+				//   decoding region, and not decoded
 
   //----- from the COD segments (main and tile)
   unsigned int progOrder;		// progression order
@@ -245,6 +258,10 @@ struct JPXImage {
   //----- computed
   unsigned int nXTiles;		// number of tiles in x direction
   unsigned int nYTiles;		// number of tiles in y direction
+  unsigned int reduction;		// number of resolution levels that
+				//   are not decoded
+  unsigned int xSizeR, ySizeR;	// size of the reference grid and image
+  unsigned int xOffsetR, yOffsetR;	//   offset, at the decoded resolution
 
   //----- children
   JPXTile *tiles;		// the tiles (len = nXTiles * nYTiles)
@@ -266,24 +283,36 @@ public:
   virtual bool isBinary(bool last = true) override;
   virtual void getImageParams(int *bitsPerComponent,
 			      StreamColorSpaceMode *csMode) override;
+  virtual bool setReducedSize(int *width, int *height,
+			      int minWidth, int minHeight) override;
+  virtual bool setDecodeRegion(int x0, int y0, int x1, int y1) override;
 
 private:
 
   void fillReadBuf();
   void getImageParams2(int *bitsPerComponent, StreamColorSpaceMode *csMode);
+  bool getCodestreamParams(unsigned int *xSize, unsigned int *ySize,
+			   unsigned int *xOffset, unsigned int *yOffset,
+			   unsigned int *nDecompLevels);
   bool readBoxes();
   bool readColorSpecBox(unsigned int dataLen);
   bool readCodestream(unsigned int len);
   bool readTilePart();
   bool readTilePartData(unsigned int tileIdx,
 			 unsigned int tilePartLen, bool tilePartToEOC);
+  bool skipTilePartData(unsigned int tilePartLen, bool tilePartToEOC);
+  void bufferCodeBlockData(JPXTileComp *tileComp, JPXCodeBlock *cb,
+			   unsigned int n);
+  bool finishDecoding();
+  void decodeCodeBlock(JPXTileComp *tileComp,
+		       unsigned int res, unsigned int sb,
+		       JPXCodeBlock *cb);
   bool readCodeBlockData(JPXTileComp *tileComp,
-			  JPXResLevel *resLevel,
-			  JPXPrecinct *precinct,
-			  JPXSubband *subband,
 			  unsigned int res, unsigned int sb,
-			  JPXCodeBlock *cb);
+			  JPXCodeBlock *cb, Stream *dataStr,
+			  unsigned int nCodingPasses, unsigned int *dataLen);
   void inverseTransform(JPXTileComp *tileComp);
+  void reduceTileComp(JPXTileComp *tileComp);
   void inverseTransformLevel(JPXTileComp *tileComp,
 			     unsigned int r, JPXResLevel *resLevel);
   void inverseTransform1D(JPXTileComp *tileComp, int *data,
@@ -318,6 +347,13 @@ private:
   JPXChannelDefn channelDefn;	// channel definition
   bool haveChannelDefn;	// set if a channel defn has been found
 
+  unsigned int reduction;		// number of resolution levels to skip
+				//   in the next reset()
+  bool haveRegion;		// set if only a region is needed in the
+				//   next reset()
+  unsigned int regionX0, regionY0,	// the region, in pixels of the
+        regionX1, regionY1;		//   reduced image
+
   JPXImage img;			// JPEG2000 decoder data
   unsigned int bitBuf;			// buffer for bit reads
   int bitBufLen;		// number of bits in bitBuf
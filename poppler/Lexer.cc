@@ -68,6 +68,7 @@ static const long long LongLongSafeLimit = (LLONG_MAX - 9) / 10;
 Lexer::Lexer(XRef *xrefA, Stream *str) {
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  spanStart = spanPtr = spanEnd = nullptr;
 
   curStr = Object(str);
   streams = new Array(xref);
@@ -80,6 +81,7 @@ Lexer::Lexer(XRef *xrefA, Stream *str) {
 Lexer::Lexer(XRef *xrefA, Object *obj) {
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  spanStart = spanPtr = spanEnd = nullptr;
 
   if (obj->isStream()) {
     streams = new Array(xref);
@@ -99,6 +101,7 @@ Lexer::Lexer(XRef *xrefA, Object *obj) {
 }
 
 Lexer::~Lexer() {
+  syncSpan();
   if (curStr.isStream()) {
     curStr.streamClose();
   }
@@ -107,17 +110,34 @@ Lexer::~Lexer() {
   }
 }
 
-int Lexer::getChar(bool comesFromLook) {
+void Lexer::syncSpan() {
+  if (spanPtr != spanStart) {
+    curStr.getStream()->skipChars((int)(spanPtr - spanStart));
+  }
+  spanStart = spanPtr = spanEnd = nullptr;
+}
+
+// Called when the current span is used up: consume it from the stream
+// and look at the next one, falling back to reading char by char from
+// streams that can't provide spans.
+int Lexer::getCharFromStream(bool comesFromLook) {
   int c;
 
-  if (LOOK_VALUE_NOT_CACHED != lookCharLastValueCached) {
-    c = lookCharLastValueCached;
-    lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
-    return c;
-  }
+  syncSpan();
 
   c = EOF;
-  while (curStr.isStream() && (c = curStr.streamGetChar()) == EOF) {
+  while (curStr.isStream()) {
+    int n;
+    const unsigned char *span = curStr.getStream()->lookChars(&n);
+    if (span && n > 0) {
+      spanStart = span;
+      spanPtr = span;
+      spanEnd = span + n;
+      return *spanPtr++;
+    }
+    if ((c = curStr.streamGetChar()) != EOF) {
+      break;
+    }
     if (comesFromLook == true) {
       return EOF;
     } else {
@@ -135,21 +155,29 @@ int Lexer::getChar(bool comesFromLook) {
   return c;
 }
 
-int Lexer::lookChar() {
-  
-  if (LOOK_VALUE_NOT_CACHED != lookCharLastValueCached) {
-    return lookCharLastValueCached;
-  }
-  lookCharLastValueCached = getChar(true);
-  if (lookCharLastValueCached == EOF) {
-    lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
+int Lexer::lookCharFromStream() {
+  const int c = getCharFromStream(true);
+  if (c == EOF) {
     return EOF;
+  }
+  if (spanPtr > spanStart) {
+    // the char came from a new span, just don't consume it
+    --spanPtr;
   } else {
-    return lookCharLastValueCached;
+    lookCharLastValueCached = c;
   }
+  return c;
 }
 
 Object Lexer::getObj(int objNum) {
+  // Leave the stream at the exact position after the object, callers
+  // may read from the stream directly between objects
+  Object obj = readObj(objNum);
+  syncSpan();
+  return obj;
+}
+
+Object Lexer::readObj(int objNum) {
   char *p;
   int c, c2;
   bool comment, neg, done, overflownInteger, overflownLongLong;
@@ -377,7 +405,7 @@ Object Lexer::getObj(int objNum) {
 	  // we are growing see if the document is not malformed and we are growing too much
 	  if (objNum > 0 && xref != nullptr)
 	  {
-	    int newObjNum = xref->getNumEntry(curStr.streamGetPos());
+	    int newObjNum = xref->getNumEntry(getPos());
 	    if (newObjNum != objNum)
 	    {
 	      error(errSyntaxError, getPos(), "Unterminated string");
@@ -590,6 +618,7 @@ Object Lexer::getObj(const char *cmdA, int objNum) {
   while (strcmp(cmdA, cmd1) && (objNum < 0 || (xref && xref->getNumEntry(getPos()) == objNum))) {
     while (1) {
       if ((c = getChar()) == EOF) {
+        syncSpan();
         return Object(objEOF);
       }
       if (comment) {
@@ -615,6 +644,7 @@ Object Lexer::getObj(const char *cmdA, int objNum) {
     *p = '\0';
   }
 
+  syncSpan();
   return Object(objCmd, tokBuf);
 }
 
@@ -68,16 +68,16 @@ public:
 
   // Get stream.
   Stream *getStream()
-    { return curStr.isStream() ? curStr.getStream() : nullptr; }
+    { syncSpan(); return curStr.isStream() ? curStr.getStream() : nullptr; }
 
   // Get current position in file.  This is only used for error
   // messages.
   Goffset getPos()
-    { return curStr.isStream() ? curStr.streamGetPos() : -1; }
+    { syncSpan(); return curStr.isStream() ? curStr.streamGetPos() : -1; }
 
   // Set position in file.
   void setPos(Goffset pos, int dir = 0)
-    { if (curStr.isStream()) curStr.streamSetPos(pos, dir); }
+    { syncSpan(); if (curStr.isStream()) curStr.streamSetPos(pos, dir); }
 
   // Returns true if <c> is a whitespace character.
   static bool isSpace(int c);
@@ -97,12 +97,35 @@ public:
 
 private:
 
-  int getChar(bool comesFromLook = false);
-  int lookChar();
+  Object readObj(int objNum);
+
+  int getChar(bool comesFromLook = false) {
+    if (LOOK_VALUE_NOT_CACHED != lookCharLastValueCached) {
+      const int c = lookCharLastValueCached;
+      lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
+      return c;
+    }
+    return spanPtr < spanEnd ? *spanPtr++ : getCharFromStream(comesFromLook);
+  }
+  int lookChar() {
+    if (LOOK_VALUE_NOT_CACHED != lookCharLastValueCached) {
+      return lookCharLastValueCached;
+    }
+    return spanPtr < spanEnd ? *spanPtr : lookCharFromStream();
+  }
+
+  int getCharFromStream(bool comesFromLook);
+  int lookCharFromStream();
+  void syncSpan();
 
   Array *streams;		// array of input streams
   int strPtr;			// index of current stream
   Object curStr;		// current stream
+  // Data of curStr we read from directly (see Stream::lookChars),
+  // the chars up to spanPtr haven't been consumed from curStr yet
+  const unsigned char *spanStart;
+  const unsigned char *spanPtr;
+  const unsigned char *spanEnd;
   bool freeArray;		// should lexer free the streams array?
   char tokBuf[tokBufSize];	// temporary token buffer
 
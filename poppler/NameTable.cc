@@ -0,0 +1,204 @@
+//========================================================================
+//
+// NameTable.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <atomic>
+#include <mutex>
+#include <string.h>
+#include "goo/gmem.h"
+#include "NameTable.h"
+
+// longest string that is interned; the lexer's token buffer holds
+// names up to 127 characters
+#define nameTableMaxLen 127
+
+// memory budget of the whole table
+#define nameTableMaxBytes (4 * 1024 * 1024)
+
+// size of the blocks interned strings are packed into
+#define nameTableBlockSize (16 * 1024)
+
+// number of independently locked shards (must be a power of 2)
+#define nameTableShards 16
+
+// size of the per-thread cache of recently interned strings (must be a
+// power of 2)
+#define nameTableRecentSize 256
+
+//------------------------------------------------------------------------
+
+// Each interned string is preceded by this header.
+struct NameHeader {
+  unsigned int hash;
+  unsigned int len;
+};
+
+struct NameShard {
+  std::mutex mutex;
+  const char **slots;		// open addressing table of strings
+  unsigned int size;		// number of slots (power of 2)
+  unsigned int count;		// number of used slots
+  char *block;			// free space in the current block
+  std::size_t blockLeft;
+};
+
+static std::atomic<std::size_t> nameTableBytes(0);
+
+static NameShard *getShards() {
+  // never freed: interned strings must stay valid until the process
+  // exits, including while static objects are destroyed
+  static NameShard *shards = new NameShard[nameTableShards]();
+
+  return shards;
+}
+
+static inline const NameHeader *getHeader(const char *s) {
+  return reinterpret_cast<const NameHeader *>(s - sizeof(NameHeader));
+}
+
+static inline bool nameMatches(const char *s, unsigned int hash,
+			       const char *name, std::size_t len) {
+  const NameHeader *hdr = getHeader(s);
+  return hdr->hash == hash && hdr->len == len && !memcmp(s, name, len);
+}
+
+// Reserve <bytes> bytes of the memory budget.
+static bool reserveBytes(std::size_t bytes) {
+  std::size_t used = nameTableBytes.load();
+  do {
+    if (used + bytes > nameTableMaxBytes) {
+      return false;
+    }
+  } while (!nameTableBytes.compare_exchange_weak(used, used + bytes));
+  return true;
+}
+
+// The shard's mutex must be locked.
+static bool growShard(NameShard *shard) {
+  unsigned int newSize, i, j;
+  const char **newSlots;
+
+  newSize = shard->size ? 2 * shard->size : 256;
+  if (!reserveBytes(newSize * sizeof(const char *))) {
+    return false;
+  }
+  newSlots = (const char **)gmallocn(newSize, sizeof(const char *));
+  memset(newSlots, 0, newSize * sizeof(const char *));
+  for (i = 0; i < shard->size; ++i) {
+    if (shard->slots[i]) {
+      j = (getHeader(shard->slots[i])->hash / nameTableShards) & (newSize - 1);
+      while (newSlots[j]) {
+	j = (j + 1) & (newSize - 1);
+      }
+      newSlots[j] = shard->slots[i];
+    }
+  }
+  gfree(shard->slots);
+  nameTableBytes -= shard->size * sizeof(const char *);
+  shard->slots = newSlots;
+  shard->size = newSize;
+  return true;
+}
+
+// The shard's mutex must be locked.
+static const char *addName(NameShard *shard, unsigned int hash,
+			   const char *name, std::size_t len) {
+  NameHeader *hdr;
+  std::size_t recSize;
+  char *s;
+
+  recSize = sizeof(NameHeader) + len + 1;
+  recSize = (recSize + alignof(NameHeader) - 1) & ~(alignof(NameHeader) - 1);
+  if (shard->blockLeft < recSize) {
+    if (!reserveBytes(nameTableBlockSize)) {
+      return nullptr;
+    }
+    shard->block = (char *)gmalloc(nameTableBlockSize);
+    shard->blockLeft = nameTableBlockSize;
+  }
+  hdr = reinterpret_cast<NameHeader *>(shard->block);
+  hdr->hash = hash;
+  hdr->len = (unsigned int)len;
+  s = shard->block + sizeof(NameHeader);
+  memcpy(s, name, len);
+  s[len] = '\0';
+  shard->block += recSize;
+  shard->blockLeft -= recSize;
+  return s;
+}
+
+//------------------------------------------------------------------------
+// NameTable
+//------------------------------------------------------------------------
+
+const char *NameTable::intern(const char *name) {
+  static thread_local const char *recent[nameTableRecentSize];
+  NameShard *shard;
+  const char *s;
+  unsigned int hash, i;
+  std::size_t len;
+
+  hash = NameTable::hash(name, &len);
+  if (len > nameTableMaxLen) {
+    return nullptr;
+  }
+
+  // most names repeat many times: look in this thread's cache first, to
+  // avoid taking the lock
+  const char *&recentSlot = recent[hash & (nameTableRecentSize - 1)];
+  if (recentSlot && nameMatches(recentSlot, hash, name, len)) {
+    return recentSlot;
+  }
+
+  shard = &getShards()[hash & (nameTableShards - 1)];
+  std::lock_guard<std::mutex> lock(shard->mutex);
+
+  if (shard->size) {
+    for (i = (hash / nameTableShards) & (shard->size - 1);
+	 (s = shard->slots[i]);
+	 i = (i + 1) & (shard->size - 1)) {
+      if (nameMatches(s, hash, name, len)) {
+	recentSlot = s;
+	return s;
+      }
+    }
+  }
+
+  // keep the table at most half full
+  if (2 * (shard->count + 1) > shard->size && !growShard(shard)) {
+    return nullptr;
+  }
+  if (!(s = addName(shard, hash, name, len))) {
+    return nullptr;
+  }
+  for (i = (hash / nameTableShards) & (shard->size - 1);
+       shard->slots[i];
+       i = (i + 1) & (shard->size - 1)) ;
+  shard->slots[i] = s;
+  ++shard->count;
+  recentSlot = s;
+  return s;
+}
+
+unsigned int NameTable::hash(const char *s, std::size_t *lenA) {
+  const unsigned char *p;
+  unsigned int h;
+
+  // FNV-1a
+  h = 2166136261U;
+  for (p = (const unsigned char *)s; *p; ++p) {
+    h = (h ^ *p) * 16777619U;
+  }
+  *lenA = p - (const unsigned char *)s;
+  return h;
+}
+
+std::size_t NameTable::getBytes() {
+  return nameTableBytes.load();
+}
@@ -0,0 +1,42 @@
+//========================================================================
+//
+// NameTable.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef NAMETABLE_H
+#define NAMETABLE_H
+
+#include <cstddef>
+
+//------------------------------------------------------------------------
+// NameTable
+//------------------------------------------------------------------------
+
+// Process-wide table of interned PDF names and content stream operators.
+// An interned string is stored once and never freed, so objName and
+// objCmd Objects can point at it instead of holding their own copy:
+// creating, copying and destroying them no longer allocates.  Interned
+// strings are packed into large blocks rather than allocated one by one.
+//
+// The table has a fixed memory budget.  Once it is used up (and for
+// unusually long names) intern() returns nullptr, and the caller has to
+// keep its own copy of the string.
+class NameTable {
+public:
+
+  // Return the interned copy of <name>, or nullptr if it can't be
+  // interned.
+  static const char *intern(const char *name);
+
+  // Hash function used for names, also by Dict.  Sets *<lenA> to the
+  // length of <s>.
+  static unsigned int hash(const char *s, std::size_t *lenA);
+
+  // Number of bytes used by the interned strings.
+  static std::size_t getBytes();
+};
+
+#endif
@@ -67,7 +67,9 @@ Object Object::copy() const {
     break;
   case objName:
   case objCmd:
-    obj.cString = copyString(cString);
+    if (ownCString) {
+      obj.cString = copyString(cString);
+    }
     break;
   case objArray:
     array->incRef();
@@ -85,6 +87,50 @@ Object Object::copy() const {
   return obj;
 }
 
+Object Object::deepCopy() const {
+  CHECK_NOT_DEAD;
+
+  switch (type) {
+  case objArray:
+    return array->deepCopy();
+  case objDict:
+    return Object(dict->deepCopy());
+  default:
+    return copy();
+  }
+}
+
+std::size_t Object::getMemoryUsage() const {
+  CHECK_NOT_DEAD;
+
+  std::size_t bytes = sizeof(Object);
+  int i;
+
+  switch (type) {
+  case objString:
+    bytes += string->getLength();
+    break;
+  case objName:
+  case objCmd:
+    bytes += strlen(cString) + 1;
+    break;
+  case objArray:
+    for (i = 0; i < arrayGetLength(); ++i) {
+      bytes += arrayGetNF(i).getMemoryUsage();
+    }
+    break;
+  case objDict:
+    for (i = 0; i < dictGetLength(); ++i) {
+      bytes += strlen(dictGetKey(i)) + 1;
+      bytes += dictGetValNF(i).getMemoryUsage();
+    }
+    break;
+  default:
+    break;
+  }
+  return bytes;
+}
+
 Object Object::fetch(XRef *xref, int recursion) const {
   CHECK_NOT_DEAD;
 
@@ -99,7 +145,9 @@ void Object::free() {
     break;
   case objName:
   case objCmd:
-    gfree(cString);
+    if (ownCString) {
+      gfree(const_cast<char *>(cString));
+    }
     break;
   case objArray:
     if (!array->decRef()) {
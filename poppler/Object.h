@@ -42,6 +42,7 @@
 #include "goo/GooString.h"
 #include "goo/GooLikely.h"
 #include "Error.h"
+#include "NameTable.h"
 
 #define OBJECT_TYPE_CHECK(wanted_type) \
     if (unlikely(type != wanted_type)) { \
@@ -169,7 +170,7 @@ public:
   explicit Object(GooString *stringA)
     { assert(stringA); type = objString; string = stringA; }
   Object(ObjType typeA, const char *stringA)
-    { assert(typeA == objName || typeA == objCmd); assert(stringA); type = typeA; cString = copyString(stringA); }
+    { assert(typeA == objName || typeA == objCmd); assert(stringA); type = typeA; setCString(stringA); }
   explicit Object(long long int64gA)
     { type = objInt64; int64g = int64gA; }
   explicit Object(Array *arrayA)
@@ -208,6 +209,14 @@ public:
   // Copy this to obj
   Object copy() const;
 
+  // Copy this to obj, including the contents of arrays and dicts, which
+  // copy() shares.  Streams are still shared.
+  Object deepCopy() const;
+
+  // Approximate memory used by the object, including the contents of
+  // arrays and dicts, but not those of streams.
+  std::size_t getMemoryUsage() const;
+
   // If object is a Ref, fetch and return the referenced object.
   // Otherwise, return a copy of the object.
   Object fetch(XRef *xref, int recursion = 0) const;
@@ -308,17 +317,28 @@ public:
   void print(FILE *f = stdout) const;
 
 private:
+  // Point cString at the interned copy of <s>, or at a private copy if
+  // it can't be interned.
+  void setCString(const char *s) {
+    cString = NameTable::intern(s);
+    ownCString = !cString;
+    if (ownCString) {
+      cString = copyString(s);
+    }
+  }
+
   // Free object contents.
   void free();
 
   ObjType type;			// object type
+  bool ownCString;		// cString is a private copy, not interned
   union {			// value for each type:
     bool booln;		//   boolean
     int intg;			//   integer
     long long int64g;           //   64-bit integer
     double real;		//   real
     GooString *string;		//   string
-    char *cString;		//   name or command, depending on objType
+    const char *cString;	//   name or command, depending on objType
     Array *array;		//   array
     Dict *dict;			//   dictionary
     Stream *stream;		//   stream
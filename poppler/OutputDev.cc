@@ -184,8 +184,13 @@ void OutputDev::opiEnd(GfxState *state, Dict *opiDict) {
 
 void OutputDev::startProfile() {
   profileHash.reset(new std::unordered_map<std::string, ProfileData>);
+  profileReport.reset(new ProfileReport);
 }
 
 std::unique_ptr<std::unordered_map<std::string, ProfileData>> OutputDev::endProfile() {
   return std::move(profileHash);
 }
+
+std::unique_ptr<ProfileReport> OutputDev::endProfileReport() {
+  return std::move(profileReport);
+}
@@ -122,6 +122,11 @@ public:
   // box is the crop box?
   virtual bool needClipToCropBox() { return false; }
 
+  // Is this device drawing one of several slices of a page that are
+  // drawn on other threads at the same time?  If so, the page's content
+  // stream is drawn without holding the page lock.
+  virtual bool drawsConcurrentSlice() { return false; }
+
   //----- initialization and control
 
   // Set default transform matrix.
@@ -344,6 +349,10 @@ public:
   void startProfile();
   std::unordered_map<std::string, ProfileData>* getProfileHash() const { return profileHash.get(); }
   std::unique_ptr<std::unordered_map<std::string, ProfileData>> endProfile();
+  // The breakdown by resource and nesting depth, which is collected
+  // from startProfile() on too; independent of endProfile().
+  ProfileReport *getProfileReport() const { return profileReport.get(); }
+  std::unique_ptr<ProfileReport> endProfileReport();
 
   //----- transparency groups and soft masks
   virtual bool checkTransparencyGroup(GfxState * /*state*/, bool /*knockout*/) { return true; }
@@ -374,6 +383,7 @@ private:
   double defCTM[6];		// default coordinate transform matrix
   double defICTM[6];		// inverse of default CTM
   std::unique_ptr<std::unordered_map<std::string, ProfileData>> profileHash;
+  std::unique_ptr<ProfileReport> profileReport;
 
 #ifdef USE_CMS
   PopplerCache<Ref, GfxICCBasedColorSpace> iccColorSpaceCache;
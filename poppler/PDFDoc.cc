@@ -61,6 +61,7 @@
 #include <stddef.h>
 #include <string.h>
 #include <time.h>
+#include <algorithm>
 #include <regex>
 #include <sys/stat.h>
 #include "goo/glibc.h"
@@ -81,6 +82,7 @@
 #include "Lexer.h"
 #include "Parser.h"
 #include "SecurityHandler.h"
+#include "CachedFile.h"
 #include "Decrypt.h"
 #include "Outline.h"
 #include "PDFDoc.h"
@@ -100,6 +102,9 @@
 #define xrefSearchSize 1024	// read this many bytes at end of file
 				//   to look for 'startxref'
 
+#define prefetchPagesDefault 2	// pages after the one asked for whose
+				//   data is loaded in the background
+
 //------------------------------------------------------------------------
 // PDFDoc
 //------------------------------------------------------------------------
@@ -121,6 +126,7 @@ void PDFDoc::init()
   startXRefPos = -1;
   secHdlr = nullptr;
   pageCache = nullptr;
+  prefetchPages = prefetchPagesDefault;
 }
 
 PDFDoc::PDFDoc()
@@ -165,8 +171,18 @@ PDFDoc::PDFDoc(const GooString *fileNameA, const GooString *ownerPassword,
     return;
   }
 
-  // create stream
-  str = new FileStream(file, 0, false, file->size(), Object(objNull));
+  // create stream; a mapped file is read without refilling small
+  // buffers on every seek (xref reconstruction, random page access)
+  Goffset mappedLength;
+  const char *mappedData = nullptr;
+  if (globalParams->getMapFiles()) {
+    mappedData = file->map(&mappedLength);
+  }
+  if (mappedData) {
+    str = new MappedFileStream(mappedData, mappedLength, Object(objNull));
+  } else {
+    str = new FileStream(file, 0, false, file->size(), Object(objNull));
+  }
 
   ok = setup(ownerPassword, userPassword);
 }
@@ -2119,6 +2135,30 @@ Page *PDFDoc::parsePage(int page)
                new PageAttrs(nullptr, pageDict), catalog->getForm());
 }
 
+// Start loading the data of <page> and of the next prefetchPages pages
+// in the background, so that a document read over the network takes a
+// few large requests per page rather than one per missing chunk.
+void PDFDoc::prefetchPageRanges(int page)
+{
+  std::vector<ByteRange> ranges;
+  std::vector<ByteRange> *pageRanges;
+  int lastPage;
+
+  if (str->getKind() != strCachedFile || prefetchPages < 0) {
+    return;
+  }
+  lastPage = std::min(page + prefetchPages, getNumPages());
+  for (int pg = page; pg <= lastPage; ++pg) {
+    if ((pageRanges = getHints()->getPageRanges(pg))) {
+      ranges.insert(ranges.end(), pageRanges->begin(), pageRanges->end());
+      delete pageRanges;
+    }
+  }
+  if (!ranges.empty()) {
+    static_cast<CachedFileStream *>(str)->getCachedFile()->prefetch(ranges);
+  }
+}
+
 Page *PDFDoc::getPage(int page)
 {
   if ((page < 1) || page > getNumPages()) return nullptr;
@@ -2132,6 +2172,7 @@ Page *PDFDoc::getPage(int page)
       }
     }
     if (!pageCache[page-1]) {
+      prefetchPageRanges(page);
       pageCache[page-1] = parsePage(page);
     }
     if (pageCache[page-1]) {
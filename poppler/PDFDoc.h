@@ -188,6 +188,12 @@ public:
   // Get page.
   Page *getPage(int page);
 
+  // Set the number of pages after the one asked for whose data
+  // getPage() starts loading in the background, when the document is
+  // linearized and read through a CachedFile.  Negative values turn the
+  // prefetching off.  Defaults to 2.
+  void setPrefetchPages(int nPages) { prefetchPages = nPages; }
+
   // Display a page.
   void displayPage(OutputDev *out, int page,
 		   double hDPI, double vDPI, int rotate,
@@ -376,6 +382,7 @@ private:
   void saveCompleteRewrite (OutStream* outStr);
 
   Page *parsePage(int page);
+  void prefetchPageRanges(int page);
 
   // Get hints.
   Hints *getHints();
@@ -421,6 +428,7 @@ private:
   Hints *hints;
   Outline *outline;
   Page **pageCache;
+  int prefetchPages;
 
   bool ok;
   int errCode;
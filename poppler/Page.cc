@@ -543,15 +543,29 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
 		  abortCheckCbk, abortCheckCbkData, localXRef);
 
   Object obj = contents.fetch(localXRef);
+
+  // When the bands of a page are drawn on several threads, the content
+  // stream only needs the page state fetched above, so the bands don't
+  // wait for each other. The resource dict is referenced here to keep it
+  // alive should a copyXRef display replace it meanwhile.
+  const bool concurrentSlice = !copyXRef && out->drawsConcurrentSlice();
+  Object resourcesRef;
+  if (concurrentSlice) {
+    resourcesRef = attrs->getResourceDictObject()->copy();
+    locker.unlock();
+  }
   if (!obj.isNull()) {
     gfx->saveState();
-    gfx->display(&obj);
+    gfx->display(&obj, true, getContentsRef());
     gfx->restoreState();
   } else {
     // empty pages need to call dump to do any setup required by the
     // OutputDev
     out->dump();
   }
+  if (concurrentSlice) {
+    locker.lock();
+  }
 
   // draw annotations
   annotList = getAnnots();
@@ -582,7 +596,7 @@ void Page::display(Gfx *gfx) {
   Object obj = contents.fetch(xref);
   if (!obj.isNull()) {
     gfx->saveState();
-    gfx->display(&obj);
+    gfx->display(&obj, true, getContentsRef());
     gfx->restoreState();
   }
 }
@@ -199,6 +199,11 @@ public:
   // Get contents.
   Object getContents() { return contents.fetch(xref); }
 
+  // Get the Ref the parsed contents are cached under: that of the
+  // contents object, or the page's own if the contents are a direct
+  // array.
+  Ref getContentsRef() const { return contents.isRef() ? contents.getRef() : pageRef; }
+
   // Get thumb.
   Object getThumb() { return thumb.fetch(xref); }
   bool loadThumb(unsigned char **data, int *width, int *height, int *rowstride);
@@ -14,50 +14,109 @@
 #ifndef POPPLER_CACHE_H
 #define POPPLER_CACHE_H
 
-#include <algorithm>
+#include <functional>
+#include <list>
 #include <memory>
+#include <unordered_map>
 #include <utility>
-#include <vector>
 
-template<typename Key, typename Item>
+// Least recently used cache owning its items.
+//
+// Lookups and insertions are O(1): entries live in a list ordered from
+// most to least recently used and are found through a hash index. The
+// cache is bounded by its number of entries and, optionally, by the
+// total size in bytes the caller reports for the items it puts.
+template<typename Key, typename Item, typename Hash = std::hash<Key>>
 class PopplerCache
 {
 public:
   PopplerCache(const PopplerCache &) = delete;
   PopplerCache& operator=(const PopplerCache &other) = delete;
 
-  PopplerCache(std::size_t cacheSizeA) { entries.reserve(cacheSizeA); }
+  // <maxBytesA> of 0 means the byte size of the items is not limited
+  PopplerCache(std::size_t cacheSizeA, std::size_t maxBytesA = 0) :
+    cacheSize{cacheSizeA}, maxBytes{maxBytesA} {}
 
   /* The item returned is owned by the cache */
   Item *lookup(const Key &key) {
-    if (!entries.empty() && entries.front().first == key) {
-      return entries.front().second.get();
+    auto it = index.find(key);
+    if (it == index.end()) {
+      ++misses;
+      return nullptr;
     }
 
-    for (auto it = entries.begin(); it != entries.end(); ++it) {
-      if (it->first == key) {
-	auto *item = it->second.get();
+    ++hits;
+    if (it->second != entries.begin()) {
+      entries.splice(entries.begin(), entries, it->second);
+    }
+    return it->second->item.get();
+  }
 
-	std::rotate(entries.begin(), it, std::next(it));
+  /* The item pointer ownership is taken by the cache. An item already
+     cached for the same key is replaced. */
+  void put(const Key &key, Item *item, std::size_t itemBytes = 0) {
+    remove(key);
 
-	return item;
-      }
-    }
+    entries.push_front(Entry{key, std::unique_ptr<Item>{item}, itemBytes});
+    index.emplace(key, entries.begin());
+    bytes += itemBytes;
 
-    return nullptr;
+    // never evict the item that was just put, even if it alone is over budget
+    evict(1);
   }
-    
-  /* The key and item pointers ownership is taken by the cache */
-  void put(const Key &key, Item *item) {
-    if (entries.size() == entries.capacity()) {
-      entries.pop_back();
+
+  // Drop the item cached for <key>, if any.
+  void remove(const Key &key) {
+    auto it = index.find(key);
+    if (it != index.end()) {
+      bytes -= it->second->bytes;
+      entries.erase(it->second);
+      index.erase(it);
     }
+  }
 
-    entries.emplace(entries.begin(), key, std::unique_ptr<Item>{item});
+  // <maxBytesA> of 0 means the byte size of the items is not limited
+  void setMaxBytes(std::size_t maxBytesA) {
+    maxBytes = maxBytesA;
+    evict(0);
   }
 
+  void clear() {
+    index.clear();
+    entries.clear();
+    bytes = 0;
+  }
+
+  std::size_t size() const { return entries.size(); }
+  std::size_t getMaxBytes() const { return maxBytes; }
+  std::size_t getBytes() const { return bytes; }
+  std::size_t getHits() const { return hits; }
+  std::size_t getMisses() const { return misses; }
+
 private:
-  std::vector<std::pair<Key, std::unique_ptr<Item>>> entries;
+  // Evict the least recently used items, keeping at least <keep> items.
+  void evict(std::size_t keep) {
+    while (entries.size() > keep &&
+	   (entries.size() > cacheSize || (maxBytes > 0 && bytes > maxBytes))) {
+      bytes -= entries.back().bytes;
+      index.erase(entries.back().key);
+      entries.pop_back();
+    }
+  }
+
+  struct Entry {
+    Key key;
+    std::unique_ptr<Item> item;
+    std::size_t bytes;
+  };
+
+  std::list<Entry> entries;	// most recently used first
+  std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+  std::size_t cacheSize;
+  std::size_t maxBytes;
+  std::size_t bytes = 0;
+  std::size_t hits = 0;
+  std::size_t misses = 0;
 };
 
 #endif
@@ -9,12 +9,28 @@
 
 #include <config.h>
 
+#include <algorithm>
+#include <math.h>
+#include <vector>
+#include "goo/gfile.h"
 #include "ProfileData.h"
 
+// upper bound of the first histogram bucket, in seconds
+#define profileDataBucketBase 1e-7
+
 //------------------------------------------------------------------------
 // ProfileData
 //------------------------------------------------------------------------
 
+static int getBucket (double elapsed) {
+	int i;
+
+	if (elapsed <= profileDataBucketBase)
+		return 0;
+	i = (int)(4 * log2 (elapsed / profileDataBucketBase)) + 1;
+	return std::min (i, profileDataBuckets - 1);
+}
+
 void
 ProfileData::addElement (double elapsed) {
 	if (count == 0) {
@@ -28,5 +44,179 @@ ProfileData::addElement (double elapsed) {
 	}
 	total += elapsed;
 	count ++;
+	buckets[getBucket (elapsed)] ++;
 }
 
+void
+ProfileData::merge (const ProfileData &data) {
+	int i;
+
+	if (data.count == 0)
+		return;
+	if (count == 0) {
+		min = data.min;
+		max = data.max;
+	} else {
+		min = std::min (min, data.min);
+		max = std::max (max, data.max);
+	}
+	total += data.total;
+	count += data.count;
+	for (i = 0; i < profileDataBuckets; ++i)
+		buckets[i] += data.buckets[i];
+}
+
+double
+ProfileData::getPercentile (double p) const {
+	double bound;
+	int target, sum, i;
+
+	if (count == 0)
+		return 0;
+	target = std::max ((int)ceil (p * count), 1);
+	sum = 0;
+	for (i = 0; i < profileDataBuckets - 1; ++i) {
+		sum += buckets[i];
+		if (sum >= target)
+			break;
+	}
+	bound = profileDataBucketBase * pow (2.0, i / 4.0);
+	return std::max (min, std::min (max, bound));
+}
+
+//------------------------------------------------------------------------
+// ProfileReport
+//------------------------------------------------------------------------
+
+bool
+ProfileReport::Key::operator== (const Key &key) const {
+	return refNum == key.refNum && refGen == key.refGen &&
+	       depth == key.depth && op == key.op;
+}
+
+std::size_t
+ProfileReport::KeyHash::operator() (const Key &key) const {
+	std::size_t h;
+
+	h = std::hash<std::string> () (key.op);
+	h = h * 31 + (std::size_t)key.refNum;
+	h = h * 31 + (std::size_t)key.refGen;
+	h = h * 31 + (std::size_t)key.depth;
+	return h;
+}
+
+void
+ProfileReport::addElement (const char *op, int refNum, int refGen, int depth,
+			   double elapsed) {
+	entries[Key{op, refNum, refGen, depth}].addElement (elapsed);
+}
+
+void
+ProfileReport::addStack (const std::string &stack, double selfTime) {
+	stacks[stack] += selfTime;
+}
+
+void
+ProfileReport::merge (const ProfileReport &report) {
+	for (const auto &entry : report.entries)
+		entries[entry.first].merge (entry.second);
+	for (const auto &stack : report.stacks)
+		stacks[stack.first] += stack.second;
+}
+
+static void writeJSONString (FILE *f, const std::string &s) {
+	fputc ('"', f);
+	for (unsigned char c : s) {
+		if (c == '"' || c == '\\')
+			fprintf (f, "\\%c", c);
+		else if (c < 0x20 || c >= 0x7f)
+			fprintf (f, "\\u%04x", c);
+		else
+			fputc (c, f);
+	}
+	fputc ('"', f);
+}
+
+static void writeJSONTimes (FILE *f, const ProfileData &data) {
+	fprintf (f, "\"count\": %d, \"total\": %.6f, \"min\": %.6f, \"max\": %.6f, "
+		 "\"p50\": %.6f, \"p90\": %.6f, \"p99\": %.6f",
+		 data.getCount (), data.getTotal () * 1000,
+		 data.getMin () * 1000, data.getMax () * 1000,
+		 data.getPercentile (0.5) * 1000,
+		 data.getPercentile (0.9) * 1000,
+		 data.getPercentile (0.99) * 1000);
+}
+
+bool
+ProfileReport::writeJSON (const char *fileName) const {
+	std::unordered_map<std::string, ProfileData> ops;
+	std::vector<std::pair<std::string, ProfileData>> opList;
+	std::vector<std::pair<Key, ProfileData>> entryList;
+	std::vector<std::pair<std::string, double>> stackList;
+	FILE *f;
+	size_t i;
+
+	if (!(f = openFile (fileName, "w")))
+		return false;
+
+	for (const auto &entry : entries)
+		ops[entry.first.op].merge (entry.second);
+	opList.assign (ops.begin (), ops.end ());
+	entryList.assign (entries.begin (), entries.end ());
+	stackList.assign (stacks.begin (), stacks.end ());
+
+	// slowest first
+	std::sort (opList.begin (), opList.end (), [] (const auto &a, const auto &b) {
+		return a.second.getTotal () > b.second.getTotal ();
+	});
+	std::sort (entryList.begin (), entryList.end (), [] (const auto &a, const auto &b) {
+		return a.second.getTotal () > b.second.getTotal ();
+	});
+	std::sort (stackList.begin (), stackList.end (), [] (const auto &a, const auto &b) {
+		return a.second > b.second;
+	});
+
+	fprintf (f, "{\n  \"unit\": \"ms\",\n  \"operators\": [");
+	for (i = 0; i < opList.size (); ++i) {
+		fprintf (f, "%s\n    {\"op\": ", i ? "," : "");
+		writeJSONString (f, opList[i].first);
+		fprintf (f, ", ");
+		writeJSONTimes (f, opList[i].second);
+		fprintf (f, "}");
+	}
+	fprintf (f, "\n  ],\n  \"resources\": [");
+	for (i = 0; i < entryList.size (); ++i) {
+		const Key &key = entryList[i].first;
+		fprintf (f, "%s\n    {\"op\": ", i ? "," : "");
+		writeJSONString (f, key.op);
+		if (key.refNum >= 0)
+			fprintf (f, ", \"ref\": \"%d %d R\"", key.refNum, key.refGen);
+		else
+			fprintf (f, ", \"ref\": null");
+		fprintf (f, ", \"depth\": %d, ", key.depth);
+		writeJSONTimes (f, entryList[i].second);
+		fprintf (f, "}");
+	}
+	fprintf (f, "\n  ],\n  \"stacks\": [");
+	for (i = 0; i < stackList.size (); ++i) {
+		fprintf (f, "%s\n    {\"stack\": ", i ? "," : "");
+		writeJSONString (f, stackList[i].first);
+		fprintf (f, ", \"self\": %.6f}", stackList[i].second * 1000);
+	}
+	fprintf (f, "\n  ]\n}\n");
+
+	fclose (f);
+	return true;
+}
+
+bool
+ProfileReport::writeFolded (const char *fileName) const {
+	FILE *f;
+
+	if (!(f = openFile (fileName, "w")))
+		return false;
+	for (const auto &stack : stacks)
+		fprintf (f, "%s %.0f\n", stack.first.c_str (), stack.second * 1e6);
+	fclose (f);
+	return true;
+}
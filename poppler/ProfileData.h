@@ -10,6 +10,14 @@
 #ifndef PROFILE_DATA_H
 #define PROFILE_DATA_H
 
+#include <cstddef>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+
+// number of histogram buckets, four per power of two above 100ns
+#define profileDataBuckets 128
+
 //------------------------------------------------------------------------
 // ProfileData
 //------------------------------------------------------------------------
@@ -18,15 +26,72 @@ class ProfileData {
 public:
   void addElement (double elapsed);
 
+  // Add the elements of <data>.
+  void merge (const ProfileData &data);
+
   int getCount () const { return count; }
   double getTotal () const { return total; }
-  double getMin () const { return max; }
+  double getMin () const { return min; }
   double getMax () const { return max; }
+
+  // Approximate <p>-th percentile (0 < <p> <= 1) of the elements; the
+  // elements are kept in a logarithmic histogram, so the result is
+  // within 19% of the exact value.
+  double getPercentile (double p) const;
+
 private:
-  int count = 0;      // size of <elems> array
-  double total = 0.0; // number of elements in array
-  double min = 0.0;   // reference count
-  double max = 0.0;   // reference count
+  int count = 0;      // number of elements
+  double total = 0.0; // sum of the elements
+  double min = 0.0;   // smallest element
+  double max = 0.0;   // largest element
+  int buckets[profileDataBuckets] = {}; // histogram of the elements
+};
+
+//------------------------------------------------------------------------
+// ProfileReport
+//------------------------------------------------------------------------
+
+// Operator timings broken down by the resource the operator works on
+// (the XObject drawn by Do, the font of Tf and of the text showing
+// operators) and by nesting depth: the operators of a form or a Type 3
+// glyph are one level deeper than the operator that draws it.  The self
+// time of each stack of nested operators is kept too, for flame graphs.
+class ProfileReport {
+public:
+
+  void addElement (const char *op, int refNum, int refGen, int depth,
+		   double elapsed);
+  void addStack (const std::string &stack, double selfTime);
+
+  // Add the timings of <report>.
+  void merge (const ProfileReport &report);
+
+  // Write the report as a JSON object with the timings, in
+  // milliseconds, of each operator ("operators"), of each operator,
+  // resource and depth ("resources") and of each stack ("stacks").
+  // Returns false if the file can't be written.
+  bool writeJSON (const char *fileName) const;
+
+  // Write the stacks in the "folded" format read by flamegraph.pl: one
+  // line per stack, with its self time in microseconds.
+  bool writeFolded (const char *fileName) const;
+
+private:
+
+  struct Key {
+    std::string op;
+    int refNum, refGen;	// -1 if there is no resource
+    int depth;
+
+    bool operator== (const Key &key) const;
+  };
+
+  struct KeyHash {
+    std::size_t operator() (const Key &key) const;
+  };
+
+  std::unordered_map<Key, ProfileData, KeyHash> entries;
+  std::unordered_map<std::string, double> stacks;
 };
 
 #endif
@@ -64,6 +64,7 @@
 #include "FontEncodingTables.h"
 #include "fofi/FoFiTrueType.h"
 #include "splash/SplashBitmap.h"
+#include "splash/SplashClip.h"
 #include "splash/SplashGlyphBitmap.h"
 #include "splash/SplashPattern.h"
 #include "splash/SplashScreen.h"
@@ -77,9 +78,14 @@
 #include "splash/Splash.h"
 #include "SplashOutputDev.h"
 #include <algorithm>
+#include <thread>
+#include <vector>
 
 static const double s_minLineWidth = 0.0;
 
+// bands thinner than this are not worth a thread of their own
+static const int s_minBandHeight = 64;
+
 static inline void convertGfxColor(SplashColorPtr dest,
                                    SplashColorMode colorMode,
                                    GfxColorSpace *colorSpace,
@@ -1284,6 +1290,9 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   transpGroupStack = nullptr;
   nestCount = 0;
   xref = nullptr;
+  bandBitmap = nullptr;
+  bandYMin = bandYMax = 0;
+  bandOk = false;
 }
 
 void SplashOutputDev::setupScreenParams(double hDPI, double vDPI) {
@@ -1373,7 +1382,14 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state, XRef *xrefA) {
     delete splash;
     splash = nullptr;
   }
-  if (!bitmap || w != bitmap->getWidth() || h != bitmap->getHeight()) {
+  if (bandBitmap) {
+    // draw into the page bitmap shared by the bands
+    if (bitmap != bandBitmap) {
+      delete bitmap;
+    }
+    bitmap = bandBitmap;
+    bandOk = w == bitmap->getWidth() && h == bitmap->getHeight();
+  } else if (!bitmap || w != bitmap->getWidth() || h != bitmap->getHeight()) {
     if (bitmap) {
       delete bitmap;
       bitmap = nullptr;
@@ -1430,11 +1446,15 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state, XRef *xrefA) {
   // the SA parameter supposedly defaults to false, but Acrobat
   // apparently hardwires it to true
   splash->setStrokeAdjust(true);
-  splash->clear(paperColor, 0);
+  if (bandBitmap) {
+    splash->clipToBand(bandYMin, bandYMax);
+  } else {
+    splash->clear(paperColor, 0);
+  }
 }
 
 void SplashOutputDev::endPage() {
-  if (colorMode != splashModeMono1 && !keepAlphaChannel) {
+  if (colorMode != splashModeMono1 && !keepAlphaChannel && !bandBitmap) {
     splash->compositeBackground(paperColor);
   }
 }
@@ -2837,6 +2857,9 @@ struct SplashOutImageData {
   ImageStream *maskStr;
   GfxImageColorMap *maskColorMap;
   SplashColor matteColor;
+  const unsigned char *cachedRows = nullptr; // rows from the image cache
+  unsigned char *recordRows = nullptr;	// rows to be put in the cache
+  int rowSize = 0;			// bytes per cached row
 };
 
 #ifdef USE_CMS
@@ -3022,6 +3045,24 @@ bool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
       }
     }
   }
+  if (imgData->recordRows) {
+    memcpy(imgData->recordRows + (size_t)imgData->y * imgData->rowSize,
+	   colorLine, imgData->rowSize);
+  }
+  ++imgData->y;
+  return true;
+}
+
+bool SplashOutputDev::cachedImageSrc(void *data, SplashColorPtr colorLine,
+				     unsigned char * /*alphaLine*/) {
+  SplashOutImageData *imgData = (SplashOutImageData *)data;
+
+  if (imgData->y == imgData->height) {
+    return false;
+  }
+  memcpy(colorLine,
+	 imgData->cachedRows + (size_t)imgData->y * imgData->rowSize,
+	 imgData->rowSize);
   ++imgData->y;
   return true;
 }
@@ -3313,6 +3354,134 @@ bool SplashOutputDev::tilingBitmapSrc(void *data, SplashColorPtr colorLine,
   return true;
 }
 
+// Get the part of a <width> x <height> image, drawn with <mat>, that is
+// inside the rectangle of <clip>, in image pixels.  The margin covers
+// the pixels the image scaling filters read around a visible pixel.
+// Returns false if <mat> is singular.
+static bool getImageClipRegion(SplashClip *clip, const SplashCoord *mat,
+			       int width, int height,
+			       int *x0, int *y0, int *x1, int *y1) {
+  SplashCoord det, dx, dy, u, v, uMin, uMax, vMin, vMax;
+  int i;
+
+  det = mat[0] * mat[3] - mat[1] * mat[2];
+  if (fabs(det) < 1e-6) {
+    return false;
+  }
+  uMin = vMin = 1e10;
+  uMax = vMax = -1e10;
+  for (i = 0; i < 4; ++i) {
+    dx = ((i & 1) ? clip->getXMaxI() + 1 : clip->getXMinI()) - mat[4];
+    dy = ((i & 2) ? clip->getYMaxI() + 1 : clip->getYMinI()) - mat[5];
+    u = (mat[3] * dx - mat[2] * dy) / det;
+    v = (mat[0] * dy - mat[1] * dx) / det;
+    uMin = std::min(uMin, u);
+    uMax = std::max(uMax, u);
+    vMin = std::min(vMin, v);
+    vMax = std::max(vMax, v);
+  }
+  *x0 = (int)std::max(floor(uMin * width) - 2, 0.0);
+  *y0 = (int)std::max(floor(vMin * height) - 2, 0.0);
+  *x1 = (int)std::min(ceil(uMax * width) + 2, (double)width);
+  *y1 = (int)std::min(ceil(vMax * height) + 2, (double)height);
+  return true;
+}
+
+// Checks if <cs1> and <cs2> are made of the same color space families.
+static bool sameColorSpaceModes(GfxColorSpace *cs1, GfxColorSpace *cs2) {
+  if (!cs1 || !cs2 || cs1->getMode() != cs2->getMode()) {
+    return false;
+  }
+  switch (cs1->getMode()) {
+  case csICCBased:
+    return sameColorSpaceModes(((GfxICCBasedColorSpace *)cs1)->getAlt(),
+			       ((GfxICCBasedColorSpace *)cs2)->getAlt());
+  case csIndexed:
+    return sameColorSpaceModes(((GfxIndexedColorSpace *)cs1)->getBase(),
+			       ((GfxIndexedColorSpace *)cs2)->getBase());
+  case csSeparation:
+    return sameColorSpaceModes(((GfxSeparationColorSpace *)cs1)->getAlt(),
+			       ((GfxSeparationColorSpace *)cs2)->getAlt());
+  case csDeviceN:
+    return sameColorSpaceModes(((GfxDeviceNColorSpace *)cs1)->getAlt(),
+			       ((GfxDeviceNColorSpace *)cs2)->getAlt());
+  default:
+    return true;
+  }
+}
+
+// Returns the image cache of the document if the decoded image can be
+// cached, and sets *<key>.  The image is identified by its XObject, the
+// size it is decoded to and the parameters of its color conversion.
+// The color space of the XObject may depend on the resources it is drawn
+// with: a name may refer to a color space resource, and the device color
+// spaces are replaced by DefaultGray, DefaultRGB and DefaultCMYK if the
+// resources have them.  The image is only cached if its color space is
+// the one its dictionary describes on its own.  ICC transforms and the
+// DeviceN separation mapping can change from one use of the image to the
+// next, so those images are not cached either.
+GfxImageCache *SplashOutputDev::getImageCache(GfxState *state, Object *ref,
+					      Stream *str,
+					      GfxImageColorMap *colorMap,
+					      int width, int height,
+					      GfxImageCacheKey *key) {
+  GfxImageCache *imageCache;
+  int nComps, i;
+
+  if (!ref || !ref->isRef() || !doc || doc->getXRef()->isModified() ||
+      colorMode == splashModeDeviceN8 || width <= 0 || height <= 0) {
+    return nullptr;
+  }
+#ifdef USE_CMS
+  if (colorMap->getColorSpace()->getMode() == csICCBased) {
+    return nullptr;
+  }
+#endif
+  Dict *dict = str->getDict();
+  if (dict) {
+    Object csObj = dict->lookup("ColorSpace");
+    if (csObj.isNull()) {
+      csObj = dict->lookup("CS");
+    }
+    if (csObj.isName() && !csObj.isName("DeviceGray") && !csObj.isName("G") &&
+	!csObj.isName("DeviceRGB") && !csObj.isName("RGB") &&
+	!csObj.isName("DeviceCMYK") && !csObj.isName("CMYK")) {
+      return nullptr;
+    }
+    if (!csObj.isNull()) {
+      // parsed without resources: no color space lookup, no defaults
+      GfxColorSpace *ownColorSpace = GfxColorSpace::parse(nullptr, &csObj, this, state);
+      bool same = sameColorSpaceModes(ownColorSpace, colorMap->getColorSpace());
+      delete ownColorSpace;
+      if (!same) {
+	return nullptr;
+      }
+    }
+  }
+
+  nComps = splashColorModeNComps[colorMode == splashModeMono1 ? splashModeMono8
+							      : colorMode];
+  imageCache = doc->getCatalog()->getImageCache();
+  if (width > INT_MAX / nComps ||
+      !imageCache->accepts((size_t)width * nComps * height)) {
+    return nullptr;
+  }
+
+  key->ref = ref->getRef();
+  key->width = width;
+  key->height = height;
+  key->mode = colorMode;
+  key->csMode = colorMap->getColorSpace()->getMode();
+  key->nComps = colorMap->getNumPixelComps();
+  key->bits = colorMap->getBits();
+  key->decode.resize(2 * key->nComps);
+  for (i = 0; i < key->nComps; ++i) {
+    key->decode[2 * i] = colorMap->getDecodeLow(i);
+    key->decode[2 * i + 1] = colorMap->getDecodeHigh(i);
+  }
+  return imageCache;
+}
+
 void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
 				int width, int height,
 				GfxImageColorMap *colorMap,
@@ -3330,6 +3499,10 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   GfxColor deviceN;
   unsigned char pix;
   int n, i;
+  GfxImageCache *imageCache = nullptr;
+  GfxImageCacheKey cacheKey;
+  std::shared_ptr<const GfxCachedImage> cachedImage;
+  std::shared_ptr<GfxCachedImage> recordImage;
 
   const double *ctm = state->getCTM();
   for (i = 0; i < 6; ++i) {
@@ -3342,10 +3515,58 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
-  imgData.imgStr = new ImageStream(str, width,
-				   colorMap->getNumPixelComps(),
-				   colorMap->getBits());
-  imgData.imgStr->reset();
+  if (colorMode == splashModeMono1) {
+    srcMode = splashModeMono8;
+  } else {
+    srcMode = colorMode;
+  }
+
+  // an image drawn much smaller than its size, as in thumbnails, can be
+  // decoded at a lower resolution by some filters (DCT, JPX); keep at
+  // least twice the drawn size, so that the box filter scaling it down
+  // still averages several pixels; and some filters (JPX) can skip the
+  // parts of the image outside the clip rectangle, as in zoomed views
+  // and bands
+  if (!inlineImg) {
+    int x0, y0, x1, y1;
+
+    str->setReducedSize(&width, &height,
+			2 * (int)ceil(sqrt(ctm[0] * ctm[0] + ctm[1] * ctm[1])),
+			2 * (int)ceil(sqrt(ctm[2] * ctm[2] + ctm[3] * ctm[3])));
+
+    // images shared by several pages or drawn several times are only
+    // decoded once; an image only partly decoded can't be cached
+    if (!maskColors &&
+	(imageCache = getImageCache(state, ref, str, colorMap, width, height,
+				    &cacheKey))) {
+      cachedImage = imageCache->lookup(cacheKey);
+    }
+    if (!cachedImage &&
+	getImageClipRegion(splash->getClip(), mat, width, height,
+			   &x0, &y0, &x1, &y1) &&
+	str->setDecodeRegion(x0, y0, x1, y1) &&
+	(x0 > 0 || y0 > 0 || x1 < width || y1 < height)) {
+      imageCache = nullptr;
+    }
+  }
+
+  if (cachedImage) {
+    imgData.imgStr = nullptr;
+    imgData.cachedRows = cachedImage->rows.data();
+    imgData.rowSize = cachedImage->rowSize;
+  } else {
+    imgData.imgStr = new ImageStream(str, width,
+				     colorMap->getNumPixelComps(),
+				     colorMap->getBits());
+    imgData.imgStr->reset();
+    if (imageCache) {
+      recordImage = std::make_shared<GfxCachedImage>();
+      recordImage->rowSize = width * splashColorModeNComps[srcMode];
+      recordImage->rows.resize((size_t)recordImage->rowSize * height);
+      imgData.recordRows = recordImage->rows.data();
+      imgData.rowSize = recordImage->rowSize;
+    }
+  }
   imgData.colorMap = colorMap;
   imgData.maskColors = maskColors;
   imgData.colorMode = colorMode;
@@ -3430,11 +3651,6 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   setOverprintMask(colorMap->getColorSpace(), state->getFillOverprint(),
 		   state->getOverprintMode(), nullptr, grayIndexed);
 
-  if (colorMode == splashModeMono1) {
-    srcMode = splashModeMono8;
-  } else {
-    srcMode = colorMode;
-  }
 #ifdef USE_CMS
   src = maskColors ? &alphaImageSrc : useIccImageSrc(&imgData) ? &iccImageSrc : &imageSrc;
   tf = maskColors == nullptr && useIccImageSrc(&imgData) ? &iccTransform : nullptr;
@@ -3442,6 +3658,9 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   src = maskColors ? &alphaImageSrc : &imageSrc;
   tf = nullptr;
 #endif
+  if (cachedImage) {
+    src = &cachedImageSrc;
+  }
   splash->drawImage(src, tf, &imgData, srcMode, maskColors ? true : false,
 		    width, height, mat, interpolate);
   if (inlineImg) {
@@ -3451,9 +3670,16 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
     }
   }
 
+  // Splash may not read all the rows, e.g. if the image is clipped out
+  if (recordImage && imgData.y == height) {
+    imageCache->put(cacheKey, std::move(recordImage));
+  }
+
   gfree(imgData.lookup);
-  delete imgData.imgStr;
-  str->close();
+  if (imgData.imgStr) {
+    delete imgData.imgStr;
+    str->close();
+  }
 }
 
 struct SplashOutMaskedImageData {
@@ -3946,6 +4172,34 @@ bool SplashOutputDev::checkTransparencyGroup(GfxState *state, bool knockout) {
   return transpGroupStack != nullptr && transpGroupStack->shape != nullptr;
 }
 
+// Copy the rows [yMin, yMax) of <src>, clearing the others.
+static SplashBitmap *copyBandRows(SplashBitmap *src, int yMin, int yMax) {
+  SplashBitmap *dest;
+  int y;
+
+  dest = new SplashBitmap(src->getWidth(), src->getHeight(), src->getRowPad(),
+			  src->getMode(), src->getAlphaPtr() != nullptr,
+			  src->getRowSize() >= 0, src->getSeparationList());
+  const size_t rowBytes = abs(src->getRowSize());
+  for (y = 0; y < src->getHeight(); ++y) {
+    SplashColorPtr row = dest->getDataPtr() + (ptrdiff_t)y * dest->getRowSize();
+    if (y >= yMin && y < yMax) {
+      memcpy(row, src->getDataPtr() + (ptrdiff_t)y * src->getRowSize(), rowBytes);
+    } else {
+      memset(row, 0, rowBytes);
+    }
+    if (dest->getAlphaPtr()) {
+      unsigned char *alphaRow = dest->getAlphaPtr() + (size_t)y * src->getWidth();
+      if (y >= yMin && y < yMax) {
+	memcpy(alphaRow, src->getAlphaPtr() + (size_t)y * src->getWidth(), src->getWidth());
+      } else {
+	memset(alphaRow, 0, src->getWidth());
+      }
+    }
+  }
+  return dest;
+}
+
 void SplashOutputDev::beginTransparencyGroup(GfxState *state, const double *bbox,
 					     GfxColorSpace *blendingColorSpace,
 					     bool isolated, bool knockout,
@@ -4026,7 +4280,13 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, const double *bbox
   transpGroup->ty = ty;
   transpGroup->blendingColorSpace = blendingColorSpace;
   transpGroup->isolated = isolated;
-  transpGroup->shape = (knockout && !isolated) ? SplashBitmap::copy(bitmap) : nullptr;
+  if (knockout && !isolated) {
+    transpGroup->shape = bitmap == bandBitmap ?
+                           copyBandRows(bitmap, bandYMin, bandYMax) :
+                           SplashBitmap::copy(bitmap);
+  } else {
+    transpGroup->shape = nullptr;
+  }
   transpGroup->knockout = (knockout && isolated);
   transpGroup->knockoutOpacity = 1.0;
   transpGroup->next = transpGroupStack;
@@ -4093,7 +4353,18 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, const double *bbox
       (transpGroup->next != nullptr && transpGroup->next->shape != nullptr) ? transpGroup->next->tx + tx : tx;
     int shapeTy = (knockout) ? ty :
       (transpGroup->next != nullptr && transpGroup->next->shape != nullptr) ? transpGroup->next->ty + ty : ty;
-    splash->blitTransparent(transpGroup->origBitmap, tx, ty, 0, 0, w, h);
+    if (transpGroup->origBitmap == bandBitmap) {
+      // other threads draw the rows outside of this band
+      int y0 = std::max(ty, bandYMin);
+      int y1 = std::min(ty + h, bandYMax);
+      splashClearColor(color);
+      splash->clear(color, 0);
+      if (y0 < y1) {
+	splash->blitTransparent(transpGroup->origBitmap, tx, y0, 0, y0 - ty, w, y1 - y0);
+      }
+    } else {
+      splash->blitTransparent(transpGroup->origBitmap, tx, ty, 0, 0, w, h);
+    }
     splash->setInNonIsolatedGroup(shape, shapeTx, shapeTy);
   }
   transpGroup->tBitmap = bitmap;
@@ -4310,6 +4581,124 @@ SplashBitmap *SplashOutputDev::takeBitmap() {
   return ret;
 }
 
+SplashOutputDev *SplashOutputDev::createBandDev(PDFDoc *docA) {
+  SplashOutputDev *dev;
+
+  dev = new SplashOutputDev(colorMode, bitmapRowPad, reverseVideo,
+			    paperColor, bitmapTopDown,
+			    splash->getThinLineMode(), overprintPreview);
+  dev->keepAlphaChannel = keepAlphaChannel;
+  dev->bitmapUpsideDown = bitmapUpsideDown;
+  dev->skipHorizText = skipHorizText;
+  dev->skipRotatedText = skipRotatedText;
+  dev->setFontAntialias(fontAntialias);
+  dev->setVectorAntialias(vectorAntialias);
+  dev->setFreeTypeHinting(enableFreeTypeHinting, enableSlightHinting);
+  dev->startDoc(docA);
+  return dev;
+}
+
+void SplashOutputDev::displayPageSliceBands(PDFDoc *docA, int page,
+					    double hDPI, double vDPI,
+					    int rotate, bool useMediaBox,
+					    bool crop, bool printing,
+					    int sliceX, int sliceY,
+					    int sliceW, int sliceH,
+					    int nThreads) {
+  SplashBitmap *pageBitmap;
+  bool ok;
+  int nBands, i;
+
+  // The bands are drawn with the transform of the whole slice, clipped
+  // to their rows of a shared bitmap, so that every pixel is computed
+  // exactly as in a single pass. The dither screen of 1-bit bitmaps,
+  // the spot color list of DeviceN bitmaps and the thin line adjustment
+  // depend on more than the rows of a band, so those are drawn in one
+  // piece.
+  nBands = std::min(nThreads, sliceH / s_minBandHeight);
+  pageBitmap = nullptr;
+  if (nBands >= 2 && sliceW > 0 &&
+      colorMode != splashModeMono1 && colorMode != splashModeDeviceN8 &&
+      splash->getThinLineMode() == splashThinLineDefault) {
+    pageBitmap = new SplashBitmap(sliceW, sliceH, bitmapRowPad, colorMode,
+				  true, bitmapTopDown);
+    if (!pageBitmap->getDataPtr()) {
+      delete pageBitmap;
+      pageBitmap = nullptr;
+    }
+  }
+  if (!pageBitmap) {
+    docA->displayPageSlice(this, page, hDPI, vDPI, rotate, useMediaBox,
+			   crop, printing, sliceX, sliceY, sliceW, sliceH);
+    return;
+  }
+
+  // the bands' startPage() leave the shared bitmap alone
+  Splash *clearSplash = new Splash(pageBitmap, vectorAntialias, &screenParams);
+  clearSplash->clear(paperColor, 0);
+  delete clearSplash;
+
+  std::vector<SplashOutputDev *> devs(nBands);
+  std::vector<std::thread> threads;
+  for (i = 0; i < nBands; ++i) {
+    devs[i] = i == 0 ? this : createBandDev(docA);
+    devs[i]->bandBitmap = pageBitmap;
+    devs[i]->bandYMin = (int)((long long)sliceH * i / nBands);
+    devs[i]->bandYMax = (int)((long long)sliceH * (i + 1) / nBands);
+    devs[i]->bandOk = false;
+  }
+
+  // this thread draws the first band
+  for (i = nBands - 1; i >= 0; --i) {
+    SplashOutputDev *dev = devs[i];
+    auto drawBand = [=] {
+      docA->displayPageSlice(dev, page, hDPI, vDPI, rotate, useMediaBox,
+			     crop, printing, sliceX, sliceY, sliceW, sliceH);
+    };
+    if (i > 0) {
+      threads.emplace_back(drawBand);
+    } else {
+      drawBand();
+    }
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  ok = true;
+  for (i = 0; i < nBands; ++i) {
+    ok = ok && devs[i]->bandOk;
+    devs[i]->bandBitmap = nullptr;
+    if (i > 0) {
+      if (devs[i]->bitmap == pageBitmap) {
+	devs[i]->bitmap = nullptr;
+      }
+      delete devs[i];
+    }
+  }
+
+  if (!ok) {
+    // the page size did not come out as the slice size, which should
+    // not happen
+    if (bitmap != pageBitmap) {
+      delete pageBitmap;
+    }
+    docA->displayPageSlice(this, page, hDPI, vDPI, rotate, useMediaBox,
+			   crop, printing, sliceX, sliceY, sliceW, sliceH);
+    return;
+  }
+
+  // drop the band clip and finish the page like endPage() does
+  SplashThinLineMode thinLineMode = splash->getThinLineMode();
+  delete splash;
+  splash = new Splash(bitmap, vectorAntialias, &screenParams);
+  splash->setThinLineMode(thinLineMode);
+  splash->setMinLineWidth(s_minLineWidth);
+  if (!keepAlphaChannel) {
+    splash->compositeBackground(paperColor);
+  }
+}
+
 void SplashOutputDev::getModRegion(int *xMin, int *yMin,
 				   int *xMax, int *yMax) {
   splash->getModRegion(xMin, yMin, xMax, yMax);
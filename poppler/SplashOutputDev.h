@@ -50,6 +50,8 @@ class T3FontCache;
 struct T3FontCacheTag;
 struct T3GlyphStack;
 struct SplashTransparencyGroup;
+class GfxImageCache;
+struct GfxImageCacheKey;
 
 //------------------------------------------------------------------------
 // Splash dynamic pattern
@@ -224,6 +226,9 @@ public:
   // text in Type 3 fonts will be drawn with drawChar/drawString.
   bool interpretType3Chars() override { return true; }
 
+  // Is this device drawing a band for displayPageSliceBands()?
+  bool drawsConcurrentSlice() override { return bandBitmap != nullptr; }
+
   //----- initialization and control
 
   // Start a page.
@@ -358,6 +363,18 @@ public:
   // caller.
   SplashBitmap *takeBitmap();
 
+  // Draw a slice of a page like PDFDoc::displayPageSlice(), splitting
+  // it into up to <nThreads> horizontal bands of this device's bitmap.
+  // Each band is drawn by a thread of its own on a copy of this device
+  // and the result is the same as drawing the slice in one piece, which
+  // is what happens for 1-bit and DeviceN bitmaps, with a thin line mode
+  // and for slices too thin to split.
+  void displayPageSliceBands(PDFDoc *docA, int page,
+			     double hDPI, double vDPI, int rotate,
+			     bool useMediaBox, bool crop, bool printing,
+			     int sliceX, int sliceY, int sliceW, int sliceH,
+			     int nThreads);
+
   // Set this flag to true to generate an upside-down bitmap (useful
   // for Windows BMP files).
   void setBitmapUpsideDown(bool f) { bitmapUpsideDown = f; }
@@ -397,6 +414,7 @@ private:
   bool univariateShadedFill(GfxState *state, SplashUnivariatePattern *pattern, double tMin, double tMax);
 
   void setupScreenParams(double hDPI, double vDPI);
+  SplashOutputDev *createBandDev(PDFDoc *docA);
   SplashPattern *getColor(GfxGray gray);
   SplashPattern *getColor(GfxRGB *rgb);
   SplashPattern *getColor(GfxCMYK *cmyk);
@@ -415,8 +433,13 @@ private:
 			unsigned char *alphaLine);
 #endif
   static bool imageMaskSrc(void *data, SplashColorPtr line);
+  GfxImageCache *getImageCache(GfxState *state, Object *ref, Stream *str,
+			       GfxImageColorMap *colorMap, int width, int height,
+			       GfxImageCacheKey *key);
   static bool imageSrc(void *data, SplashColorPtr colorLine,
 			unsigned char *alphaLine);
+  static bool cachedImageSrc(void *data, SplashColorPtr colorLine,
+			     unsigned char *alphaLine);
   static bool alphaImageSrc(void *data, SplashColorPtr line,
 			     unsigned char *alphaLine);
   static bool maskedImageSrc(void *data, SplashColorPtr line,
@@ -448,6 +471,10 @@ private:
   Splash *splash;
   SplashFontEngine *fontEngine;
 
+  SplashBitmap *bandBitmap;	// page bitmap shared with other bands
+  int bandYMin, bandYMax;	// rows of the band drawn by this device
+  bool bandOk;			// set if the page matched bandBitmap
+
   T3FontCache *			// Type 3 font cache
     t3FontCache[splashOutT3FontCacheSize];
   int nT3Fonts;			// number of valid entries in t3FontCache
@@ -53,6 +53,10 @@
 #endif
 #include <string.h>
 #include <ctype.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "goo/gmem.h"
 #include "goo/gfile.h"
 #include "poppler-config.h"
@@ -107,8 +111,15 @@ int Stream::getChars(int nChars, unsigned char *buffer) {
   return 0;
 }
 
-void Stream::getRawChars(int nChars, int *buffer) {
+int Stream::getRawChars(int nChars, unsigned char *buffer) {
   error(errInternal, -1, "Internal: called getRawChars() on non-predictor stream");
+  return 0;
+}
+
+void Stream::skipChars(int nChars) {
+  for (int i = 0; i < nChars; ++i) {
+    getChar();
+  }
 }
 
 char *Stream::getLine(char *buf, int size) {
@@ -558,6 +569,8 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   nComps = nCompsA;
   nBits = nBitsA;
   predLine = nullptr;
+  prevLine = nullptr;
+  rawLine = nullptr;
   ok = false;
 
   nVals = width * nComps;
@@ -572,6 +585,9 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   rowBytes = ((nVals * nBits + 7) >> 3) + pixBytes;
   predLine = (unsigned char *)gmalloc(rowBytes);
   memset(predLine, 0, rowBytes);
+  prevLine = (unsigned char *)gmalloc(rowBytes);
+  memset(prevLine, 0, rowBytes);
+  rawLine = (unsigned char *)gmalloc(rowBytes - pixBytes);
   predIdx = rowBytes;
 
   ok = true;
@@ -579,6 +595,8 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(prevLine);
+  gfree(rawLine);
 }
 
 int StreamPredictor::lookChar() {
@@ -620,11 +638,141 @@ int StreamPredictor::getChars(int nChars, unsigned char *buffer) {
   return n;
 }
 
+// The PNG predictors below decode the <n> bytes of <line> from the raw
+// bytes in <raw> and the previous line in <prev>. The <bpp> bytes in
+// front of <line> and <prev> are zero, which stands for the missing
+// left neighbours of the first pixel.
+
+#ifdef __SSE2__
+
+static inline __m128i loadPixel(const unsigned char *p) {
+  int v;
+  memcpy(&v, p, 4);
+  return _mm_cvtsi32_si128(v);
+}
+
+static inline void storePixel(unsigned char *p, __m128i v) {
+  const int x = _mm_cvtsi128_si32(v);
+  memcpy(p, &x, 4);
+}
+
+#endif
+
+static void pngPredictUp(unsigned char *line, const unsigned char *prev,
+			 const unsigned char *raw, int n) {
+  int i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16) {
+    const __m128i b = _mm_loadu_si128((const __m128i *)(prev + i));
+    const __m128i x = _mm_loadu_si128((const __m128i *)(raw + i));
+    _mm_storeu_si128((__m128i *)(line + i), _mm_add_epi8(b, x));
+  }
+#endif
+  for (; i < n; ++i) {
+    line[i] = prev[i] + raw[i];
+  }
+}
+
+static void pngPredictSub(unsigned char *line, const unsigned char *raw,
+			  int n, int bpp) {
+  int i = 0;
+
+#ifdef __SSE2__
+  // one 3 or 4 byte pixel per step, the byte stored past a 3 byte pixel
+  // is overwritten by the next one
+  if (bpp == 3 || bpp == 4) {
+    __m128i a = loadPixel(line - bpp);
+    for (; i + 4 <= n; i += bpp) {
+      a = _mm_add_epi8(a, loadPixel(raw + i));
+      storePixel(line + i, a);
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    line[i] = line[i - bpp] + raw[i];
+  }
+}
+
+static void pngPredictAverage(unsigned char *line, const unsigned char *prev,
+			      const unsigned char *raw, int n, int bpp) {
+  int i = 0;
+
+#ifdef __SSE2__
+  if (bpp == 3 || bpp == 4) {
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = loadPixel(line - bpp);
+    for (; i + 4 <= n; i += bpp) {
+      const __m128i b = loadPixel(prev + i);
+      // _mm_avg_epu8 rounds up, PNG rounds down
+      __m128i avg = _mm_avg_epu8(a, b);
+      avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(avg, loadPixel(raw + i));
+      storePixel(line + i, a);
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    line[i] = ((line[i - bpp] + prev[i]) >> 1) + raw[i];
+  }
+}
+
+static void pngPredictPaeth(unsigned char *line, const unsigned char *prev,
+			    const unsigned char *raw, int n, int bpp) {
+  int i = 0;
+
+#ifdef __SSE2__
+  if (bpp == 3 || bpp == 4) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = _mm_unpacklo_epi8(loadPixel(line - bpp), zero);
+    __m128i c = _mm_unpacklo_epi8(loadPixel(prev - bpp), zero);
+    for (; i + 4 <= n; i += bpp) {
+      const __m128i b = _mm_unpacklo_epi8(loadPixel(prev + i), zero);
+      // p = a + b - c, so p - a = b - c, p - b = a - c and
+      // p - c = (b - c) + (a - c)
+      __m128i pa = _mm_sub_epi16(b, c);
+      __m128i pb = _mm_sub_epi16(a, c);
+      __m128i pc = _mm_add_epi16(pa, pb);
+      pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+      pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+      pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+      const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      // ties prefer a, then b
+      const __m128i useA = _mm_cmpeq_epi16(smallest, pa);
+      const __m128i useB = _mm_andnot_si128(useA, _mm_cmpeq_epi16(smallest, pb));
+      const __m128i useC = _mm_andnot_si128(_mm_or_si128(useA, useB),
+					     _mm_set1_epi16(-1));
+      __m128i pred = _mm_or_si128(_mm_and_si128(useA, a),
+				  _mm_or_si128(_mm_and_si128(useB, b),
+					       _mm_and_si128(useC, c)));
+      pred = _mm_packus_epi16(pred, pred);
+      const __m128i x = _mm_add_epi8(pred, loadPixel(raw + i));
+      storePixel(line + i, x);
+      a = _mm_unpacklo_epi8(x, zero);
+      c = b;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    const int left = line[i - bpp];
+    const int up = prev[i];
+    const int upLeft = prev[i - bpp];
+    const int p = left + up - upLeft;
+    const int pa = abs(p - left);
+    const int pb = abs(p - up);
+    const int pc = abs(p - upLeft);
+    if (pa <= pb && pa <= pc)
+      line[i] = left + raw[i];
+    else if (pb <= pc)
+      line[i] = up + raw[i];
+    else
+      line[i] = upLeft + raw[i];
+  }
+}
+
 bool StreamPredictor::getNextLine() {
   int curPred;
   unsigned char upLeftBuf[gfxColorMaxComps * 2 + 1];
-  int left, up, upLeft, p, pa, pb, pc;
-  int c;
   unsigned long inBuf, outBuf, bitMask;
   int inBits, outBits;
   int i, j, k, kk;
@@ -639,61 +787,42 @@ bool StreamPredictor::getNextLine() {
     curPred = predictor;
   }
 
-  // read the raw line, apply PNG (byte) predictor
-  int *rawCharLine = new int[rowBytes - pixBytes];
-  str->getRawChars(rowBytes - pixBytes, rawCharLine);
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
-    }
-    upLeftBuf[0] = predLine[i];
-    if ((c = rawCharLine[i - pixBytes]) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
-      }
-      delete[] rawCharLine;
-      return false;
-    }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = predLine[i - pixBytes] + (unsigned char)c;
-      break;
-    case 12:			// PNG up
-      predLine[i] = predLine[i] + (unsigned char)c;
-      break;
-    case 13:			// PNG average
-      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
-	            (unsigned char)c;
-      break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
-      p = left + up - upLeft;
-      if ((pa = p - left) < 0)
-	pa = -pa;
-      if ((pb = p - up) < 0)
-	pb = -pb;
-      if ((pc = p - upLeft) < 0)
-	pc = -pc;
-      if (pa <= pb && pa <= pc)
-	predLine[i] = left + (unsigned char)c;
-      else if (pb <= pc)
-	predLine[i] = up + (unsigned char)c;
-      else
-	predLine[i] = upLeft + (unsigned char)c;
-      break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (unsigned char)c;
-      break;
-    }
+  // read the raw line
+  const int lineBytes = rowBytes - pixBytes;
+  const int n = str->getRawChars(lineBytes, rawLine);
+  if (n == 0) {
+    return false;
+  }
+
+  // apply PNG (byte) predictor; the previous line becomes the base for
+  // the new one
+  std::swap(predLine, prevLine);
+  unsigned char *line = predLine + pixBytes;
+  const unsigned char *prev = prevLine + pixBytes;
+  switch (curPred) {
+  case 11:			// PNG sub
+    pngPredictSub(line, rawLine, n, pixBytes);
+    break;
+  case 12:			// PNG up
+    pngPredictUp(line, prev, rawLine, n);
+    break;
+  case 13:			// PNG average
+    pngPredictAverage(line, prev, rawLine, n, pixBytes);
+    break;
+  case 14:			// PNG Paeth
+    pngPredictPaeth(line, prev, rawLine, n, pixBytes);
+    break;
+  case 10:			// PNG none
+  default:			// no predictor or TIFF predictor
+    memcpy(line, rawLine, n);
+    break;
+  }
+  if (n < lineBytes) {
+    // some (broken) PDF files contain truncated image data, and Adobe
+    // apparently reads the last partial line, the rest of which keeps
+    // the previous line's data
+    memcpy(line + n, prev + n, lineBytes - n);
   }
-  delete[] rawCharLine;
 
   // apply TIFF (component) predictor
   if (predictor == 2) {
@@ -940,6 +1069,20 @@ void CachedFileStream::moveStart(Goffset delta)
   bufPos = start;
 }
 
+//------------------------------------------------------------------------
+// MappedFileStream
+//------------------------------------------------------------------------
+
+MappedFileStream::MappedFileStream(const char *bufA, Goffset lengthA, Object &&dictA)
+  : BaseMemStream(bufA, 0, lengthA, std::move(dictA))
+{
+  mappedLength = lengthA;
+}
+
+MappedFileStream::~MappedFileStream() {
+  GooFile::unmap(buf, mappedLength);
+}
+
 //------------------------------------------------------------------------
 // EmbedStream
 //------------------------------------------------------------------------
@@ -1310,9 +1453,25 @@ int LZWStream::lookChar() {
   return seqBuf[seqIndex];
 }
 
-void LZWStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
+int LZWStream::getRawChars(int nChars, unsigned char *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (eof) {
+      break;
+    }
+    if (seqIndex >= seqLength) {
+      if (!processNextCode()) {
+	break;
+      }
+    }
+    m = std::min(seqLength - seqIndex, nChars - n);
+    memcpy(buffer + n, seqBuf + seqIndex, m);
+    seqIndex += m;
+    n += m;
+  }
+  return n;
 }
 
 int LZWStream::getRawChar() {
@@ -4561,14 +4720,8 @@ int FlateStream::getChar() {
 int FlateStream::getChars(int nChars, unsigned char *buffer) {
   if (pred) {
     return pred->getChars(nChars, buffer);
-  } else {
-    for (int i = 0; i < nChars; ++i) {
-      const int c = doGetRawChar();
-      if (likely(c != EOF)) buffer[i] = c;
-      else return i;
-    }
-    return nChars;
   }
+  return getRawChars(nChars, buffer);
 }
 
 int FlateStream::lookChar() {
@@ -4586,9 +4739,42 @@ int FlateStream::lookChar() {
   return c;
 }
 
-void FlateStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
+const unsigned char *FlateStream::lookChars(int *nChars) {
+  if (pred) {
+    return nullptr;
+  }
+  while (remain == 0) {
+    if (endOfBlock && eof)
+      return nullptr;
+    readSome();
+  }
+  // the output buffer is circular, hand out the part up to its end
+  *nChars = std::min(remain, flateWindow - index);
+  return buf + index;
+}
+
+void FlateStream::skipChars(int nChars) {
+  index = (index + nChars) & flateMask;
+  remain -= nChars;
+}
+
+int FlateStream::getRawChars(int nChars, unsigned char *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    while (remain == 0) {
+      if (endOfBlock && eof)
+	return n;
+      readSome();
+    }
+    m = std::min(std::min(remain, flateWindow - index), nChars - n);
+    memcpy(buffer + n, buf + index, m);
+    index = (index + m) & flateMask;
+    remain -= m;
+    n += m;
+  }
+  return n;
 }
 
 int FlateStream::getRawChar() {
@@ -4624,46 +4810,60 @@ void FlateStream::readSome() {
   }
 
   if (compressedBlock) {
-    if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
-      goto err;
-    if (code1 < 256) {
-      buf[index] = code1;
-      remain = 1;
-    } else if (code1 == 256) {
-      endOfBlock = true;
-      remain = 0;
-    } else {
-      code1 -= 257;
-      code2 = lengthDecode[code1].bits;
-      if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
-	goto err;
-      len = lengthDecode[code1].first + code2;
-      if ((code1 = getHuffmanCodeWord(&distCodeTab)) == EOF)
-	goto err;
-      code2 = distDecode[code1].bits;
-      if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
+    // decode symbols until the block ends or the window could not hold
+    // another maximum length match; the caller consumes the bytes from
+    // index on while they are still in the window
+    i = (index + remain) & flateMask;
+    while (remain + flateMaxMatchLen <= flateWindow) {
+      if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
 	goto err;
-      dist = distDecode[code1].first + code2;
-      i = index;
-      j = (index - dist) & flateMask;
-      for (k = 0; k < len; ++k) {
-	buf[i] = buf[j];
+      if (code1 < 256) {
+	buf[i] = code1;
 	i = (i + 1) & flateMask;
-	j = (j + 1) & flateMask;
+	++remain;
+      } else if (code1 == 256) {
+	endOfBlock = true;
+	break;
+      } else {
+	code1 -= 257;
+	code2 = lengthDecode[code1].bits;
+	if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
+	  goto err;
+	len = lengthDecode[code1].first + code2;
+	if ((code1 = getHuffmanCodeWord(&distCodeTab)) == EOF)
+	  goto err;
+	code2 = distDecode[code1].bits;
+	if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
+	  goto err;
+	dist = distDecode[code1].first + code2;
+	j = (i - dist) & flateMask;
+	if (dist >= len && i + len <= flateWindow && j + len <= flateWindow) {
+	  // source and destination neither overlap nor wrap around
+	  memcpy(buf + i, buf + j, len);
+	  i += len;
+	} else {
+	  for (k = 0; k < len; ++k) {
+	    buf[i] = buf[j];
+	    i = (i + 1) & flateMask;
+	    j = (j + 1) & flateMask;
+	  }
+	}
+	i &= flateMask;
+	remain += len;
       }
-      remain = len;
     }
 
   } else {
-    len = (blockLen < flateWindow) ? blockLen : flateWindow;
-    for (i = 0, j = index; i < len; ++i, j = (j + 1) & flateMask) {
+    len = (blockLen < flateWindow - remain) ? blockLen : flateWindow - remain;
+    for (i = 0, j = (index + remain) & flateMask; i < len;
+	 ++i, j = (j + 1) & flateMask) {
       if ((c = str->getChar()) == EOF) {
 	endOfBlock = eof = true;
 	break;
       }
       buf[j] = c & 0xff;
     }
-    remain = i;
+    remain += i;
     blockLen -= len;
     if (blockLen == 0)
       endOfBlock = true;
@@ -4672,9 +4872,9 @@ void FlateStream::readSome() {
   return;
 
 err:
+  // the bytes decoded before the error are still handed out
   error(errSyntaxError, getPos(), "Unexpected end of file in flate stream");
   endOfBlock = eof = true;
-  remain = 0;
 }
 
 bool FlateStream::startBlock() {
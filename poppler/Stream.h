@@ -36,6 +36,7 @@
 #define STREAM_H
 
 #include <atomic>
+#include <climits>
 #include <cstdio>
 
 #include "poppler-config.h"
@@ -169,10 +170,22 @@ public:
   // Peek at next char in stream.
   virtual int lookChar() = 0;
 
+  // Peek at the data the stream has already decoded at the current
+  // position, without consuming it.  Returns a pointer to that data and
+  // sets <nChars> to its length, or returns nullptr if the stream can't
+  // expose its data this way (or is at its end); use getChar() then.
+  // The data is only valid until the next call to the stream.
+  virtual const unsigned char *lookChars(int * /*nChars*/) { return nullptr; }
+
+  // Consume <nChars> chars of the data returned by lookChars().
+  virtual void skipChars(int nChars);
+
   // Get next char from stream without using the predictor.
   // This is only used by StreamPredictor.
   virtual int getRawChar();
-  virtual void getRawChars(int nChars, int *buffer);
+  // Returns the number of chars read, which is less than <nChars>
+  // only at the end of the stream.
+  virtual int getRawChars(int nChars, unsigned char *buffer);
 
   // Get next char directly from stream source, without filtering it
   virtual int getUnfilteredChar () = 0;
@@ -217,6 +230,22 @@ public:
   virtual void getImageParams(int * /*bitsPerComponent*/,
 			      StreamColorSpaceMode * /*csMode*/) {}
 
+  // Ask an image stream of <*width> x <*height> pixels to decode at a
+  // reduced size that is still at least <minWidth> x <minHeight>.  On
+  // success, sets <*width> and <*height> to the size the stream will
+  // decode to and returns true.  Must be called before reset(), and
+  // only applies to that reset(): the stream may be drawn again later.
+  virtual bool setReducedSize(int * /*width*/, int * /*height*/,
+			      int /*minWidth*/, int /*minHeight*/) { return false; }
+
+  // Tell an image stream that only the pixels in [<x0>,<x1>) x
+  // [<y0>,<y1>) (of the reduced size, if setReducedSize was called) will
+  // be used.  The stream may leave other pixels undecoded, with any
+  // value.  Same rules as setReducedSize.  Returns true if the stream
+  // may actually skip pixels.
+  virtual bool setDecodeRegion(int /*x0*/, int /*y0*/,
+			       int /*x1*/, int /*y1*/) { return false; }
+
   // Return the next stream in the "stack".
   virtual Stream *getNextStream() { return nullptr; }
 
@@ -436,6 +465,8 @@ private:
   int pixBytes;			// bytes per pixel
   int rowBytes;			// bytes per line
   unsigned char *predLine;		// line buffer
+  unsigned char *prevLine;		// previous line
+  unsigned char *rawLine;		// raw (filtered) bytes of the next line
   int predIdx;			// current index in predLine
   bool ok;
 };
@@ -462,6 +493,14 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   int lookChar() override
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  const unsigned char *lookChars(int *nChars) override {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      return nullptr;
+    }
+    *nChars = (int)(bufEnd - bufPtr);
+    return (const unsigned char *)bufPtr;
+  }
+  void skipChars(int nChars) override { bufPtr += nChars; }
   Goffset getPos() override { return bufPos + (bufPtr - buf); }
   void setPos(Goffset pos, int dir = 0) override;
   Goffset getStart() override { return start; }
@@ -537,6 +576,14 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   int lookChar() override
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  const unsigned char *lookChars(int *nChars) override {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      return nullptr;
+    }
+    *nChars = (int)(bufEnd - bufPtr);
+    return (const unsigned char *)bufPtr;
+  }
+  void skipChars(int nChars) override { bufPtr += nChars; }
   Goffset getPos() override { return bufPos + (bufPtr - buf); }
   void setPos(Goffset pos, int dir = 0) override;
   Goffset getStart() override { return start; }
@@ -545,6 +592,8 @@ public:
   int getUnfilteredChar () override { return getChar(); }
   void unfilteredReset () override { reset(); }
 
+  CachedFile *getCachedFile() { return cc; }
+
 private:
 
   bool fillBuf();
@@ -606,10 +655,21 @@ public:
   int lookChar() override
     { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
 
-  Goffset getPos() override { return (int)(bufPtr - buf); }
+  const unsigned char *lookChars(int *nChars) override {
+    if (bufPtr >= bufEnd) {
+      return nullptr;
+    }
+    // spans are ints, callers just come back for the rest
+    *nChars = bufEnd - bufPtr > INT_MAX ? INT_MAX : (int)(bufEnd - bufPtr);
+    return (const unsigned char *)bufPtr;
+  }
+
+  void skipChars(int nChars) override { bufPtr += nChars; }
+
+  Goffset getPos() override { return (Goffset)(bufPtr - buf); }
 
   void setPos(Goffset pos, int dir = 0) override {
-    unsigned int i;
+    Goffset i;
 
     if (dir >= 0) {
       i = pos;
@@ -683,6 +743,26 @@ public:
     { gfree(buf); }
 };
 
+//------------------------------------------------------------------------
+// MappedFileStream
+//
+// A MemStream over a whole file mapped into memory, see GooFile::map().
+// Sub streams point into the mapping, so they must not outlive it.  The
+// file must not be truncated or rewritten while it is mapped: reading a
+// page that is no longer backed by the file raises SIGBUS.
+//------------------------------------------------------------------------
+
+class MappedFileStream : public BaseMemStream<const char>
+{
+public:
+  // Takes ownership of the mapping.
+  MappedFileStream(const char *bufA, Goffset lengthA, Object &&dictA);
+  ~MappedFileStream();
+
+private:
+  Goffset mappedLength;
+};
+
 
 //------------------------------------------------------------------------
 // EmbedStream
@@ -797,7 +877,7 @@ public:
   int getChar() override;
   int lookChar() override;
   int getRawChar() override;
-  void getRawChars(int nChars, int *buffer) override;
+  int getRawChars(int nChars, unsigned char *buffer) override;
   GooString *getPSFilter(int psLevel, const char *indent) override;
   bool isBinary(bool last = true) override;
 
@@ -1052,6 +1132,7 @@ private:
 
 #define flateWindow          32768    // buffer size
 #define flateMask            (flateWindow-1)
+#define flateMaxMatchLen       258    // max length of a back reference
 #define flateMaxHuffman         15    // max Huffman code length
 #define flateMaxCodeLenCodes    19    // max # code length codes
 #define flateMaxLitCodes       288    // max # literal codes
@@ -1084,8 +1165,10 @@ public:
   void reset() override;
   int getChar() override;
   int lookChar() override;
+  const unsigned char *lookChars(int *nChars) override;
+  void skipChars(int nChars) override;
   int getRawChar() override;
-  void getRawChars(int nChars, int *buffer) override;
+  int getRawChars(int nChars, unsigned char *buffer) override;
   GooString *getPSFilter(int psLevel, const char *indent) override;
   bool isBinary(bool last = true) override;
   void unfilteredReset () override;
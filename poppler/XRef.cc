@@ -70,6 +70,10 @@
 #define permHighResPrint  (1<<11) // bit 12
 #define defPermFlags 0xfffc
 
+// number of parsed object streams kept around; lookups in the cache are
+// O(1), so this only trades memory for re-parsing
+#define objStrCacheSize 64
+
 //------------------------------------------------------------------------
 // ObjectStream
 //------------------------------------------------------------------------
@@ -225,7 +229,7 @@ Object ObjectStream::getObject(int objIdx, int objNum) {
 
 #define xrefLocker()   std::unique_lock<std::recursive_mutex> locker(mutex)
 
-XRef::XRef() : objStrs{5} {
+XRef::XRef() : objStrs{objStrCacheSize} {
   ok = true;
   errCode = errNone;
   entries = nullptr;
@@ -826,6 +830,7 @@ bool XRef::constructXRef(bool *wasReconstructed, bool needCatalogDict) {
   bool oneCycle = true;
   int offset = 0;
 
+  invalidateResolvedObjects();
   resize(0); // free entries properly
   gfree(entries);
   capacity = 0;
@@ -996,6 +1001,9 @@ void XRef::setEncryption(int permFlagsA, bool ownerPasswordOkA,
   encVersion = encVersionA;
   encRevision = encRevisionA;
   encAlgorithm = encAlgorithmA;
+
+  // objects resolved so far were not decrypted
+  invalidateResolvedObjects();
 }
 
 void XRef::getEncryptionParameters(unsigned char **fileKeyA, CryptAlgorithm *encAlgorithmA,
@@ -1079,6 +1087,10 @@ Object XRef::fetch(int num, int gen, int recursion) {
   XRefEntry *e;
   Object obj1, obj2, obj3;
 
+  if (lookupResolvedObject(num, gen, &obj1)) {
+    return obj1;
+  }
+
   xrefLocker();
   // check for bogus ref - this can happen in corrupted PDF files
   if (num < 0 || num >= size) {
@@ -1129,6 +1141,9 @@ Object XRef::fetch(int num, int gen, int recursion) {
     }
     Object obj = parser.getObj(false, (encrypted && !e->getFlag(XRefEntry::Unencrypted)) ? fileKey : nullptr,
 		   encAlgorithm, keyLength, num, gen, recursion);
+    if (recursion == 0) {
+      cacheResolvedObject(num, gen, obj);
+    }
     return obj;
   }
 
@@ -1158,7 +1173,11 @@ Object XRef::fetch(int num, int gen, int recursion) {
 	objStrs.put(e->offset, objStr);
       }
     }
-    return objStr->getObject(e->gen, num);
+    Object obj = objStr->getObject(e->gen, num);
+    if (recursion == 0) {
+      cacheResolvedObject(num, gen, obj);
+    }
+    return obj;
   }
 
   default:
@@ -1175,6 +1194,60 @@ Object XRef::fetch(int num, int gen, int recursion) {
   return Object(objNull);
 }
 
+bool XRef::lookupResolvedObject(int num, int gen, Object *obj) {
+  if (num < 0) {
+    return false;
+  }
+  ResolvedObjectShard &shard = resolvedObjects[num % resolvedObjectShards];
+  Object cached;
+  {
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    ResolvedObject *resolved = shard.objs.lookup(num);
+    if (!resolved || resolved->gen != gen) {
+      return false;
+    }
+    cached = resolved->obj.copy();
+  }
+  // callers may modify what they fetch, as with a fresh parse; nothing
+  // modifies the cached object itself, so it is copied without the lock
+  *obj = cached.deepCopy();
+  return true;
+}
+
+void XRef::cacheResolvedObject(int num, int gen, const Object &obj) {
+  // streams carry a read position, so every caller needs its own
+  if (obj.isStream() || obj.isNull() || obj.isError() || obj.isNone()) {
+    return;
+  }
+  // copying an object too large for the cache on every hit would cost
+  // as much as parsing it again
+  const std::size_t bytes = obj.getMemoryUsage();
+  if (bytes > resolvedObjectShardMaxBytes / 4) {
+    return;
+  }
+  // a copy of its own, since the caller may modify <obj>
+  ResolvedObject *resolved = new ResolvedObject{gen, obj.deepCopy()};
+  ResolvedObjectShard &shard = resolvedObjects[num % resolvedObjectShards];
+  std::lock_guard<std::mutex> locker(shard.mutex);
+  shard.objs.put(num, resolved, bytes);
+}
+
+void XRef::invalidateResolvedObject(int num) {
+  if (num < 0) {
+    return;
+  }
+  ResolvedObjectShard &shard = resolvedObjects[num % resolvedObjectShards];
+  std::lock_guard<std::mutex> locker(shard.mutex);
+  shard.objs.remove(num);
+}
+
+void XRef::invalidateResolvedObjects() {
+  for (ResolvedObjectShard &shard : resolvedObjects) {
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    shard.objs.clear();
+  }
+}
+
 void XRef::lock() {
   mutex.lock();
 }
@@ -1286,6 +1359,7 @@ void XRef::add(int num, int gen, Goffset offs, bool used) {
     size = num + 1;
   }
   XRefEntry *e = getEntry(num);
+  invalidateResolvedObject(num);
   e->gen = gen;
   e->obj.setToNull();
   e->flags = 0;
@@ -1305,6 +1379,7 @@ void XRef::setModifiedObject (const Object* o, Ref r) {
     return;
   }
   XRefEntry *e = getEntry(r.num);
+  invalidateResolvedObject(r.num);
   e->obj = o->copy();
   e->setFlag(XRefEntry::Updated, true);
   setModified();
@@ -1351,6 +1426,7 @@ void XRef::removeIndirectObject(Ref r) {
   if (e->type == xrefEntryFree) {
     return;
   }
+  invalidateResolvedObject(r.num);
   e->obj.~Object();
   e->type = xrefEntryFree;
   e->gen++;
@@ -1644,6 +1720,7 @@ void XRef::markUnencrypted(Object *obj) {
       if (e->getFlag(XRefEntry::Unencrypted))
         return; // We've already been here: prevent infinite recursion
       e->setFlag(XRefEntry::Unencrypted, true);
+      invalidateResolvedObject(ref.num);
       obj1 = fetch(ref);
       markUnencrypted(&obj1);
       break;
@@ -1686,6 +1763,7 @@ void XRef::scanSpecialFlags() {
     const int objNum = xrefStreamObjNums.at(i);
     getEntry(objNum)->setFlag(XRefEntry::Unencrypted, true);
     getEntry(objNum)->setFlag(XRefEntry::DontRewrite, true);
+    invalidateResolvedObject(objNum);
   }
 
   // Mark objects referred from the Encrypt dict as Unencrypted
@@ -1698,6 +1776,7 @@ void XRef::markUnencrypted() {
   if (obj.isRef()) {
     XRefEntry *e = getEntry(obj.getRefNum());
     e->setFlag(XRefEntry::Unencrypted, true);
+    invalidateResolvedObject(obj.getRefNum());
   }
 }
 
@@ -39,6 +39,8 @@
 #include "Stream.h"
 #include "PopplerCache.h"
 
+#include <mutex>
+
 class Dict;
 class Stream;
 class Parser;
@@ -238,6 +240,28 @@ private:
   bool strOwner;     // true if str is owned by the instance
   mutable std::recursive_mutex mutex;
 
+  // Already resolved objects other than streams, striped by object
+  // number so that concurrent fetch() calls of them neither take <mutex>
+  // nor contend with each other. fetch() returns deep copies of them,
+  // which callers may modify like a fresh parse. Entries are only added
+  // and removed while <mutex> is held. Each shard is an LRU cache with
+  // its share of the memory budget.
+  enum {
+    resolvedObjectShards = 64,
+    resolvedObjectShardMaxSize = 1024,
+    resolvedObjectShardMaxBytes = 256 * 1024	// 16 MB in all
+  };
+  struct ResolvedObject {
+    int gen;
+    Object obj;
+  };
+  struct ResolvedObjectShard {
+    std::mutex mutex;
+    PopplerCache<int, ResolvedObject> objs{resolvedObjectShardMaxSize,
+					   resolvedObjectShardMaxBytes};
+  };
+  ResolvedObjectShard resolvedObjects[resolvedObjectShards];
+
   int reserve(int newSize);
   int resize(int newSize);
   bool readXRef(Goffset *pos, std::vector<Goffset> *followedXRefStm, std::vector<int> *xrefStreamObjsNum);
@@ -248,6 +272,10 @@ private:
   bool parseEntry(Goffset offset, XRefEntry *entry);
   void readXRefUntil(int untilEntryNum, std::vector<int> *xrefStreamObjsNum = nullptr);
   void markUnencrypted(Object *obj);
+  bool lookupResolvedObject(int num, int gen, Object *obj);
+  void cacheResolvedObject(int num, int gen, const Object &obj);
+  void invalidateResolvedObject(int num);
+  void invalidateResolvedObjects();
 
   class XRefWriter {
   public:
@@ -52,6 +52,9 @@
 #include "SplashGlyphBitmap.h"
 #include "Splash.h"
 #include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 //------------------------------------------------------------------------
 
@@ -162,6 +165,11 @@ struct SplashPipe {
 
   // the "run" function
   void (Splash::*run)(SplashPipe *pipe);
+
+  // the "run" function for a span of pixels (nullptr if the span has
+  // to be run one pixel at a time)
+  void (Splash::*runSpan)(SplashPipe *pipe, const unsigned char *shapes,
+			  int n);
 };
 
 SplashPipeResultColorCtrl Splash::pipeResultColorNoAlphaBlend[] = {
@@ -326,6 +334,21 @@ inline void Splash::pipeInit(SplashPipe *pipe, int x, int y,
       pipe->run = &Splash::pipeRunAADeviceN8;
     }
   }
+
+  // select the span 'run' function
+  pipe->runSpan = nullptr;
+  if (!pipe->pattern && !state->blendFunc && pipe->destAlphaPtr &&
+      (bitmap->mode == splashModeMono8 || bitmap->mode == splashModeRGB8 ||
+       bitmap->mode == splashModeBGR8 || bitmap->mode == splashModeXBGR8 ||
+       (bitmap->mode == splashModeCMYK8 &&
+	(state->overprintMask & 15) == 15 && !state->overprintAdditive))) {
+    if (pipe->noTransparency) {
+      pipe->runSpan = &Splash::pipeRunSimpleSpan;
+    } else if (!(state->inNonIsolatedGroup && alpha0Bitmap->alpha) &&
+	       !pipe->nonIsolatedGroup) {
+      pipe->runSpan = &Splash::pipeRunAASpan;
+    }
+  }
 }
 
 // general case
@@ -1311,6 +1334,267 @@ void Splash::pipeRunAADeviceN8(SplashPipe *pipe) {
   ++pipe->x;
 }
 
+// Store the source color of <pipe> in <pixel> with the byte order of
+// the bitmap, passed through the transfer function if <transfer> is
+// set, and return the number of bytes per pixel.  Only used for the
+// Mono8, RGB8, BGR8, XBGR8 and CMYK8 modes.
+int Splash::pipeGetSrcPixel(SplashPipe *pipe, bool transfer,
+			    unsigned char *pixel) {
+  switch (bitmap->mode) {
+  case splashModeMono8:
+    pixel[0] = transfer ? state->grayTransfer[pipe->cSrc[0]] : pipe->cSrc[0];
+    return 1;
+  case splashModeRGB8:
+    pixel[0] = transfer ? state->rgbTransferR[pipe->cSrc[0]] : pipe->cSrc[0];
+    pixel[1] = transfer ? state->rgbTransferG[pipe->cSrc[1]] : pipe->cSrc[1];
+    pixel[2] = transfer ? state->rgbTransferB[pipe->cSrc[2]] : pipe->cSrc[2];
+    return 3;
+  case splashModeBGR8:
+  case splashModeXBGR8:
+    pixel[0] = transfer ? state->rgbTransferB[pipe->cSrc[2]] : pipe->cSrc[2];
+    pixel[1] = transfer ? state->rgbTransferG[pipe->cSrc[1]] : pipe->cSrc[1];
+    pixel[2] = transfer ? state->rgbTransferR[pipe->cSrc[0]] : pipe->cSrc[0];
+    pixel[3] = 255;
+    return bitmap->mode == splashModeXBGR8 ? 4 : 3;
+  case splashModeCMYK8:
+    pixel[0] = transfer ? state->cmykTransferC[pipe->cSrc[0]] : pipe->cSrc[0];
+    pixel[1] = transfer ? state->cmykTransferM[pipe->cSrc[1]] : pipe->cSrc[1];
+    pixel[2] = transfer ? state->cmykTransferY[pipe->cSrc[2]] : pipe->cSrc[2];
+    pixel[3] = transfer ? state->cmykTransferK[pipe->cSrc[3]] : pipe->cSrc[3];
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+// span version of the pipeRunSimple* special cases:
+// !pipe->pattern && pipe->noTransparency && !state->blendFunc &&
+// bitmap->mode is Mono8, RGB8, BGR8, XBGR8 or CMYK8 (overprinting all
+// components, not additive) && pipe->destAlphaPtr
+// <shapes> is not used, as these pipes don't use shape.
+void Splash::pipeRunSimpleSpan(SplashPipe *pipe, const unsigned char *shapes,
+			       int n) {
+  unsigned char pixel[4];
+  unsigned char *p;
+  unsigned int word;
+  int nComps, i;
+
+  nComps = pipeGetSrcPixel(pipe, true, pixel);
+  p = pipe->destColorPtr;
+  switch (nComps) {
+  case 1:
+    memset(p, pixel[0], n);
+    break;
+  case 3:
+    for (i = 0; i < n; ++i, p += 3) {
+      p[0] = pixel[0];
+      p[1] = pixel[1];
+      p[2] = pixel[2];
+    }
+    break;
+  case 4:
+    memcpy(&word, pixel, 4);
+    i = 0;
+#ifdef __SSE2__
+    {
+      const __m128i v = _mm_set1_epi32((int)word);
+      for (; i + 4 <= n; i += 4) {
+	_mm_storeu_si128((__m128i *)(p + 4 * i), v);
+      }
+    }
+#endif
+    for (; i < n; ++i) {
+      memcpy(p + 4 * i, &word, 4);
+    }
+    break;
+  }
+  memset(pipe->destAlphaPtr, 255, n);
+
+  pipe->destColorPtr += n * nComps;
+  pipe->destAlphaPtr += n;
+  pipe->x += n;
+}
+
+// span version of the pipeRunAA* special cases, which also handles
+// soft masks and pipes without shape:
+// !pipe->pattern && !pipe->noTransparency && !state->blendFunc &&
+// !pipe->alpha0Ptr && !pipe->nonIsolatedGroup &&
+// bitmap->mode is Mono8, RGB8, BGR8, XBGR8 or CMYK8 (overprinting all
+// components, not additive) && pipe->destAlphaPtr
+// <shapes> holds the shape of each pixel, it is nullptr if the pipe
+// doesn't use shape.
+void Splash::pipeRunAASpan(SplashPipe *pipe, const unsigned char *shapes,
+			   int n) {
+  unsigned char src[4], aSrc, aDest, aResult;
+  const unsigned char *transfer[4];
+  unsigned char *colorPtr, *alphaPtr, *p;
+  const unsigned char *softMaskPtr;
+  int nComps, nColorComps, i, c;
+
+  nComps = pipeGetSrcPixel(pipe, false, src);
+  nColorComps = nComps;
+  switch (bitmap->mode) {
+  case splashModeMono8:
+    transfer[0] = state->grayTransfer;
+    break;
+  case splashModeRGB8:
+    transfer[0] = state->rgbTransferR;
+    transfer[1] = state->rgbTransferG;
+    transfer[2] = state->rgbTransferB;
+    break;
+  case splashModeXBGR8:
+    nColorComps = 3;
+    // fallthrough
+  case splashModeBGR8:
+    transfer[0] = state->rgbTransferB;
+    transfer[1] = state->rgbTransferG;
+    transfer[2] = state->rgbTransferR;
+    break;
+  case splashModeCMYK8:
+    transfer[0] = state->cmykTransferC;
+    transfer[1] = state->cmykTransferM;
+    transfer[2] = state->cmykTransferY;
+    transfer[3] = state->cmykTransferK;
+    break;
+  default:
+    return;
+  }
+  colorPtr = pipe->destColorPtr;
+  alphaPtr = pipe->destAlphaPtr;
+  softMaskPtr = state->softMask ? pipe->softMaskPtr : nullptr;
+
+#ifdef __SSE2__
+  // Over an opaque destination the result alpha is 255 and the result
+  // color is ((255 - aSrc) * cDest + aSrc * cSrc) / 255, which is
+  // computed for eight pixels at a time, using x / 255 = (x * 0x8081)
+  // >> 23 for x in [0, 255 * 255].  With an aSrc of 0 the destination
+  // is left as it is.
+  const bool vectorize = state->identityTransfer;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i opaque = _mm_set1_epi8((char)0xff);
+  const __m128i c255 = _mm_set1_epi16(255);
+  const __m128i c128 = _mm_set1_epi16(0x80);
+  const __m128i cDiv = _mm_set1_epi16((short)0x8081);
+  const __m128i aInput = _mm_set1_epi16(pipe->aInput);
+  unsigned char srcBytes[32], aSrcBytes[24], aSrc8[8];
+
+  for (c = 0; c < 8 * nComps; ++c) {
+    srcBytes[c] = src[c % nComps];
+  }
+#endif
+
+  for (i = 0; i < n; ++i) {
+#ifdef __SSE2__
+    if (vectorize && i + 8 <= n &&
+	(_mm_movemask_epi8(_mm_cmpeq_epi8(
+	     _mm_loadl_epi64((const __m128i *)(alphaPtr + i)), opaque)) & 0xff)
+	    == 0xff) {
+      __m128i a, t, d, s, r;
+
+      // aSrc = div255(div255(aInput * softMask) * shape)
+      a = aInput;
+      if (softMaskPtr) {
+	t = _mm_unpacklo_epi8(
+	        _mm_loadl_epi64((const __m128i *)(softMaskPtr + i)), zero);
+	t = _mm_mullo_epi16(a, t);
+	a = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)),
+					 c128), 8);
+      }
+      if (shapes) {
+	t = _mm_unpacklo_epi8(
+	        _mm_loadl_epi64((const __m128i *)(shapes + i)), zero);
+	t = _mm_mullo_epi16(a, t);
+	a = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)),
+					 c128), 8);
+      }
+      p = colorPtr + i * nComps;
+      t = _mm_packus_epi16(a, zero);
+      if ((_mm_movemask_epi8(_mm_cmpeq_epi8(t, opaque)) & 0xff) == 0xff) {
+	// fully covered
+	memcpy(p, srcBytes, 8 * nComps);
+      } else if ((_mm_movemask_epi8(_mm_cmpeq_epi8(t, zero)) & 0xff) != 0xff) {
+	// spread aSrc over the components of each pixel
+	__m128i aComps[4];
+	switch (nComps) {
+	case 1:
+	  aComps[0] = a;
+	  break;
+	case 3:
+	  _mm_storel_epi64((__m128i *)aSrc8, t);
+	  for (int k = 0, j = 0; k < 8; ++k, j += 3) {
+	    aSrcBytes[j] = aSrcBytes[j + 1] = aSrcBytes[j + 2] = aSrc8[k];
+	  }
+	  for (c = 0; c < 3; ++c) {
+	    aComps[c] = _mm_unpacklo_epi8(
+	        _mm_loadl_epi64((const __m128i *)(aSrcBytes + 8 * c)), zero);
+	  }
+	  break;
+	case 4:
+	  t = _mm_unpacklo_epi16(a, a);
+	  aComps[0] = _mm_unpacklo_epi32(t, t);
+	  aComps[1] = _mm_unpackhi_epi32(t, t);
+	  t = _mm_unpackhi_epi16(a, a);
+	  aComps[2] = _mm_unpacklo_epi32(t, t);
+	  aComps[3] = _mm_unpackhi_epi32(t, t);
+	  break;
+	}
+	for (c = 0; c < nComps; ++c) {
+	  d = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p + 8 * c)),
+				zero);
+	  s = _mm_unpacklo_epi8(
+	          _mm_loadl_epi64((const __m128i *)(srcBytes + 8 * c)), zero);
+	  r = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(c255, aComps[c]), d),
+			    _mm_mullo_epi16(aComps[c], s));
+	  r = _mm_srli_epi16(_mm_mulhi_epu16(r, cDiv), 7);
+	  _mm_storel_epi64((__m128i *)(p + 8 * c), _mm_packus_epi16(r, zero));
+	}
+      }
+      if (nColorComps != nComps) {
+	for (c = 3; c < 32; c += 4) {
+	  p[c] = 255;
+	}
+      }
+      i += 7;
+      continue;
+    }
+#endif
+
+    //----- source alpha
+    if (softMaskPtr) {
+      aSrc = div255(pipe->aInput * softMaskPtr[i]);
+    } else {
+      aSrc = pipe->aInput;
+    }
+    if (shapes) {
+      aSrc = div255(aSrc * shapes[i]);
+    }
+
+    //----- result alpha and color
+    p = colorPtr + i * nComps;
+    aDest = alphaPtr[i];
+    aResult = aSrc + aDest - div255(aSrc * aDest);
+    for (c = 0; c < nColorComps; ++c) {
+      if (aResult == 0) {
+	p[c] = 0;
+      } else {
+	p[c] = transfer[c][((aResult - aSrc) * p[c] + aSrc * src[c]) /
+			   aResult];
+      }
+    }
+    if (nColorComps != nComps) {
+      p[3] = 255;
+    }
+    alphaPtr[i] = aResult;
+  }
+
+  pipe->destColorPtr += n * nComps;
+  pipe->destAlphaPtr += n;
+  if (softMaskPtr) {
+    pipe->softMaskPtr += n;
+  }
+  pipe->x += n;
+}
+
 inline void Splash::pipeSetXY(SplashPipe *pipe, int x, int y) {
   pipe->x = x;
   pipe->y = y;
@@ -1471,8 +1755,14 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
 
   if (noClip) {
     pipeSetXY(pipe, x0, y);
-    for (x = x0; x <= x1; ++x) {
-      (this->*pipe->run)(pipe);
+    if (pipe->runSpan && !pipe->usesShape) {
+      if (x0 <= x1) {
+	(this->*pipe->runSpan)(pipe, nullptr, x1 - x0 + 1);
+      }
+    } else {
+      for (x = x0; x <= x1; ++x) {
+	(this->*pipe->run)(pipe);
+      }
     }
     updateModX(x0);
     updateModX(x1);
@@ -1507,7 +1797,10 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adj
   SplashColorPtr p;
   int xx, yy, t;
 #endif
-  int x;
+  // shapes of the pixels not yet drawn, if the pipe can draw spans
+  unsigned char shapes[256];
+  int x, nShapes;
+  const bool useSpans = pipe->runSpan && pipe->usesShape;
 
 #if splashAASize == 4
   p0 = aaBuf->getDataPtr() + (x0 >> 1);
@@ -1516,6 +1809,7 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adj
   p3 = p2 + aaBuf->getRowSize();
 #endif
   pipeSetXY(pipe, x0, y);
+  nShapes = 0;
   for (x = x0; x <= x1; ++x) {
 
     // compute the shape value
@@ -1539,7 +1833,23 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adj
     }
 #endif
 
-    if (t != 0) {
+    if (useSpans) {
+      if (t != 0) {
+	shapes[nShapes++] = (adjustLine) ? div255((int) lineOpacity * (double)aaGamma[t]) : (double)aaGamma[t];
+      }
+      if (nShapes > 0 && (t == 0 || nShapes == (int)sizeof(shapes) || x == x1)) {
+	const int xEnd = t == 0 ? x - 1 : x;
+	(this->*pipe->runSpan)(pipe, shapes, nShapes);
+	pipe->shape = shapes[nShapes - 1];
+	updateModX(xEnd - nShapes + 1);
+	updateModX(xEnd);
+	updateModY(y);
+	nShapes = 0;
+      }
+      if (t == 0) {
+	pipeIncX(pipe);
+      }
+    } else if (t != 0) {
       pipe->shape = (adjustLine) ? div255((int) lineOpacity * (double)aaGamma[t]) : (double)aaGamma[t];
       (this->*pipe->run)(pipe);
       updateModX(x);
@@ -1810,6 +2120,10 @@ SplashError Splash::clipToRect(SplashCoord x0, SplashCoord y0,
   return state->clip->clipToRect(x0, y0, x1, y1);
 }
 
+void Splash::clipToBand(int y0, int y1) {
+  state->clip->clipToBand(y0, y1);
+}
+
 SplashError Splash::clipToPath(SplashPath *path, bool eo) {
   return state->clip->clipToPath(path, state->matrix, state->flatness, eo);
 }
@@ -5828,7 +6142,7 @@ SplashError Splash::blitTransparent(SplashBitmap *src, int xSrc, int ySrc,
   case splashModeMono8:
     for (y = 0; y < height; ++y) {
       p = &bitmap->data[(yDest + y) * bitmap->rowSize + xDest];
-      sp = &src->data[(ySrc + y) * bitmap->rowSize + xSrc];
+      sp = &src->data[(ySrc + y) * src->rowSize + xSrc];
       for (x = 0; x < width; ++x) {
 	*p++ = *sp++;
       }
@@ -6311,6 +6625,7 @@ SplashError Splash::shadedFill(SplashPath *path, bool hasBBox,
                                SplashPattern *pattern) {
   SplashPipe pipe;
   int xMinI, yMinI, xMaxI, yMaxI, x0, x1, y;
+  int yFirst, yLast;
   SplashClipResult clipRes;
 
   if (vectorAntialias && aaBuf == nullptr) { // should not happen, but to be secure
@@ -6351,6 +6666,31 @@ SplashError Splash::shadedFill(SplashPath *path, bool hasBBox,
 
     pipeInit(&pipe, 0, yMinI, pattern, nullptr, (unsigned char)splashRound(state->fillAlpha * 255), vectorAntialias && !hasBBox, false);
 
+    // the first and last rows of the fill get no shape correction;
+    // in a band of the page, find them as if the page was drawn in one
+    // piece
+    yFirst = yMinI;
+    yLast = yMaxI;
+    if (vectorAntialias &&
+	(state->clip->getUnbandedYMinI() != state->clip->getYMinI() ||
+	 state->clip->getUnbandedYMaxI() != state->clip->getYMaxI())) {
+      int unbandedYMinI = state->clip->getUnbandedYMinI();
+      int unbandedYMaxI = state->clip->getUnbandedYMaxI();
+      int x;
+      if (!inShading) {
+	unbandedYMinI = unbandedYMinI * splashAASize;
+	unbandedYMaxI = (unbandedYMaxI + 1) * splashAASize - 1;
+      }
+      SplashXPathScanner unbandedScanner(&xPath, false, unbandedYMinI, unbandedYMaxI);
+      unbandedScanner.getBBoxAA(&x, &yFirst, &x, &yLast);
+      if (yFirst < state->clip->getUnbandedYMinI()) {
+	yFirst = state->clip->getUnbandedYMinI();
+      }
+      if (yLast > state->clip->getUnbandedYMaxI()) {
+	yLast = state->clip->getUnbandedYMaxI();
+      }
+    }
+
     // draw the spans
     if (vectorAntialias) {
       for (y = yMinI; y <= yMaxI; ++y) {
@@ -6359,7 +6699,7 @@ SplashError Splash::shadedFill(SplashPath *path, bool hasBBox,
           state->clip->clipAALine(aaBuf, &x0, &x1, y);
         }
 #if splashAASize == 4
-        if (!hasBBox && y > yMinI && y < yMaxI) {
+        if (!hasBBox && y > yFirst && y < yLast) {
           // correct shape on left side if clip is
           // vertical through the middle of shading:
           unsigned char *p0, *p1, *p2, *p3;
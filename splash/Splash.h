@@ -141,6 +141,9 @@ public:
   // NB: uses transformed coordinates.
   SplashError clipToRect(SplashCoord x0, SplashCoord y0,
 			 SplashCoord x1, SplashCoord y1);
+  // Limit drawing to the rows <y0> up to <y1> (excluded) of a band of
+  // the page (see SplashClip::clipToBand).
+  void clipToBand(int y0, int y1);
   // NB: uses untransformed coordinates.
   SplashError clipToPath(SplashPath *path, bool eo);
   void setSoftMask(SplashBitmap *softMask);
@@ -299,6 +302,9 @@ private:
   void pipeRunAABGR8(SplashPipe *pipe);
   void pipeRunAACMYK8(SplashPipe *pipe);
   void pipeRunAADeviceN8(SplashPipe *pipe);
+  void pipeRunSimpleSpan(SplashPipe *pipe, const unsigned char *shapes, int n);
+  void pipeRunAASpan(SplashPipe *pipe, const unsigned char *shapes, int n);
+  int pipeGetSrcPixel(SplashPipe *pipe, bool transfer, unsigned char *pixel);
   void pipeSetXY(SplashPipe *pipe, int x, int y);
   void pipeIncX(SplashPipe *pipe);
   void drawPixel(SplashPipe *pipe, int x, int y, bool noClip);
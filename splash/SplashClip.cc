@@ -63,6 +63,8 @@ SplashClip::SplashClip(SplashCoord x0, SplashCoord y0,
   yMinI = splashFloor(yMin);
   xMaxI = splashCeil(xMax) - 1;
   yMaxI = splashCeil(yMax) - 1;
+  unbandedYMin = yMin;
+  unbandedYMax = yMax;
   paths = nullptr;
   flags = nullptr;
   scanners = nullptr;
@@ -82,6 +84,8 @@ SplashClip::SplashClip(SplashClip *clip) {
   yMinI = clip->yMinI;
   xMaxI = clip->xMaxI;
   yMaxI = clip->yMaxI;
+  unbandedYMin = clip->unbandedYMin;
+  unbandedYMax = clip->unbandedYMax;
   length = clip->length;
   size = clip->size;
   paths = (SplashXPath **)gmallocn(size, sizeof(SplashXPath *));
@@ -164,6 +168,8 @@ void SplashClip::resetToRect(SplashCoord x0, SplashCoord y0,
   yMinI = splashFloor(yMin);
   xMaxI = splashCeil(xMax) - 1;
   yMaxI = splashCeil(yMax) - 1;
+  unbandedYMin = yMin;
+  unbandedYMax = yMax;
 }
 
 SplashError SplashClip::clipToRect(SplashCoord x0, SplashCoord y0,
@@ -196,6 +202,12 @@ SplashError SplashClip::clipToRect(SplashCoord x0, SplashCoord y0,
       yMax = y1;
       yMaxI = splashCeil(yMax) - 1;
     }
+    if (y0 > unbandedYMin) {
+      unbandedYMin = y0;
+    }
+    if (y1 < unbandedYMax) {
+      unbandedYMax = y1;
+    }
   } else {
     if (y1 > yMin) {
       yMin = y1;
@@ -205,10 +217,26 @@ SplashError SplashClip::clipToRect(SplashCoord x0, SplashCoord y0,
       yMax = y0;
       yMaxI = splashCeil(yMax) - 1;
     }
+    if (y1 > unbandedYMin) {
+      unbandedYMin = y1;
+    }
+    if (y0 < unbandedYMax) {
+      unbandedYMax = y0;
+    }
   }
   return splashOk;
 }
 
+void SplashClip::clipToBand(int y0, int y1) {
+  SplashCoord unbandedYMinA, unbandedYMaxA;
+
+  unbandedYMinA = unbandedYMin;
+  unbandedYMaxA = unbandedYMax;
+  clipToRect(xMin, y0, xMax, y1);
+  unbandedYMin = unbandedYMinA;
+  unbandedYMax = unbandedYMaxA;
+}
+
 SplashError SplashClip::clipToPath(SplashPath *path, SplashCoord *matrix,
 				   SplashCoord flatness, bool eo) {
   SplashXPath *xPath;
@@ -220,6 +248,7 @@ SplashError SplashClip::clipToPath(SplashPath *path, SplashCoord *matrix,
   if (xPath->length == 0) {
     xMax = xMin - 1;
     yMax = yMin - 1;
+    unbandedYMax = unbandedYMin - 1;
     xMaxI = splashCeil(xMax) - 1;
     yMaxI = splashCeil(yMax) - 1;
     delete xPath;
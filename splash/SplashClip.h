@@ -66,6 +66,11 @@ public:
   SplashError clipToRect(SplashCoord x0, SplashCoord y0,
 			 SplashCoord x1, SplashCoord y1);
 
+  // Intersect the clip with the rows <y0> up to <y1> (excluded) of a
+  // band of the page.  Unlike a clip rectangle, the band is not an
+  // edge of what is drawn (see getUnbandedYMinI).
+  void clipToBand(int y0, int y1);
+
   // Intersect the clip with <path>.
   SplashError clipToPath(SplashPath *path, SplashCoord *matrix,
 			 SplashCoord flatness, bool eo);
@@ -131,6 +136,10 @@ public:
   int getYMinI() { return yMinI; }
   int getYMaxI() { return yMaxI; }
 
+  // Same as getYMinI and getYMaxI, but without the band limits.
+  int getUnbandedYMinI() { return splashFloor(unbandedYMin); }
+  int getUnbandedYMaxI() { return splashCeil(unbandedYMax) - 1; }
+
   // Get the number of arbitrary paths used by the clip region.
   int getNumPaths() { return length; }
 
@@ -142,6 +151,7 @@ protected:
   bool antialias;
   SplashCoord xMin, yMin, xMax, yMax;
   int xMinI, yMinI, xMaxI, yMaxI;
+  SplashCoord unbandedYMin, unbandedYMax;
   SplashXPath **paths;
   unsigned char *flags;
   SplashXPathScanner **scanners;
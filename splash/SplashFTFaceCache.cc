@@ -0,0 +1,222 @@
+//========================================================================
+//
+// SplashFTFaceCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <string.h>
+#include <sys/stat.h>
+#include "goo/GooString.h"
+#include "SplashFontFile.h"
+#include "SplashFTFaceCache.h"
+
+// default memory budget for the unused faces
+#define splashFTFaceCacheMaxBytes (32 * 1024 * 1024)
+
+// cost of a face in addition to its font data: the bookkeeping, and
+// the tables FreeType keeps for the face
+#define splashFTFaceCacheEntryBytes (8 * 1024)
+
+//------------------------------------------------------------------------
+
+// Digest of the font data (or of the name, size and modification time
+// of the font file) and the face index, which identifies the face
+// independently of the document and the font engine it is loaded from.
+static unsigned long long digestFontSrc(SplashFontSrc *src, int faceIndex,
+					long long fileSize, long long fileMTime) {
+  const unsigned char *p;
+  unsigned long long h, w;
+  size_t len, i;
+
+  if (src->isFile) {
+    p = (const unsigned char *)src->fileName->c_str();
+    len = src->fileName->getLength();
+  } else {
+    p = (const unsigned char *)src->buf;
+    len = src->bufLen;
+  }
+  h = 0xcbf29ce484222325ULL ^ ((unsigned long long)len << 1) ^ (src->isFile ? 1 : 0);
+  h = (h ^ (unsigned int)faceIndex) * 0x9e3779b97f4a7c15ULL;
+  h = (h ^ (unsigned long long)fileSize) * 0x9e3779b97f4a7c15ULL;
+  h = (h ^ (unsigned long long)fileMTime) * 0x9e3779b97f4a7c15ULL;
+  for (i = 0; i + 8 <= len; i += 8) {
+    memcpy(&w, p + i, 8);
+    h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 32;
+  }
+  for (; i < len; ++i) {
+    h = (h ^ p[i]) * 0x100000001b3ULL;
+  }
+  return h ^ (h >> 29);
+}
+
+//------------------------------------------------------------------------
+// SplashFTFaceCache
+//------------------------------------------------------------------------
+
+SplashFTFaceCache *SplashFTFaceCache::getCache() {
+  static SplashFTFaceCache cache(splashFTFaceCacheMaxBytes);
+
+  return &cache;
+}
+
+SplashFTFaceCache::SplashFTFaceCache(std::size_t maxBytesA) {
+  if (FT_Init_FreeType(&lib)) {
+    lib = nullptr;
+  }
+  maxBytes = maxBytesA;
+  unusedBytes = 0;
+}
+
+SplashFTFaceCache::~SplashFTFaceCache() {
+  clear();
+  // font files that outlive the cache still use their faces
+  if (lib && faces.empty()) {
+    FT_Done_FreeType(lib);
+  }
+}
+
+SplashFTSharedFace *SplashFTFaceCache::getFace(SplashFontSrc *src, int faceIndex) {
+  SplashFTSharedFace *face;
+  unsigned long long digest;
+  long long fileSize, fileMTime;
+  FT_Error err;
+
+  if (!lib) {
+    return nullptr;
+  }
+  // a font file of the same name may have been rewritten since
+  fileSize = fileMTime = 0;
+  if (src->isFile) {
+    struct stat st;
+    if (stat(src->fileName->c_str(), &st)) {
+      return nullptr;
+    }
+    fileSize = st.st_size;
+    fileMTime = st.st_mtime;
+  }
+  digest = digestFontSrc(src, faceIndex, fileSize, fileMTime);
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // the digest only picks the candidates, compare the data too
+  auto range = faces.equal_range(digest);
+  for (auto it = range.first; it != range.second; ++it) {
+    face = it->second;
+    if (face->isFile != src->isFile || face->faceIndex != faceIndex) {
+      continue;
+    }
+    if (src->isFile ? (face->fileName != src->fileName->c_str() ||
+		       face->fileSize != fileSize || face->fileMTime != fileMTime)
+	            : (face->dataLen != (size_t)src->bufLen ||
+		       memcmp(face->src ? face->src->buf : face->data.data(),
+			      src->buf, src->bufLen))) {
+      continue;
+    }
+    if (face->refCnt++ == 0) {
+      unused.erase(face->unusedPos);
+      unusedBytes -= face->dataLen + splashFTFaceCacheEntryBytes;
+    }
+    return face;
+  }
+
+  // FreeType needs the library to be locked while it creates a face
+  face = new SplashFTSharedFace();
+  face->digest = digest;
+  face->isFile = src->isFile;
+  face->faceIndex = faceIndex;
+  face->refCnt = 1;
+  face->fileSize = fileSize;
+  face->fileMTime = fileMTime;
+  face->src = nullptr;
+  face->dataLen = 0;
+  if (src->isFile) {
+    face->fileName = src->fileName->c_str();
+    err = FT_New_Face(lib, face->fileName.c_str(), faceIndex, &face->face);
+  } else {
+    // the face points into its data, which must outlive the document:
+    // keep the font source alive, or copy data the source doesn't own
+    const char *data;
+    if (src->getDeleteSrc()) {
+      src->ref();
+      face->src = src;
+      data = src->buf;
+    } else {
+      face->data.assign(src->buf, src->buf + src->bufLen);
+      data = face->data.data();
+    }
+    face->dataLen = src->bufLen;
+    err = FT_New_Memory_Face(lib, (const FT_Byte *)data, face->dataLen,
+			     faceIndex, &face->face);
+  }
+  if (err) {
+    if (face->src) {
+      face->src->unref();
+    }
+    delete face;
+    return nullptr;
+  }
+  faces.emplace(digest, face);
+  return face;
+}
+
+void SplashFTFaceCache::releaseFace(SplashFTSharedFace *face) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (--face->refCnt == 0) {
+    unused.push_front(face);
+    face->unusedPos = unused.begin();
+    unusedBytes += face->dataLen + splashFTFaceCacheEntryBytes;
+    evict();
+  }
+}
+
+void SplashFTFaceCache::setMaxBytes(std::size_t maxBytesA) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  maxBytes = maxBytesA;
+  evict();
+}
+
+std::size_t SplashFTFaceCache::getMaxBytes() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return maxBytes;
+}
+
+void SplashFTFaceCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  while (!unused.empty()) {
+    deleteFace(unused.back());
+  }
+}
+
+// The mutex must be locked, and the face unused.
+void SplashFTFaceCache::deleteFace(SplashFTSharedFace *face) {
+  unused.erase(face->unusedPos);
+  unusedBytes -= face->dataLen + splashFTFaceCacheEntryBytes;
+  auto range = faces.equal_range(face->digest);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == face) {
+      faces.erase(it);
+      break;
+    }
+  }
+  FT_Done_Face(face->face);
+  if (face->src) {
+    face->src->unref();
+  }
+  delete face;
+}
+
+// The mutex must be locked.
+void SplashFTFaceCache::evict() {
+  while (unusedBytes > maxBytes && !unused.empty()) {
+    deleteFace(unused.back());
+  }
+}
@@ -0,0 +1,117 @@
+//========================================================================
+//
+// SplashFTFaceCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHFTFACECACHE_H
+#define SPLASHFTFACECACHE_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+class SplashFontSrc;
+
+//------------------------------------------------------------------------
+// SplashFTSharedFace
+//------------------------------------------------------------------------
+
+// A FreeType face shared by all the font files loaded from the same
+// font data, in any font engine and thread.
+class SplashFTSharedFace {
+public:
+
+  SplashFTSharedFace(const SplashFTSharedFace &) = delete;
+  SplashFTSharedFace& operator=(const SplashFTSharedFace &) = delete;
+
+  FT_Face face;
+  unsigned long long digest;	// identifies the font data and face index
+  std::mutex mutex;		// must be locked while using face
+
+private:
+
+  SplashFTSharedFace() {}
+
+  bool isFile;
+  std::string fileName;		// if isFile
+  long long fileSize;		// if isFile
+  long long fileMTime;		// if isFile
+  SplashFontSrc *src;		// if !isFile and src owns its data; face
+				//   points into src->buf
+  std::vector<char> data;	// if !isFile and src doesn't own its
+				//   data; face points into it
+  std::size_t dataLen;		// font data size
+  int faceIndex;
+  int refCnt;			// number of font files using the face
+  std::list<SplashFTSharedFace *>::iterator unusedPos;	// if refCnt == 0
+
+  friend class SplashFTFaceCache;
+};
+
+//------------------------------------------------------------------------
+// SplashFTFaceCache
+//------------------------------------------------------------------------
+
+// Process-wide cache of FreeType faces, keyed by a digest of the font
+// data (or of the path, size and modification time of the font file,
+// which may be a temporary file reused for other fonts).  Documents
+// processed one after the other (or at the same time, in other threads)
+// often embed the same fonts; their font files share one face instead
+// of each parsing the font program again.  Faces that no font file uses
+// anymore are kept around until the total size of their font data goes
+// over the memory budget.  All the faces belong to one FT_Library,
+// which the font engines share as well.
+class SplashFTFaceCache {
+public:
+
+  // The cache used by all the font engines.
+  static SplashFTFaceCache *getCache();
+
+  SplashFTFaceCache(std::size_t maxBytesA);
+  ~SplashFTFaceCache();
+
+  SplashFTFaceCache(const SplashFTFaceCache &) = delete;
+  SplashFTFaceCache& operator=(const SplashFTFaceCache &) = delete;
+
+  // The library the faces are loaded with.  Returns nullptr if
+  // FreeType couldn't be initialized.
+  FT_Library getLibrary() { return lib; }
+
+  // Get the face <faceIndex> of the font in <src>, loading it if
+  // there's none with the same data yet.  Returns nullptr if FreeType
+  // can't load the font.  The face must be released with releaseFace.
+  SplashFTSharedFace *getFace(SplashFontSrc *src, int faceIndex);
+
+  // Drop a reference returned by getFace.
+  void releaseFace(SplashFTSharedFace *face);
+
+  // Set the memory budget for unused faces, in bytes; 0 frees the
+  // faces as soon as they aren't used anymore.
+  void setMaxBytes(std::size_t maxBytesA);
+  std::size_t getMaxBytes();
+
+  // Free all the unused faces.
+  void clear();
+
+private:
+
+  void deleteFace(SplashFTSharedFace *face);
+  void evict();
+
+  std::mutex mutex;
+  FT_Library lib;
+  std::unordered_multimap<unsigned long long, SplashFTSharedFace *> faces;
+  std::list<SplashFTSharedFace *> unused;	// most recently used first
+  std::size_t maxBytes;
+  std::size_t unusedBytes;
+};
+
+#endif
@@ -31,12 +31,15 @@
 #include FT_OUTLINE_H
 #include FT_SIZES_H
 #include FT_GLYPH_H
+#include <mutex>
 #include "goo/gmem.h"
 #include "SplashMath.h"
 #include "SplashGlyphBitmap.h"
 #include "SplashPath.h"
+#include "SplashFTFaceCache.h"
 #include "SplashFTFontEngine.h"
 #include "SplashFTFontFile.h"
+#include "SplashGlyphCache.h"
 #include "SplashFTFont.h"
 
 #include "goo/GooLikely.h"
@@ -57,6 +60,7 @@ static int glyphPathCubicTo(const FT_Vector *ctrl1, const FT_Vector *ctrl2,
 SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA,
 			   const SplashCoord *textMatA):
   SplashFont(fontFileA, matA, textMatA, fontFileA->engine->aa), 
+  sizeObj(nullptr),
   textScale(0),
   enableFreeTypeHinting(fontFileA->engine->enableFreeTypeHinting),
   enableSlightHinting(fontFileA->engine->enableSlightHinting),
@@ -67,7 +71,9 @@ SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA,
   int x, y;
 
   face = fontFileA->face;
+  std::lock_guard<std::mutex> lock(fontFileA->sharedFace->mutex);
   if (FT_New_Size(face, &sizeObj)) {
+    sizeObj = nullptr;
     return;
   }
   face->size = sizeObj;
@@ -163,6 +169,14 @@ SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA,
 }
 
 SplashFTFont::~SplashFTFont() {
+  SplashFTFontFile *ff;
+
+  // the face may outlive this font, so don't leave the size behind
+  if (sizeObj) {
+    ff = (SplashFTFontFile *)fontFile;
+    std::lock_guard<std::mutex> lock(ff->sharedFace->mutex);
+    FT_Done_Size(sizeObj);
+  }
 }
 
 bool SplashFTFont::getGlyph(int c, int xFrac, int yFrac,
@@ -199,6 +213,35 @@ static FT_Int32 getFTLoadFlags(bool type1, bool trueType, bool aa, bool enableFr
   return ret;
 }
 
+bool SplashFTFont::getGlyphCacheKey(int c, int xFrac, int yFrac,
+				    SplashGlyphCacheKey *key) {
+  SplashFTFontFile *ff;
+
+  if (unlikely(!isOk)) {
+    return false;
+  }
+
+  ff = (SplashFTFontFile *)fontFile;
+
+  // key on the glyph index, so that fonts sharing the font data but
+  // not the encoding still share their glyphs
+  key->fontDigest = ff->digest;
+  if (ff->codeToGID && c < ff->codeToGIDLen && c >= 0) {
+    key->gid = (unsigned int)ff->codeToGID[c];
+  } else {
+    key->gid = (unsigned int)c;
+  }
+  key->loadFlags = getFTLoadFlags(ff->type1, ff->trueType, aa, enableFreeTypeHinting, enableSlightHinting);
+  key->aa = aa;
+  key->xFrac = xFrac;
+  key->yFrac = yFrac;
+  key->mat[0] = mat[0];
+  key->mat[1] = mat[1];
+  key->mat[2] = mat[2];
+  key->mat[3] = mat[3];
+  return true;
+}
+
 bool SplashFTFont::makeGlyph(int c, int xFrac, int yFrac,
 			      SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes) {
   SplashFTFontFile *ff;
@@ -215,6 +258,7 @@ bool SplashFTFont::makeGlyph(int c, int xFrac, int yFrac,
 
   ff = (SplashFTFontFile *)fontFile;
 
+  std::lock_guard<std::mutex> lock(ff->sharedFace->mutex);
   ff->face->size = sizeObj;
   offset.x = (FT_Pos)(int)((SplashCoord)xFrac * splashFontFractionMul * 64);
   offset.y = 0;
@@ -303,6 +347,7 @@ double SplashFTFont::getGlyphAdvance(int c)
   offset.x = 0;
   offset.y = 0;
 
+  std::lock_guard<std::mutex> lock(ff->sharedFace->mutex);
   ff->face->size = sizeObj;
   FT_Set_Transform(ff->face, &identityMatrix, &offset);
 
@@ -352,6 +397,7 @@ SplashPath *SplashFTFont::getGlyphPath(int c) {
   }
 
   ff = (SplashFTFontFile *)fontFile;
+  std::lock_guard<std::mutex> lock(ff->sharedFace->mutex);
   ff->face->size = sizeObj;
   FT_Set_Transform(ff->face, &textMatrix, nullptr);
   slot = ff->face->glyph;
@@ -49,6 +49,9 @@ public:
   bool getGlyph(int c, int xFrac, int yFrac,
 		 SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes) override;
 
+  bool getGlyphCacheKey(int c, int xFrac, int yFrac,
+			SplashGlyphCacheKey *key) override;
+
   // Rasterize a glyph.  The <xFrac> and <yFrac> values are the same
   // as described for getGlyph.
   bool makeGlyph(int c, int xFrac, int yFrac,
@@ -34,6 +34,7 @@
 #include "goo/gfile.h"
 #include "fofi/FoFiTrueType.h"
 #include "fofi/FoFiType1C.h"
+#include "SplashFTFaceCache.h"
 #include "SplashFTFontFile.h"
 #include "SplashFTFontEngine.h"
 
@@ -60,14 +61,15 @@ SplashFTFontEngine *SplashFTFontEngine::init(bool aaA, bool enableFreeTypeHintin
 					     bool enableSlightHintingA) {
   FT_Library libA;
 
-  if (FT_Init_FreeType(&libA)) {
+  // the faces are shared between the engines, so they use the same
+  // library
+  if (!(libA = SplashFTFaceCache::getCache()->getLibrary())) {
     return nullptr;
   }
   return new SplashFTFontEngine(aaA, enableFreeTypeHintingA, enableSlightHintingA, libA);
 }
 
 SplashFTFontEngine::~SplashFTFontEngine() {
-  FT_Done_FreeType(lib);
 }
 
 SplashFontFile *SplashFTFontEngine::loadType1Font(SplashFontFileID *idA,
@@ -23,9 +23,12 @@
 
 #include <config.h>
 
+#include <string.h>
+#include <mutex>
 #include "goo/gmem.h"
 #include "goo/GooString.h"
 #include "poppler/GfxFont.h"
+#include "SplashFTFaceCache.h"
 #include "SplashFTFontEngine.h"
 #include "SplashFTFont.h"
 #include "SplashFTFontFile.h"
@@ -38,27 +41,24 @@ SplashFontFile *SplashFTFontFile::loadType1Font(SplashFTFontEngine *engineA,
 						SplashFontFileID *idA,
 						SplashFontSrc *src,
 						const char **encA) {
-  FT_Face faceA;
+  SplashFTSharedFace *faceA;
   int *codeToGIDA;
   const char *name;
   int i;
 
-  if (src->isFile) {
-    if (FT_New_Face(engineA->lib, src->fileName->c_str(), 0, &faceA))
-      return nullptr;
-  } else {
-    if (FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf, src->bufLen, 0, &faceA))
-      return nullptr;
+  if (!(faceA = SplashFTFaceCache::getCache()->getFace(src, 0))) {
+    return nullptr;
   }
+  std::lock_guard<std::mutex> lock(faceA->mutex);
   codeToGIDA = (int *)gmallocn(256, sizeof(int));
   for (i = 0; i < 256; ++i) {
     codeToGIDA[i] = 0;
     if ((name = encA[i])) {
-      codeToGIDA[i] = (int)FT_Get_Name_Index(faceA, (char *)name);
+      codeToGIDA[i] = (int)FT_Get_Name_Index(faceA->face, (char *)name);
       if (codeToGIDA[i] == 0) {
 	name = GfxFont::getAlternateName(name);
 	if (name) {
-	  codeToGIDA[i] = FT_Get_Name_Index(faceA, (char *)name);
+	  codeToGIDA[i] = FT_Get_Name_Index(faceA->face, (char *)name);
 	}
       }
     }
@@ -73,14 +73,10 @@ SplashFontFile *SplashFTFontFile::loadCIDFont(SplashFTFontEngine *engineA,
 					      SplashFontSrc *src,
 					      int *codeToGIDA,
 					      int codeToGIDLenA) {
-  FT_Face faceA;
-
-  if (src->isFile) {
-    if (FT_New_Face(engineA->lib, src->fileName->c_str(), 0, &faceA))
-      return nullptr;
-  } else {
-    if (FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf, src->bufLen, 0, &faceA))
-      return nullptr;
+  SplashFTSharedFace *faceA;
+
+  if (!(faceA = SplashFTFaceCache::getCache()->getFace(src, 0))) {
+    return nullptr;
   }
 
   return new SplashFTFontFile(engineA, idA, src,
@@ -93,14 +89,10 @@ SplashFontFile *SplashFTFontFile::loadTrueTypeFont(SplashFTFontEngine *engineA,
 						   int *codeToGIDA,
 						   int codeToGIDLenA,
 						   int faceIndexA) {
-  FT_Face faceA;
-
-  if (src->isFile) {
-    if (FT_New_Face(engineA->lib, src->fileName->c_str(), faceIndexA, &faceA))
-      return nullptr;
-  } else {
-    if (FT_New_Memory_Face(engineA->lib, (const FT_Byte *)src->buf, src->bufLen, faceIndexA, &faceA))
-      return nullptr;
+  SplashFTSharedFace *faceA;
+
+  if (!(faceA = SplashFTFaceCache::getCache()->getFace(src, faceIndexA))) {
+    return nullptr;
   }
 
   return new SplashFTFontFile(engineA, idA, src,
@@ -110,13 +102,15 @@ SplashFontFile *SplashFTFontFile::loadTrueTypeFont(SplashFTFontEngine *engineA,
 SplashFTFontFile::SplashFTFontFile(SplashFTFontEngine *engineA,
 				   SplashFontFileID *idA,
 				   SplashFontSrc *srcA,
-				   FT_Face faceA,
+				   SplashFTSharedFace *sharedFaceA,
 				   int *codeToGIDA, int codeToGIDLenA,
 				   bool trueTypeA, bool type1A):
   SplashFontFile(idA, srcA)
 {
   engine = engineA;
-  face = faceA;
+  sharedFace = sharedFaceA;
+  face = sharedFace->face;
+  digest = sharedFace->digest;
   codeToGID = codeToGIDA;
   codeToGIDLen = codeToGIDLenA;
   trueType = trueTypeA;
@@ -124,9 +118,7 @@ SplashFTFontFile::SplashFTFontFile(SplashFTFontEngine *engineA,
 }
 
 SplashFTFontFile::~SplashFTFontFile() {
-  if (face) {
-    FT_Done_Face(face);
-  }
+  SplashFTFaceCache::getCache()->releaseFace(sharedFace);
   if (codeToGID) {
     gfree(codeToGID);
   }
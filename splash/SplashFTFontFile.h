@@ -29,6 +29,7 @@
 
 class SplashFontFileID;
 class SplashFTFontEngine;
+class SplashFTSharedFace;
 
 //------------------------------------------------------------------------
 // SplashFTFontFile
@@ -63,12 +64,17 @@ private:
   SplashFTFontFile(SplashFTFontEngine *engineA,
 		   SplashFontFileID *idA,
 		   SplashFontSrc *src,
-		   FT_Face faceA,
+		   SplashFTSharedFace *sharedFaceA,
 		   int *codeToGIDA, int codeToGIDLenA,
 		   bool trueTypeA, bool type1A);
 
   SplashFTFontEngine *engine;
-  FT_Face face;
+  SplashFTSharedFace *sharedFace;	// shared with the other font files
+				//   loaded from the same font data
+  FT_Face face;			// sharedFace->face; lock sharedFace->mutex
+				//   while using it
+  unsigned long long digest;	// identifies the font data and face,
+				//   for the shared glyph cache
   int *codeToGID;
   int codeToGIDLen;
   bool trueType;
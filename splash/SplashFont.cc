@@ -26,6 +26,7 @@
 #include "goo/gmem.h"
 #include "SplashMath.h"
 #include "SplashGlyphBitmap.h"
+#include "SplashGlyphCache.h"
 #include "SplashFontFile.h"
 #include "SplashFont.h"
 
@@ -119,8 +120,9 @@ SplashFont::~SplashFont() {
 bool SplashFont::getGlyph(int c, int xFrac, int yFrac,
 			   SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes) {
   SplashGlyphBitmap bitmap2;
+  SplashGlyphCacheKey key;
+  bool shared;
   int size;
-  unsigned char *p;
   int i, j, k;
 
   // no fractional coordinates for large glyphs or non-anti-aliased
@@ -161,6 +163,31 @@ bool SplashFont::getGlyph(int c, int xFrac, int yFrac,
     }
   }
 
+  // check the cache shared with the other fonts, which another page,
+  // output device or thread may have filled
+  shared = cacheAssoc > 0 && getGlyphCacheKey(c, xFrac, yFrac, &key);
+  if (shared) {
+    std::shared_ptr<const SplashCachedGlyph> glyph =
+      SplashGlyphCache::getCache()->lookup(key);
+    if (glyph && glyph->w <= glyphW && glyph->h <= glyphH) {
+      bitmap->x = glyph->x;
+      bitmap->y = glyph->y;
+      bitmap->w = glyph->w;
+      bitmap->h = glyph->h;
+      bitmap->aa = aa;
+      bitmap->data = insertCache(i, c, xFrac, yFrac, bitmap,
+				 glyph->data.data(), (int)glyph->data.size());
+      bitmap->freeData = false;
+
+      *clipRes = clip->testRect(x0 - bitmap->x,
+                                y0 - bitmap->y,
+                                x0 - bitmap->x + bitmap->w - 1,
+                                y0 - bitmap->y + bitmap->h - 1);
+
+      return true;
+    }
+  }
+
   // generate the glyph bitmap
   if (!makeGlyph(c, xFrac, yFrac, &bitmap2, x0, y0, clip, clipRes)) {
     return false;
@@ -186,7 +213,6 @@ bool SplashFont::getGlyph(int c, int xFrac, int yFrac,
   } else {
     size = ((bitmap2.w + 7) >> 3) * bitmap2.h;
   }
-  p = nullptr; // make gcc happy
   if (cacheAssoc == 0)
   {
     // we had problems on the malloc of the cache, so ignore it
@@ -194,24 +220,14 @@ bool SplashFont::getGlyph(int c, int xFrac, int yFrac,
   }
   else
   {
-    for (j = 0; j < cacheAssoc; ++j) {
-      if ((cacheTags[i+j].mru & 0x7fffffff) == cacheAssoc - 1) {
-        cacheTags[i+j].mru = 0x80000000;
-        cacheTags[i+j].c = c;
-        cacheTags[i+j].xFrac = (short)xFrac;
-        cacheTags[i+j].yFrac = (short)yFrac;
-        cacheTags[i+j].x = bitmap2.x;
-        cacheTags[i+j].y = bitmap2.y;
-        cacheTags[i+j].w = bitmap2.w;
-        cacheTags[i+j].h = bitmap2.h;
-        p = cache + (i+j) * glyphSize;
-        memcpy(p, bitmap2.data, size);
-      } else {
-        ++cacheTags[i+j].mru;
-      }
+    if (shared) {
+      SplashGlyphCache::getCache()->put(key, bitmap2.x, bitmap2.y,
+					bitmap2.w, bitmap2.h,
+					bitmap2.data, size);
     }
     *bitmap = bitmap2;
-    bitmap->data = p;
+    bitmap->data = insertCache(i, c, xFrac, yFrac, &bitmap2,
+			       bitmap2.data, size);
     bitmap->freeData = false;
     if (bitmap2.freeData) {
       gfree(bitmap2.data);
@@ -219,3 +235,29 @@ bool SplashFont::getGlyph(int c, int xFrac, int yFrac,
   }
   return true;
 }
+
+unsigned char *SplashFont::insertCache(int i, int c, int xFrac, int yFrac,
+				       const SplashGlyphBitmap *bitmap,
+				       const unsigned char *data, int size) {
+  unsigned char *p;
+  int j;
+
+  p = nullptr; // make gcc happy
+  for (j = 0; j < cacheAssoc; ++j) {
+    if ((cacheTags[i+j].mru & 0x7fffffff) == cacheAssoc - 1) {
+      cacheTags[i+j].mru = 0x80000000;
+      cacheTags[i+j].c = c;
+      cacheTags[i+j].xFrac = (short)xFrac;
+      cacheTags[i+j].yFrac = (short)yFrac;
+      cacheTags[i+j].x = bitmap->x;
+      cacheTags[i+j].y = bitmap->y;
+      cacheTags[i+j].w = bitmap->w;
+      cacheTags[i+j].h = bitmap->h;
+      p = cache + (i+j) * glyphSize;
+      memcpy(p, data, size);
+    } else {
+      ++cacheTags[i+j].mru;
+    }
+  }
+  return p;
+}
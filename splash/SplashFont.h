@@ -27,6 +27,7 @@
 
 struct SplashGlyphBitmap;
 struct SplashFontCacheTag;
+struct SplashGlyphCacheKey;
 class SplashFontFile;
 class SplashPath;
 
@@ -80,6 +81,12 @@ public:
   virtual bool getGlyph(int c, int xFrac, int yFrac,
 			 SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes);
 
+  // Fill in the key identifying a glyph in the cache shared by all
+  // fonts (see SplashGlyphCache).  Returns false if the glyph can't be
+  // shared.
+  virtual bool getGlyphCacheKey(int c, int xFrac, int yFrac,
+				SplashGlyphCacheKey *key) { return false; }
+
   // Rasterize a glyph.  The <xFrac> and <yFrac> values are the same
   // as described for getGlyph.
   virtual bool makeGlyph(int c, int xFrac, int yFrac,
@@ -101,6 +108,12 @@ public:
 
 protected:
 
+  // Store a glyph bitmap in the least recently used entry of cache set
+  // <i>, and return the cached copy of <data>.
+  unsigned char *insertCache(int i, int c, int xFrac, int yFrac,
+			     const SplashGlyphBitmap *bitmap,
+			     const unsigned char *data, int size);
+
   SplashFontFile *fontFile;
   SplashCoord mat[4];		// font transform matrix
 				//   (text space -> device space)
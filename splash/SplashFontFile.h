@@ -22,6 +22,7 @@
 #ifndef SPLASHFONTFILE_H
 #define SPLASHFONTFILE_H
 
+#include <atomic>
 #include "SplashTypes.h"
 
 class GooString;
@@ -47,6 +48,9 @@ public:
   void ref();
   void unref();
 
+  // Is the file or buffer deleted along with the font source?
+  bool getDeleteSrc() const { return deleteSrc; }
+
   bool isFile;
   GooString *fileName;
   char *buf;
@@ -54,7 +58,7 @@ public:
 
 private:
   ~SplashFontSrc();
-  int refcnt;
+  std::atomic_int refcnt;
   bool deleteSrc;
 };
 
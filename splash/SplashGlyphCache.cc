@@ -0,0 +1,134 @@
+//========================================================================
+//
+// SplashGlyphCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <functional>
+#include "SplashGlyphCache.h"
+
+// default memory budget of the shared cache
+#define splashGlyphCacheMaxBytes (16 * 1024 * 1024)
+
+// bookkeeping cost of an entry, in addition to its bitmap
+#define splashGlyphCacheEntryBytes \
+  (sizeof(SplashCachedGlyph) + 4 * sizeof(void *) + 64)
+
+//------------------------------------------------------------------------
+// SplashGlyphCacheKey
+//------------------------------------------------------------------------
+
+bool SplashGlyphCacheKey::operator==(const SplashGlyphCacheKey &key) const {
+  return fontDigest == key.fontDigest && gid == key.gid &&
+         loadFlags == key.loadFlags && aa == key.aa &&
+         xFrac == key.xFrac && yFrac == key.yFrac &&
+         mat[0] == key.mat[0] && mat[1] == key.mat[1] &&
+         mat[2] == key.mat[2] && mat[3] == key.mat[3];
+}
+
+std::size_t SplashGlyphCacheKeyHash::operator()(const SplashGlyphCacheKey &key) const {
+  std::hash<SplashCoord> coordHash;
+  unsigned long long h;
+  int i;
+
+  h = key.fontDigest ^ 0x9e3779b97f4a7c15ULL;
+  h = (h ^ key.gid) * 0x100000001b3ULL;
+  h = (h ^ (unsigned int)key.loadFlags) * 0x100000001b3ULL;
+  h = (h ^ (key.aa ? 1 : 0)) * 0x100000001b3ULL;
+  h = (h ^ (unsigned int)((key.xFrac << 8) | key.yFrac)) * 0x100000001b3ULL;
+  for (i = 0; i < 4; ++i) {
+    h = (h ^ coordHash(key.mat[i])) * 0x100000001b3ULL;
+  }
+  return (std::size_t)(h ^ (h >> 32));
+}
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+SplashGlyphCache *SplashGlyphCache::getCache() {
+  static SplashGlyphCache cache(splashGlyphCacheMaxBytes);
+
+  return &cache;
+}
+
+SplashGlyphCache::SplashGlyphCache(std::size_t maxBytesA) {
+  maxBytes = maxBytesA;
+  bytes = 0;
+}
+
+std::shared_ptr<const SplashCachedGlyph> SplashGlyphCache::lookup(const SplashGlyphCacheKey &key) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = index.find(key);
+  if (it == index.end()) {
+    return nullptr;
+  }
+  if (it->second != entries.begin()) {
+    entries.splice(entries.begin(), entries, it->second);
+  }
+  return it->second->glyph;
+}
+
+void SplashGlyphCache::put(const SplashGlyphCacheKey &key, int x, int y, int w, int h,
+			   const unsigned char *data, std::size_t dataLen) {
+  // copy the bitmap before taking the lock
+  std::shared_ptr<SplashCachedGlyph> glyph = std::make_shared<SplashCachedGlyph>();
+  glyph->x = x;
+  glyph->y = y;
+  glyph->w = w;
+  glyph->h = h;
+  glyph->data.assign(data, data + dataLen);
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // another thread may have rasterized the same glyph meanwhile
+  if (dataLen + splashGlyphCacheEntryBytes > maxBytes ||
+      index.find(key) != index.end()) {
+    return;
+  }
+  entries.push_front(Entry{key, glyph});
+  index.emplace(key, entries.begin());
+  bytes += dataLen + splashGlyphCacheEntryBytes;
+  evict();
+}
+
+void SplashGlyphCache::setMaxBytes(std::size_t maxBytesA) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  maxBytes = maxBytesA;
+  evict();
+}
+
+std::size_t SplashGlyphCache::getMaxBytes() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return maxBytes;
+}
+
+std::size_t SplashGlyphCache::getBytes() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return bytes;
+}
+
+void SplashGlyphCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  index.clear();
+  entries.clear();
+  bytes = 0;
+}
+
+// The mutex must be locked.
+void SplashGlyphCache::evict() {
+  while (bytes > maxBytes && !entries.empty()) {
+    bytes -= entries.back().glyph->data.size() + splashGlyphCacheEntryBytes;
+    index.erase(entries.back().key);
+    entries.pop_back();
+  }
+}
@@ -0,0 +1,100 @@
+//========================================================================
+//
+// SplashGlyphCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHGLYPHCACHE_H
+#define SPLASHGLYPHCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "SplashTypes.h"
+
+//------------------------------------------------------------------------
+// SplashGlyphCacheKey
+//------------------------------------------------------------------------
+
+struct SplashGlyphCacheKey {
+  unsigned long long fontDigest;	// identifies the font data and face
+  unsigned int gid;
+  int loadFlags;		// rasterizer flags, including hinting
+  bool aa;
+  int xFrac, yFrac;
+  SplashCoord mat[4];		// font transform matrix
+
+  bool operator==(const SplashGlyphCacheKey &key) const;
+};
+
+struct SplashGlyphCacheKeyHash {
+  std::size_t operator()(const SplashGlyphCacheKey &key) const;
+};
+
+//------------------------------------------------------------------------
+// SplashCachedGlyph
+//------------------------------------------------------------------------
+
+struct SplashCachedGlyph {
+  int x, y, w, h;		// offset and size of the glyph
+  std::vector<unsigned char> data;
+};
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+// Process-wide cache of rasterized glyphs, shared by all font engines
+// (and therefore by all output devices, pages and threads).  It backs
+// the small per-font caches in SplashFont: a glyph that another font
+// instance already rasterized is copied from here instead of being
+// rendered again.  The least recently used glyphs are dropped when the
+// total size of the bitmaps goes over the memory budget.
+class SplashGlyphCache {
+public:
+
+  // The cache used by all the fonts.
+  static SplashGlyphCache *getCache();
+
+  SplashGlyphCache(std::size_t maxBytesA);
+
+  SplashGlyphCache(const SplashGlyphCache &) = delete;
+  SplashGlyphCache& operator=(const SplashGlyphCache &) = delete;
+
+  // Returns nullptr if the glyph isn't cached.
+  std::shared_ptr<const SplashCachedGlyph> lookup(const SplashGlyphCacheKey &key);
+
+  // Add a glyph bitmap of <dataLen> bytes.
+  void put(const SplashGlyphCacheKey &key, int x, int y, int w, int h,
+	   const unsigned char *data, std::size_t dataLen);
+
+  // Set the memory budget, in bytes; 0 disables the cache.
+  void setMaxBytes(std::size_t maxBytesA);
+  std::size_t getMaxBytes();
+  std::size_t getBytes();
+
+  void clear();
+
+private:
+
+  struct Entry {
+    SplashGlyphCacheKey key;
+    std::shared_ptr<const SplashCachedGlyph> glyph;
+  };
+
+  void evict();
+
+  std::mutex mutex;
+  std::list<Entry> entries;	// most recently used first
+  std::unordered_map<SplashGlyphCacheKey, std::list<Entry>::iterator,
+		     SplashGlyphCacheKeyHash> index;
+  std::size_t maxBytes;
+  std::size_t bytes;
+};
+
+#endif
@@ -84,6 +84,7 @@ SplashState::SplashState(int width, int height, bool vectorAntialias,
     for (int cp = 0; cp < SPOT_NCOMPS+4; cp++)
       deviceNTransfer[cp][i] = (unsigned char)i;
   }
+  identityTransfer = true;
   overprintMask = 0xffffffff;
   overprintAdditive = false;
   next = nullptr;
@@ -135,6 +136,7 @@ SplashState::SplashState(int width, int height, bool vectorAntialias,
     for (int cp = 0; cp < SPOT_NCOMPS+4; cp++)
       deviceNTransfer[cp][i] = (unsigned char)i;
   }
+  identityTransfer = true;
   overprintMask = 0xffffffff;
   overprintAdditive = false;
   next = nullptr;
@@ -183,6 +185,7 @@ SplashState::SplashState(SplashState *state) {
   memcpy(cmykTransferK, state->cmykTransferK, 256);
   for (int cp = 0; cp < SPOT_NCOMPS+4; cp++)
     memcpy(deviceNTransfer[cp], state->deviceNTransfer[cp], 256);
+  identityTransfer = state->identityTransfer;
   overprintMask = state->overprintMask;
   overprintAdditive = state->overprintAdditive;
   next = nullptr;
@@ -253,4 +256,11 @@ void SplashState::setTransfer(unsigned char *red, unsigned char *green, unsigned
   memcpy(rgbTransferG, green, 256);
   memcpy(rgbTransferB, blue, 256);
   memcpy(grayTransfer, gray, 256);
+  identityTransfer = true;
+  for (int i = 0; i < 256 && identityTransfer; ++i) {
+    identityTransfer = rgbTransferR[i] == i && rgbTransferG[i] == i &&
+                       rgbTransferB[i] == i && grayTransfer[i] == i &&
+                       cmykTransferC[i] == i && cmykTransferM[i] == i &&
+                       cmykTransferY[i] == i && cmykTransferK[i] == i;
+  }
 }
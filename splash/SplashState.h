@@ -130,6 +130,7 @@ private:
          cmykTransferY[256],
          cmykTransferK[256];
   unsigned char deviceNTransfer[SPOT_NCOMPS+4][256];
+  bool identityTransfer;	// rgb, gray and cmyk transfers are the identity
   unsigned int overprintMask;
   bool overprintAdditive;
 
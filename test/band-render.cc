@@ -0,0 +1,101 @@
+//========================================================================
+//
+// band-render.cc
+//
+// Checks that SplashOutputDev::displayPageSliceBands() draws a page
+// exactly like a single pass does, including transparency groups that
+// span several bands.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "splash/SplashBitmap.h"
+#include "build-pdf.h"
+
+// Build a one page document with paths, a shading and a non-isolated
+// transparency group covering most of the page.
+static std::string makeDocument() {
+  const std::string content =
+    "0.2 0.6 0.9 rg 5 5 90 90 re f "
+    "q 1 0 0 RG 3 w 5 95 m 95 5 l S Q "
+    "q 10 50 80 40 re W n /Sh0 sh Q "
+    "q /GS0 gs /Fm0 Do Q";
+  const std::string form =
+    "0 0.5 0 rg 20 20 60 60 re f "
+    "/GS1 gs 1 1 0 rg 40 10 20 80 re f";
+
+  return buildPDF({"<< /Type /Catalog /Pages 2 0 R >>",
+                   "<< /Type /Pages /Count 1 /Kids [4 0 R] >>",
+                   buildPDFStream("", content),
+                   "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] /Contents 3 0 R "
+                   "/Resources << /XObject << /Fm0 5 0 R >> "
+                   "/ExtGState << /GS0 << /ca 0.6 /BM /Multiply >> >> "
+                   "/Shading << /Sh0 << /ShadingType 2 /ColorSpace /DeviceRGB "
+                   "/Coords [10 0 90 0] /Function << /FunctionType 2 /Domain [0 1] "
+                   "/C0 [1 0 0] /C1 [0 0 1] /N 1 >> >> >> >> >>",
+                   buildPDFStream("/Type /XObject /Subtype /Form /BBox [0 0 100 100] "
+                                  "/Group << /S /Transparency /CS /DeviceRGB >> "
+                                  "/Resources << /ExtGState << /GS1 << /ca 0.5 /BM /Screen >> >> >>",
+                                  form)});
+}
+
+// Draw the page in <nBands> bands, and return the bitmap.
+static std::string drawPage(PDFDoc *doc, SplashColorMode mode, int nBands) {
+  const int size = 400;		// pixels, at 288 dpi
+  SplashColor paperColor;
+  paperColor[0] = paperColor[1] = paperColor[2] = paperColor[3] = 0xff;
+  SplashOutputDev *splashOut = new SplashOutputDev(mode, 4, false, paperColor);
+  splashOut->startDoc(doc);
+  splashOut->displayPageSliceBands(doc, 1, 288, 288, 0, true, false, false,
+                                   0, 0, size, size, nBands);
+  SplashBitmap *bitmap = splashOut->getBitmap();
+  std::string data((const char *)bitmap->getDataPtr(),
+                   bitmap->getRowSize() * bitmap->getHeight());
+  delete splashOut;
+  return data;
+}
+
+static bool checkBands(PDFDoc *doc, const char *name, SplashColorMode mode) {
+  const std::string single = drawPage(doc, mode, 1);
+  const std::string bands = drawPage(doc, mode, 4);
+  const bool ok = !single.empty() && single == bands;
+  printf("%-8s %s\n", name, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  bool ok = true;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(true);
+
+  std::string pdf = makeDocument();
+  PDFDoc *doc = openPDF(&pdf);
+  if (!doc->isOk()) {
+    fprintf(stderr, "error loading the document\n");
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+
+  ok &= checkBands(doc, "Mono8", splashModeMono8);
+  ok &= checkBands(doc, "RGB8", splashModeRGB8);
+  ok &= checkBands(doc, "XBGR8", splashModeXBGR8);
+#ifdef SPLASH_CMYK
+  ok &= checkBands(doc, "CMYK8", splashModeCMYK8);
+#endif
+
+  delete doc;
+  delete globalParams;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+//========================================================================
+//
+// build-pdf.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <stdio.h>
+#include "Object.h"
+#include "PDFDoc.h"
+#include "Stream.h"
+#include "build-pdf.h"
+
+std::string buildPDF(const std::vector<std::string> &objs) {
+  std::vector<size_t> offsets;
+  std::string pdf;
+  char buf[256];
+
+  pdf = "%PDF-1.4\n";
+  for (size_t i = 0; i < objs.size(); ++i) {
+    offsets.push_back(pdf.size());
+    snprintf(buf, sizeof(buf), "%d 0 obj\n", (int)i + 1);
+    pdf += buf + objs[i] + "\nendobj\n";
+  }
+  const size_t xrefOffset = pdf.size();
+  snprintf(buf, sizeof(buf), "xref\n0 %d\n0000000000 65535 f \n", (int)objs.size() + 1);
+  pdf += buf;
+  for (size_t offset : offsets) {
+    snprintf(buf, sizeof(buf), "%010d 00000 n \n", (int)offset);
+    pdf += buf;
+  }
+  snprintf(buf, sizeof(buf), "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%d\n%%%%EOF\n",
+           (int)objs.size() + 1, (int)xrefOffset);
+  return pdf + buf;
+}
+
+std::string buildPDFStream(const std::string &dict, const std::string &data) {
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), "/Length %d", (int)data.size());
+  return "<< " + dict + (dict.empty() ? "" : " ") + buf + " >>\nstream\n" + data + "\nendstream";
+}
+
+PDFDoc *openPDF(std::string *pdf) {
+  return new PDFDoc(new MemStream(&(*pdf)[0], 0, pdf->size(), Object(objNull)));
+}
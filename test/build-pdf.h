@@ -0,0 +1,29 @@
+//========================================================================
+//
+// build-pdf.h
+//
+// Builds small PDF documents in memory for the unit tests.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef BUILD_PDF_H
+#define BUILD_PDF_H
+
+#include <string>
+#include <vector>
+
+class PDFDoc;
+
+// Write <objs> out as a PDF file with a cross-reference table.  objs[i]
+// is object i + 1, and object 1 must be the catalog.
+std::string buildPDF(const std::vector<std::string> &objs);
+
+// A stream object with the entries <dict> (besides /Length) and <data>.
+std::string buildPDFStream(const std::string &dict, const std::string &data);
+
+// Open a document made by buildPDF.  <pdf> must outlive the document.
+PDFDoc *openPDF(std::string *pdf);
+
+#endif
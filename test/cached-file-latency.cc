@@ -0,0 +1,157 @@
+//========================================================================
+//
+// cached-file-latency.cc
+//
+// Measures how long it takes to walk the pages of a document read
+// through a CachedFile whose loader has the latency of a remote server,
+// with and without the page prefetching of linearized documents, and
+// with a chunk store on disk.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "CachedFile.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "PDFDoc.h"
+#include "Stream.h"
+#include "TextOutputDev.h"
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "goo/gfile.h"
+#include "utils/parseargs.h"
+
+static int latency = 50;
+static int prefetchPages = 2;
+static int thinkTime = 0;
+static char storeDir[1024] = "";
+static bool printHelp = false;
+
+static const ArgDesc argDesc[] = {
+  {"-latency", argInt,     &latency,         0,
+   "milliseconds each request to the loader takes (default is 50)"},
+  {"-prefetch", argInt,    &prefetchPages,   0,
+   "number of pages to prefetch (default is 2)"},
+  {"-think",  argInt,      &thinkTime,       0,
+   "milliseconds spent on each page after extracting its text (default is 0)"},
+  {"-store",  argString,   storeDir,         sizeof(storeDir),
+   "also load the document twice through a chunk store in this directory"},
+  {"-h",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-help",   argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"--help",  argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-?",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  { }
+};
+
+// Loads from a local file, waiting <latency> milliseconds per requested
+// range like a server would.
+class LatencyCachedFileLoader : public CachedFileLoader {
+public:
+
+  LatencyCachedFileLoader() : file(nullptr), requests(0), bytes(0) {}
+  ~LatencyCachedFileLoader() { if (file) fclose(file); }
+
+  size_t init(GooString *uri, CachedFile *cachedFile) override {
+    if (!(file = openFile(uri->c_str(), "rb"))) {
+      return (size_t)-1;
+    }
+    Gfseek(file, 0, SEEK_END);
+    key = uri->toStr() + '\n' + std::to_string(Gftell(file));
+    return Gftell(file);
+  }
+
+  std::string getCacheKey() override { return key; }
+
+  int load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer) override {
+    char buf[CachedFileChunkSize];
+    size_t n;
+
+    for (const ByteRange &range : ranges) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+      ++requests;
+      Gfseek(file, range.offset, SEEK_SET);
+      for (size_t left = range.length; left > 0; left -= n) {
+        n = fread(buf, 1, std::min(left, sizeof(buf)), file);
+        if (n == 0) {
+          break;
+        }
+        writer->write(buf, n);
+        bytes += n;
+      }
+    }
+    return 0;
+  }
+
+  FILE *file;
+  std::string key;
+  std::atomic_int requests;
+  std::atomic_long bytes;
+};
+
+static bool walkPages(const char *fileName, int prefetch, const char *store) {
+  LatencyCachedFileLoader *loader = new LatencyCachedFileLoader();
+  CachedFile *cachedFile = new CachedFile(loader, new GooString(fileName));
+  if (cachedFile->getLength() == ((unsigned int) -1)) {
+    cachedFile->decRefCnt();
+    return false;
+  }
+
+  GooTimer timer;
+  PDFDoc *doc = new PDFDoc(new CachedFileStream(cachedFile, 0, false, cachedFile->getLength(),
+                                                Object(objNull)));
+  if (!doc->isOk()) {
+    delete doc;
+    return false;
+  }
+  doc->setPrefetchPages(prefetch);
+  TextOutputDev *textOut = new TextOutputDev(nullptr, false, 0, false, false);
+  for (int pg = 1; pg <= doc->getNumPages(); ++pg) {
+    doc->displayPage(textOut, pg, 72, 72, 0, true, false, false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(thinkTime));
+  }
+  printf("%8d %-6s %9.3f %9d %9ld\n", prefetch, store, timer.getElapsed(),
+         loader->requests.load(), loader->bytes.load() / 1024);
+  delete textOut;
+  delete doc;
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  bool ok = parseArgs(argDesc, &argc, argv);
+  if (!ok || argc != 2 || printHelp) {
+    printUsage(argv[0], "PDF-FILE", argDesc);
+    return printHelp ? 0 : 1;
+  }
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(true);
+
+  printf("prefetch store    seconds  requests kilobytes\n");
+  ok = walkPages(argv[1], -1, "none") && walkPages(argv[1], prefetchPages, "none");
+  if (ok && storeDir[0]) {
+    // the first pass fills the store, the second one reads from it
+    globalParams->setChunkCacheDir(storeDir);
+    ok = walkPages(argv[1], prefetchPages, "cold") && walkPages(argv[1], prefetchPages, "warm");
+  }
+  if (!ok) {
+    fprintf(stderr, "Error loading document\n");
+    delete globalParams;
+    return 1;
+  }
+
+  delete globalParams;
+  return 0;
+}
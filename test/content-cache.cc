@@ -0,0 +1,96 @@
+//========================================================================
+//
+// content-cache.cc
+//
+// Checks that a page drawn from its cached, already parsed content
+// stream looks the same as when it was parsed, and that a content stream
+// too large for the cache isn't recorded.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Gfx.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "splash/SplashBitmap.h"
+#include "build-pdf.h"
+
+// Build a one page document whose content stream (object 3) is <content>.
+static std::string makeDocument(const std::string &content) {
+  return buildPDF({"<< /Type /Catalog /Pages 2 0 R >>",
+                   "<< /Type /Pages /Count 1 /Kids [4 0 R] >>",
+                   buildPDFStream("", content),
+                   "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] /Contents 3 0 R >>"});
+}
+
+// Draw the page of the document twice, and check whether its content
+// stream was cached after the first time and that both drawings are the
+// same.
+static bool checkContentCache(const char *name, const std::string &content,
+                              bool expectCached) {
+  std::string pdf = makeDocument(content);
+  PDFDoc *doc = openPDF(&pdf);
+  if (!doc->isOk()) {
+    fprintf(stderr, "%s: error loading the document\n", name);
+    delete doc;
+    return false;
+  }
+
+  SplashColor paperColor;
+  paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+  SplashOutputDev *splashOut = new SplashOutputDev(splashModeRGB8, 4, false, paperColor);
+  splashOut->startDoc(doc);
+  std::vector<std::string> drawings;
+  bool cached = false;
+  for (int i = 0; i < 2; ++i) {
+    doc->displayPage(splashOut, 1, 72, 72, 0, false, true, false);
+    SplashBitmap *bitmap = splashOut->getBitmap();
+    drawings.push_back(std::string((const char *)bitmap->getDataPtr(),
+                                   bitmap->getRowSize() * bitmap->getHeight()));
+    if (i == 0) {
+      cached = doc->getCatalog()->getContentCache()->lookup({3, 0}) != nullptr;
+    }
+  }
+  delete splashOut;
+  delete doc;
+
+  const bool same = drawings[0] == drawings[1];
+  const bool ok = cached == expectCached && same;
+  printf("%-24s cached %s (expected %s), replay %s: %s\n", name,
+         cached ? "yes" : "no", expectCached ? "yes" : "no",
+         same ? "same" : "different", ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  bool ok = true;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(true);
+
+  ok &= checkContentCache("paths",
+                          "q 1 0 0 rg 10 10 40 40 re f Q "
+                          "q 0 0 1 RG 4 w [6 2] 0 d 10 90 m 90 10 l S Q "
+                          "/P << /MCID 0 >> BDC 0 g 60 60 30 30 re f EMC",
+                          true);
+
+  // a TJ array and a property list holding more than the cache's share
+  // of its memory budget, in nested strings
+  const std::string big(9 * 1024 * 1024, 'x');
+  ok &= checkContentCache("large array operand",
+                          "0 g 10 10 80 80 re f [(" + big + ")] TJ", false);
+  ok &= checkContentCache("large dict operand",
+                          "/P << /Alt (" + big + ") >> BDC 0 g 10 10 80 80 re f EMC",
+                          false);
+
+  delete globalParams;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+//========================================================================
+//
+// font-subst-cache.cc
+//
+// Checks that the system fonts fontconfig picked for non-embedded fonts
+// are saved to the font substitute cache file and used by the next
+// process, unless fontconfig's files changed in between.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include <string>
+#include <vector>
+#include "goo/GooString.h"
+#include "GfxFont.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+#include "build-pdf.h"
+
+static bool check(const char *what, bool ok) {
+  printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+static bool readFile(const std::string &fileName, std::string *data) {
+  FILE *f = fopen(fileName.c_str(), "r");
+  char buf[4096];
+  size_t n;
+
+  if (!f) {
+    return false;
+  }
+  data->clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    data->append(buf, n);
+  }
+  fclose(f);
+  return true;
+}
+
+static bool writeFile(const std::string &fileName, const std::string &data) {
+  FILE *f = fopen(fileName.c_str(), "w");
+
+  if (!f) {
+    return false;
+  }
+  fwrite(data.data(), 1, data.size(), f);
+  return fclose(f) == 0;
+}
+
+// Find the system font for the non-embedded font of the document, as a
+// new process with the font substitute cache in <cacheFile> would, and
+// return its file and substitute name.
+static void findFont(const std::string &cacheFile, std::string *path, std::string *name) {
+  std::string pdf = buildPDF({"<< /Type /Catalog /Pages 2 0 R >>",
+                              "<< /Type /Pages /Count 0 /Kids [] >>",
+                              "<< /Type /Font /Subtype /TrueType /BaseFont /NoSuchFontSans-Bold >>"});
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(true);
+  globalParams->setFontSubstCacheFile(cacheFile.c_str());
+  PDFDoc *doc = openPDF(&pdf);
+  Object fontDict = doc->getXRef()->fetch(3, 0);
+  GfxFont *font = GfxFont::makeFont(doc->getXRef(), "F1", {3, 0}, fontDict.getDict());
+  SysFontType type;
+  int fontNum;
+  GooString substituteName;
+  GooString *fontFile = globalParams->findSystemFontFile(font, &type, &fontNum, &substituteName);
+  *path = fontFile ? fontFile->c_str() : "";
+  *name = substituteName.c_str();
+  delete fontFile;
+  font->decRefCnt();
+  delete doc;
+  // saves the cache file
+  delete globalParams;
+  globalParams = nullptr;
+}
+
+int main(int argc, char *argv[])
+{
+  char dir[] = "/tmp/font-subst-cache-XXXXXX";
+  bool ok = true;
+
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  const std::string cacheFile = std::string(dir) + "/substitutes";
+  const std::string stampFile = std::string(dir) + "/stamp";
+
+  // the first process asks fontconfig, and saves what it picked
+  std::string path, name, data;
+  findFont(cacheFile, &path, &name);
+  ok &= check("the substitute is saved",
+	      readFile(cacheFile, &data) && data.find("\nsubst\tNoSuchFontSans-Bold\t") != std::string::npos);
+
+  // rename the saved substitute, so that it can be told apart from what
+  // fontconfig picks, and make the file depend on the time of another
+  // file, like it does on those of fontconfig's files
+  struct stat st;
+  std::string edited;
+  size_t start = 0, end;
+  ok &= check("the stamp file is written", writeFile(stampFile, "") && stat(stampFile.c_str(), &st) == 0);
+  while ((end = data.find('\n', start)) != std::string::npos) {
+    std::string line = data.substr(start, end - start);
+    if (line.compare(0, 6, "subst\t") == 0) {
+      line = line.substr(0, line.rfind('\t') + 1) + "Cached-Substitute";
+    }
+    edited += line + '\n';
+    start = end + 1;
+  }
+  edited += "stamp\t" + std::to_string((long long)st.st_mtime) + '\t' + stampFile + '\n';
+  ok &= check("the cache file is edited", writeFile(cacheFile, edited));
+
+  // the next process finds the substitute in the file
+  std::string cachedPath, cachedName;
+  findFont(cacheFile, &cachedPath, &cachedName);
+  ok &= check("the saved substitute is used",
+	      cachedName == "Cached-Substitute" && cachedPath == path);
+
+  // once a stamped file changed, fontconfig is asked again
+  struct utimbuf times;
+  times.actime = st.st_atime;
+  times.modtime = st.st_mtime - 10;
+  utime(stampFile.c_str(), &times);
+  findFont(cacheFile, &cachedPath, &cachedName);
+  ok &= check("a changed file invalidates the substitutes",
+	      cachedName == name && cachedPath == path);
+  ok &= check("the substitute is saved again",
+	      readFile(cacheFile, &data) && data.find("Cached-Substitute") == std::string::npos &&
+	      data.find("\nsubst\tNoSuchFontSans-Bold\t") != std::string::npos);
+
+  unlink(cacheFile.c_str());
+  unlink(stampFile.c_str());
+  rmdir(dir);
+  return ok ? 0 : 1;
+}
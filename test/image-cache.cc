@@ -0,0 +1,112 @@
+//========================================================================
+//
+// image-cache.cc
+//
+// Checks that SplashOutputDev decodes an image XObject shared by several
+// pages only once, and that it doesn't reuse an image whose color space
+// depends on the resources it is drawn with.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Gfx.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "build-pdf.h"
+
+// Build a document with one page per entry of <pageResources>, each
+// drawing image XObject 3 with those resources.
+static std::string makeDocument(const std::string &imageColorSpace,
+                                const std::vector<std::string> &pageResources) {
+  std::vector<std::string> objs;
+  std::string kids, data;
+  char buf[256];
+  const int numPages = pageResources.size();
+
+  for (int i = 0; i < 32 * 32; ++i) {
+    data += (char)(i % 32 * 8);
+    data += (char)(i / 32 * 8);
+    data += (char)128;
+  }
+  for (int i = 0; i < numPages; ++i) {
+    snprintf(buf, sizeof(buf), "%d 0 R ", 5 + 2 * i);
+    kids += buf;
+  }
+  objs.push_back("<< /Type /Catalog /Pages 2 0 R >>");
+  snprintf(buf, sizeof(buf), "<< /Type /Pages /Count %d /Kids [", numPages);
+  objs.push_back(buf + kids + "] >>");
+  objs.push_back(buildPDFStream("/Type /XObject /Subtype /Image /Width 32 /Height 32 "
+                                "/ColorSpace " + imageColorSpace + " /BitsPerComponent 8",
+                                data));
+  objs.push_back(buildPDFStream("", "q 100 0 0 100 0 0 cm /Im1 Do Q"));
+  for (int i = 0; i < numPages; ++i) {
+    objs.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] /Contents 4 0 R "
+                   "/Resources << /XObject << /Im1 3 0 R >> " + pageResources[i] + " >> >>");
+    objs.push_back("null");
+  }
+  return buildPDF(objs);
+}
+
+// Draw every page of the document, and check the number of image cache
+// hits and misses.
+static bool checkImageCache(const char *name, const std::string &imageColorSpace,
+                            const std::vector<std::string> &pageResources,
+                            size_t expectedHits, size_t expectedMisses) {
+  std::string pdf = makeDocument(imageColorSpace, pageResources);
+  PDFDoc *doc = openPDF(&pdf);
+  if (!doc->isOk()) {
+    fprintf(stderr, "%s: error loading the document\n", name);
+    delete doc;
+    return false;
+  }
+
+  SplashColor paperColor;
+  paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+  SplashOutputDev *splashOut = new SplashOutputDev(splashModeRGB8, 4, false, paperColor);
+  splashOut->startDoc(doc);
+  for (int pg = 1; pg <= doc->getNumPages(); ++pg) {
+    doc->displayPage(splashOut, pg, 72, 72, 0, false, true, false);
+  }
+  GfxImageCache *imageCache = doc->getCatalog()->getImageCache();
+  const size_t hits = imageCache->getHits();
+  const size_t misses = imageCache->getMisses();
+  delete splashOut;
+  delete doc;
+
+  const bool ok = hits == expectedHits && misses == expectedMisses;
+  printf("%-24s hits %zu (expected %zu), misses %zu (expected %zu): %s\n", name,
+         hits, expectedHits, misses, expectedMisses, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  const std::string calRGB = "[/CalRGB << /WhitePoint [0.9505 1 1.089] >>]";
+  bool ok = true;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(true);
+
+  // decoded on the first page, reused on the other ones
+  ok &= checkImageCache("DeviceRGB", "/DeviceRGB", {"", "", "", ""}, 3, 1);
+  ok &= checkImageCache("CalRGB", calRGB, {"", "", "", ""}, 3, 1);
+  // the color space resource could differ from one page to the next
+  ok &= checkImageCache("named resource", "/CS0",
+                        {"/ColorSpace << /CS0 /DeviceRGB >>",
+                         "/ColorSpace << /CS0 /DeviceRGB >>"}, 0, 0);
+  // DefaultRGB replaces DeviceRGB on the second page only
+  ok &= checkImageCache("DefaultRGB", "/DeviceRGB",
+                        {"", "/ColorSpace << /DefaultRGB " + calRGB + " >>", ""}, 1, 1);
+  ok &= checkImageCache("Indexed DefaultRGB", "[/Indexed /DeviceRGB 1 <000000ffffff>]",
+                        {"", "/ColorSpace << /DefaultRGB " + calRGB + " >>", ""}, 1, 1);
+
+  delete globalParams;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+//========================================================================
+//
+// jpx-decode.cc
+//
+// Measures how decoding the JPEG 2000 images of a document scales with
+// the number of threads set by GlobalParams::setJPXDecodeThreads(), and
+// checks that every number of threads decodes the same pixels as one
+// thread.  Only the built-in JPX decoder uses the setting.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "GlobalParams.h"
+#include "Object.h"
+#include "PDFDoc.h"
+#include "Page.h"
+#include "Stream.h"
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "utils/parseargs.h"
+
+static int maxThreads = 4;
+static int iterations = 3;
+static bool printHelp = false;
+
+static const ArgDesc argDesc[] = {
+  {"-j",      argInt,      &maxThreads,      0,
+   "maximum number of threads (default is 4)"},
+  {"-n",      argInt,      &iterations,      0,
+   "number of times each image is decoded (default is 3)"},
+  {"-h",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-help",   argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"--help",  argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-?",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  { }
+};
+
+// Collect the JPX image XObjects used directly by the pages.
+static void findImages(PDFDoc *doc, std::vector<Object> *images) {
+  for (int pg = 1; pg <= doc->getNumPages(); ++pg) {
+    Page *page = doc->getPage(pg);
+    if (!page || !page->getResourceDict()) {
+      continue;
+    }
+    Object xObjects = page->getResourceDict()->lookup("XObject");
+    if (!xObjects.isDict()) {
+      continue;
+    }
+    for (int i = 0; i < xObjects.dictGetLength(); ++i) {
+      Object xObject = xObjects.dictGetVal(i);
+      if (xObject.isStream() && xObject.getStream()->getKind() == strJPX) {
+        images->push_back(std::move(xObject));
+      }
+    }
+  }
+}
+
+// Decode an image the way a renderer reads it, and return the decoded
+// bytes.
+static std::string decodeImage(Object *image) {
+  Stream *str = image->getStream();
+  std::string data;
+  int c;
+
+  str->reset();
+  while ((c = str->getChar()) != EOF) {
+    data += (char)c;
+  }
+  str->close();
+  return data;
+}
+
+int main(int argc, char *argv[])
+{
+  bool ok = parseArgs(argDesc, &argc, argv);
+  if (!ok || argc != 2 || printHelp || maxThreads < 1 || iterations < 1) {
+    printUsage(argv[0], "PDF-FILE", argDesc);
+    return printHelp ? 0 : 1;
+  }
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(true);
+  PDFDoc *doc = new PDFDoc(new GooString(argv[1]));
+  if (!doc->isOk()) {
+    fprintf(stderr, "Error loading document\n");
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+
+  std::vector<Object> images;
+  findImages(doc, &images);
+  if (images.empty()) {
+    fprintf(stderr, "No JPX images in the document\n");
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+
+  printf("threads     seconds      Mbyte/s  speedup\n");
+  std::vector<std::string> expected(images.size());
+  double baseRate = 0;
+  bool same = true;
+  for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+    globalParams->setJPXDecodeThreads(numThreads);
+    long bytes = 0;
+    int mismatches = 0;
+    GooTimer timer;
+
+    for (int n = 0; n < iterations; ++n) {
+      for (size_t i = 0; i < images.size(); ++i) {
+        const std::string data = decodeImage(&images[i]);
+        bytes += data.size();
+        if (numThreads == 1 && n == 0) {
+          expected[i] = data;
+        } else if (data != expected[i]) {
+          ++mismatches;
+        }
+      }
+    }
+    timer.stop();
+
+    const double rate = bytes / timer.getElapsed() / 1e6;
+    if (numThreads == 1) {
+      baseRate = rate;
+    }
+    printf("%7d  %10.3f  %11.2f  %6.2fx", numThreads, timer.getElapsed(), rate, rate / baseRate);
+    if (mismatches > 0) {
+      printf("  %d decodings differ from 1 thread", mismatches);
+      same = false;
+    }
+    printf("\n");
+  }
+
+  images.clear();
+  delete doc;
+  delete globalParams;
+  return same ? 0 : 1;
+}
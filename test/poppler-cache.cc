@@ -0,0 +1,145 @@
+//========================================================================
+//
+// poppler-cache.cc
+//
+// Checks PopplerCache's least recently used order, its byte budget, the
+// replacement of an item put again under the same key, and its hit and
+// miss counters.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <stdio.h>
+#include "PopplerCache.h"
+
+// An item that counts how many of its kind are alive, to check that the
+// cache deletes the items it drops.
+struct CountedItem {
+  explicit CountedItem(int valueA) : value(valueA) { ++alive; }
+  ~CountedItem() { --alive; }
+
+  int value;
+  static int alive;
+};
+
+int CountedItem::alive = 0;
+
+static bool check(const char *what, bool ok) {
+  printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Returns true if <key> is cached with <value>.  This is a lookup, so
+// it makes <key> the most recently used.
+static bool has(PopplerCache<int, CountedItem> *cache, int key, int value) {
+  CountedItem *item = cache->lookup(key);
+  return item && item->value == value;
+}
+
+static bool checkEvictionOrder() {
+  PopplerCache<int, CountedItem> cache(3);
+  bool ok = true;
+
+  cache.put(1, new CountedItem(10));
+  cache.put(2, new CountedItem(20));
+  cache.put(3, new CountedItem(30));
+  // 1 becomes the most recently used, so 2 is the first to go
+  ok &= check("lookup of a cached key", has(&cache, 1, 10));
+  cache.put(4, new CountedItem(40));
+  ok &= check("least recently used is evicted", !cache.lookup(2));
+  ok &= check("others are kept", has(&cache, 3, 30) && has(&cache, 1, 10) &&
+	      has(&cache, 4, 40));
+  ok &= check("evicted item is deleted", CountedItem::alive == 3);
+  // the order is now 4, 1, 3
+  cache.put(5, new CountedItem(50));
+  ok &= check("eviction follows the lookups", !cache.lookup(3) && cache.size() == 3);
+
+  cache.clear();
+  ok &= check("clear deletes the items", CountedItem::alive == 0 && cache.size() == 0);
+  return ok;
+}
+
+static bool checkReplace() {
+  PopplerCache<int, CountedItem> cache(2, 100);
+  bool ok = true;
+
+  cache.put(1, new CountedItem(10), 30);
+  cache.put(2, new CountedItem(20), 30);
+  cache.put(1, new CountedItem(11), 50);
+  ok &= check("put replaces the item of the same key",
+	      has(&cache, 1, 11) && cache.size() == 2);
+  ok &= check("replaced item is deleted", CountedItem::alive == 2);
+  ok &= check("replaced item's bytes are released", cache.getBytes() == 80);
+  // the replaced key is the most recently used one
+  cache.put(3, new CountedItem(30), 10);
+  ok &= check("replaced key is the most recently used", !cache.lookup(2) && has(&cache, 1, 11));
+  return ok;
+}
+
+static bool checkRemove() {
+  PopplerCache<int, CountedItem> cache(3, 100);
+  bool ok = true;
+
+  cache.put(1, new CountedItem(10), 30);
+  cache.put(2, new CountedItem(20), 30);
+  cache.remove(1);
+  cache.remove(3);
+  ok &= check("remove drops only the item of the key",
+	      !cache.lookup(1) && has(&cache, 2, 20) && cache.size() == 1);
+  ok &= check("removed item is deleted", CountedItem::alive == 1);
+  ok &= check("removed item's bytes are released", cache.getBytes() == 30);
+  return ok;
+}
+
+static bool checkByteBudget() {
+  PopplerCache<int, CountedItem> cache(100, 10);
+  bool ok = true;
+
+  cache.put(1, new CountedItem(10), 4);
+  cache.put(2, new CountedItem(20), 4);
+  ok &= check("items within the budget are kept", cache.size() == 2 && cache.getBytes() == 8);
+  cache.put(3, new CountedItem(30), 4);
+  ok &= check("going over the budget evicts the oldest",
+	      !cache.lookup(1) && cache.size() == 2 && cache.getBytes() == 8);
+  cache.put(4, new CountedItem(40), 20);
+  ok &= check("an item over the budget is kept alone",
+	      has(&cache, 4, 40) && cache.size() == 1 && cache.getBytes() == 20);
+  ok &= check("items evicted for bytes are deleted", CountedItem::alive == 1);
+
+  cache.setMaxBytes(0);
+  for (int i = 0; i < 10; ++i) {
+    cache.put(10 + i, new CountedItem(i), 1000);
+  }
+  ok &= check("a budget of 0 doesn't limit the bytes", cache.size() == 11);
+  cache.setMaxBytes(2500);
+  ok &= check("lowering the budget evicts at once",
+	      cache.size() == 2 && cache.getBytes() == 2000 && has(&cache, 19, 9));
+  return ok;
+}
+
+static bool checkCounters() {
+  PopplerCache<int, CountedItem> cache(2);
+  bool ok = true;
+
+  cache.put(1, new CountedItem(10));
+  cache.lookup(1);
+  cache.lookup(1);
+  cache.lookup(2);
+  ok &= check("hits and misses are counted", cache.getHits() == 2 && cache.getMisses() == 1);
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  bool ok = true;
+
+  ok &= checkEvictionOrder();
+  ok &= checkReplace();
+  ok &= checkRemove();
+  ok &= checkByteBudget();
+  ok &= checkCounters();
+  ok &= check("all the items are deleted", CountedItem::alive == 0);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,366 @@
+//========================================================================
+//
+// ps-function.cc
+//
+// Checks that PostScript (Type 4) functions compiled to register code
+// give the same results as the interpreter, on random programs and on
+// the cases where the compiled code leaves the work to the interpreter.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Object.h"
+#include "Array.h"
+#include "Dict.h"
+#include "Function.h"
+#include "GlobalParams.h"
+#include "Stream.h"
+
+#define numInputs 2
+#define numOutputs 2
+
+static bool check(const char *what, bool ok) {
+  printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Parse <code> as a function with numInputs inputs in [-2, 2] and
+// numOutputs outputs in [-1000, 1000].
+static PostScriptFunction *makeFunction(const std::string &code) {
+  Dict *dict = new Dict((XRef *)nullptr);
+  dict->add("FunctionType", Object(4));
+  Array *domain = new Array(nullptr);
+  for (int i = 0; i < numInputs; ++i) {
+    domain->add(Object(-2.0));
+    domain->add(Object(2.0));
+  }
+  dict->add("Domain", Object(domain));
+  Array *range = new Array(nullptr);
+  for (int i = 0; i < numOutputs; ++i) {
+    range->add(Object(-1000.0));
+    range->add(Object(1000.0));
+  }
+  dict->add("Range", Object(range));
+  std::string buf = code;
+  Object str((Stream *)new MemStream(&buf[0], 0, buf.size(), Object(dict)));
+  Function *func = Function::parse(&str);
+  if (func && func->getType() != 4) {
+    delete func;
+    return nullptr;
+  }
+  return static_cast<PostScriptFunction *>(func);
+}
+
+// Returns true if the compiled code and the interpreter give the same
+// results over a grid of inputs, bit for bit.
+static bool sameResults(const PostScriptFunction *func) {
+  std::vector<double> in;
+  for (int a = -8; a <= 8; ++a) {
+    for (int b = -8; b <= 8; ++b) {
+      in.push_back(a / 4.0);
+      in.push_back(b / 3.0);
+    }
+  }
+  const int count = in.size() / numInputs;
+  std::vector<double> out(count * numOutputs);
+  func->transformBatch(in.data(), out.data(), count);
+  for (int i = 0; i < count; ++i) {
+    double expected[numOutputs];
+    func->transformInterpreted(&in[i * numInputs], expected);
+    for (int k = 0; k < numOutputs; ++k) {
+      const double got = out[i * numOutputs + k];
+      if (memcmp(&got, &expected[k], sizeof(double)) != 0 &&
+	  !(got != got && expected[k] != expected[k])) {
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------
+// random programs
+//------------------------------------------------------------------------
+
+// The generator tracks the type of each stack entry, so that every
+// operator gets operands of the types it takes.
+enum GenType { genInt, genReal, genBool };
+
+static unsigned int seed = 1;
+
+static unsigned int rnd(unsigned int n) {
+  seed = seed * 1103515245 + 12345;
+  return ((seed >> 16) & 0x7fff) % n;
+}
+
+static bool isNum(GenType t) {
+  return t == genInt || t == genReal;
+}
+
+static std::string genProgram(std::vector<GenType> *stack, int depth);
+
+static void genConstant(std::vector<GenType> *stack, std::string *code) {
+  char buf[32];
+  if (rnd(2)) {
+    snprintf(buf, sizeof(buf), "%d ", (int)rnd(7) - 3);
+    stack->push_back(genInt);
+  } else {
+    snprintf(buf, sizeof(buf), "%.2f ", rnd(400) / 100.0 - 2);
+    stack->push_back(genReal);
+  }
+  *code += buf;
+}
+
+// Append an if or ifelse testing the top of <stack>, whose branches
+// leave the same types on the stack.  Returns false if no such branches
+// were found.
+static bool genConditional(std::vector<GenType> *stack, std::string *code, int depth) {
+  for (int attempt = 0; attempt < 4; ++attempt) {
+    // the test leaves the stack as it was
+    const std::string test = rnd(2) ? "dup 0 ge " : "2 copy lt ";
+    const std::vector<GenType> cond = *stack;
+    std::vector<GenType> thenStack = cond, elseStack = cond;
+    std::string thenCode = genProgram(&thenStack, depth + 1);
+    if (rnd(2)) {
+      std::string elseCode = genProgram(&elseStack, depth + 1);
+      if (thenStack == elseStack) {
+	*code += test + "{ " + thenCode + "} { " + elseCode + "} ifelse ";
+	*stack = thenStack;
+	return true;
+      }
+    } else if (thenStack == cond) {
+      *code += test + "{ " + thenCode + "} if ";
+      *stack = cond;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Append random operators to <code>, with operands of the types on
+// <stack>, and update <stack> to their results.
+static std::string genProgram(std::vector<GenType> *stack, int depth) {
+  static const char *arithOps[] = {"add", "sub", "mul"};
+  static const char *realOps[] = {"div", "atan", "exp"};
+  static const char *intOps[] = {"idiv", "mod", "bitshift"};
+  static const char *bitOps[] = {"and", "or", "xor"};
+  static const char *eqOps[] = {"eq", "ne"};
+  static const char *cmpOps[] = {"ge", "gt", "le", "lt"};
+  static const char *sameOps[] = {"abs", "neg", "ceiling", "floor", "round", "truncate"};
+  static const char *toRealOps[] = {"cvr", "sin", "cos", "sqrt", "ln", "log"};
+  std::string code;
+  char buf[32];
+
+  const int len = (depth ? 1 : 4) + rnd(depth ? 4 : 12);
+  for (int i = 0; i < len && stack->size() < 40; ++i) {
+    const int d = stack->size();
+    const GenType t1 = d > 0 ? (*stack)[d - 1] : genBool;
+    const GenType t2 = d > 1 ? (*stack)[d - 2] : genBool;
+    const bool nums = d > 1 && isNum(t1) && isNum(t2);
+    const bool ints = d > 1 && t1 == genInt && t2 == genInt;
+    const bool bools = d > 1 && t1 == genBool && t2 == genBool;
+    const int r = rnd(100);
+    if (r < 10 && depth < 2 && nums) {
+      if (genConditional(stack, &code, depth)) {
+	continue;
+      }
+    }
+    if (r < 14 || d < 2) {
+      genConstant(stack, &code);
+    } else if (r < 24 && nums) {
+      code += std::string(arithOps[rnd(3)]) + " ";
+      stack->pop_back();
+      stack->back() = ints ? genInt : genReal;
+    } else if (r < 30 && nums) {
+      code += std::string(realOps[rnd(3)]) + " ";
+      stack->pop_back();
+      stack->back() = genReal;
+    } else if (r < 36 && ints) {
+      code += std::string(intOps[rnd(3)]) + " ";
+      stack->pop_back();
+    } else if (r < 40 && (ints || bools)) {
+      code += std::string(bitOps[rnd(3)]) + " ";
+      stack->pop_back();
+    } else if (r < 44 && (nums || bools)) {
+      code += std::string(eqOps[rnd(2)]) + " ";
+      stack->pop_back();
+      stack->back() = genBool;
+    } else if (r < 48 && nums) {
+      code += std::string(cmpOps[rnd(4)]) + " ";
+      stack->pop_back();
+      stack->back() = genBool;
+    } else if (r < 56 && isNum(t1)) {
+      code += std::string(sameOps[rnd(6)]) + " ";
+    } else if (r < 62 && isNum(t1)) {
+      code += std::string(toRealOps[rnd(6)]) + " ";
+      stack->back() = genReal;
+    } else if (r < 65 && isNum(t1)) {
+      code += "cvi ";
+      stack->back() = genInt;
+    } else if (r < 68 && t1 != genReal) {
+      code += "not ";
+    } else if (r < 74) {
+      code += "dup ";
+      stack->push_back(t1);
+    } else if (r < 80) {
+      code += "exch ";
+      std::swap((*stack)[d - 1], (*stack)[d - 2]);
+    } else if (r < 84) {
+      code += "pop ";
+      stack->pop_back();
+    } else if (r < 88) {
+      const int k = rnd(d);
+      snprintf(buf, sizeof(buf), "%d index ", k);
+      code += buf;
+      stack->push_back((*stack)[d - 1 - k]);
+    } else if (r < 92) {
+      const int k = 1 + rnd(d < 4 ? d : 4);
+      snprintf(buf, sizeof(buf), "%d copy ", k);
+      code += buf;
+      for (int j = 0; j < k; ++j) {
+	stack->push_back((*stack)[d - k + j]);
+      }
+    } else if (r < 96) {
+      const int k = 1 + rnd(d);
+      const int j = (int)rnd(7) - 3;
+      snprintf(buf, sizeof(buf), "%d %d roll ", k, j);
+      code += buf;
+      std::vector<GenType> rolled(stack->end() - k, stack->end());
+      for (int q = 0; q < k; ++q) {
+	(*stack)[d - k + ((q + j) % k + k) % k] = rolled[q];
+      }
+    } else {
+      genConstant(stack, &code);
+    }
+  }
+  return code;
+}
+
+// A random program whose results are numbers.
+static std::string genFunction() {
+  std::vector<GenType> stack(numInputs, genReal);
+  std::string code = "{ " + genProgram(&stack, 0);
+  while (stack.size() < numOutputs) {
+    genConstant(&stack, &code);
+  }
+  for (int i = 0; i < numOutputs; ++i) {
+    if (stack.back() == genBool) {
+      code += "{ 1 } { 0 } ifelse ";
+      stack.back() = genInt;
+    }
+    // bring the next output to the top
+    code += std::to_string(numOutputs) + " 1 roll ";
+    stack.insert(stack.end() - numOutputs, stack.back());
+    stack.pop_back();
+  }
+  return code + "}";
+}
+
+static bool checkRandomPrograms() {
+  const int count = 2000;
+  int compiled = 0, same = 0;
+
+  for (int i = 0; i < count; ++i) {
+    const std::string code = genFunction();
+    PostScriptFunction *func = makeFunction(code);
+    if (!func) {
+      fprintf(stderr, "error parsing %s\n", code.c_str());
+      continue;
+    }
+    if (func->isCompiled()) {
+      ++compiled;
+    }
+    if (sameResults(func)) {
+      ++same;
+    } else {
+      fprintf(stderr, "different results for %s\n", code.c_str());
+    }
+    delete func;
+  }
+  bool ok = true;
+  ok &= check("random programs give the same results", same == count);
+  ok &= check("most random programs are compiled", compiled > count / 2);
+  return ok;
+}
+
+//------------------------------------------------------------------------
+// fallbacks to the interpreter
+//------------------------------------------------------------------------
+
+// Returns true if <func> gives <out0> for the input (<in0>, 0).
+static bool gives(const PostScriptFunction *func, double in0, double out0) {
+  double in[numInputs] = {in0, 0};
+  double out[numOutputs];
+  func->transform(in, out);
+  return out[0] == out0;
+}
+
+static bool checkZeroDivisor() {
+  bool ok = true;
+
+  // the interpreter leaves the stack without a result when the divisor
+  // is 0, so that the 5 below it is the first output
+  PostScriptFunction *idiv = makeFunction("{ pop 5 exch cvi 7 exch idiv 0 }");
+  ok &= check("idiv by an input is compiled", idiv && idiv->isCompiled());
+  ok &= check("idiv by a non-zero input", idiv && gives(idiv, 2, 3) && gives(idiv, -2, -3));
+  ok &= check("idiv by zero is interpreted", idiv && gives(idiv, 0, 5) && sameResults(idiv));
+  delete idiv;
+
+  PostScriptFunction *mod = makeFunction("{ pop 5 exch cvi 7 exch mod 0 }");
+  ok &= check("mod by an input is compiled", mod && mod->isCompiled());
+  ok &= check("mod by a non-zero input", mod && gives(mod, 2, 1));
+  ok &= check("mod by zero is interpreted", mod && gives(mod, 0, 5) && sameResults(mod));
+  delete mod;
+
+  return ok;
+}
+
+static bool checkTooManyRegisters() {
+  bool ok = true;
+
+  // every add writes a new register, more than the 512 a program has
+  std::string code = "{ pop ";
+  for (int i = 0; i < 600; ++i) {
+    code += "1 add ";
+  }
+  code += "0 }";
+  PostScriptFunction *func = makeFunction(code);
+  ok &= check("too large a program is interpreted", func && !func->isCompiled());
+  ok &= check("too large a program gives its results", func && gives(func, 1.5, 601.5));
+  delete func;
+
+  // a smaller one is compiled
+  code = "{ pop ";
+  for (int i = 0; i < 200; ++i) {
+    code += "1 add ";
+  }
+  code += "0 }";
+  func = makeFunction(code);
+  ok &= check("smaller program is compiled", func && func->isCompiled());
+  ok &= check("smaller program gives its results", func && gives(func, 1.5, 201.5));
+  delete func;
+
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  bool ok = true;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(true);
+
+  ok &= checkRandomPrograms();
+  ok &= checkZeroDivisor();
+  ok &= checkTooManyRegisters();
+
+  delete globalParams;
+  return ok ? 0 : 1;
+}
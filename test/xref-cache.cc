@@ -0,0 +1,115 @@
+//========================================================================
+//
+// xref-cache.cc
+//
+// Checks that XRef::fetch() doesn't hand out objects from its cache of
+// resolved objects once they were modified, removed, or found elsewhere
+// by reconstructing the xref table, and that callers can't modify the
+// cached objects.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "GlobalParams.h"
+#include "Object.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+#include "build-pdf.h"
+
+static bool check(const char *what, bool ok) {
+  printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Returns true if object <num> is the string <s>.
+static bool fetchesString(XRef *xref, int num, const char *s) {
+  Object obj = xref->fetch(num, 0);
+  return obj.isString() && !obj.getString()->cmp(s);
+}
+
+// Returns true if object <num> is a dict whose /A is <a>.
+static bool fetchesDict(XRef *xref, int num, int a) {
+  Object obj = xref->fetch(num, 0);
+  if (!obj.isDict()) {
+    return false;
+  }
+  Object aObj = obj.dictLookup("A");
+  return aObj.isInt() && aObj.getInt() == a;
+}
+
+static bool checkModified() {
+  std::string pdf = buildPDF({"<< /Type /Catalog /Pages 2 0 R >>",
+                              "<< /Type /Pages /Count 0 /Kids [] >>",
+                              "(three)",
+                              "(four)",
+                              "<< /A 1 >>"});
+  PDFDoc *doc = openPDF(&pdf);
+  XRef *xref = doc->getXRef();
+  bool ok = true;
+
+  // fetch everything twice, the second time from the cache
+  for (int i = 0; i < 2; ++i) {
+    ok &= check(i == 0 ? "objects are parsed" : "objects are cached",
+                fetchesString(xref, 3, "three") && fetchesString(xref, 4, "four") &&
+                fetchesDict(xref, 5, 1));
+  }
+
+  Object modified(new GooString("modified"));
+  xref->setModifiedObject(&modified, {3, 0});
+  ok &= check("setModifiedObject replaces a cached object", fetchesString(xref, 3, "modified"));
+
+  xref->removeIndirectObject({4, 0});
+  ok &= check("removeIndirectObject drops a cached object", !fetchesString(xref, 4, "four"));
+
+  Object dict = xref->fetch(5, 0);
+  dict.dictSet("A", Object(2));
+  ok &= check("callers can't modify cached objects", fetchesDict(xref, 5, 1));
+
+  delete doc;
+  return ok;
+}
+
+static bool checkReconstructed() {
+  // object 3 is defined again after object 4, which is where the
+  // reconstructed xref table finds it; the xref table points object 5
+  // to the header, so fetching it reconstructs the table
+  std::string pdf = buildPDF({"<< /Type /Catalog /Pages 2 0 R >>",
+                              "<< /Type /Pages /Count 0 /Kids [] >>",
+                              "(old)",
+                              "(four)\nendobj\n3 0 obj\n(new)",
+                              "(five)"});
+  const size_t entry5 = pdf.find("xref\n") + strlen("xref\n0 6\n") + 5 * 20;
+  pdf.replace(entry5, 10, "0000000001");
+  PDFDoc *doc = openPDF(&pdf);
+  XRef *xref = doc->getXRef();
+  bool ok = true;
+
+  ok &= check("object is cached before reconstruction",
+              fetchesString(xref, 3, "old") && fetchesString(xref, 3, "old"));
+  ok &= check("broken object is found by reconstruction", fetchesString(xref, 5, "five"));
+  ok &= check("reconstruction drops cached objects", fetchesString(xref, 3, "new"));
+
+  delete doc;
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  bool ok = true;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(true);
+
+  ok &= checkModified();
+  ok &= checkReconstructed();
+
+  delete globalParams;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+//========================================================================
+//
+// xref-contention.cc
+//
+// Measures how well concurrent XRef::fetch() calls on one shared PDFDoc
+// scale with the number of threads, the way parallel renderers use it.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include "GlobalParams.h"
+#include "Object.h"
+#include "PDFDoc.h"
+#include "Page.h"
+#include "XRef.h"
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "utils/parseargs.h"
+
+static int maxThreads = 4;
+static int iterations = 20;
+static bool printHelp = false;
+
+static const ArgDesc argDesc[] = {
+  {"-j",      argInt,      &maxThreads,      0,
+   "maximum number of threads (default is 4)"},
+  {"-n",      argInt,      &iterations,      0,
+   "number of passes over the document per thread (default is 20)"},
+  {"-h",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-help",   argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"--help",  argFlag,     &printHelp,       0,
+   "print usage information"},
+  {"-?",      argFlag,     &printHelp,       0,
+   "print usage information"},
+  { }
+};
+
+// Resolve what a renderer resolves for every page: the page dict, its
+// resources and everything they reference one level down.
+static long fetchPageObjects(PDFDoc *doc, int firstPage) {
+  const int numPages = doc->getNumPages();
+  long fetches = 0;
+
+  for (int i = 0; i < numPages; ++i) {
+    const int pg = (firstPage + i) % numPages + 1;
+    const Ref *pageRef = doc->getCatalog()->getPageRef(pg);
+    if (!pageRef) {
+      continue;
+    }
+    Object pageObj = doc->getXRef()->fetch(*pageRef);
+    ++fetches;
+    if (!pageObj.isDict()) {
+      continue;
+    }
+    Object resources = pageObj.dictLookup("Resources");
+    ++fetches;
+    if (!resources.isDict()) {
+      continue;
+    }
+    for (int j = 0; j < resources.dictGetLength(); ++j) {
+      Object category = resources.dictGetVal(j);
+      ++fetches;
+      if (!category.isDict()) {
+        continue;
+      }
+      for (int k = 0; k < category.dictGetLength(); ++k) {
+        Object res = category.dictGetVal(k);
+        ++fetches;
+      }
+    }
+  }
+  return fetches;
+}
+
+int main(int argc, char *argv[])
+{
+  bool ok = parseArgs(argDesc, &argc, argv);
+  if (!ok || argc != 2 || printHelp || maxThreads < 1) {
+    printUsage(argv[0], "PDF-FILE", argDesc);
+    return printHelp ? 0 : 1;
+  }
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(true);
+  PDFDoc *doc = new PDFDoc(new GooString(argv[1]));
+  if (!doc->isOk()) {
+    fprintf(stderr, "Error loading document\n");
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+
+  // warm up, so that page tree loading is not part of the measurement
+  fetchPageObjects(doc, 0);
+
+  printf("threads     seconds    fetches/s  speedup\n");
+  double baseRate = 0;
+  for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+    std::vector<std::thread> threads;
+    std::vector<long> fetches(numThreads, 0);
+    GooTimer timer;
+
+    for (int t = 0; t < numThreads; ++t) {
+      threads.emplace_back([doc, t, numThreads, &fetches] {
+        for (int n = 0; n < iterations; ++n) {
+          fetches[t] += fetchPageObjects(doc, t * doc->getNumPages() / numThreads);
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    timer.stop();
+
+    long total = 0;
+    for (long f : fetches) {
+      total += f;
+    }
+    const double rate = total / timer.getElapsed();
+    if (numThreads == 1) {
+      baseRate = rate;
+    }
+    printf("%7d  %10.3f  %11.0f  %6.2fx\n", numThreads, timer.getElapsed(), rate, rate / baseRate);
+  }
+
+  delete doc;
+  delete globalParams;
+  return 0;
+}
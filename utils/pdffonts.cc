@@ -117,6 +117,7 @@ int main(int argc, char *argv[]) {
 
   // read config file
   globalParams = new GlobalParams();
+  globalParams->setMapFiles(true);
 
   // open PDF file
   if (ownerPassword[0] != '\001') {
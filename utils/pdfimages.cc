@@ -144,6 +144,7 @@ int main(int argc, char *argv[]) {
 
   // read config file
   globalParams = new GlobalParams();
+  globalParams->setMapFiles(true);
   if (quiet) {
     globalParams->setErrQuiet(quiet);
   }
@@ -869,6 +869,7 @@ int main(int argc, char *argv[]) {
 
   // read config file
   globalParams = new GlobalParams();
+  globalParams->setMapFiles(true);
 
   if (printEnc) {
     printEncodings();
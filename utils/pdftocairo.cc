@@ -124,6 +124,9 @@ static char tiffCompressionStr[16] = "";
 static char ownerPassword[33] = "";
 static char userPassword[33] = "";
 static bool quiet = false;
+static GooString profileFile;
+static GooString flameGraphFile;
+static GooString fontSubstCacheFile;
 static bool printVersion = false;
 static bool printHelp = false;
 
@@ -260,6 +263,13 @@ static const ArgDesc argDesc[] = {
   {"-upw",    argString,   userPassword,   sizeof(userPassword),
    "user password (for encrypted files)"},
 
+  {"-profile", argGooString, &profileFile,  0,
+   "write the time spent in each operator and resource, as JSON, to the file"},
+  {"-flamegraph", argGooString, &flameGraphFile, 0,
+   "write the time spent in nested operators, as folded stacks, to the file"},
+  {"-fontsubstcache", argGooString, &fontSubstCacheFile, 0,
+   "remember in the file which system fonts replace non-embedded fonts"},
+
   {"-q",      argFlag,     &quiet,         0,
    "don't print any messages or errors"},
   {"-v",      argFlag,     &printVersion,  0,
@@ -927,6 +937,7 @@ int main(int argc, char *argv[]) {
   GooString *ownerPW, *userPW;
   CairoOutputDev *cairoOut;
   int pg, pg_num_len;
+  int exitCode;
   double pg_w, pg_h, tmp, output_w, output_h;
   int num_outputs;
 
@@ -1083,6 +1094,12 @@ int main(int argc, char *argv[]) {
   if (quiet) {
     globalParams->setErrQuiet(quiet);
   }
+  if (profileFile.getLength() > 0 || flameGraphFile.getLength() > 0) {
+    globalParams->setProfileCommands(true);
+  }
+  if (fontSubstCacheFile.getLength() > 0) {
+    globalParams->setFontSubstCacheFile(fontSubstCacheFile.c_str());
+  }
 
   // open PDF file
   if (ownerPassword[0]) {
@@ -1202,6 +1219,9 @@ int main(int argc, char *argv[]) {
 
   cairoOut = new CairoOutputDev();
   cairoOut->startDoc(doc);
+  if (profileFile.getLength() > 0 || flameGraphFile.getLength() > 0) {
+    cairoOut->startProfile();
+  }
   if (sz != 0)
     crop_w = crop_h = sz;
   pg_num_len = numberOfCharacters(doc->getNumPages());
@@ -1259,6 +1279,19 @@ int main(int argc, char *argv[]) {
   }
   endDocument();
 
+  // the pages are written already, report the profile and go on
+  exitCode = 0;
+  if (profileFile.getLength() > 0 &&
+      !cairoOut->getProfileReport()->writeJSON(profileFile.c_str())) {
+    fprintf(stderr, "Couldn't write profile file '%s'\n", profileFile.c_str());
+    exitCode = 2;
+  }
+  if (flameGraphFile.getLength() > 0 &&
+      !cairoOut->getProfileReport()->writeFolded(flameGraphFile.c_str())) {
+    fprintf(stderr, "Couldn't write flame graph file '%s'\n", flameGraphFile.c_str());
+    exitCode = 2;
+  }
+
   // clean up
   delete cairoOut;
   delete doc;
@@ -1282,5 +1315,5 @@ int main(int argc, char *argv[]) {
     gfree(icc_data);
 #endif
 
-  return 0;
+  return exitCode;
 }
@@ -43,6 +43,11 @@
 #endif
 #include <stdio.h>
 #include <math.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "parseargs.h"
 #include "goo/gmem.h"
 #include "goo/GooString.h"
@@ -53,21 +58,10 @@
 #include "splash/SplashBitmap.h"
 #include "splash/Splash.h"
 #include "SplashOutputDev.h"
+#include "ProfileData.h"
 #include "Win32Console.h"
 #include "numberofcharacters.h"
 
-// Uncomment to build pdftoppm with pthreads
-// You may also have to change the buildsystem to
-// link pdftoppm to pthread library
-// This is here for developer testing not user ready
-// #define UTILS_USE_PTHREADS 1
-
-#ifdef UTILS_USE_PTHREADS
-#include <errno.h>
-#include <pthread.h>
-#include <deque>
-#endif // UTILS_USE_PTHREADS
-
 static int firstPage = 1;
 static int lastPage = 0;
 static bool printOnlyOdd = false;
@@ -108,9 +102,11 @@ static char userPassword[33] = "";
 static char TiffCompressionStr[16] = "";
 static char thinLineModeStr[8] = "";
 static SplashThinLineMode thinLineMode = splashThinLineDefault;
-#ifdef UTILS_USE_PTHREADS
 static int numberOfJobs = 1;
-#endif // UTILS_USE_PTHREADS
+static int bandsPerPage = 1;
+static GooString profileFile;
+static GooString flameGraphFile;
+static GooString fontSubstCacheFile;
 static bool quiet = false;
 static bool printVersion = false;
 static bool printHelp = false;
@@ -195,11 +191,16 @@ static const ArgDesc argDesc[] = {
    "owner password (for encrypted files)"},
   {"-upw",    argString,   userPassword,   sizeof(userPassword),
    "user password (for encrypted files)"},
-  
-#ifdef UTILS_USE_PTHREADS
+
   {"-j",      argInt,      &numberOfJobs,  0,
-   "number of jobs to run concurrently"},
-#endif // UTILS_USE_PTHREADS
+   "number of pages to render concurrently (default is 1)"},
+
+  {"-profile", argGooString, &profileFile,  0,
+   "write the time spent in each operator and resource, as JSON, to the file"},
+  {"-flamegraph", argGooString, &flameGraphFile, 0,
+   "write the time spent in nested operators, as folded stacks, to the file"},
+  {"-fontsubstcache", argGooString, &fontSubstCacheFile, 0,
+   "remember in the file which system fonts replace non-embedded fonts"},
 
   {"-q",      argFlag,     &quiet,         0,
    "don't print any messages or errors"},
@@ -276,22 +277,27 @@ static bool parseJpegOptions()
   return true;
 }
 
-static void savePageSlice(PDFDoc *doc,
+static void renderPageSlice(PDFDoc *doc,
                    SplashOutputDev *splashOut, 
                    int pg, int x, int y, int w, int h, 
                    double pg_w, double pg_h, 
-                   char *ppmFile) {
+                   double x_res, double y_res) {
   if (w == 0) w = (int)ceil(pg_w);
   if (h == 0) h = (int)ceil(pg_h);
   w = (x+w > pg_w ? (int)ceil(pg_w-x) : w);
   h = (y+h > pg_h ? (int)ceil(pg_h-y) : h);
-  doc->displayPageSlice(splashOut, 
-    pg, x_resolution, y_resolution, 
+  splashOut->displayPageSliceBands(doc,
+    pg, x_res, y_res,
     0,
     !useCropBox, false, false,
-    x, y, w, h
+    x, y, w, h,
+    bandsPerPage
   );
+}
 
+static void writePageImage(SplashOutputDev *splashOut,
+                   double x_res, double y_res,
+                   char *ppmFile) {
   SplashBitmap *bitmap = splashOut->getBitmap();
 
   SplashBitmap::WriteImgParams params;
@@ -302,13 +308,13 @@ static void savePageSlice(PDFDoc *doc,
 
   if (ppmFile != nullptr) {
     if (png) {
-      bitmap->writeImgFile(splashFormatPng, ppmFile, x_resolution, y_resolution);
+      bitmap->writeImgFile(splashFormatPng, ppmFile, x_res, y_res);
     } else if (jpeg) {
-      bitmap->writeImgFile(splashFormatJpeg, ppmFile, x_resolution, y_resolution, &params);
+      bitmap->writeImgFile(splashFormatJpeg, ppmFile, x_res, y_res, &params);
     } else if (jpegcmyk) {
-      bitmap->writeImgFile(splashFormatJpegCMYK, ppmFile, x_resolution, y_resolution, &params);
+      bitmap->writeImgFile(splashFormatJpegCMYK, ppmFile, x_res, y_res, &params);
     } else if (tiff) {
-      bitmap->writeImgFile(splashFormatTiff, ppmFile, x_resolution, y_resolution, &params);
+      bitmap->writeImgFile(splashFormatTiff, ppmFile, x_res, y_res, &params);
     } else {
       bitmap->writePNMFile(ppmFile);
     }
@@ -318,64 +324,93 @@ static void savePageSlice(PDFDoc *doc,
 #endif
 
     if (png) {
-      bitmap->writeImgFile(splashFormatPng, stdout, x_resolution, y_resolution);
+      bitmap->writeImgFile(splashFormatPng, stdout, x_res, y_res);
     } else if (jpeg) {
-      bitmap->writeImgFile(splashFormatJpeg, stdout, x_resolution, y_resolution, &params);
+      bitmap->writeImgFile(splashFormatJpeg, stdout, x_res, y_res, &params);
     } else if (tiff) {
-      bitmap->writeImgFile(splashFormatTiff, stdout, x_resolution, y_resolution, &params);
+      bitmap->writeImgFile(splashFormatTiff, stdout, x_res, y_res, &params);
     } else {
       bitmap->writePNMFile(stdout);
     }
   }
 }
 
-#ifdef UTILS_USE_PTHREADS
+//------------------------------------------------------------------------
+// Page jobs
+//
+// All pages to render are collected up front into pageJobs, with their
+// per-page resolution already computed, so that the workers share
+// nothing but the (thread safe) PDFDoc and the output ordering state.
+// Each worker owns its SplashOutputDev and therefore its font engine.
+//------------------------------------------------------------------------
 
 struct PageJob {
-  PDFDoc *doc;
   int pg;
-  
   double pg_w, pg_h;
-  SplashColor* paperColor;
-  
+  double x_res, y_res;
   char *ppmFile;
 };
 
-static std::deque<PageJob> pageJobQueue;
-static pthread_mutex_t pageJobMutex = PTHREAD_MUTEX_INITIALIZER;
-
-static void processPageJobs() {
-  while(true) {
-    // pop the next job or exit if queue is empty
-    pthread_mutex_lock(&pageJobMutex);
-    
-    if(pageJobQueue.empty()) {
-      pthread_mutex_unlock(&pageJobMutex);
-      return;
+static std::vector<PageJob> pageJobs;
+static std::atomic<size_t> nextPageJob(0);
+
+// Pages written to stdout are concatenated, so they have to be emitted
+// in page order no matter which worker finishes first.
+static std::mutex outputMutex;
+static std::condition_variable outputCond;
+static size_t nextPageToOutput = 0;
+
+static SplashOutputDev *createSplashOutputDev(PDFDoc *doc, SplashColor paperColor) {
+  SplashOutputDev *splashOut = new SplashOutputDev(mono ? splashModeMono1 :
+				    gray ? splashModeMono8 :
+				    (jpegcmyk || overprint) ? splashModeDeviceN8 :
+				             splashModeRGB8, 4,
+				  false, paperColor, true, thinLineMode);
+
+  splashOut->setFontAntialias(fontAntialias);
+  splashOut->setVectorAntialias(vectorAntialias);
+  splashOut->startDoc(doc);
+  return splashOut;
+}
+
+// The workers' profiles, merged as they finish.
+static std::mutex profileMutex;
+static ProfileReport profileReport;
+
+static bool isProfiling() {
+  return profileFile.getLength() > 0 || flameGraphFile.getLength() > 0;
+}
+
+static void processPageJobs(PDFDoc *doc, SplashColor paperColor) {
+  SplashOutputDev *splashOut = createSplashOutputDev(doc, paperColor);
+
+  if (isProfiling()) {
+    splashOut->startProfile();
+  }
+
+  for (size_t i = nextPageJob++; i < pageJobs.size(); i = nextPageJob++) {
+    const PageJob &pageJob = pageJobs[i];
+
+    renderPageSlice(doc, splashOut, pageJob.pg, param_x, param_y, param_w, param_h,
+                  pageJob.pg_w, pageJob.pg_h, pageJob.x_res, pageJob.y_res);
+
+    if (pageJob.ppmFile != nullptr) {
+      writePageImage(splashOut, pageJob.x_res, pageJob.y_res, pageJob.ppmFile);
+    } else {
+      std::unique_lock<std::mutex> locker(outputMutex);
+      outputCond.wait(locker, [i] { return nextPageToOutput == i; });
+      writePageImage(splashOut, pageJob.x_res, pageJob.y_res, pageJob.ppmFile);
+      ++nextPageToOutput;
+      outputCond.notify_all();
     }
-    
-    PageJob pageJob = pageJobQueue.front();
-    pageJobQueue.pop_front();
-    
-    pthread_mutex_unlock(&pageJobMutex);
-    
-    // process the job    
-    SplashOutputDev *splashOut = new SplashOutputDev(mono ? splashModeMono1 :
-                  gray ? splashModeMono8 :
-        			    (jpegcmyk || overprint) ? splashModeDeviceN8 :
-		              splashModeRGB8, 4, false, *pageJob.paperColor, true, thinLineMode);
-    splashOut->setFontAntialias(fontAntialias);
-    splashOut->setVectorAntialias(vectorAntialias);
-    splashOut->startDoc(pageJob.doc);
-    
-    savePageSlice(pageJob.doc, splashOut, pageJob.pg, x, y, w, h, pageJob.pg_w, pageJob.pg_h, pageJob.ppmFile);
-    
-    delete splashOut;
-    delete[] pageJob.ppmFile;
   }
-}
 
-#endif // UTILS_USE_PTHREADS
+  if (isProfiling()) {
+    std::lock_guard<std::mutex> locker(profileMutex);
+    profileReport.merge(*splashOut->getProfileReport());
+  }
+  delete splashOut;
+}
 
 int main(int argc, char *argv[]) {
   PDFDoc *doc;
@@ -384,11 +419,7 @@ int main(int argc, char *argv[]) {
   char *ppmFile;
   GooString *ownerPW, *userPW;
   SplashColor paperColor;
-#ifndef UTILS_USE_PTHREADS
-  SplashOutputDev *splashOut;
-#else
-  pthread_t* jobs;
-#endif // UTILS_USE_PTHREADS
+  std::vector<std::thread> workers;
   bool ok;
   int exitCode;
   int pg, pg_num_len;
@@ -441,6 +472,7 @@ int main(int argc, char *argv[]) {
 
   // read config file
   globalParams = new GlobalParams();
+  globalParams->setMapFiles(true);
   if (enableFreeTypeStr[0]) {
     if (!globalParams->setEnableFreeType(enableFreeTypeStr)) {
       fprintf(stderr, "Bad '-freetype' value on command line\n");
@@ -458,6 +490,12 @@ int main(int argc, char *argv[]) {
   if (quiet) {
     globalParams->setErrQuiet(quiet);
   }
+  if (isProfiling()) {
+    globalParams->setProfileCommands(true);
+  }
+  if (fontSubstCacheFile.getLength() > 0) {
+    globalParams->setFontSubstCacheFile(fontSubstCacheFile.c_str());
+  }
 
   // open PDF file
   if (ownerPassword[0]) {
@@ -525,23 +563,7 @@ int main(int argc, char *argv[]) {
     paperColor[1] = 255;
     paperColor[2] = 255;
   }
-  
-#ifndef UTILS_USE_PTHREADS
 
-  splashOut = new SplashOutputDev(mono ? splashModeMono1 :
-				    gray ? splashModeMono8 :
-				    (jpegcmyk || overprint) ? splashModeDeviceN8 :
-				             splashModeRGB8, 4,
-				  false, paperColor, true, thinLineMode);
-
-
-
-  splashOut->setFontAntialias(fontAntialias);
-  splashOut->setVectorAntialias(vectorAntialias);
-  splashOut->startDoc(doc);
-  
-#endif // UTILS_USE_PTHREADS
-  
   if (sz != 0) param_w = param_h = sz;
   pg_num_len = numberOfCharacters(doc->getNumPages());
   for (pg = firstPage; pg <= lastPage; ++pg) {
@@ -589,55 +611,46 @@ int main(int argc, char *argv[]) {
     } else {
       ppmFile = nullptr;
     }
-#ifndef UTILS_USE_PTHREADS
-    // process job in main thread
-    savePageSlice(doc, splashOut, pg, param_x, param_y, param_w, param_h, pg_w, pg_h, ppmFile);
-    
-    delete[] ppmFile;
-#else
-    
-    // queue job for worker threads
-    PageJob pageJob = {
-      .doc = doc,
-      .pg = pg,
-      
-      .pg_w = pg_w, .pg_h = pg_h,
-      
-      .paperColor = &paperColor,
-      
-      .ppmFile = ppmFile
-    };
-    
-    pageJobQueue.push_back(pageJob);
-    
-#endif // UTILS_USE_PTHREADS
-  }
-#ifndef UTILS_USE_PTHREADS
-  delete splashOut;
-#else
-  
-  // spawn worker threads and wait on them
-  jobs = (pthread_t*)malloc(numberOfJobs * sizeof(pthread_t));
+    PageJob pageJob = { pg, pg_w, pg_h, x_resolution, y_resolution, ppmFile };
+    pageJobs.push_back(pageJob);
+  }
 
-  for(int i=0; i < numberOfJobs; ++i) {
-    if(pthread_create(&jobs[i], NULL, (void* (*)(void*))processPageJobs, NULL) != 0) {
-	    fprintf(stderr, "pthread_create() failed with errno: %d\n", errno);
-	    exit(EXIT_FAILURE);
-    }
+  if (numberOfJobs < 1) {
+    numberOfJobs = 1;
   }
-  
-  for(int i=0; i < numberOfJobs; ++i) {
-    if(pthread_join(jobs[i], NULL) != 0) {
-      fprintf(stderr, "pthread_join() failed with errno: %d\n", errno);
-      exit(EXIT_FAILURE);
+  // jobs left over when there are fewer pages than jobs draw the pages
+  // in horizontal bands; not while profiling, as the bands of a page
+  // share its output device
+  if ((size_t)numberOfJobs > pageJobs.size()) {
+    if (pageJobs.size() > 0 && !isProfiling()) {
+      bandsPerPage = numberOfJobs / pageJobs.size();
     }
+    numberOfJobs = pageJobs.size();
   }
 
-  free(jobs);
-  
-#endif // UTILS_USE_PTHREADS
+  // the main thread is the first worker
+  for (int i = 1; i < numberOfJobs; ++i) {
+    workers.emplace_back(processPageJobs, doc, paperColor);
+  }
+  processPageJobs(doc, paperColor);
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  for (PageJob &pageJob : pageJobs) {
+    delete[] pageJob.ppmFile;
+  }
 
+  // the pages are written already, report the profile and go on
   exitCode = 0;
+  if (profileFile.getLength() > 0 && !profileReport.writeJSON(profileFile.c_str())) {
+    fprintf(stderr, "Couldn't write profile file '%s'\n", profileFile.c_str());
+    exitCode = 2;
+  }
+  if (flameGraphFile.getLength() > 0 && !profileReport.writeFolded(flameGraphFile.c_str())) {
+    fprintf(stderr, "Couldn't write flame graph file '%s'\n", flameGraphFile.c_str());
+    exitCode = 2;
+  }
 
   // clean up
  err1:
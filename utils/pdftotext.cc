@@ -38,14 +38,24 @@
 
 #include "config.h"
 #include <poppler-config.h>
+#ifdef _WIN32
+#include <fcntl.h> // for O_BINARY
+#include <io.h>    // for setmode
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "parseargs.h"
 #include "printencodings.h"
 #include "goo/GooString.h"
 #include "goo/gmem.h"
+#include "goo/gfile.h"
 #include "GlobalParams.h"
 #include "Object.h"
 #include "Stream.h"
@@ -61,6 +71,7 @@
 #include "UnicodeMap.h"
 #include "PDFDocEncoding.h"
 #include "Error.h"
+#include "ProfileData.h"
 #include <string>
 #include <sstream>
 #include <iomanip>
@@ -95,6 +106,14 @@ static bool quiet = false;
 static bool printVersion = false;
 static bool printHelp = false;
 static bool printEnc = false;
+static int numberOfJobs = 1;
+static double pageTimeout = 0;
+static GooString profileFile;
+static GooString flameGraphFile;
+
+static bool isProfiling() {
+  return profileFile.getLength() > 0 || flameGraphFile.getLength() > 0;
+}
 
 static const ArgDesc argDesc[] = {
   {"-f",       argInt,      &firstPage,     0,
@@ -133,6 +152,14 @@ static const ArgDesc argDesc[] = {
    "output bounding box for each word and page size to html.  Sets -htmlmeta"},
   {"-bbox-layout", argFlag,     &bboxLayout,  0,
    "like -bbox but with extra layout bounding box data.  Sets -htmlmeta"},
+  {"-j",       argInt,      &numberOfJobs,  0,
+   "number of pages to extract concurrently (default is 1)"},
+  {"-timeout", argFP,       &pageTimeout,   0,
+   "stop extracting a page after this many seconds (default is 0, no limit)"},
+  {"-profile", argGooString, &profileFile,  0,
+   "write the time spent in each operator and resource, as JSON, to the file"},
+  {"-flamegraph", argGooString, &flameGraphFile, 0,
+   "write the time spent in nested operators, as folded stacks, to the file"},
   {"-opw",     argString,   ownerPassword,  sizeof(ownerPassword),
    "owner password (for encrypted files)"},
   {"-upw",     argString,   userPassword,   sizeof(userPassword),
@@ -176,20 +203,159 @@ static std::string myXmlTokenReplace(const char *inString){
   return myString;
 }
 
+//------------------------------------------------------------------------
+// Page jobs
+//
+// With -j or -timeout the pages are extracted by workers that share the
+// (thread safe) PDFDoc, each with its own TextOutputDev.  The text of a
+// page is collected in its own buffer and written out as soon as all
+// the pages before it are, so the output is the same as when the pages
+// are extracted one after the other.
+//------------------------------------------------------------------------
+
+struct PageText {
+  std::string text;
+  bool done = false;
+};
+
+struct PageDeadline {
+  std::chrono::steady_clock::time_point deadline;
+  bool expired;
+};
+
+static std::vector<PageText> pageTexts;
+static std::atomic<int> nextPageJob(0);
+
+static std::mutex outputMutex;
+static FILE *outputFile;
+static size_t nextPageToOutput = 0;
+
+// The workers' profiles, merged as they finish.
+static std::mutex profileMutex;
+static ProfileReport profileReport;
+
+static void outputToString(void *stream, const char *text, int len) {
+  static_cast<std::string *>(stream)->append(text, len);
+}
+
+static bool checkPageDeadline(void *data) {
+  PageDeadline *pageDeadline = static_cast<PageDeadline *>(data);
+
+  if (std::chrono::steady_clock::now() >= pageDeadline->deadline) {
+    pageDeadline->expired = true;
+  }
+  return pageDeadline->expired;
+}
+
+static void processPageJobs(PDFDoc *doc) {
+  std::string text;
+  PageDeadline pageDeadline;
+  TextOutputDev *textOut;
+
+  textOut = new TextOutputDev(&outputToString, &text,
+			      physLayout, fixedPitch, rawOrder, discardDiag);
+  if (isProfiling()) {
+    textOut->startProfile();
+  }
+
+  for (int pg = firstPage + nextPageJob++; pg <= lastPage; pg = firstPage + nextPageJob++) {
+    pageDeadline.expired = false;
+    if (pageTimeout > 0) {
+      pageDeadline.deadline = std::chrono::steady_clock::now() +
+	std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+	  std::chrono::duration<double>(pageTimeout));
+    }
+
+    // a page that runs out of time still ends, and its text so far is
+    // written out
+    text.clear();
+    if ((w==0) && (h==0) && (x==0) && (y==0)) {
+      doc->displayPage(textOut, pg, resolution, resolution, 0,
+		       true, false, false,
+		       pageTimeout > 0 ? &checkPageDeadline : nullptr, &pageDeadline);
+    } else {
+      doc->displayPageSlice(textOut, pg, resolution, resolution, 0,
+			    true, false, false,
+			    x, y, w, h,
+			    pageTimeout > 0 ? &checkPageDeadline : nullptr, &pageDeadline);
+    }
+    if (pageDeadline.expired && !quiet) {
+      fprintf(stderr, "Page %d took longer than %.2g seconds, its text is incomplete\n",
+	      pg, pageTimeout);
+    }
+
+    std::lock_guard<std::mutex> locker(outputMutex);
+    pageTexts[pg - firstPage].text.swap(text);
+    pageTexts[pg - firstPage].done = true;
+    while (nextPageToOutput < pageTexts.size() && pageTexts[nextPageToOutput].done) {
+      PageText &pageText = pageTexts[nextPageToOutput];
+      fwrite(pageText.text.data(), 1, pageText.text.size(), outputFile);
+      std::string().swap(pageText.text);
+      ++nextPageToOutput;
+    }
+  }
+
+  if (isProfiling()) {
+    std::lock_guard<std::mutex> locker(profileMutex);
+    profileReport.merge(*textOut->getProfileReport());
+  }
+  delete textOut;
+}
+
+// Extract the pages with numberOfJobs workers.  Returns false if the
+// text file can't be opened.
+static bool extractPages(PDFDoc *doc, const GooString *textFileName) {
+  std::vector<std::thread> workers;
+
+  if (!textFileName->cmp("-")) {
+    outputFile = stdout;
+#ifdef _WIN32
+    // keep DOS from munging the end-of-line characters
+    setmode(fileno(stdout), O_BINARY);
+#endif
+  } else if (!(outputFile = openFile(textFileName->c_str(), htmlMeta ? "ab" : "wb"))) {
+    error(errIO, -1, "Couldn't open text file '{0:t}'", textFileName);
+    return false;
+  }
+
+  pageTexts.resize(lastPage - firstPage + 1);
+  if (numberOfJobs > lastPage - firstPage + 1) {
+    numberOfJobs = lastPage - firstPage + 1;
+  }
+
+  // the main thread is the first worker
+  for (int i = 1; i < numberOfJobs; ++i) {
+    workers.emplace_back(processPageJobs, doc);
+  }
+  processPageJobs(doc);
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  if (outputFile != stdout) {
+    fclose(outputFile);
+  } else {
+    fflush(stdout);
+  }
+  return true;
+}
+
 int main(int argc, char *argv[]) {
   PDFDoc *doc;
   GooString *fileName;
   GooString *textFileName;
   GooString *ownerPW, *userPW;
   TextOutputDev *textOut;
+  const ProfileReport *report;
   FILE *f;
   UnicodeMap *uMap;
   Object info;
-  bool ok;
+  bool ok, profileOk;
   int exitCode;
 
   Win32Console win32Console(&argc, &argv);
   exitCode = 99;
+  profileOk = true;
 
   // parse args
   ok = parseArgs(argDesc, &argc, argv);
@@ -240,6 +406,9 @@ int main(int argc, char *argv[]) {
   if (quiet) {
     globalParams->setErrQuiet(quiet);
   }
+  if (isProfiling()) {
+    globalParams->setProfileCommands(true);
+  }
 
   // get mapping to output encoding
   if (!(uMap = globalParams->getTextEncoding())) {
@@ -368,6 +537,9 @@ int main(int argc, char *argv[]) {
   // write text file
   if (htmlMeta && bbox) { // htmlMeta && is superfluous but makes gcc happier
     textOut = new TextOutputDev(nullptr, physLayout, fixedPitch, rawOrder, htmlMeta, discardDiag);
+    if (isProfiling()) {
+      textOut->startProfile();
+    }
 
     if (textOut->isOk()) {
       if (bboxLayout) {
@@ -380,9 +552,18 @@ int main(int argc, char *argv[]) {
     if (f != stdout) {
       fclose(f);
     }
+  } else if (numberOfJobs > 1 || pageTimeout > 0) {
+    textOut = nullptr;
+    if (!extractPages(doc, textFileName)) {
+      exitCode = 2;
+      goto err3;
+    }
   } else {
     textOut = new TextOutputDev(textFileName->c_str(),
 				physLayout, fixedPitch, rawOrder, htmlMeta, discardDiag);
+    if (isProfiling()) {
+      textOut->startProfile();
+    }
     if (textOut->isOk()) {
       if ((w==0) && (h==0) && (x==0) && (y==0)) {
 	doc->displayPages(textOut, firstPage, lastPage, resolution, resolution, 0,
@@ -402,6 +583,18 @@ int main(int argc, char *argv[]) {
       goto err3;
     }
   }
+  // the text is written already, report the profile and go on
+  report = textOut ? textOut->getProfileReport() : &profileReport;
+  if (profileFile.getLength() > 0 &&
+      !report->writeJSON(profileFile.c_str())) {
+    fprintf(stderr, "Couldn't write profile file '%s'\n", profileFile.c_str());
+    profileOk = false;
+  }
+  if (flameGraphFile.getLength() > 0 &&
+      !report->writeFolded(flameGraphFile.c_str())) {
+    fprintf(stderr, "Couldn't write flame graph file '%s'\n", flameGraphFile.c_str());
+    profileOk = false;
+  }
   delete textOut;
 
   // write end of HTML file
@@ -423,7 +616,7 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  exitCode = 0;
+  exitCode = profileOk ? 0 : 2;
 
   // clean up
  err3:
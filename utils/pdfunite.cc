@@ -22,12 +22,25 @@
 #include "parseargs.h"
 #include "config.h"
 #include <poppler-config.h>
+#include <climits>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+#include "Decrypt.h"
 
+static int numberOfJobs = 1;
+static bool dedupStreams = false;
 static bool printVersion = false;
 static bool printHelp = false;
 
 static const ArgDesc argDesc[] = {
+  {"-j", argInt, &numberOfJobs, 0,
+   "number of files to parse concurrently (default is 1)"},
+  {"-dedup", argFlag, &dedupStreams, 0,
+   "write streams found identical in several places only once"},
   {"-v", argFlag, &printVersion, 0,
    "print copyright and version info"},
   {"-h", argFlag, &printHelp, 0,
@@ -124,25 +137,346 @@ static void doMergeFormDict(Dict *srcFormDict, Dict *mergeFormDict, int numOffse
   }
 }
 
+//------------------------------------------------------------------------
+// Parsing the source files
+//------------------------------------------------------------------------
+
+// number of files each job may parse ahead of the one being written
+#define parseAheadPerJob 2
+
+// The files parsed by the jobs, in the order of the command line;
+// nullptr until parsed.  The main thread takes them in that order.
+static std::vector<PDFDoc *> sourceDocs;
+static int nextSourceToParse = 0;
+static int nextSourceToTake = 0;
+static bool stopParsing = false;
+static std::mutex sourceMutex;
+static std::condition_variable sourceCond;
+
+// Open a source file and prepare its pages for merging.
+static PDFDoc *parseSource(const char *sourceFileName) {
+  PDFDoc *doc = new PDFDoc(new GooString(sourceFileName), nullptr, nullptr, nullptr);
+
+  if (doc->isOk() && !doc->isEncrypted() &&
+      doc->getXRef()->getCatalog().isDict()) {
+    for (int j = 1; j <= doc->getNumPages(); j++) {
+      Page *page = doc->getCatalog()->getPage(j);
+      if (!page) {
+        continue;
+      }
+      const PDFRectangle *cropBox = nullptr;
+      if (page->isCropped())
+        cropBox = page->getCropBox();
+      doc->replacePageDict(j, page->getRotate(), page->getMediaBox(), cropBox);
+    }
+  }
+  return doc;
+}
+
+static void parseSourceJobs(char **sourceFileNames) {
+  std::unique_lock<std::mutex> locker(sourceMutex);
+  const int parseAhead = numberOfJobs * parseAheadPerJob;
+
+  while (true) {
+    sourceCond.wait(locker, [parseAhead] {
+      return stopParsing || nextSourceToParse >= (int) sourceDocs.size() ||
+             nextSourceToParse < nextSourceToTake + parseAhead;
+    });
+    if (stopParsing || nextSourceToParse >= (int) sourceDocs.size()) {
+      return;
+    }
+    int i = nextSourceToParse++;
+    locker.unlock();
+    PDFDoc *doc = parseSource(sourceFileNames[i]);
+    locker.lock();
+    sourceDocs[i] = doc;
+    sourceCond.notify_all();
+  }
+}
+
+// Wait for source file <i> to be parsed, and take it.
+static PDFDoc *takeSource(int i) {
+  std::unique_lock<std::mutex> locker(sourceMutex);
+
+  sourceCond.wait(locker, [i] { return sourceDocs[i] != nullptr; });
+  nextSourceToTake = i + 1;
+  sourceCond.notify_all();
+  return sourceDocs[i];
+}
+
+// Stop the jobs, and delete the files parsed but not taken.
+static void stopParsingSources(std::vector<std::thread> *jobs) {
+  {
+    std::lock_guard<std::mutex> locker(sourceMutex);
+    stopParsing = true;
+    sourceCond.notify_all();
+  }
+  for (std::thread &job : *jobs) {
+    job.join();
+  }
+  for (int i = nextSourceToTake; i < (int) sourceDocs.size(); i++) {
+    delete sourceDocs[i];
+  }
+  jobs->clear();
+}
+
+static bool checkSource(PDFDoc *doc, const char *sourceFileName) {
+  if (!doc->isOk()) {
+    error(errSyntaxError, -1, "Could not merge damaged documents ('{0:s}')", sourceFileName);
+    return false;
+  } else if (doc->isEncrypted()) {
+    error(errUnimplemented, -1, "Could not merge encrypted files ('{0:s}')", sourceFileName);
+    return false;
+  } else if (!doc->getXRef()->getCatalog().isDict()) {
+    error(errSyntaxError, -1, "XRef's Catalog is not a dictionary ('{0:s}')", sourceFileName);
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------
+// Deduplicating streams
+//------------------------------------------------------------------------
+
+// The streams written so far, by SHA-256 digest of their dictionary
+// and raw data, and the streams left out because they are identical to
+// one of them.  Object numbers are the ones of the merged file.
+static std::unordered_map<std::string, Ref> writtenStreams;
+static std::unordered_map<int, Ref> duplicateStreams;
+
+static int findMergedStreamNum(PDFDoc *doc, XRef *yRef, unsigned int numOffset, int num,
+                               std::unordered_map<int, int> *mergedNums);
+
+// Append a description of <obj> to <key>, with references replaced by
+// the numbers of the objects they point to in the merged file.
+static void appendStreamKey(std::string *key, const Object &obj, PDFDoc *doc, XRef *yRef,
+                            unsigned int numOffset, std::unordered_map<int, int> *mergedNums) {
+  char buf[64];
+
+  switch (obj.getType()) {
+    case objBool:
+      key->append(obj.getBool() ? "t" : "f");
+      return;
+    case objInt:
+      snprintf(buf, sizeof(buf), "i%d ", obj.getInt());
+      break;
+    case objInt64:
+      snprintf(buf, sizeof(buf), "l%lld ", obj.getInt64());
+      break;
+    case objReal:
+      snprintf(buf, sizeof(buf), "r%.17g ", obj.getReal());
+      break;
+    case objString:
+      snprintf(buf, sizeof(buf), "s%d:", obj.getString()->getLength());
+      key->append(buf);
+      key->append(obj.getString()->c_str(), obj.getString()->getLength());
+      return;
+    case objName:
+      snprintf(buf, sizeof(buf), "n%zu:", strlen(obj.getName()));
+      key->append(buf);
+      key->append(obj.getName());
+      return;
+    case objNull:
+      key->append("z");
+      return;
+    case objArray:
+      key->append("[");
+      for (int i = 0; i < obj.arrayGetLength(); i++) {
+        appendStreamKey(key, obj.arrayGetNF(i), doc, yRef, numOffset, mergedNums);
+      }
+      key->append("]");
+      return;
+    case objDict:
+      key->append("<");
+      for (int i = 0; i < obj.dictGetLength(); i++) {
+        snprintf(buf, sizeof(buf), "k%zu:", strlen(obj.dictGetKey(i)));
+        key->append(buf);
+        key->append(obj.dictGetKey(i));
+        appendStreamKey(key, obj.dictGetValNF(i), doc, yRef, numOffset, mergedNums);
+      }
+      key->append(">");
+      return;
+    case objRef:
+      snprintf(buf, sizeof(buf), "R%d ",
+               findMergedStreamNum(doc, yRef, numOffset, obj.getRef().num, mergedNums));
+      break;
+    default:
+      snprintf(buf, sizeof(buf), "?%d ", (int) obj.getType());
+      break;
+  }
+  key->append(buf);
+}
+
+// Return the number in the merged file of object <num> of <doc>.  If
+// it is a stream identical to one already written, or to be written
+// before, that is the number of the other stream.  <mergedNums> keeps
+// the numbers found for the objects of <doc>.
+static int findMergedStreamNum(PDFDoc *doc, XRef *yRef, unsigned int numOffset, int num,
+                               std::unordered_map<int, int> *mergedNums) {
+  int mergedNum = num + numOffset;
+
+  auto found = mergedNums->find(num);
+  if (found != mergedNums->end()) {
+    return found->second;
+  }
+  // also keeps reference loops from recursing forever
+  (*mergedNums)[num] = mergedNum;
+
+  if (mergedNum < 0 || mergedNum >= yRef->getNumObjects() ||
+      yRef->getEntry(mergedNum)->type == xrefEntryFree) {
+    return mergedNum;
+  }
+  int gen = yRef->getEntry(mergedNum)->gen;
+  Object obj = doc->getXRef()->fetch(num, gen);
+  if (!obj.isStream()) {
+    return mergedNum;
+  }
+
+  // the Length is implied by the data, and may be an indirect object
+  std::string key;
+  Dict *dict = obj.streamGetDict();
+  for (int i = 0; i < dict->getLength(); i++) {
+    if (strcmp(dict->getKey(i), "Length")) {
+      key.append(dict->getKey(i));
+      appendStreamKey(&key, dict->getValNF(i), doc, yRef, numOffset, mergedNums);
+    }
+  }
+  key.append("stream");
+  Stream *str = obj.getStream();
+  str->unfilteredReset();
+  for (int c = str->getUnfilteredChar(); c != EOF; c = str->getUnfilteredChar()) {
+    key.push_back((char) c);
+  }
+  if (key.size() > INT_MAX) {
+    return mergedNum;
+  }
+
+  unsigned char digest[32];
+  sha256((unsigned char *) key.data(), key.size(), digest);
+  std::string digestKey((const char *) digest, sizeof(digest));
+  auto written = writtenStreams.find(digestKey);
+  if (written != writtenStreams.end()) {
+    duplicateStreams[mergedNum] = written->second;
+    (*mergedNums)[num] = written->second.num;
+    return written->second.num;
+  }
+  writtenStreams.emplace(digestKey, Ref{mergedNum, gen});
+  return mergedNum;
+}
+
+// Copy <obj> of the source file with its references turned into the
+// ones of the merged file, pointing to the streams actually written.
+static Object remapRefs(const Object &obj, XRef *xref, unsigned int numOffset) {
+  switch (obj.getType()) {
+    case objRef:
+    {
+      Ref ref = { obj.getRef().num + (int) numOffset, obj.getRef().gen };
+      auto dup = duplicateStreams.find(ref.num);
+      return Object(dup != duplicateStreams.end() ? dup->second : ref);
+    }
+    case objArray:
+    {
+      Array *array = new Array(xref);
+      for (int i = 0; i < obj.arrayGetLength(); i++) {
+        array->add(remapRefs(obj.arrayGetNF(i), xref, numOffset));
+      }
+      return Object(array);
+    }
+    case objDict:
+    {
+      Dict *dict = new Dict(xref);
+      for (int i = 0; i < obj.dictGetLength(); i++) {
+        dict->add(obj.dictGetKey(i), remapRefs(obj.dictGetValNF(i), xref, numOffset));
+      }
+      return Object(dict);
+    }
+    case objStream:
+    {
+      // streams are fetched anew each time, so their dict is ours
+      Dict *dict = obj.streamGetDict();
+      for (int i = 0; i < dict->getLength(); i++) {
+        dict->set(dict->getKey(i), remapRefs(dict->getValNF(i), xref, numOffset));
+      }
+      return obj.copy();
+    }
+    default:
+      return obj.copy();
+  }
+}
+
+// Write <obj>, whose references are numbered <numOffset> below the ones
+// of the merged file.
+static void writeMergedObject(Object *obj, OutStream *outStr, XRef *xref, unsigned int numOffset) {
+  if (dedupStreams) {
+    Object mergedObj = remapRefs(*obj, xref, numOffset);
+    PDFDoc::writeObject(&mergedObj, outStr, xref, 0, nullptr, cryptRC4, 0, 0, 0);
+  } else {
+    PDFDoc::writeObject(obj, outStr, xref, numOffset, nullptr, cryptRC4, 0, 0, 0);
+  }
+}
+
+// Write the objects of <doc> marked in yRef from numOffset on, leaving
+// out the streams identical to ones already written if deduplicating.
+static unsigned int writeSourceObjects(PDFDoc *doc, OutStream *outStr, XRef *yRef, unsigned int numOffset) {
+  if (!dedupStreams) {
+    return doc->writePageObjects(outStr, yRef, numOffset, true);
+  }
+
+  // find all the duplicates first: objects may refer to later ones
+  std::unordered_map<int, int> mergedNums;
+  for (int n = numOffset; n < yRef->getNumObjects(); n++) {
+    if (yRef->getEntry(n)->type != xrefEntryFree) {
+      findMergedStreamNum(doc, yRef, numOffset, n - numOffset, &mergedNums);
+    }
+  }
+
+  unsigned int objectsCount = 0;
+  for (int n = numOffset; n < yRef->getNumObjects(); n++) {
+    int gen = yRef->getEntry(n)->gen;
+    if (yRef->getEntry(n)->type == xrefEntryFree) {
+      continue;
+    } else if (duplicateStreams.count(n)) {
+      yRef->add(n, gen, 0, false);
+      continue;
+    }
+    Object obj = doc->getXRef()->fetch(n - numOffset, gen);
+    Goffset offset = outStr->getPos();
+    outStr->printf("%i %i obj\r\n", n, gen);
+    writeMergedObject(&obj, outStr, doc->getXRef(), numOffset);
+    outStr->printf("\r\nendobj\r\n");
+    yRef->add(n, gen, offset, true);
+    objectsCount++;
+  }
+  return objectsCount;
+}
+
 ///////////////////////////////////////////////////////////////////////////
 int main (int argc, char *argv[])
 ///////////////////////////////////////////////////////////////////////////
 // Merge PDF files given by arguments 1 to argc-2 and write the result
 // to the file specified by argument argc-1.
+//
+// The files are written one after the other as they are parsed, and
+// only the first one is kept until the end, for the catalog entries
+// taken from it.  The catalog and the page tree root get numbers right
+// after the objects of the first file, so that the pages of every file
+// can be written along with its objects.
 ///////////////////////////////////////////////////////////////////////////
 {
   int objectsCount = 0;
   unsigned int numOffset = 0;
-  std::vector<Object> pages;
-  std::vector<unsigned int> offsets;
-  XRef *yRef, *countRef;
-  FILE *f;
-  OutStream *outStr;
+  std::vector<int> pageNums;
+  XRef *yRef = nullptr, *countRef = nullptr;
+  FILE *f = nullptr;
+  OutStream *outStr = nullptr;
   int i;
-  int j, rootNum;
-  std::vector<PDFDoc *>docs;
+  int j, rootNum = 0;
+  PDFDoc *firstDoc = nullptr;
+  std::vector<std::thread> jobs;
   int majorVersion = 0;
   int minorVersion = 0;
+  int headerMajorVersion = 0;
+  int headerMinorVersion = 0;
   char *fileName = argv[argc - 1];
   int exitCode;
 
@@ -163,159 +497,160 @@ int main (int argc, char *argv[])
   exitCode = 0;
   globalParams = new GlobalParams();
 
-  for (i = 1; i < argc - 1; i++) {
-    GooString *gfileName = new GooString(argv[i]);
-    PDFDoc *doc = new PDFDoc(gfileName, nullptr, nullptr, nullptr);
-    if (doc->isOk() && !doc->isEncrypted() &&
-        doc->getXRef()->getCatalog().isDict()) {
-      docs.push_back(doc);
-      if (doc->getPDFMajorVersion() > majorVersion) {
-        majorVersion = doc->getPDFMajorVersion();
-        minorVersion = doc->getPDFMinorVersion();
-      } else if (doc->getPDFMajorVersion() == majorVersion) {
-        if (doc->getPDFMinorVersion() > minorVersion) {
-          minorVersion = doc->getPDFMinorVersion();
-        }
-      }
-    } else if (doc->isOk()) {
-      if (doc->isEncrypted()) {
-        error(errUnimplemented, -1, "Could not merge encrypted files ('{0:s}')", argv[i]);
-        return -1;
-      } else if (!doc->getXRef()->getCatalog().isDict()) {
-        error(errSyntaxError, -1, "XRef's Catalog is not a dictionary ('{0:s}')", argv[i]);
-        return -1;
-      }
-    } else {
-      error(errSyntaxError, -1, "Could not merge damaged documents ('{0:s}')", argv[i]);
-      return -1;
-    }
+  const int numSources = argc - 2;
+  if (numberOfJobs > numSources) {
+    numberOfJobs = numSources;
   }
-
-  if (!(f = fopen(fileName, "wb"))) {
-    error(errIO, -1, "Could not open file '{0:s}'", fileName);
-    return -1;
+  if (numberOfJobs > 1) {
+    sourceDocs.assign(numSources, nullptr);
+    for (i = 0; i < numberOfJobs; i++) {
+      jobs.emplace_back(parseSourceJobs, argv + 1);
+    }
   }
-  outStr = new FileOutStream(f, 0);
 
-  yRef = new XRef();
-  countRef = new XRef();
-  yRef->add(0, 65535, 0, false);
-  PDFDoc::writeHeader(outStr, majorVersion, minorVersion);
-
-  // handle OutputIntents, AcroForm, OCProperties & Names
   Object intents;
   Object names;
   Object afObj;
   Object ocObj;
-  if (docs.size() >= 1) {
-    Object catObj = docs[0]->getXRef()->getCatalog();
-    Dict *catDict = catObj.getDict();
-    intents = catDict->lookup("OutputIntents");
-    afObj = catDict->lookupNF("AcroForm").copy();
-    Ref *refPage = docs[0]->getCatalog()->getPageRef(1);
-    if (!afObj.isNull() && refPage) {
-      docs[0]->markAcroForm(&afObj, yRef, countRef, 0, refPage->num, refPage->num);
-    }
-    ocObj = catDict->lookupNF("OCProperties").copy();
-    if (!ocObj.isNull() && ocObj.isDict() && refPage) {
-      docs[0]->markPageObjects(ocObj.getDict(), yRef, countRef, 0, refPage->num, refPage->num);
+  bool checkIntents = false;
+
+  for (i = 0; i < numSources; i++) {
+    PDFDoc *doc = numberOfJobs > 1 ? takeSource(i) : parseSource(argv[i + 1]);
+    if (!checkSource(doc, argv[i + 1])) {
+      delete doc;
+      stopParsingSources(&jobs);
+      if (outStr) {
+        // don't leave a partial file behind
+        outStr->close();
+        delete outStr;
+        fclose(f);
+        remove(fileName);
+        delete yRef;
+        delete countRef;
+        delete firstDoc;
+      }
+      delete globalParams;
+      return -1;
     }
-    names = catDict->lookup("Names");
-    if (!names.isNull() && names.isDict() && refPage) {
-      docs[0]->markPageObjects(names.getDict(), yRef, countRef, 0, refPage->num, refPage->num);
+    if (doc->getPDFMajorVersion() > majorVersion) {
+      majorVersion = doc->getPDFMajorVersion();
+      minorVersion = doc->getPDFMinorVersion();
+    } else if (doc->getPDFMajorVersion() == majorVersion) {
+      if (doc->getPDFMinorVersion() > minorVersion) {
+        minorVersion = doc->getPDFMinorVersion();
+      }
     }
-    if (intents.isArray() && intents.arrayGetLength() > 0) {
-      for (i = 1; i < (int) docs.size(); i++) {
-        Object pagecatObj = docs[i]->getXRef()->getCatalog();
-        Dict *pagecatDict = pagecatObj.getDict();
-        Object pageintents = pagecatDict->lookup("OutputIntents");
-        if (pageintents.isArray() && pageintents.arrayGetLength() > 0) {
-          for (j = intents.arrayGetLength() - 1; j >= 0; j--) {
-            Object intent = intents.arrayGet(j, 0);
-            if (intent.isDict()) {
-              Object idf = intent.dictLookup("OutputConditionIdentifier");
-              if (idf.isString()) {
-                const GooString *gidf = idf.getString();
-                bool removeIntent = true;
-                for (int k = 0; k < pageintents.arrayGetLength(); k++) {
-                  Object pgintent = pageintents.arrayGet(k, 0);
-                  if (pgintent.isDict()) {
-                    Object pgidf = pgintent.dictLookup("OutputConditionIdentifier");
-                    if (pgidf.isString()) {
-                      const GooString *gpgidf = pgidf.getString();
-                      if (gpgidf->cmp(gidf) == 0) {
-                        removeIntent = false;
-                        break;
-                      }
+
+    if (i == 0) {
+      if (!(f = fopen(fileName, "wb"))) {
+        error(errIO, -1, "Could not open file '{0:s}'", fileName);
+        delete doc;
+        stopParsingSources(&jobs);
+        delete globalParams;
+        return -1;
+      }
+      outStr = new FileOutStream(f, 0);
+
+      yRef = new XRef();
+      countRef = new XRef();
+      yRef->add(0, 65535, 0, false);
+      // fixed up at the end if another file has a higher version
+      headerMajorVersion = majorVersion;
+      headerMinorVersion = minorVersion;
+      PDFDoc::writeHeader(outStr, majorVersion, minorVersion);
+
+      // handle OutputIntents, AcroForm, OCProperties & Names
+      firstDoc = doc;
+      Object catObj = doc->getXRef()->getCatalog();
+      Dict *catDict = catObj.getDict();
+      intents = catDict->lookup("OutputIntents");
+      checkIntents = intents.isArray() && intents.arrayGetLength() > 0;
+      afObj = catDict->lookupNF("AcroForm").copy();
+      Ref *refPage = doc->getCatalog()->getPageRef(1);
+      if (!afObj.isNull() && refPage) {
+        doc->markAcroForm(&afObj, yRef, countRef, 0, refPage->num, refPage->num);
+      }
+      ocObj = catDict->lookupNF("OCProperties").copy();
+      if (!ocObj.isNull() && ocObj.isDict() && refPage) {
+        doc->markPageObjects(ocObj.getDict(), yRef, countRef, 0, refPage->num, refPage->num);
+      }
+      names = catDict->lookup("Names");
+      if (!names.isNull() && names.isDict() && refPage) {
+        doc->markPageObjects(names.getDict(), yRef, countRef, 0, refPage->num, refPage->num);
+      }
+    } else if (checkIntents) {
+      // keep the output intents of the first file all the others have
+      Object pagecatObj = doc->getXRef()->getCatalog();
+      Dict *pagecatDict = pagecatObj.getDict();
+      Object pageintents = pagecatDict->lookup("OutputIntents");
+      if (pageintents.isArray() && pageintents.arrayGetLength() > 0) {
+        for (j = intents.arrayGetLength() - 1; j >= 0; j--) {
+          Object intent = intents.arrayGet(j, 0);
+          if (intent.isDict()) {
+            Object idf = intent.dictLookup("OutputConditionIdentifier");
+            if (idf.isString()) {
+              const GooString *gidf = idf.getString();
+              bool removeIntent = true;
+              for (int k = 0; k < pageintents.arrayGetLength(); k++) {
+                Object pgintent = pageintents.arrayGet(k, 0);
+                if (pgintent.isDict()) {
+                  Object pgidf = pgintent.dictLookup("OutputConditionIdentifier");
+                  if (pgidf.isString()) {
+                    const GooString *gpgidf = pgidf.getString();
+                    if (gpgidf->cmp(gidf) == 0) {
+                      removeIntent = false;
+                      break;
                     }
                   }
                 }
-                if (removeIntent) {
-                  intents.arrayRemove(j);
-                  error(errSyntaxWarning, -1, "Output intent {0:s} missing in pdf {1:s}, removed",
-                   gidf->c_str(), docs[i]->getFileName()->c_str());
-                }
-              } else {
+              }
+              if (removeIntent) {
                 intents.arrayRemove(j);
-                error(errSyntaxWarning, -1, "Invalid output intent dict, missing required OutputConditionIdentifier");
+                error(errSyntaxWarning, -1, "Output intent {0:s} missing in pdf {1:s}, removed",
+                 gidf->c_str(), doc->getFileName()->c_str());
               }
             } else {
               intents.arrayRemove(j);
+              error(errSyntaxWarning, -1, "Invalid output intent dict, missing required OutputConditionIdentifier");
             }
+          } else {
+            intents.arrayRemove(j);
           }
-        } else {
-          error(errSyntaxWarning, -1, "Output intents differs, remove them all");
-          break;
-        }
-      }
-    }
-    if (intents.isArray() && intents.arrayGetLength() > 0) {
-      for (j = intents.arrayGetLength() - 1; j >= 0; j--) {
-        Object intent = intents.arrayGet(j, 0);
-        if (intent.isDict()) {
-          docs[0]->markPageObjects(intent.getDict(), yRef, countRef, numOffset, 0, 0);
-        } else {
-          intents.arrayRemove(j);
         }
+      } else {
+        error(errSyntaxWarning, -1, "Output intents differs, remove them all");
+        checkIntents = false;
       }
     }
-  }
 
-  for (i = 0; i < (int) docs.size(); i++) {
-    for (j = 1; j <= docs[i]->getNumPages(); j++) {
-      if (!docs[i]->getCatalog()->getPage(j)) {
+    std::vector<Object> pages;
+    for (j = 1; j <= doc->getNumPages(); j++) {
+      if (!doc->getCatalog()->getPage(j)) {
         continue;
       }
 
-      const PDFRectangle *cropBox = nullptr;
-      if (docs[i]->getCatalog()->getPage(j)->isCropped())
-        cropBox = docs[i]->getCatalog()->getPage(j)->getCropBox();
-      docs[i]->replacePageDict(j,
-	    docs[i]->getCatalog()->getPage(j)->getRotate(),
-	    docs[i]->getCatalog()->getPage(j)->getMediaBox(), cropBox);
-      Ref *refPage = docs[i]->getCatalog()->getPageRef(j);
-      Object page = docs[i]->getXRef()->fetch(*refPage);
+      Ref *refPage = doc->getCatalog()->getPageRef(j);
+      Object page = doc->getXRef()->fetch(*refPage);
       Dict *pageDict = page.getDict();
-      Object *resDict = docs[i]->getCatalog()->getPage(j)->getResourceDictObject();
+      Object *resDict = doc->getCatalog()->getPage(j)->getResourceDictObject();
       if (resDict->isDict()) {
         pageDict->set("Resources", resDict->copy());
       }
       pages.push_back(std::move(page));
-      offsets.push_back(numOffset);
-      docs[i]->markPageObjects(pageDict, yRef, countRef, numOffset, refPage->num, refPage->num);
+      doc->markPageObjects(pageDict, yRef, countRef, numOffset, refPage->num, refPage->num);
       Object annotsObj = pageDict->lookupNF("Annots").copy();
       if (!annotsObj.isNull()) {
-        docs[i]->markAnnotations(&annotsObj, yRef, countRef, numOffset, refPage->num, refPage->num);
+        doc->markAnnotations(&annotsObj, yRef, countRef, numOffset, refPage->num, refPage->num);
       }
     }
-    Object pageCatObj = docs[i]->getXRef()->getCatalog();
+    Object pageCatObj = doc->getXRef()->getCatalog();
     Dict *pageCatDict = pageCatObj.getDict();
     Object pageNames = pageCatDict->lookup("Names");
     if (!pageNames.isNull() && pageNames.isDict()) {
       if (!names.isDict()) {
         names = Object(new Dict(yRef));
       }
-      doMergeNameDict(docs[i], yRef, countRef, 0, 0, names.getDict(), pageNames.getDict(), numOffset);
+      doMergeNameDict(doc, yRef, countRef, 0, 0, names.getDict(), pageNames.getDict(), numOffset);
     }
     Object pageForm = pageCatDict->lookup("AcroForm");
     if (i > 0 && !pageForm.isNull() && pageForm.isDict()) {
@@ -325,11 +660,57 @@ int main (int argc, char *argv[])
         doMergeFormDict(afObj.getDict(), pageForm.getDict(), numOffset);
       }
     }
-    objectsCount += docs[i]->writePageObjects(outStr, yRef, numOffset, true);
+    objectsCount += writeSourceObjects(doc, outStr, yRef, numOffset);
+
+    if (i == 0) {
+      rootNum = yRef->getNumObjects();
+      yRef->add(rootNum, 0, 0, true);
+      yRef->add(rootNum + 1, 0, 0, true);
+    }
+    for (Object &page : pages) {
+      int pageNum = yRef->getNumObjects();
+      yRef->add(pageNum, 0, outStr->getPos(), true);
+      outStr->printf("%d 0 obj\n", pageNum);
+      outStr->printf("<< ");
+      Dict *pageDict = page.getDict();
+      for (j = 0; j < pageDict->getLength(); j++) {
+        if (j > 0)
+	  outStr->printf(" ");
+        const char *key = pageDict->getKey(j);
+        Object value = pageDict->getValNF(j).copy();
+        if (strcmp(key, "Parent") == 0) {
+          outStr->printf("/Parent %d 0 R", rootNum + 1);
+        } else {
+          outStr->printf("/%s ", key);
+          writeMergedObject(&value, outStr, yRef, numOffset);
+        }
+      }
+      outStr->printf(" >>\nendobj\n");
+      objectsCount++;
+      pageNums.push_back(pageNum);
+    }
+    pages.clear();
+    if (doc != firstDoc) {
+      delete doc;
+    }
     numOffset = yRef->getNumObjects() + 1;
   }
+  stopParsingSources(&jobs);
+
+  // the intents are only known once all the files are parsed
+  unsigned int intentsOffset = numOffset;
+  if (intents.isArray() && intents.arrayGetLength() > 0) {
+    for (j = intents.arrayGetLength() - 1; j >= 0; j--) {
+      Object intent = intents.arrayGet(j, 0);
+      if (intent.isDict()) {
+        firstDoc->markPageObjects(intent.getDict(), yRef, countRef, intentsOffset, 0, 0);
+      } else {
+        intents.arrayRemove(j);
+      }
+    }
+    objectsCount += writeSourceObjects(firstDoc, outStr, yRef, intentsOffset);
+  }
 
-  rootNum = yRef->getNumObjects() + 1;
   yRef->add(rootNum, 0, outStr->getPos(), true);
   outStr->printf("%d 0 obj\n", rootNum);
   outStr->printf("<< /Type /Catalog /Pages %d 0 R", rootNum + 1);
@@ -339,7 +720,7 @@ int main (int argc, char *argv[])
     for (j = 0; j < intents.arrayGetLength(); j++) {
       Object intent = intents.arrayGet(j, 0);
       if (intent.isDict()) {
-        PDFDoc::writeObject(&intent, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+        writeMergedObject(&intent, outStr, yRef, intentsOffset);
       }
     }
     outStr->printf("]");
@@ -347,17 +728,17 @@ int main (int argc, char *argv[])
   // insert AcroForm
   if (!afObj.isNull()) {
     outStr->printf(" /AcroForm ");
-    PDFDoc::writeObject(&afObj, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+    writeMergedObject(&afObj, outStr, yRef, 0);
   }
   // insert OCProperties
   if (!ocObj.isNull() && ocObj.isDict()) {
     outStr->printf(" /OCProperties ");
-    PDFDoc::writeObject(&ocObj, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+    writeMergedObject(&ocObj, outStr, yRef, 0);
   }
   // insert Names
   if (!names.isNull() && names.isDict()) {
     outStr->printf(" /Names ");
-    PDFDoc::writeObject(&names, outStr, yRef, 0, nullptr, cryptRC4, 0, 0, 0);
+    writeMergedObject(&names, outStr, yRef, 0);
   }
   outStr->printf(">>\nendobj\n");
   objectsCount++;
@@ -365,31 +746,11 @@ int main (int argc, char *argv[])
   yRef->add(rootNum + 1, 0, outStr->getPos(), true);
   outStr->printf("%d 0 obj\n", rootNum + 1);
   outStr->printf("<< /Type /Pages /Kids [");
-  for (j = 0; j < (int) pages.size(); j++)
-    outStr->printf(" %d 0 R", rootNum + j + 2);
-  outStr->printf(" ] /Count %zd >>\nendobj\n", pages.size());
+  for (int pageNum : pageNums)
+    outStr->printf(" %d 0 R", pageNum);
+  outStr->printf(" ] /Count %zd >>\nendobj\n", pageNums.size());
   objectsCount++;
 
-  for (i = 0; i < (int) pages.size(); i++) {
-    yRef->add(rootNum + i + 2, 0, outStr->getPos(), true);
-    outStr->printf("%d 0 obj\n", rootNum + i + 2);
-    outStr->printf("<< ");
-    Dict *pageDict = pages[i].getDict();
-    for (j = 0; j < pageDict->getLength(); j++) {
-      if (j > 0)
-	outStr->printf(" ");
-      const char *key = pageDict->getKey(j);
-      Object value = pageDict->getValNF(j).copy();
-      if (strcmp(key, "Parent") == 0) {
-        outStr->printf("/Parent %d 0 R", rootNum + 1);
-      } else {
-        outStr->printf("/%s ", key);
-        PDFDoc::writeObject(&value, outStr, yRef, offsets[i], nullptr, cryptRC4, 0, 0, 0);
-      }
-    }
-    outStr->printf(" >>\nendobj\n");
-    objectsCount++;
-  }
   Goffset uxrefOffset = outStr->getPos();
   Ref ref;
   ref.num = rootNum;
@@ -401,10 +762,25 @@ int main (int argc, char *argv[])
 
   outStr->close();
   delete outStr;
+  if (majorVersion != headerMajorVersion || minorVersion != headerMinorVersion) {
+    // the header was written before the other files were parsed; the
+    // versions are single digits, so the new one takes the same room
+    fflush(f);
+    if (majorVersion < 10 && minorVersion < 10 && headerMinorVersion < 10 &&
+        fseek(f, 0, SEEK_SET) == 0) {
+      outStr = new FileOutStream(f, 0);
+      PDFDoc::writeHeader(outStr, majorVersion, minorVersion);
+      outStr->close();
+      delete outStr;
+    } else {
+      error(errIO, -1, "Could not set the PDF version of '{0:s}' to {1:d}.{2:d}",
+            fileName, majorVersion, minorVersion);
+    }
+  }
   fclose(f);
   delete yRef;
   delete countRef;
-  for (i = 0; i < (int) docs.size (); i++) delete docs[i];
+  delete firstDoc;
   delete globalParams;
   return exitCode;
 }